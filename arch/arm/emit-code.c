@@ -4,6 +4,7 @@
 #include "jit/basic-block.h"
 #include "jit/lir-printer.h"
 #include "jit/exception.h"
+#include "jit/text.h"
 
 #include "vm/backtrace.h"
 #include "vm/call.h"
@@ -16,6 +17,7 @@
 #include "arch/itable.h"
 #include "arch/instruction.h"
 #include "arch/encode.h"
+#include "arch/text.h"
 
 void __attribute__((regparm(1)))
 itable_resolver_stub_error(struct vm_method *method, struct vm_object *obj)
@@ -38,6 +40,11 @@ void *emit_itable_resolver_stub(struct vm_class *vmc, struct itable_entry **sort
 	assert(!"not implemented");
 }
 
+void *emit_vtable_dispatch_stub(unsigned long virtual_index)
+{
+	assert(!"not implemented");
+}
+
 bool called_from_jit_trampoline(struct native_stack_frame *frame)
 {
 	assert(!"not implemented");
@@ -59,8 +66,7 @@ void emit_trampoline(struct compilation_unit *cu,
 {
 	struct buffer *buf = trampoline->objcode;
 
-	jit_text_lock();
-	buf->buf = jit_text_ptr();
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE);
 
 	/* Store FP and LR */
 	encode_stm(buf, 0b0100100000000000);
@@ -80,8 +86,7 @@ void emit_trampoline(struct compilation_unit *cu,
 	encode_restore_sp(buf, 4);
 	encode_ldm(buf, 0b1000100000000000);
 
-	jit_text_reserve(buffer_offset(buf));
-	jit_text_unlock();
+	jit_text_end(buffer_offset(buf));
 }
 
 void emit_jni_trampoline(struct buffer *b, struct vm_method *vm, void *v)
@@ -93,6 +98,15 @@ void fixup_direct_calls(struct jit_trampoline *trampoline, unsigned long target)
 {
 }
 
+void fixup_direct_call(unsigned char *site_addr, void *target)
+{
+}
+
+void emit_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	assert(!"not implemented");
+}
+
 void emit_unlock(struct buffer *buffer, struct vm_object *vo)
 {
 	assert(!"not implemented");
@@ -308,3 +308,8 @@ bool insn_is_mov_imm_reg(struct insn *insn)
 
 	return false;
 }
+
+void insn_semantics(struct insn *insn, struct insn_semantics *sem)
+{
+	assert(!"not implemented");
+}
@@ -28,9 +28,11 @@
 
 #include "jit/basic-block.h"
 #include "jit/compiler.h"
+#include "jit/text.h"
 
 #include "arch/instruction.h"
 #include "arch/encode.h"
+#include "arch/text.h"
 
 #include "lib/buffer.h"
 
@@ -61,6 +63,11 @@ void *emit_itable_resolver_stub(struct vm_class *vmc, struct itable_entry **sort
 	assert(!"not implemented");
 }
 
+void *emit_vtable_dispatch_stub(unsigned long virtual_index)
+{
+	assert(!"not implemented");
+}
+
 bool called_from_jit_trampoline(struct native_stack_frame *frame)
 {
 	assert(!"not implemented");
@@ -81,9 +88,7 @@ emit_trampoline(struct compilation_unit *cu, void *target_addr, struct jit_tramp
 {
 	struct buffer *b = t->objcode;
 
-	jit_text_lock();
-
-	b->buf = jit_text_ptr();
+	b->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE);
 
 	/* Allocate memory on the stack */
 	emit(b, stwu(1, -16, 1));
@@ -113,9 +118,7 @@ emit_trampoline(struct compilation_unit *cu, void *target_addr, struct jit_tramp
 	emit(b, mtctr(3));
 	emit(b, bctr());
 
-	jit_text_reserve(buffer_offset(b));
-
-	jit_text_unlock();
+	jit_text_end(buffer_offset(b));
 }
 
 void emit_jni_trampoline(struct buffer *b, struct vm_method *vm, void *v)
@@ -127,6 +130,15 @@ void fixup_direct_calls(struct jit_trampoline *trampoline, unsigned long target)
 {
 }
 
+void fixup_direct_call(unsigned char *site_addr, void *target)
+{
+}
+
+void emit_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	assert(!"not implemented");
+}
+
 void emit_unlock(struct buffer *buffer, struct vm_object *vo)
 {
 	assert(!"not implemented");
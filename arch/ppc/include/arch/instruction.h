@@ -45,6 +45,7 @@ enum insn_flag_type {
 	INSN_FLAG_SSA_ADDED		= 1U << 4, /* instruction added during SSA deconstruction */
 	INSN_FLAG_BACKPATCH_BRANCH	= 1U << 5,
 	INSN_FLAG_BACKPATCH_RESOLUTION	= 1U << 6,
+	INSN_FLAG_GC_MAP		= 1U << 7, /* GC point, see include/jit/gc-map.h */
 };
 
 struct insn {
@@ -4,4 +4,9 @@
 #define TEXT_ALIGNMENT		0
 #define TEXT_MAP_FLAGS		0
 
+/* Upper bounds for the size of emitted code, see jit_text_begin(). */
+#define TEXT_MAX_INSN_SIZE		64
+#define TEXT_MAX_METHOD_OVERHEAD	4096
+#define TEXT_MAX_STUB_SIZE		1024
+
 #endif /* JATO__PPC_TEXT_H */
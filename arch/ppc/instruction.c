@@ -25,6 +25,7 @@
  */
 
 #include "arch/instruction.h"
+#include "jit/instruction.h"
 
 #include <stdlib.h>
 
@@ -163,3 +164,8 @@ bool insn_is_mov_imm_reg(struct insn *insn)
 
 	return false;
 }
+
+void insn_semantics(struct insn *insn, struct insn_semantics *sem)
+{
+	assert(!"not implemented");
+}
@@ -8,6 +8,7 @@
 
 #include "jit/compilation-unit.h"
 #include "jit/cu-mapping.h"
+#include "jit/gc-map.h"
 #include "jit/instruction.h"
 #include "jit/inline-cache.h"
 #include "jit/bc-offset-mapping.h"
@@ -117,3 +118,28 @@ int insn_use_def(struct insn *insn)
 {
 	assert(!"not implemented");
 }
+
+bool insn_is_safepoint_poll(struct insn *insn)
+{
+	return false;
+}
+
+unsigned long register_state_get(struct register_state *regs, enum machine_reg reg)
+{
+	assert(!"not implemented");
+}
+
+unsigned long *jit_frame_callee_save_slot(struct compilation_unit *cu, void *frame, enum machine_reg reg)
+{
+	assert(!"not implemented");
+}
+
+unsigned long *jit_frame_this_slot(struct compilation_unit *cu, void *frame)
+{
+	assert(!"not implemented");
+}
+
+void *jit_frame_bottom(struct compilation_unit *cu, void *frame)
+{
+	assert(!"not implemented");
+}
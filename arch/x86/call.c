@@ -26,12 +26,15 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "arch/registers.h"
 
 #include "jit/args.h"
+#include "jit/exception.h"
 
 #include "vm/call.h"
+#include "vm/interp.h"
 #include "vm/method.h"
 #include "vm/stack-trace.h"
 
@@ -94,7 +97,7 @@ static void do_native_call_xmm(struct vm_method *method, void *target,
 		"	rep movsd			\n"
 		"	call *%[target]			\n"
 		"	movl %[result], %%edi		\n"
-		"	movss %%xmm0, (%%edi)		\n"
+		"	movsd %%xmm0, (%%edi)		\n"
 		"	addl %[stack_size], %%esp	\n"
 		:
 		: [target] "a" (target),
@@ -161,22 +164,45 @@ void native_call(struct vm_method *method, void *target,
 	}
 }
 
+/**
+ * interp_from_jit - runs a cold method called from JIT code
+ * @cu: compilation unit of the called method
+ * @regs: unused, all arguments are passed on the stack
+ * @stack: arguments of the call
+ * @result: return value that interp_entry() loads to %eax:%edx and %xmm0
+ *
+ * Returns the trampoline exception guard that interp_entry() tests to
+ * throw an exception that the method left pending.
+ */
+void *interp_from_jit(struct compilation_unit *cu, unsigned long *regs,
+		      unsigned long *stack, union jvalue *result)
+{
+	vm_interp_method_a(cu->method, stack, result);
+
+	return trampoline_exception_guard;
+}
+
 #else /* CONFIG_X86_32 */
 
 /**
  * Calls @method which address is obtained from a memory
  * pointed by @target. Function returns call result which
- * is supposed to be saved to %rax.
+ * is supposed to be saved to %rax. The content of %xmm0
+ * is stored to @xmm_result for methods returning floating
+ * point values.
  */
 static unsigned long native_call_gp(struct vm_method *method,
 				    const void *target,
-				    unsigned long *args)
+				    unsigned long *args,
+				    double *xmm_result)
 {
 	int i;
 	size_t reg_count = 0;
+	size_t xmm_count = 0;
 	size_t stack_count = 0;
 	struct vm_args_map *map = method->args_map;
 	unsigned long *stack, regs[6];
+	double xmm[8];
 	unsigned long result;
 	unsigned long stack_size;
 
@@ -187,6 +213,8 @@ static unsigned long native_call_gp(struct vm_method *method,
 	for (i = 0; i < method->args_count; i++) {
 		if (map[i].reg == MACH_REG_UNASSIGNED)
 			stack[stack_count++] = args[i];
+		else if (map[i].type == J_FLOAT || map[i].type == J_DOUBLE)
+			memcpy(&xmm[xmm_count++], &args[i], sizeof(double));
 		else
 			regs[reg_count++] = args[i];
 
@@ -198,8 +226,20 @@ static unsigned long native_call_gp(struct vm_method *method,
 	while (reg_count < 6)
 		regs[reg_count++] = 0;
 
+	while (xmm_count < 8)
+		xmm[xmm_count++] = 0;
+
 	stack_size = stack_count * sizeof(unsigned long);
 
+	register double xmm0 __asm__("xmm0") = xmm[0];
+	register double xmm1 __asm__("xmm1") = xmm[1];
+	register double xmm2 __asm__("xmm2") = xmm[2];
+	register double xmm3 __asm__("xmm3") = xmm[3];
+	register double xmm4 __asm__("xmm4") = xmm[4];
+	register double xmm5 __asm__("xmm5") = xmm[5];
+	register double xmm6 __asm__("xmm6") = xmm[6];
+	register double xmm7 __asm__("xmm7") = xmm[7];
+
 	__asm__ volatile (
 		/* Copy stack arguments onto the stack. */
 		"	movq %[stack], %%rsi		\n"
@@ -219,17 +259,24 @@ static unsigned long native_call_gp(struct vm_method *method,
 
 		"	call *%[target]			\n"
 		"	addq %[stack_size], %%rsp	\n"
-		: "=a" (result)
+		: "=a" (result),
+		  "+x" (xmm0), "+x" (xmm1), "+x" (xmm2), "+x" (xmm3),
+		  "+x" (xmm4), "+x" (xmm5), "+x" (xmm6), "+x" (xmm7)
 		: [target] "m" (target),
 		  [regs] "r" (regs),
 		  [stack] "r" (stack),
 		  [stack_count] "r" (stack_count),
 		  [stack_size] "b" (stack_size)
-		: "rdi", "rsi", "rdx", "rcx", "r8", "r9", "r10", "r11", "cc", "memory"
+		: "rdi", "rsi", "rdx", "rcx", "r8", "r9", "r10", "r11",
+		  "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15",
+		  "cc", "memory"
 	);
 
 	free(stack);
 
+	if (xmm_result)
+		*xmm_result = xmm0;
+
 	return result;
 }
 
@@ -244,34 +291,40 @@ void native_call(struct vm_method *method,
 		 unsigned long *args,
 		 union jvalue *result)
 {
+	double xmm_result;
+
 	switch (method->return_type.vm_type) {
 	case J_VOID:
-		native_call_gp(method, target, args);
+		native_call_gp(method, target, args, NULL);
 		break;
 	case J_REFERENCE:
-		result->l = (jobject) native_call_gp(method, target, args);
+		result->l = (jobject) native_call_gp(method, target, args, NULL);
 		break;
 	case J_INT:
-		result->i = (jint) native_call_gp(method, target, args);
+		result->i = (jint) native_call_gp(method, target, args, NULL);
 		break;
 	case J_CHAR:
-		result->c = (jchar) native_call_gp(method, target, args);
+		result->c = (jchar) native_call_gp(method, target, args, NULL);
 		break;
 	case J_BYTE:
-		result->b = (jbyte) native_call_gp(method, target, args);
+		result->b = (jbyte) native_call_gp(method, target, args, NULL);
 		break;
 	case J_SHORT:
-		result->s = (jshort) native_call_gp(method, target, args);
+		result->s = (jshort) native_call_gp(method, target, args, NULL);
 		break;
 	case J_BOOLEAN:
-		result->z = (jboolean) native_call_gp(method, target, args);
+		result->z = (jboolean) native_call_gp(method, target, args, NULL);
 		break;
 	case J_LONG:
-		result->j = (jlong) native_call_gp(method, target, args);
+		result->j = (jlong) native_call_gp(method, target, args, NULL);
 		break;
 	case J_DOUBLE:
+		native_call_gp(method, target, args, &xmm_result);
+		result->d = xmm_result;
+		break;
 	case J_FLOAT:
-		error("not implemented");
+		native_call_gp(method, target, args, &xmm_result);
+		memcpy(&result->f, &xmm_result, sizeof(jfloat));
 		break;
 	case J_RETURN_ADDRESS:
 	case VM_TYPE_MAX:
@@ -279,4 +332,44 @@ void native_call(struct vm_method *method,
 	}
 }
 
+/**
+ * interp_from_jit - runs a cold method called from JIT code
+ * @cu: compilation unit of the called method
+ * @regs: %rdi, %rsi, %rdx, %rcx, %r8, %r9 and %xmm0-%xmm7 of the call
+ * @stack: arguments of the call that were passed on the stack
+ * @result: return value that interp_entry() loads to %rax and %xmm0
+ *
+ * The arguments are collected the opposite way to native_call_gp().
+ * Returns the trampoline exception guard that interp_entry() tests to
+ * throw an exception that the method left pending.
+ */
+void *interp_from_jit(struct compilation_unit *cu, unsigned long *regs,
+		      unsigned long *stack, union jvalue *result)
+{
+	struct vm_method *method = cu->method;
+	struct vm_args_map *map = method->args_map;
+	unsigned long args[method->args_count + 1];
+	size_t reg_count = 0;
+	size_t xmm_count = 0;
+	size_t stack_count = 0;
+	int i;
+
+	for (i = 0; i < method->args_count; i++) {
+		if (map[i].reg == MACH_REG_UNASSIGNED)
+			args[i] = stack[stack_count++];
+		else if (map[i].type == J_FLOAT || map[i].type == J_DOUBLE)
+			args[i] = regs[6 + xmm_count++];
+		else
+			args[i] = regs[reg_count++];
+
+		/* Skip duplicate slots. */
+		if (map[i].type == J_LONG || map[i].type == J_DOUBLE)
+			args[++i] = 0;
+	}
+
+	vm_interp_method_a(method, args, result);
+
+	return trampoline_exception_guard;
+}
+
 #endif /* CONFIG_X86_32 */
@@ -30,6 +30,7 @@
 
 #include "arch/instruction.h"
 #include "arch/stack-frame.h"
+#include "arch/text.h"
 #include "arch/encode.h"
 #include "arch/itable.h"
 #include "arch/memory.h"
@@ -54,6 +55,7 @@
 #include "lib/list.h"
 
 #include "vm/backtrace.h"
+#include "vm/class.h"
 #include "vm/method.h"
 #include "vm/object.h"
 
@@ -547,6 +549,24 @@ static void emit_mov_reg_memindex(struct insn *insn, struct buffer *buf, struct
 	emit(buf, x86_encode_sib(insn->dest.shift, encode_reg(&insn->dest.index_reg), encode_reg(&insn->dest.base_reg)));
 }
 
+/*
+ * Dirties the card of the object address in the destination register.
+ * The source register holds the biased card table, see gc_card_mark().
+ */
+static void emit_card_mark_reg_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	/* shr $GC_CARD_SHIFT, %addr */
+	emit(buf, 0xc1);
+	emit(buf, x86_encode_mod_rm(0x03, 0x05, encode_reg(&insn->dest.reg)));
+	emit(buf, GC_CARD_SHIFT);
+
+	/* movb $GC_CARD_DIRTY, (%table, %addr, 1) */
+	emit(buf, 0xc6);
+	emit(buf, x86_encode_mod_rm(0x00, 0x00, 0x04));
+	emit(buf, x86_encode_sib(0x00, encode_reg(&insn->dest.reg), encode_reg(&insn->src.reg)));
+	emit(buf, GC_CARD_DIRTY);
+}
+
 static void emit_alu_imm_reg(struct buffer *buf, unsigned char opc_ext,
 			     long imm, enum machine_reg reg)
 {
@@ -594,6 +614,11 @@ static void emit_test_imm_memdisp(struct insn *insn, struct buffer *buf, struct
 	__emit_test_imm_memdisp(buf, insn->src.imm, insn->dest.disp);
 }
 
+static void emit_inc_memdisp(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_memdisp(buf, 0xff, insn->operand.disp, 0);
+}
+
 static void emit_save_callee_save_regs(struct buffer *buf)
 {
 	int i;
@@ -912,9 +937,7 @@ void emit_trampoline(struct compilation_unit *cu,
 {
 	struct buffer *buf = trampoline->objcode;
 
-	jit_text_lock();
-
-	buf->buf = jit_text_ptr();
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE);
 
 	/* This is for __builtin_return_address() to work and to access
 	   call arguments in correct manner. */
@@ -950,10 +973,12 @@ void emit_trampoline(struct compilation_unit *cu,
 	}
 
 	__emit_pop_reg(buf, MACH_REG_EBP);
+
+	/* For interp_entry() which finds the method from it. */
+	__emit_mov_imm_reg(buf, (unsigned long) cu, MACH_REG_ECX);
 	emit_indirect_jump_reg(buf, MACH_REG_EAX);
 
-	jit_text_reserve(buffer_offset(buf));
-	jit_text_unlock();
+	jit_text_end(buffer_offset(buf));
 }
 
 void emit_lock(struct buffer *buf, struct vm_object *obj)
@@ -1047,14 +1072,134 @@ void emit_ic_miss_handler(struct buffer *buf, void *ic_check, struct vm_method *
 	emit_indirect_jump_reg(buf, MACH_REG_EAX);
 }
 
+/*
+ * The receiver class is in %ecx as loaded at the call site. Classes that
+ * are not in the stub are handed to resolve_pic_miss() via ic_pic_miss.
+ */
+void *emit_pic_stub(struct ic_site *site)
+{
+	static struct buffer_operations exec_buf_ops = {
+		.expand = NULL,
+		.free   = NULL,
+	};
+
+	struct buffer *buf = __alloc_buffer(&exec_buf_ops);
+	unsigned int i;
+	void *stub;
+
+	buf->buf = jit_text_begin(JIT_TEXT_IC_STUBS, TEXT_MAX_STUB_SIZE);
+
+	for (i = 0; i < site->nr_entries; i++) {
+		uint8_t *je_addr;
+
+		__emit_cmp_imm_reg(buf, 1, (long) site->classes[i], MACH_REG_ECX);
+
+		/* open-coded "je" */
+		emit(buf, 0x0f);
+		emit(buf, 0x84);
+
+		je_addr = buffer_current(buf);
+		emit_imm32(buf, 0);
+
+		fixup_branch_target(je_addr, site->targets[i]);
+	}
+
+	__emit_mov_imm_reg(buf, (long) site, MACH_REG_EAX);
+	__emit_jmp(buf, (unsigned long) ic_pic_miss);
+
+	site->stub_size = buffer_offset(buf);
+
+	jit_text_end(buffer_offset(buf));
+
+	stub = buffer_ptr(buf);
+	free_buffer(buf);
+
+	return stub;
+}
+
+/*
+ * Array index checks that fail call a stub that is shared by all checks
+ * of the same registers in the compilation unit. The stub tail calls
+ * vm_object_check_array() so that the stack trace of the exception
+ * points at the check. The check then calls exception_throw().
+ */
+static void emit_array_check_membase_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	unsigned long skip, call_offset;
+
+	/* cmp array_length(%ref), %index */
+	__emit_membase_reg(buf, 0x3b, mach_reg(&insn->src.base_reg),
+			   insn->src.disp, mach_reg(&insn->dest.reg));
+
+	/* Unsigned comparison catches negative indices too. */
+	emit(buf, 0x72);	/* jb */
+	skip = buffer_offset(buf);
+	emit(buf, 0);
+
+	/* The stub is filled in when the slow path is emitted. */
+	emit(buf, 0xe8);
+	call_offset = buffer_offset(buf);
+	emit_imm32(buf, 0);
+
+	/* Drop the arguments and the copy of the return address. */
+	__emit_add_imm_reg(buf, 3 * PTR_SIZE, MACH_REG_ESP);
+	__emit_call(buf, exception_throw);
+
+	((unsigned char *) buffer_ptr(buf))[skip] = buffer_offset(buf) - skip - 1;
+
+	if (!alloc_slow_path(bb->b_parent, insn, call_offset))
+		die("out of memory");
+}
+
+static bool same_array_check_regs(struct insn *insn, struct insn *other)
+{
+	return other->type == INSN_ARRAY_CHECK_MEMBASE_REG
+		&& mach_reg(&other->src.base_reg) == mach_reg(&insn->src.base_reg)
+		&& mach_reg(&other->dest.reg) == mach_reg(&insn->dest.reg);
+}
+
+static void emit_array_check_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	struct insn *insn = sp->insn;
+	struct slow_path *stub;
+
+	/* The first check of the registers owns the stub. */
+	list_for_each_entry(stub, &sp->cu->slow_path_list, list_node) {
+		if (same_array_check_regs(insn, stub->insn))
+			break;
+	}
+
+	write_imm32(buf, sp->branch_offset,
+		    stub->start - sp->branch_offset - 4);
+
+	if (stub != sp)
+		return;
+
+	__emit_push_reg(buf, mach_reg(&insn->dest.reg));
+	__emit_push_reg(buf, mach_reg(&insn->src.base_reg));
+
+	/* Return to the check with the arguments in place. */
+	__emit_push_membase(buf, MACH_REG_ESP, 2 * PTR_SIZE);
+	__emit_jmp(buf, (unsigned long) vm_object_check_array);
+}
+
+void emit_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	switch (sp->insn->type) {
+	case INSN_ARRAY_CHECK_MEMBASE_REG:
+		emit_array_check_slow_path(buf, sp);
+		break;
+	default:
+		die("no slow path for instruction type %d", sp->insn->type);
+	}
+}
+
 extern void jni_trampoline(void);
 
 void emit_jni_trampoline(struct buffer *buf, struct vm_method *vmm,
 			 void *target)
 {
-	jit_text_lock();
-
-	buf->buf = jit_text_ptr();
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE);
 
 	__emit_pop_reg(buf, MACH_REG_xAX);	/* return address */
 
@@ -1065,8 +1210,7 @@ void emit_jni_trampoline(struct buffer *buf, struct vm_method *vmm,
 	__emit_push_reg(buf, MACH_REG_xBP);
 	__emit_jmp(buf, (unsigned long) jni_trampoline);
 
-	jit_text_reserve(buffer_offset(buf));
-	jit_text_unlock();
+	jit_text_end(buffer_offset(buf));
 }
 
 /* The regparm(1) makes GCC get the first argument from %ecx and the rest
@@ -1175,9 +1319,7 @@ void *emit_itable_resolver_stub(struct vm_class *vmc,
 
 	struct buffer *buf = __alloc_buffer(&exec_buf_ops);
 
-	jit_text_lock();
-
-	buf->buf = jit_text_ptr();
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE + nr_entries * TEXT_MAX_INSN_SIZE);
 
 	/* Note: When the stub is called, %eax contains the signature hash that
 	 * we look up in the stub. 0(%esp) contains the object reference. %ecx
@@ -1190,8 +1332,38 @@ void *emit_itable_resolver_stub(struct vm_class *vmc,
 
 	emit_itable_bsearch(buf, table, 0, nr_entries - 1);
 
-	jit_text_reserve(buffer_offset(buf));
-	jit_text_unlock();
+	jit_text_end(buffer_offset(buf));
+
+	return buffer_ptr(buf);
+}
+
+/*
+ * Emits a stub that jumps to the vtable entry @virtual_index of the
+ * receiver's class. Devirtualized call sites are redirected to the stub
+ * when the class hierarchy assumption they were compiled with no longer
+ * holds. See jit/cha.c for details.
+ */
+void *emit_vtable_dispatch_stub(unsigned long virtual_index)
+{
+	static struct buffer_operations exec_buf_ops = {
+		.expand = NULL,
+		.free   = NULL,
+	};
+
+	struct buffer *buf = __alloc_buffer(&exec_buf_ops);
+
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE);
+
+	/* Note: When the stub is called, 4(%esp) contains the object reference
+	 * and 0(%esp) the return address. %eax is available here because it's
+	 * clobbered by the call anyway. */
+	__emit_membase_reg(buf, 0x8b, MACH_REG_ESP, sizeof(unsigned long), MACH_REG_EAX);
+	__emit_membase_reg(buf, 0x8b, MACH_REG_EAX, offsetof(struct vm_object, class), MACH_REG_EAX);
+	__emit_membase_reg(buf, 0x8b, MACH_REG_EAX, offsetof(struct vm_class, vtable.native_ptr), MACH_REG_EAX);
+	__emit_add_imm_reg(buf, sizeof(void *) * virtual_index, MACH_REG_EAX);
+	emit_really_indirect_jump_reg(buf, MACH_REG_EAX);
+
+	jit_text_end(buffer_offset(buf));
 
 	return buffer_ptr(buf);
 }
@@ -1211,8 +1383,10 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_ADD_IMM_REG, insn_encode),
 	DECL_EMITTER(INSN_ADD_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_AND_REG_REG, insn_encode),
+	DECL_EMITTER(INSN_ARRAY_CHECK_MEMBASE_REG, emit_array_check_membase_reg),
 	DECL_EMITTER(INSN_CALL_REG, insn_encode),
 	DECL_EMITTER(INSN_CALL_REL, emit_call),
+	DECL_EMITTER(INSN_CARD_MARK_REG_REG, emit_card_mark_reg_reg),
 	DECL_EMITTER(INSN_CLTD_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_DIVSD_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_DIVSS_XMM_XMM, insn_encode),
@@ -1266,7 +1440,9 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_RET, insn_encode),
 	DECL_EMITTER(INSN_SAR_IMM_REG, insn_encode),
 	DECL_EMITTER(INSN_SAR_REG_REG, insn_encode),
+	DECL_EMITTER(INSN_SHL_IMM_REG, insn_encode),
 	DECL_EMITTER(INSN_SHL_REG_REG, insn_encode),
+	DECL_EMITTER(INSN_SHR_IMM_REG, insn_encode),
 	DECL_EMITTER(INSN_SHR_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_SUBSD_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_SUBSS_XMM_XMM, insn_encode),
@@ -1327,6 +1503,7 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_SBB_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_SUB_MEMBASE_REG, insn_encode),
 	DECL_EMITTER(INSN_TEST_IMM_MEMDISP, emit_test_imm_memdisp),
+	DECL_EMITTER(INSN_INC_MEMDISP, emit_inc_memdisp),
 	DECL_EMITTER(INSN_TEST_MEMBASE_REG, insn_encode),
 	DECL_EMITTER(INSN_SAVE_CALLER_REGS, emit_pseudo),
 	DECL_EMITTER(INSN_RESTORE_CALLER_REGS, emit_pseudo),
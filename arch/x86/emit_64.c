@@ -30,6 +30,7 @@
 
 #include "arch/instruction.h"
 #include "arch/stack-frame.h"
+#include "arch/text.h"
 #include "arch/encode.h"
 #include "arch/itable.h"
 #include "arch/memory.h"
@@ -46,6 +47,7 @@
 #include "jit/statement.h"
 #include "jit/compiler.h"
 #include "jit/debug.h"
+#include "jit/emulate.h"
 #include "jit/exception.h"
 #include "jit/emit-code.h"
 #include "jit/text.h"
@@ -54,8 +56,11 @@
 #include "lib/list.h"
 
 #include "vm/backtrace.h"
+#include "vm/class.h"
 #include "vm/method.h"
 #include "vm/object.h"
+#include "vm/thread.h"
+#include "vm/tlab.h"
 
 #include <stdbool.h>
 #include <assert.h>
@@ -74,11 +79,6 @@
 
 #define PTR_SIZE	sizeof(long)
 
-static unsigned char encode_reg(struct use_position *reg)
-{
-	return x86_encode_reg(mach_reg(reg));
-}
-
 static inline unsigned char reg_low(unsigned char reg)
 {
 	return reg & 0x7;
@@ -289,6 +289,26 @@ static void emit_jl_branch(struct insn *insn, struct buffer *buf, struct basic_b
 	__emit_branch(buf, bb, 0x0f, 0x8c, insn);
 }
 
+static void emit_ja_branch(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_branch(buf, bb, 0x0f, 0x87, insn);
+}
+
+static void emit_jae_branch(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_branch(buf, bb, 0x0f, 0x83, insn);
+}
+
+static void emit_jb_branch(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_branch(buf, bb, 0x0f, 0x82, insn);
+}
+
+static void emit_jbe_branch(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_branch(buf, bb, 0x0f, 0x86, insn);
+}
+
 static void emit_jmp_branch(struct insn *insn, struct buffer *buf, struct basic_block *bb)
 {
 	__emit_branch(buf, bb, 0x00, 0xe9, insn);
@@ -346,6 +366,7 @@ static int has_legacy_prefix(unsigned char *str, size_t len)
 		return 0;
 
 	switch (str[0]) {
+		case 0x66:
 		case 0xF2:
 		case 0xF3:
 			return 1;
@@ -782,6 +803,53 @@ static void __emit_reg_memdisp(struct buffer *buf,
 	__emit_memdisp(buf, rex_w, opc, disp, x86_encode_reg(reg));
 }
 
+static void __emit_lopc_memdisp(struct buffer *buf,
+				unsigned char *lopc,
+				size_t lopc_size,
+				unsigned long disp,
+				unsigned char reg_opcode)
+{
+	unsigned char rex_pfx = 0;
+
+	if (reg_high(reg_opcode))
+		rex_pfx |= REX_R;
+
+	emit_lopc(buf, rex_pfx, lopc, lopc_size);
+	emit(buf, x86_encode_mod_rm(0, reg_opcode, 5));
+	emit_imm32(buf, rip_relative(buf, disp, 4));
+}
+
+static void __emit_sse_memdisp(struct buffer *buf,
+			       unsigned char prefix,
+			       unsigned char opc,
+			       unsigned long disp,
+			       enum machine_reg reg)
+{
+	unsigned char lopc[3] = { prefix, 0x0F, opc };
+
+	__emit_lopc_memdisp(buf, lopc, 3, disp, x86_encode_reg(reg));
+}
+
+static void emit_movss_memdisp_xmm(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_sse_memdisp(buf, 0xF3, 0x10, insn->src.imm, mach_reg(&insn->dest.reg));
+}
+
+static void emit_movsd_memdisp_xmm(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_sse_memdisp(buf, 0xF2, 0x10, insn->src.imm, mach_reg(&insn->dest.reg));
+}
+
+static void emit_movss_xmm_memdisp(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_sse_memdisp(buf, 0xF3, 0x11, insn->dest.imm, mach_reg(&insn->src.reg));
+}
+
+static void emit_movsd_xmm_memdisp(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_sse_memdisp(buf, 0xF2, 0x11, insn->dest.imm, mach_reg(&insn->src.reg));
+}
+
 static void emit_mov_reg_memdisp(struct insn *insn, struct buffer *buf, struct basic_block *bb)
 {
 	int rex_w = is_64bit_reg(&insn->src);
@@ -976,6 +1044,11 @@ static void emit_test_imm_memdisp(struct insn *insn, struct buffer *buf, struct
 	__emit_test_imm_memdisp(buf, 0, insn->src.imm, insn->dest.disp);
 }
 
+static void emit_inc_memdisp(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	__emit_memdisp(buf, 1, 0xff, insn->operand.disp, 0);
+}
+
 static void __emit_lopc_memindex(struct buffer *buf,
 				 int rex_w,
 				 unsigned char *lopc,
@@ -1053,6 +1126,28 @@ static void emit_mov_reg_memindex(struct insn *insn, struct buffer *buf, struct
 			    mach_reg(&insn->dest.base_reg));
 }
 
+/*
+ * Dirties the card of the object address in the destination register.
+ * The source register holds the biased card table, see gc_card_mark().
+ */
+static void emit_card_mark_reg_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg table = mach_reg(&insn->src.reg);
+	enum machine_reg addr = mach_reg(&insn->dest.reg);
+	unsigned char __addr = x86_encode_reg(addr);
+	unsigned char opc = 0xc6;
+
+	/* shr $GC_CARD_SHIFT, %addr */
+	emit(buf, reg_high(__addr) ? REX_W | REX_B : REX_W);
+	emit(buf, 0xc1);
+	emit(buf, x86_encode_mod_rm(0x03, 0x05, reg_low(__addr)));
+	emit(buf, GC_CARD_SHIFT);
+
+	/* movb $GC_CARD_DIRTY, (%table, %addr, 1) */
+	__emit_lopc_memindex(buf, 0, &opc, 1, 0, addr, table, 0x00);
+	emit(buf, GC_CARD_DIRTY);
+}
+
 static void __emit_mov_imm_membase(struct buffer *buf, long imm, enum machine_reg base, long disp)
 {
 	__emit_membase(buf, 0, 0xc7, base, disp, 0);
@@ -1129,33 +1224,119 @@ static void emit_conv_fpu_to_fpu(struct insn *insn, struct buffer *buf, struct b
 	__emit_lopc_reg_reg(buf, 0, opc, 3, dest, src);
 }
 
-static void __emit_div_mul_reg_rax(struct buffer *buf,
-				   struct operand *src,
-				   struct operand *dest,
-				   unsigned char opc_ext)
+static void emit_ucomis_xmm_xmm(struct insn *insn, struct buffer *buf, struct basic_block *bb)
 {
-	unsigned char rex_pfx = 0, rm;
+	enum machine_reg src, dest;
+	unsigned char opc[3];
+	size_t len = 0;
 
-	assert(mach_reg(&dest->reg) == MACH_REG_RAX);
+	src = mach_reg(&insn->src.reg);
+	dest = mach_reg(&insn->dest.reg);
+
+	/* UCOMISD has an operand size prefix, UCOMISS has none. */
+	if (insn->type == INSN_UCOMISD_XMM_XMM)
+		opc[len++] = 0x66;
+	opc[len++] = 0x0F;
+	opc[len++] = 0x2E;
+
+	__emit_lopc_reg_reg(buf, 0, opc, len, dest, src);
+}
+
+/*
+ * Turns the flags of a preceding ucomiss/ucomisd into the fcmpl/dcmpl
+ * result: 1 if above, 0 if equal and -1 if below or unordered.
+ */
+static void emit_fcmp_flags_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg dest = mach_reg(&insn->dest.reg);
+	unsigned char reg_num = x86_encode_reg(dest);
+
+	/* mov $0, %dest is used because xor would clobber the flags. */
+	__emit_reg(buf, 0, 0xb8, dest);
+	emit_imm32(buf, 0);
+
+	/* seta %dest8, needs a REX prefix for %sil, %dil and friends */
+	if (reg_high(reg_num))
+		emit(buf, REX | REX_B);
+	else if (reg_num >= 4)
+		emit(buf, REX);
+	emit(buf, 0x0f);
+	emit(buf, 0x97);
+	emit(buf, x86_encode_mod_rm(0x3, 0x00, reg_low(reg_num)));
+
+	/* sbb $0, %dest */
+	emit_alu_imm_reg(buf, 0, 0x03, 0, dest);
+}
+
+/*
+ * Emits a one-operand instruction whose opcode is extended by the reg
+ * field of the ModR/M byte.
+ */
+static void __emit_opc_ext_reg(struct buffer *buf,
+			       int rex_w,
+			       unsigned char opc,
+			       unsigned char opc_ext,
+			       enum machine_reg reg)
+{
+	unsigned char rex_pfx = 0, rm;
 
-	rm = encode_reg(&src->reg);
+	rm = x86_encode_reg(reg);
 
-	if (is_64bit_reg(src))
+	if (rex_w)
 		rex_pfx |= REX_W;
 	if (reg_high(rm))
 		rex_pfx |= REX_B;
 
 	if (rex_pfx)
 		emit(buf, rex_pfx);
-	emit(buf, 0xF7);
+	emit(buf, opc);
 	emit(buf, x86_encode_mod_rm(0x03, opc_ext, rm));
 }
 
+static void __emit_div_mul_reg_rax(struct buffer *buf,
+				   struct operand *src,
+				   struct operand *dest,
+				   unsigned char opc_ext)
+{
+	assert(mach_reg(&dest->reg) == MACH_REG_RAX);
+
+	__emit_opc_ext_reg(buf, is_64bit_reg(src), 0xF7, opc_ext, mach_reg(&src->reg));
+}
+
 static void emit_div_reg_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
 {
 	__emit_div_mul_reg_rax(buf, &insn->src, &insn->dest, 0x07);
 }
 
+/*
+ * The shift count is in %cl, which is a fixed register and thus always
+ * 64-bit, so the operand size comes from the shifted register alone. The
+ * CPU masks the count to five bits for 32-bit shifts and to six bits for
+ * 64-bit shifts, which is what Java expects.
+ */
+static void emit_shift_reg_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	unsigned char opc_ext;
+
+	assert(mach_reg(&insn->src.reg) == MACH_REG_RCX);
+
+	switch (insn->type) {
+	case INSN_SHL_REG_REG:
+		opc_ext = 0x04;
+		break;
+	case INSN_SHR_REG_REG:
+		opc_ext = 0x05;
+		break;
+	case INSN_SAR_REG_REG:
+		opc_ext = 0x07;
+		break;
+	default:
+		die("unknown shift instruction type %d", insn->type);
+	}
+
+	__emit_opc_ext_reg(buf, is_64bit_reg(&insn->dest), 0xd3, opc_ext, mach_reg(&insn->dest.reg));
+}
+
 static void __emit64_push_xmm(struct buffer *buf, enum machine_reg reg)
 {
 	unsigned char opc[3] = { 0xF2, 0x0F, 0x11 };	/* MOVSD */
@@ -1323,9 +1504,7 @@ void emit_trampoline(struct compilation_unit *cu,
 {
 	struct buffer *buf = trampoline->objcode;
 
-	jit_text_lock();
-
-	buf->buf = jit_text_ptr();
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE);
 
 	/* This is for __builtin_return_address() to work and to access
 	   call arguments in correct manner. */
@@ -1375,10 +1554,12 @@ void emit_trampoline(struct compilation_unit *cu,
 	emit_restore_arg_regs(buf);
 
 	__emit_pop_reg(buf, MACH_REG_RBP);
+
+	/* For interp_entry() which finds the method from it. */
+	__emit_mov_imm_reg(buf, (unsigned long) cu, MACH_REG_R10);
 	emit_indirect_jump_reg(buf, MACH_REG_RAX);
 
-	jit_text_reserve(buffer_offset(buf));
-	jit_text_unlock();
+	jit_text_end(buffer_offset(buf));
 }
 
 static void emit_exception_test(struct buffer *buf, enum machine_reg reg)
@@ -1392,8 +1573,97 @@ static void emit_exception_test(struct buffer *buf, enum machine_reg reg)
 	__emit64_test_membase_reg(buf, reg, 0, reg);
 }
 
+static void emit_load_exec_env(struct buffer *buf, enum machine_reg reg)
+{
+	/* mov fs:(0xXXX), %reg */
+	emit(buf, 0x64);
+	__emit_memdisp_reg(buf, 1, 0x8b,
+		get_thread_local_offset(&current_exec_env), reg);
+}
+
+/*
+ * Emits a forward branch whose target is filled in later by
+ * resolve_forward_branch(). Returns the offset of the displacement.
+ */
+static unsigned long emit_forward_branch(struct buffer *buf, unsigned char opc)
+{
+	unsigned long offset;
+
+	if (opc != 0xe9)
+		emit(buf, 0x0f);
+	emit(buf, opc);
+
+	offset = buffer_offset(buf);
+	emit_imm32(buf, 0);
+
+	return offset;
+}
+
+static void resolve_forward_branch(struct buffer *buf, unsigned long offset)
+{
+	write_imm32(buf, offset, buffer_offset(buf) - offset - 4);
+}
+
+/*
+ * Thin lock fast paths (see include/vm/monitor.h). Locking swaps the
+ * current thread's lock word into an unlocked object with one cmpxchg
+ * and leaves ZF set on success. Clobbers %rax and @scratch.
+ */
+static void emit_thin_lock(struct buffer *buf, enum machine_reg obj,
+			   enum machine_reg scratch)
+{
+	unsigned char cmpxchg[2] = { 0x0f, 0xb1 };
+
+	emit_load_exec_env(buf, scratch);
+	__emit64_mov_membase_reg(buf, scratch,
+				 offsetof(struct vm_exec_env, thin_lock_word), scratch);
+
+	/* xor %eax, %eax */
+	__emit_reg_reg(buf, 0, 0x31, MACH_REG_RAX, MACH_REG_RAX);
+
+	/* lock cmpxchg %scratch, monitor_record(%obj) */
+	emit(buf, 0xf0);
+	__emit_lopc_reg_membase(buf, 1, cmpxchg, 2, scratch, obj,
+				offsetof(struct vm_object, monitor_record));
+}
+
+/*
+ * Sets ZF when the object is thin locked by current thread without
+ * recursion so that it can be released with emit_thin_unlock().
+ * Clobbers @scratch.
+ */
+static void emit_thin_unlock_test(struct buffer *buf, enum machine_reg obj,
+				  enum machine_reg scratch)
+{
+	emit_load_exec_env(buf, scratch);
+	__emit64_mov_membase_reg(buf, scratch,
+				 offsetof(struct vm_exec_env, thin_lock_word), scratch);
+
+	/* cmp %scratch, monitor_record(%obj) */
+	__emit_reg_membase(buf, 1, 0x39, scratch, obj,
+			   offsetof(struct vm_object, monitor_record));
+}
+
+/*
+ * Only the owner writes a thin lock word and x86 does not reorder stores,
+ * so a plain store releases the lock.
+ */
+static void emit_thin_unlock(struct buffer *buf, enum machine_reg obj)
+{
+	/* movq $0, monitor_record(%obj) */
+	__emit_membase(buf, 1, 0xc7, obj,
+		       offsetof(struct vm_object, monitor_record), 0);
+	emit_imm32(buf, 0);
+}
+
 void emit_lock(struct buffer *buf, struct vm_object *obj)
 {
+	unsigned long done;
+
+	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_R10);
+	emit_thin_lock(buf, MACH_REG_R10, MACH_REG_R11);
+	done = emit_forward_branch(buf, 0x84);	/* je */
+
 	emit_save_arg_regs(buf);
 
 	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_RDI);
@@ -1404,10 +1674,22 @@ void emit_lock(struct buffer *buf, struct vm_object *obj)
 	__emit_push_reg(buf, MACH_REG_RAX);
 	emit_exception_test(buf, MACH_REG_RAX);
 	__emit_pop_reg(buf, MACH_REG_RAX);
+
+	resolve_forward_branch(buf, done);
 }
 
 void emit_unlock(struct buffer *buf, struct vm_object *obj)
 {
+	unsigned long slow, done;
+
+	__emit_mov_imm_reg(buf, (unsigned long) obj, MACH_REG_R10);
+	emit_thin_unlock_test(buf, MACH_REG_R10, MACH_REG_R11);
+	slow = emit_forward_branch(buf, 0x85);	/* jne */
+	emit_thin_unlock(buf, MACH_REG_R10);
+	done = emit_forward_branch(buf, 0xe9);	/* jmp */
+
+	resolve_forward_branch(buf, slow);
+
 	__emit_push_reg(buf, MACH_REG_RAX);
 	emit_save_arg_regs(buf);
 
@@ -1418,13 +1700,19 @@ void emit_unlock(struct buffer *buf, struct vm_object *obj)
 
 	emit_restore_arg_regs(buf);
 	__emit_pop_reg(buf, MACH_REG_RAX);
+
+	resolve_forward_branch(buf, done);
 }
 
 void emit_lock_this(struct buffer *buf, unsigned long frame_size)
 {
 	unsigned long this_offset = frame_size + 8 * NR_CALLEE_SAVE_REGS + 8;
+	unsigned long done;
 
 	__emit64_mov_membase_reg(buf, MACH_REG_RBP, - this_offset, MACH_REG_RDI);
+	emit_thin_lock(buf, MACH_REG_RDI, MACH_REG_R11);
+	done = emit_forward_branch(buf, 0x84);	/* je */
+
 	emit_save_arg_regs(buf);
 	__emit_call(buf, vm_object_lock);
 	emit_restore_arg_regs(buf);
@@ -1432,13 +1720,23 @@ void emit_lock_this(struct buffer *buf, unsigned long frame_size)
 	__emit_push_reg(buf, MACH_REG_RAX);
 	emit_exception_test(buf, MACH_REG_RAX);
 	__emit_pop_reg(buf, MACH_REG_RAX);
+
+	resolve_forward_branch(buf, done);
 }
 
 void emit_unlock_this(struct buffer *buf, unsigned long frame_size)
 {
 	unsigned long this_offset = frame_size + 8 * NR_CALLEE_SAVE_REGS + 8;
+	unsigned long slow, done;
 
 	__emit64_mov_membase_reg(buf, MACH_REG_RBP, - this_offset, MACH_REG_RDI);
+	emit_thin_unlock_test(buf, MACH_REG_RDI, MACH_REG_R11);
+	slow = emit_forward_branch(buf, 0x85);	/* jne */
+	emit_thin_unlock(buf, MACH_REG_RDI);
+	done = emit_forward_branch(buf, 0xe9);	/* jmp */
+
+	resolve_forward_branch(buf, slow);
+
 	__emit_push_reg(buf, MACH_REG_RAX);
 	emit_save_arg_regs(buf);
 	__emit_call(buf, vm_object_unlock);
@@ -1447,16 +1745,738 @@ void emit_unlock_this(struct buffer *buf, unsigned long frame_size)
 
 	emit_restore_arg_regs(buf);
 	__emit_pop_reg(buf, MACH_REG_RAX);
+
+	resolve_forward_branch(buf, done);
 }
 
 
+/*
+ * Array index checks that fail call a stub that is shared by all checks
+ * of the same registers in the compilation unit. The stub tail calls
+ * vm_object_check_array() so that the stack trace of the exception
+ * points at the check. The check then calls exception_throw().
+ */
+static void emit_array_check_membase_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	unsigned long skip, call_offset;
+
+	/* cmp array_length(%ref), %index */
+	emit_membase_reg(buf, 0, 0x3b, &insn->src, &insn->dest);
+
+	/* Unsigned comparison catches negative indices too. */
+	emit(buf, 0x72);	/* jb */
+	skip = buffer_offset(buf);
+	emit(buf, 0);
+
+	/* The stub is filled in when the slow path is emitted. */
+	emit(buf, 0xe8);
+	call_offset = buffer_offset(buf);
+	emit_imm32(buf, 0);
+
+	__emit_call(buf, exception_throw);
+
+	((unsigned char *) buffer_ptr(buf))[skip] = buffer_offset(buf) - skip - 1;
+
+	if (!alloc_slow_path(bb->b_parent, insn, call_offset))
+		die("out of memory");
+}
+
+static bool same_array_check_regs(struct insn *insn, struct insn *other)
+{
+	return other->type == INSN_ARRAY_CHECK_MEMBASE_REG
+		&& mach_reg(&other->src.base_reg) == mach_reg(&insn->src.base_reg)
+		&& mach_reg(&other->dest.reg) == mach_reg(&insn->dest.reg);
+}
+
+static void emit_array_check_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	struct insn *insn = sp->insn;
+	enum machine_reg ref, index;
+	struct slow_path *stub;
+
+	/* The first check of the registers owns the stub. */
+	list_for_each_entry(stub, &sp->cu->slow_path_list, list_node) {
+		if (same_array_check_regs(insn, stub->insn))
+			break;
+	}
+
+	write_imm32(buf, sp->branch_offset,
+		    stub->start - sp->branch_offset - 4);
+
+	if (stub != sp)
+		return;
+
+	ref = mach_reg(&insn->src.base_reg);
+	index = mach_reg(&insn->dest.reg);
+
+	/* Go through the stack so that %ref can live in %rsi. */
+	__emit_push_reg(buf, ref);
+	__emit_mov_reg_reg(buf, index, MACH_REG_RSI);
+	__emit_pop_reg(buf, MACH_REG_RDI);
+	__emit_jmp(buf, (unsigned long) vm_object_check_array);
+}
+
+static struct slow_path *
+emit_slow_path_branch(struct buffer *buf, struct basic_block *bb,
+		      struct insn *insn, unsigned char opc)
+{
+	struct slow_path *sp;
+
+	sp = alloc_slow_path(bb->b_parent, insn, emit_forward_branch(buf, opc));
+	if (!sp)
+		die("out of memory");
+
+	return sp;
+}
+
+/*
+ * Classes which were not initialized at compile time need a runtime check
+ * because only vm_object_alloc() and friends run the class initializer.
+ */
+static struct slow_path *
+emit_class_init_check(struct buffer *buf, struct basic_block *bb,
+		      struct insn *insn, enum machine_reg class_reg)
+{
+	/* cmpl $VM_CLASS_INITIALIZED, state(%class_reg) */
+	__emit_membase(buf, 0, 0x83, class_reg, offsetof(struct vm_class, state), 0x07);
+	emit(buf, VM_CLASS_INITIALIZED);
+
+	return emit_slow_path_branch(buf, bb, insn, 0x85);	/* jne */
+}
+
+/*
+ * Pops the head of the TLAB free list at @disp(%rcx) into %rax, where
+ * %rcx points into the current execution environment.
+ */
+static struct slow_path *
+emit_tlab_pop(struct buffer *buf, struct basic_block *bb,
+	      struct insn *insn, unsigned long disp)
+{
+	struct slow_path *sp;
+
+	__emit64_mov_membase_reg(buf, MACH_REG_RCX, disp, MACH_REG_RAX);
+	__emit_reg_reg(buf, 1, 0x85, MACH_REG_RAX, MACH_REG_RAX);
+
+	sp = emit_slow_path_branch(buf, bb, insn, 0x84);	/* je */
+
+	__emit64_mov_membase_reg(buf, MACH_REG_RAX, 0, MACH_REG_R8);
+	__emit_mov_reg_membase(buf, 1, MACH_REG_R8, MACH_REG_RCX, disp);
+
+	return sp;
+}
+
+static void emit_object_header(struct buffer *buf, enum machine_reg class_reg)
+{
+	__emit_mov_reg_membase(buf, 1, class_reg, MACH_REG_RAX,
+			       offsetof(struct vm_object, class));
+
+	/* movq $0, monitor_record(%rax) */
+	__emit_membase(buf, 1, 0xc7, MACH_REG_RAX,
+		       offsetof(struct vm_object, monitor_record), 0);
+	emit_imm32(buf, 0);
+}
+
+static void emit_tlab_alloc_object(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	struct vm_class *vmc = (struct vm_class *) insn->operand.imm;
+	struct slow_path *sp[2];
+	unsigned long disp;
+	unsigned int i, nr_sp = 0;
+
+	disp = offsetof(struct vm_exec_env, tlab.free_lists)
+		+ tlab_index(sizeof(struct vm_object) + vmc->object_size) * sizeof(void *);
+
+	/* The class is passed in %rdi for vm_object_alloc() */
+	if (vmc->state != VM_CLASS_INITIALIZED)
+		sp[nr_sp++] = emit_class_init_check(buf, bb, insn, MACH_REG_RDI);
+
+	emit_load_exec_env(buf, MACH_REG_RCX);
+	sp[nr_sp++] = emit_tlab_pop(buf, bb, insn, disp);
+	emit_object_header(buf, MACH_REG_RDI);
+
+	for (i = 0; i < nr_sp; i++)
+		sp[i]->resume_offset = buffer_offset(buf);
+}
+
+static unsigned int array_elem_shift(struct vm_class *vmc)
+{
+	switch (vmtype_get_size(vm_class_get_storage_vmtype(vmc->array_element_class))) {
+	case 1:
+		return 0;
+	case 2:
+		return 1;
+	case 4:
+		return 2;
+	default:
+		return 3;
+	}
+}
+
+static void emit_tlab_alloc_array(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	struct vm_class *vmc = (struct vm_class *) insn->operand.imm;
+	unsigned int i, nr_sp = 0, shift;
+	struct slow_path *sp[3];
+	unsigned long max_count;
+	unsigned long lists;
+
+	shift = array_elem_shift(vmc);
+	max_count = (TLAB_MAX_SIZE - sizeof(struct vm_array)) >> shift;
+
+	/*
+	 * The element count is in %rsi and %rdi holds the first argument of
+	 * the allocation function. Negative counts have already been
+	 * rejected so the unsigned compare only filters large arrays.
+	 */
+	emit_alu_imm_reg(buf, 0, 0x07, max_count, MACH_REG_RSI);
+	sp[nr_sp++] = emit_slow_path_branch(buf, bb, insn, 0x87);	/* ja */
+
+	__emit_mov_imm_reg(buf, (unsigned long) vmc, MACH_REG_RDX);
+	if (vmc->state != VM_CLASS_INITIALIZED)
+		sp[nr_sp++] = emit_class_init_check(buf, bb, insn, MACH_REG_RDX);
+
+	/*
+	 * Free lists are indexed by size in TLAB_GRANULE units, so the size
+	 * rounded up to a granule is also the byte offset of the list.
+	 */
+	__emit_reg_reg(buf, 0, 0x89, MACH_REG_RSI, MACH_REG_RAX);
+	if (shift) {
+		/* shl $shift, %rax */
+		emit(buf, REX_W);
+		emit(buf, 0xc1);
+		emit(buf, x86_encode_mod_rm(0x3, 0x04, x86_encode_reg(MACH_REG_RAX)));
+		emit(buf, shift);
+	}
+	__emit_add_imm_reg(buf, sizeof(struct vm_array) + TLAB_GRANULE - 1, MACH_REG_RAX);
+	emit_alu_imm_reg(buf, 1, 0x04, -(long) TLAB_GRANULE, MACH_REG_RAX);
+
+	if (vm_class_is_primitive_class(vmc->array_element_class))
+		lists = offsetof(struct vm_exec_env, tlab.noscan_free_lists);
+	else
+		lists = offsetof(struct vm_exec_env, tlab.free_lists);
+
+	emit_load_exec_env(buf, MACH_REG_RCX);
+	__emit_reg_reg(buf, 1, 0x01, MACH_REG_RAX, MACH_REG_RCX);
+	sp[nr_sp++] = emit_tlab_pop(buf, bb, insn, lists);
+
+	emit_object_header(buf, MACH_REG_RDX);
+	__emit_mov_reg_membase(buf, 0, MACH_REG_RSI, MACH_REG_RAX,
+			       offsetof(struct vm_array, array_length));
+
+	for (i = 0; i < nr_sp; i++)
+		sp[i]->resume_offset = buffer_offset(buf);
+}
+
+static void emit_tlab_alloc_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	struct insn *insn = sp->insn;
+	struct vm_class *vmc;
+
+	write_imm32(buf, sp->branch_offset,
+		    buffer_offset(buf) - sp->branch_offset - 4);
+
+	vmc = (struct vm_class *) insn->operand.imm;
+
+	/* Arguments are still in %rdi and %rsi as set up by the selector. */
+	if (insn->type == INSN_TLAB_ALLOC_OBJECT)
+		__emit_call(buf, vm_object_alloc);
+	else if (vm_class_is_primitive_class(vmc->array_element_class))
+		__emit_call(buf, vm_object_alloc_primitive_array);
+	else
+		__emit_call(buf, vm_object_alloc_array);
+
+	__emit_jmp(buf, (unsigned long) buffer_ptr(buf) + sp->resume_offset);
+}
+
+/*
+ * The monitor and type check instructions clobber only %rax, %rcx and %rdx
+ * so their slow paths preserve the other caller saved registers around the
+ * call.
+ */
+static enum machine_reg slow_path_saved_gp_regs[] = {
+	MACH_REG_RSI,
+	MACH_REG_RDI,
+	MACH_REG_R8,
+	MACH_REG_R9,
+	MACH_REG_R10,
+	MACH_REG_R11,
+};
+
+static void emit_save_slow_path_regs(struct buffer *buf)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(slow_path_saved_gp_regs); i++)
+		__emit_push_reg(buf, slow_path_saved_gp_regs[i]);
+
+	for (i = MACH_REG_XMM0; i <= MACH_REG_XMM15; i++)
+		__emit64_push_xmm(buf, i);
+}
+
+static void emit_restore_slow_path_regs(struct buffer *buf)
+{
+	unsigned int i;
+
+	for (i = MACH_REG_XMM15 + 1; i-- > MACH_REG_XMM0; )
+		__emit64_pop_xmm(buf, i);
+
+	for (i = ARRAY_SIZE(slow_path_saved_gp_regs); i-- > 0; )
+		__emit_pop_reg(buf, slow_path_saved_gp_regs[i]);
+}
+
+/*
+ * The object may have been allocated to %rax which the thin lock fast
+ * path needs for cmpxchg. It is moved to %rdx in that case.
+ */
+static enum machine_reg monitor_obj_reg(struct insn *insn)
+{
+	enum machine_reg obj = mach_reg(&insn->src.reg);
+
+	if (obj == MACH_REG_RAX)
+		return MACH_REG_RDX;
+
+	return obj;
+}
+
+static enum machine_reg monitor_scratch_reg(enum machine_reg obj)
+{
+	return obj == MACH_REG_RCX ? MACH_REG_RDX : MACH_REG_RCX;
+}
+
+static void emit_monitor_enter_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg obj = monitor_obj_reg(insn);
+	struct slow_path *sp;
+
+	if (obj != mach_reg(&insn->src.reg))
+		__emit_mov_reg_reg(buf, MACH_REG_RAX, obj);
+
+	emit_thin_lock(buf, obj, monitor_scratch_reg(obj));
+	sp = emit_slow_path_branch(buf, bb, insn, 0x85);	/* jne */
+	sp->resume_offset = buffer_offset(buf);
+}
+
+static void emit_monitor_exit_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg obj = monitor_obj_reg(insn);
+	struct slow_path *sp;
+
+	if (obj != mach_reg(&insn->src.reg))
+		__emit_mov_reg_reg(buf, MACH_REG_RAX, obj);
+
+	emit_thin_unlock_test(buf, obj, monitor_scratch_reg(obj));
+	sp = emit_slow_path_branch(buf, bb, insn, 0x85);	/* jne */
+	emit_thin_unlock(buf, obj);
+	sp->resume_offset = buffer_offset(buf);
+}
+
+static void emit_monitor_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	struct insn *insn = sp->insn;
+
+	write_imm32(buf, sp->branch_offset,
+		    buffer_offset(buf) - sp->branch_offset - 4);
+
+	emit_save_slow_path_regs(buf);
+
+	__emit_mov_reg_reg(buf, monitor_obj_reg(insn), MACH_REG_RDI);
+	if (insn->type == INSN_MONITOR_ENTER_REG)
+		__emit_call(buf, vm_object_lock);
+	else
+		__emit_call(buf, vm_object_unlock);
+
+	/* Test while registers are saved; exception_check() clobbers them. */
+	if (running_on_valgrind)
+		__emit_call(buf, exception_check);
+	else
+		emit_exception_test(buf, MACH_REG_RAX);
+
+	emit_restore_slow_path_regs(buf);
+
+	__emit_jmp(buf, (unsigned long) buffer_ptr(buf) + sp->resume_offset);
+}
+
+/*
+ * The object is kept intact for the slow path so the type check uses the
+ * two registers out of %rax, %rcx and %rdx that do not hold it.
+ */
+static void type_check_scratch_regs(enum machine_reg obj,
+				    enum machine_reg *class_reg,
+				    enum machine_reg *super_reg)
+{
+	switch (obj) {
+	case MACH_REG_RCX:
+		*class_reg = MACH_REG_RDX;
+		*super_reg = MACH_REG_RAX;
+		break;
+	case MACH_REG_RDX:
+		*class_reg = MACH_REG_RCX;
+		*super_reg = MACH_REG_RAX;
+		break;
+	default:
+		*class_reg = MACH_REG_RCX;
+		*super_reg = MACH_REG_RDX;
+		break;
+	}
+}
+
+/*
+ * Compares @vmc against the class of the non-null object in @obj and
+ * sets ZF on a match. For primary types the display entry at the depth
+ * of @vmc is checked, which answers the check either way. For other
+ * types only the secondary supertype cache is checked and a mismatch
+ * must be resolved by the slow path.
+ */
+static void emit_type_check(struct buffer *buf, enum machine_reg obj,
+			    struct vm_class *vmc)
+{
+	enum machine_reg class_reg, super_reg;
+	unsigned long disp;
+
+	type_check_scratch_regs(obj, &class_reg, &super_reg);
+
+	if (vm_class_is_primary_type(vmc))
+		disp = offsetof(struct vm_class, primary_supers)
+			+ vmc->depth * sizeof(struct vm_class *);
+	else
+		disp = offsetof(struct vm_class, secondary_super_cache);
+
+	__emit64_mov_membase_reg(buf, obj, offsetof(struct vm_object, class), class_reg);
+	__emit_mov_imm_reg(buf, (unsigned long) vmc, super_reg);
+
+	/* cmp %super_reg, disp(%class_reg) */
+	__emit_reg_membase(buf, 1, 0x39, super_reg, class_reg, disp);
+}
+
+static void emit_checkcast_imm_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	struct vm_class *vmc = (struct vm_class *) insn->src.imm;
+	enum machine_reg obj = mach_reg(&insn->dest.reg);
+	unsigned long null_branch;
+	struct slow_path *sp;
+
+	__emit_reg_reg(buf, 1, 0x85, obj, obj);
+	null_branch = emit_forward_branch(buf, 0x84);	/* je */
+
+	emit_type_check(buf, obj, vmc);
+	sp = emit_slow_path_branch(buf, bb, insn, 0x85);	/* jne */
+
+	resolve_forward_branch(buf, null_branch);
+	sp->resume_offset = buffer_offset(buf);
+}
+
+static void emit_instanceof_imm_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	struct vm_class *vmc = (struct vm_class *) insn->src.imm;
+	enum machine_reg obj = mach_reg(&insn->dest.reg);
+	unsigned long null_branch, done;
+	struct slow_path *sp = NULL;
+
+	__emit_reg_reg(buf, 1, 0x85, obj, obj);
+	null_branch = emit_forward_branch(buf, 0x84);	/* je */
+
+	emit_type_check(buf, obj, vmc);
+	if (!vm_class_is_primary_type(vmc))
+		sp = emit_slow_path_branch(buf, bb, insn, 0x85);	/* jne */
+
+	/* sete %al; movzbl %al, %eax */
+	emit(buf, 0x0f);
+	emit(buf, 0x94);
+	emit(buf, 0xc0);
+	emit(buf, 0x0f);
+	emit(buf, 0xb6);
+	emit(buf, 0xc0);
+	done = emit_forward_branch(buf, 0xe9);
+
+	resolve_forward_branch(buf, null_branch);
+	__emit_reg_reg(buf, 0, 0x31, MACH_REG_RAX, MACH_REG_RAX);
+
+	resolve_forward_branch(buf, done);
+	if (sp)
+		sp->resume_offset = buffer_offset(buf);
+}
+
+static void emit_type_check_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	struct insn *insn = sp->insn;
+
+	write_imm32(buf, sp->branch_offset,
+		    buffer_offset(buf) - sp->branch_offset - 4);
+
+	emit_save_slow_path_regs(buf);
+
+	__emit_mov_reg_reg(buf, mach_reg(&insn->dest.reg), MACH_REG_RDI);
+	__emit_mov_imm_reg(buf, insn->src.imm, MACH_REG_RSI);
+
+	if (insn->type == INSN_CHECKCAST_IMM_REG) {
+		__emit_call(buf, vm_object_check_cast);
+
+		/* Test while registers are saved; exception_check() clobbers them. */
+		if (running_on_valgrind)
+			__emit_call(buf, exception_check);
+		else
+			emit_exception_test(buf, MACH_REG_RAX);
+	} else {
+		__emit_call(buf, vm_object_is_instance_of);
+
+		/* movzbl %al, %eax */
+		emit(buf, 0x0f);
+		emit(buf, 0xb6);
+		emit(buf, 0xc0);
+	}
+
+	emit_restore_slow_path_regs(buf);
+
+	__emit_jmp(buf, (unsigned long) buffer_ptr(buf) + sp->resume_offset);
+}
+
+/*
+ * Signed division of %rdx:%rax by the source register which leaves the
+ * quotient in %rax and the remainder in %rdx. The selector has already
+ * sign extended the dividend into %rdx. A zero divisor branches to the
+ * slow path. idiv raises #DE for MIN_VALUE / -1 whereas Java wants
+ * MIN_VALUE with a zero remainder so a divisor of -1 is done with neg.
+ */
+static void emit_div_check_reg_reg(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg divisor = mach_reg(&insn->src.reg);
+	int rex_w = is_64bit_reg(&insn->src);
+	unsigned long not_minus_one, done;
+
+	assert(mach_reg(&insn->dest.reg) == MACH_REG_RAX);
+	assert(divisor != MACH_REG_RAX && divisor != MACH_REG_RDX);
+
+	/* test %divisor, %divisor */
+	__emit_reg_reg(buf, rex_w, 0x85, divisor, divisor);
+	emit_slow_path_branch(buf, bb, insn, 0x84);	/* je */
+
+	__emit_cmp_imm_reg(buf, rex_w, -1, divisor);
+	not_minus_one = emit_forward_branch(buf, 0x85);	/* jne */
+
+	/* neg %rax; xor %edx, %edx */
+	__emit_opc_ext_reg(buf, rex_w, 0xf7, 0x03, MACH_REG_RAX);
+	__emit_reg_reg(buf, 0, 0x31, MACH_REG_RDX, MACH_REG_RDX);
+	done = emit_forward_branch(buf, 0xe9);
+
+	resolve_forward_branch(buf, not_minus_one);
+
+	/* idiv %divisor */
+	__emit_opc_ext_reg(buf, rex_w, 0xf7, 0x07, divisor);
+
+	resolve_forward_branch(buf, done);
+}
+
+static void emit_div_check_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	write_imm32(buf, sp->branch_offset,
+		    buffer_offset(buf) - sp->branch_offset - 4);
+
+	__emit_call(buf, emulate_division_by_zero);
+
+	/* The exception is always pending so the test does not fall through. */
+	if (running_on_valgrind)
+		__emit_call(buf, exception_check);
+	else
+		emit_exception_test(buf, MACH_REG_RAX);
+
+	__emit_jmp(buf, (unsigned long) buffer_ptr(buf) + sp->resume_offset);
+}
+
+/*
+ * Truncating float or double to int or long conversion. cvttss2si and
+ * cvttsd2si return MIN_VALUE for NaN and for values that don't fit the
+ * destination. cmp $1 overflows only for MIN_VALUE so all of those, and
+ * the rare genuine MIN_VALUE, branch to the slow path which computes
+ * the Java result without calling out of the compiled code.
+ */
+static void emit_conv_fpu_to_gpr_trunc(struct insn *insn, struct buffer *buf, struct basic_block *bb)
+{
+	enum machine_reg src, dest;
+	unsigned char opc[3];
+	struct slow_path *sp;
+	int rex_w;
+
+	src = mach_reg(&insn->src.reg);
+	dest = mach_reg(&insn->dest.reg);
+
+	if (!is_64bit_reg(&insn->src))
+		opc[0] = 0xF3;
+	else
+		opc[0] = 0xF2;
+	opc[1] = 0x0F;
+	opc[2] = 0x2C;
+
+	rex_w = is_64bit_reg(&insn->dest);
+
+	__emit_lopc_reg_reg(buf, rex_w, opc, 3, dest, src);
+
+	__emit_cmp_imm_reg(buf, rex_w, 1, dest);
+	sp = emit_slow_path_branch(buf, bb, insn, 0x80);	/* jo */
+
+	sp->resume_offset = buffer_offset(buf);
+}
+
+/*
+ * NaN converts to zero. Anything else left here is out of range or
+ * MIN_VALUE itself so the sign of the source selects between MIN_VALUE
+ * and MAX_VALUE.
+ */
+static void emit_conv_fpu_to_gpr_trunc_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	struct insn *insn = sp->insn;
+	enum machine_reg src, dest;
+	unsigned char opc[3], reg_num;
+	unsigned long nan;
+	size_t len = 0;
+	int rex_w;
+
+	src = mach_reg(&insn->src.reg);
+	dest = mach_reg(&insn->dest.reg);
+	rex_w = is_64bit_reg(&insn->dest);
+
+	write_imm32(buf, sp->branch_offset,
+		    buffer_offset(buf) - sp->branch_offset - 4);
+
+	/* ucomis %src, %src sets PF only for NaN */
+	if (is_64bit_reg(&insn->src))
+		opc[len++] = 0x66;
+	opc[len++] = 0x0F;
+	opc[len++] = 0x2E;
+	__emit_lopc_reg_reg(buf, 0, opc, len, src, src);
+
+	nan = emit_forward_branch(buf, 0x8a);	/* jp */
+
+	/* movmskps/movmskpd %src, %dest puts the sign in bit 0 */
+	opc[len - 1] = 0x50;
+	__emit_lopc_reg_reg(buf, 0, opc, len, dest, src);
+	emit_alu_imm_reg(buf, 0, 0x04, 1, dest);
+
+	/* 1 - 1 = 0 and 0 - 1 = ~0, flipping the sign bit gives MIN or MAX */
+	emit_alu_imm_reg(buf, rex_w, 0x05, 1, dest);
+
+	/* btc $31 or $63, %dest */
+	reg_num = x86_encode_reg(dest);
+	if (rex_w || reg_high(reg_num))
+		emit(buf, (rex_w ? REX_W : 0) | (reg_high(reg_num) ? REX_B : 0));
+	emit(buf, 0x0f);
+	emit(buf, 0xba);
+	emit(buf, x86_encode_mod_rm(0x3, 0x07, reg_low(reg_num)));
+	emit(buf, rex_w ? 63 : 31);
+
+	__emit_jmp(buf, (unsigned long) buffer_ptr(buf) + sp->resume_offset);
+
+	resolve_forward_branch(buf, nan);
+
+	/* xor %dest, %dest */
+	__emit_reg_reg(buf, 0, 0x31, dest, dest);
+
+	__emit_jmp(buf, (unsigned long) buffer_ptr(buf) + sp->resume_offset);
+}
+
+void emit_slow_path(struct buffer *buf, struct slow_path *sp)
+{
+	switch (sp->insn->type) {
+	case INSN_ARRAY_CHECK_MEMBASE_REG:
+		emit_array_check_slow_path(buf, sp);
+		break;
+	case INSN_CONV_FPU_TO_GPR_TRUNC:
+		emit_conv_fpu_to_gpr_trunc_slow_path(buf, sp);
+		break;
+	case INSN_DIV_CHECK_REG_REG:
+		emit_div_check_slow_path(buf, sp);
+		break;
+	case INSN_CHECKCAST_IMM_REG:
+	case INSN_INSTANCEOF_IMM_REG:
+		emit_type_check_slow_path(buf, sp);
+		break;
+	case INSN_MONITOR_ENTER_REG:
+	case INSN_MONITOR_EXIT_REG:
+		emit_monitor_slow_path(buf, sp);
+		break;
+	case INSN_TLAB_ALLOC_ARRAY:
+	case INSN_TLAB_ALLOC_OBJECT:
+		emit_tlab_alloc_slow_path(buf, sp);
+		break;
+	default:
+		die("no slow path for instruction type %d", sp->insn->type);
+	}
+}
+
+static uint8_t *emit_open_jcc(struct buffer *buf, unsigned char opc)
+{
+	uint8_t *disp_addr;
+
+	emit(buf, 0x0f);
+	emit(buf, opc);
+
+	disp_addr = buffer_current(buf);
+	emit_imm32(buf, 0);
+
+	return disp_addr;
+}
+
 void *emit_ic_check(struct buffer *buf)
 {
-	return NULL;
+	__emit_reg_reg(buf, 1, 0x39, IC_IMM_REG, IC_CLASS_REG);
+
+	/* open-coded "jne" */
+	return emit_open_jcc(buf, 0x85);
 }
 
+/*
+ * The call site's return address is still on top of the stack because
+ * the prolog has not run yet. ic_miss saves the argument registers and
+ * calls resolve_ic_miss().
+ */
 void emit_ic_miss_handler(struct buffer *buf, void *ic_check, struct vm_method *vmm)
 {
+	fixup_branch_target(ic_check, buffer_current(buf));
+
+	__emit_mov_imm_reg(buf, (long) vmm, IC_IMM_REG);
+	__emit_jmp(buf, (unsigned long) ic_miss);
+}
+
+/*
+ * The receiver class is in %r11 as loaded at the call site. %rax is free
+ * because it is not used for passing arguments. Classes that are not in
+ * the stub are handed to resolve_pic_miss() via ic_pic_miss.
+ */
+void *emit_pic_stub(struct ic_site *site)
+{
+	static struct buffer_operations exec_buf_ops = {
+		.expand = NULL,
+		.free   = NULL,
+	};
+
+	struct buffer *buf = __alloc_buffer(&exec_buf_ops);
+	unsigned int i;
+	void *stub;
+
+	buf->buf = jit_text_begin(JIT_TEXT_IC_STUBS, TEXT_MAX_STUB_SIZE);
+
+	for (i = 0; i < site->nr_entries; i++) {
+		uint8_t *je_addr;
+
+		__emit_mov_imm_reg(buf, (long) site->classes[i], MACH_REG_RAX);
+		__emit_reg_reg(buf, 1, 0x39, MACH_REG_RAX, IC_CLASS_REG);
+
+		/* open-coded "je" */
+		je_addr = emit_open_jcc(buf, 0x84);
+
+		fixup_branch_target(je_addr, site->targets[i]);
+	}
+
+	__emit_mov_imm_reg(buf, (long) site, MACH_REG_RAX);
+	__emit_jmp(buf, (unsigned long) ic_pic_miss);
+
+	site->stub_size = buffer_offset(buf);
+
+	jit_text_end(buffer_offset(buf));
+
+	stub = buffer_ptr(buf);
+	free_buffer(buf);
+
+	return stub;
 }
 
 extern void jni_trampoline(void);
@@ -1464,9 +2484,7 @@ extern void jni_trampoline(void);
 void emit_jni_trampoline(struct buffer *buf, struct vm_method *vmm,
 			 void *target)
 {
-	jit_text_lock();
-
-	buf->buf = jit_text_ptr();
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE);
 
 	__emit_pop_reg(buf, MACH_REG_xAX);	/* return address */
 
@@ -1479,8 +2497,7 @@ void emit_jni_trampoline(struct buffer *buf, struct vm_method *vmm,
 	__emit_push_reg(buf, MACH_REG_xBP);
 	__emit_jmp(buf, (unsigned long) jni_trampoline);
 
-	jit_text_reserve(buffer_offset(buf));
-	jit_text_unlock();
+	jit_text_end(buffer_offset(buf));
 }
 
 /* The regparm(1) makes GCC get the first argument from %ecx and the rest
@@ -1589,9 +2606,7 @@ void *emit_itable_resolver_stub(struct vm_class *vmc,
 
 	struct buffer *buf = __alloc_buffer(&exec_buf_ops);
 
-	jit_text_lock();
-
-	buf->buf = jit_text_ptr();
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE + nr_entries * TEXT_MAX_INSN_SIZE);
 
 	/* Note: When the stub is called, %eax contains the signature hash that
 	 * we look up in the stub. 0(%esp) contains the object reference. %ecx
@@ -1604,8 +2619,37 @@ void *emit_itable_resolver_stub(struct vm_class *vmc,
 
 	emit_itable_bsearch(buf, table, 0, nr_entries - 1);
 
-	jit_text_reserve(buffer_offset(buf));
-	jit_text_unlock();
+	jit_text_end(buffer_offset(buf));
+
+	return buffer_ptr(buf);
+}
+
+/*
+ * Emits a stub that jumps to the vtable entry @virtual_index of the
+ * receiver's class. Devirtualized call sites are redirected to the stub
+ * when the class hierarchy assumption they were compiled with no longer
+ * holds. See jit/cha.c for details.
+ */
+void *emit_vtable_dispatch_stub(unsigned long virtual_index)
+{
+	static struct buffer_operations exec_buf_ops = {
+		.expand = NULL,
+		.free   = NULL,
+	};
+
+	struct buffer *buf = __alloc_buffer(&exec_buf_ops);
+
+	buf->buf = jit_text_begin(JIT_TEXT_STUBS, TEXT_MAX_STUB_SIZE);
+
+	/* Note: When the stub is called, %rdi contains the object reference.
+	 * %rax is available here because it's not used for passing arguments
+	 * and is clobbered by the call anyway. */
+	__emit64_mov_membase_reg(buf, MACH_REG_RDI, offsetof(struct vm_object, class), MACH_REG_RAX);
+	__emit64_mov_membase_reg(buf, MACH_REG_RAX, offsetof(struct vm_class, vtable.native_ptr), MACH_REG_RAX);
+	__emit_add_imm_reg(buf, sizeof(void *) * virtual_index, MACH_REG_RAX);
+	emit_really_indirect_jump_reg(buf, MACH_REG_RAX);
+
+	jit_text_end(buffer_offset(buf));
 
 	return buffer_ptr(buf);
 }
@@ -1625,8 +2669,11 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_ADD_IMM_REG, insn_encode),
 	DECL_EMITTER(INSN_ADD_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_AND_REG_REG, insn_encode),
+	DECL_EMITTER(INSN_ARRAY_CHECK_MEMBASE_REG, emit_array_check_membase_reg),
 	DECL_EMITTER(INSN_CALL_REG, insn_encode),
 	DECL_EMITTER(INSN_CALL_REL, emit_call),
+	DECL_EMITTER(INSN_CARD_MARK_REG_REG, emit_card_mark_reg_reg),
+	DECL_EMITTER(INSN_CHECKCAST_IMM_REG, emit_checkcast_imm_reg),
 	DECL_EMITTER(INSN_CLTD_REG_REG, insn_encode),
 	DECL_EMITTER(INSN_DIVSD_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_DIVSS_XMM_XMM, insn_encode),
@@ -1634,6 +2681,11 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_FLD_MEMLOCAL, insn_encode),
 	DECL_EMITTER(INSN_FSTP_64_MEMLOCAL, insn_encode),
 	DECL_EMITTER(INSN_FSTP_MEMLOCAL, insn_encode),
+	DECL_EMITTER(INSN_INSTANCEOF_IMM_REG, emit_instanceof_imm_reg),
+	DECL_EMITTER(INSN_JAE_BRANCH, emit_jae_branch),
+	DECL_EMITTER(INSN_JA_BRANCH, emit_ja_branch),
+	DECL_EMITTER(INSN_JBE_BRANCH, emit_jbe_branch),
+	DECL_EMITTER(INSN_JB_BRANCH, emit_jb_branch),
 	DECL_EMITTER(INSN_JE_BRANCH, emit_je_branch),
 	DECL_EMITTER(INSN_JGE_BRANCH, emit_jge_branch),
 	DECL_EMITTER(INSN_JG_BRANCH, emit_jg_branch),
@@ -1643,18 +2695,20 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_JMP_MEMBASE, insn_encode),
 	DECL_EMITTER(INSN_JMP_MEMINDEX, insn_encode),
 	DECL_EMITTER(INSN_JNE_BRANCH, emit_jne_branch),
+	DECL_EMITTER(INSN_MONITOR_ENTER_REG, emit_monitor_enter_reg),
+	DECL_EMITTER(INSN_MONITOR_EXIT_REG, emit_monitor_exit_reg),
 	DECL_EMITTER(INSN_MOVSD_MEMBASE_XMM, insn_encode),
-	DECL_EMITTER(INSN_MOVSD_MEMDISP_XMM, insn_encode),
+	DECL_EMITTER(INSN_MOVSD_MEMDISP_XMM, emit_movsd_memdisp_xmm),
 	DECL_EMITTER(INSN_MOVSD_MEMLOCAL_XMM, insn_encode),
 	DECL_EMITTER(INSN_MOVSD_XMM_MEMBASE, insn_encode),
-	DECL_EMITTER(INSN_MOVSD_XMM_MEMDISP, insn_encode),
+	DECL_EMITTER(INSN_MOVSD_XMM_MEMDISP, emit_movsd_xmm_memdisp),
 	DECL_EMITTER(INSN_MOVSD_XMM_MEMLOCAL, insn_encode),
 	DECL_EMITTER(INSN_MOVSD_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_MOVSS_MEMBASE_XMM, insn_encode),
-	DECL_EMITTER(INSN_MOVSS_MEMDISP_XMM, insn_encode),
+	DECL_EMITTER(INSN_MOVSS_MEMDISP_XMM, emit_movss_memdisp_xmm),
 	DECL_EMITTER(INSN_MOVSS_MEMLOCAL_XMM, insn_encode),
 	DECL_EMITTER(INSN_MOVSS_XMM_MEMBASE, insn_encode),
-	DECL_EMITTER(INSN_MOVSS_XMM_MEMDISP, insn_encode),
+	DECL_EMITTER(INSN_MOVSS_XMM_MEMDISP, emit_movss_xmm_memdisp),
 	DECL_EMITTER(INSN_MOVSS_XMM_MEMLOCAL, insn_encode),
 	DECL_EMITTER(INSN_MOVSS_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_MOVSXD_REG_REG, insn_encode),
@@ -1679,9 +2733,8 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_PUSH_REG, insn_encode),
 	DECL_EMITTER(INSN_RET, insn_encode),
 	DECL_EMITTER(INSN_SAR_IMM_REG, insn_encode),
-	DECL_EMITTER(INSN_SAR_REG_REG, insn_encode),
-	DECL_EMITTER(INSN_SHL_REG_REG, insn_encode),
-	DECL_EMITTER(INSN_SHR_REG_REG, insn_encode),
+	DECL_EMITTER(INSN_SHL_IMM_REG, insn_encode),
+	DECL_EMITTER(INSN_SHR_IMM_REG, insn_encode),
 	DECL_EMITTER(INSN_SUBSD_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_SUBSS_XMM_XMM, insn_encode),
 	DECL_EMITTER(INSN_SUB_IMM_REG, insn_encode),
@@ -1694,10 +2747,13 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_CMP_MEMBASE_REG, emit_cmp_membase_reg),
 	DECL_EMITTER(INSN_CMP_REG_REG, emit_cmp_reg_reg),
 	DECL_EMITTER(INSN_CONV_FPU_TO_GPR, emit_conv_fpu_to_gpr),
+	DECL_EMITTER(INSN_CONV_FPU_TO_GPR_TRUNC, emit_conv_fpu_to_gpr_trunc),
 	DECL_EMITTER(INSN_CONV_GPR_TO_FPU, emit_conv_gpr_to_fpu),
 	DECL_EMITTER(INSN_CONV_XMM_TO_XMM64, emit_conv_fpu_to_fpu),
 	DECL_EMITTER(INSN_CONV_XMM64_TO_XMM, emit_conv_fpu_to_fpu),
+	DECL_EMITTER(INSN_DIV_CHECK_REG_REG, emit_div_check_reg_reg),
 	DECL_EMITTER(INSN_DIV_REG_REG, emit_div_reg_reg),
+	DECL_EMITTER(INSN_FCMP_FLAGS_REG, emit_fcmp_flags_reg),
 	DECL_EMITTER(INSN_MOV_MEMBASE_REG, emit_mov_membase_reg),
 	DECL_EMITTER(INSN_MOV_MEMDISP_REG, emit_mov_memdisp_reg),
 	DECL_EMITTER(INSN_MOV_MEMINDEX_REG, emit_mov_memindex_reg),
@@ -1711,8 +2767,16 @@ static emit_fn_t emitters[] = {
 	DECL_EMITTER(INSN_MOV_THREAD_LOCAL_MEMDISP_REG, emit_mov_thread_local_memdisp_reg),
 	DECL_EMITTER(INSN_MUL_REG_REG, emit_mul_reg_reg),
 	DECL_EMITTER(INSN_PUSH_IMM, emit_push_imm),
+	DECL_EMITTER(INSN_SAR_REG_REG, emit_shift_reg_reg),
+	DECL_EMITTER(INSN_SHL_REG_REG, emit_shift_reg_reg),
+	DECL_EMITTER(INSN_SHR_REG_REG, emit_shift_reg_reg),
 	DECL_EMITTER(INSN_TEST_MEMBASE_REG, emit_test_membase_reg),
+	DECL_EMITTER(INSN_TLAB_ALLOC_ARRAY, emit_tlab_alloc_array),
+	DECL_EMITTER(INSN_TLAB_ALLOC_OBJECT, emit_tlab_alloc_object),
 	DECL_EMITTER(INSN_TEST_IMM_MEMDISP, emit_test_imm_memdisp),
+	DECL_EMITTER(INSN_INC_MEMDISP, emit_inc_memdisp),
+	DECL_EMITTER(INSN_UCOMISD_XMM_XMM, emit_ucomis_xmm_xmm),
+	DECL_EMITTER(INSN_UCOMISS_XMM_XMM, emit_ucomis_xmm_xmm),
 	DECL_EMITTER(INSN_SAVE_CALLER_REGS, emit_pseudo),
 	DECL_EMITTER(INSN_RESTORE_CALLER_REGS, emit_pseudo),
 	DECL_EMITTER(INSN_RESTORE_CALLER_REGS_I32, emit_pseudo),
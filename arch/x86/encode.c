@@ -268,7 +268,9 @@ static uint64_t encode_table[NR_INSN_TYPES] = {
 	[INSN_SBB_IMM_REG]		= OPCODE(0x81) | OPCODE_EXT(3)   | ADDMODE_IMM_REG | WIDTH_FULL | REX_W_PREFIX,
 	[INSN_SBB_MEMBASE_REG]		= OPCODE(0x1b) | ADDMODE_RM_REG  | WIDTH_FULL | REX_W_PREFIX,
 	[INSN_SBB_REG_REG]		= OPCODE(0x19) | ADDMODE_REG_REG | DIR_REVERSED | WIDTH_FULL | REX_W_PREFIX,
+	[INSN_SHL_IMM_REG]		= OPCODE(0xc1) | OPCODE_EXT(4)   | ADDMODE_IMM8_REG | DIR_REVERSED | WIDTH_FULL | REX_W_PREFIX,
 	[INSN_SHL_REG_REG]		= OPCODE(0xd3) | OPCODE_EXT(4)   | ADDMODE_REG_REG|DIR_REVERSED | WIDTH_FULL | REX_W_PREFIX,
+	[INSN_SHR_IMM_REG]		= OPCODE(0xc1) | OPCODE_EXT(5)   | ADDMODE_IMM8_REG | DIR_REVERSED | WIDTH_FULL | REX_W_PREFIX,
 	[INSN_SHR_REG_REG]		= OPCODE(0xd3) | OPCODE_EXT(5)   | ADDMODE_REG_REG|DIR_REVERSED | WIDTH_FULL | REX_W_PREFIX,
 	[INSN_SUBSD_XMM_XMM]		= REPNE_PREFIX | ESCAPE_OPC_BYTE | OPCODE(0x5c) | ADDMODE_REG_REG | WIDTH_64,
 	[INSN_SUBSS_XMM_XMM]		= REPE_PREFIX  | ESCAPE_OPC_BYTE | OPCODE(0x5c) | ADDMODE_REG_REG | WIDTH_FULL,
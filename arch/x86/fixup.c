@@ -17,9 +17,9 @@ static inline bool is_rex_prefix(unsigned char opc)
 #endif
 }
 
-static inline bool is_sse_insn(unsigned char *opc)
+static inline bool is_sse_prefix(unsigned char opc)
 {
-	return (opc[0] & 0xfe) == 0xf2 && opc[1] == 0x0f;
+	return (opc & 0xfe) == 0xf2;
 }
 
 /*
@@ -35,6 +35,13 @@ static inline bool is_sse_insn(unsigned char *opc)
  * achieve this, we could suspend all threads before patching, and force them
  * to execute flush_icache() on resume.
  */
+void fixup_direct_call(unsigned char *site_addr, void *target)
+{
+	cpu_write_u32(site_addr+1, x86_call_disp(site_addr, target));
+
+	VALGRIND_DISCARD_TRANSLATIONS(site_addr, X86_CALL_INSN_SIZE);
+}
+
 void fixup_direct_calls(struct jit_trampoline *t, unsigned long target)
 {
 	struct fixup_site *this, *next;
@@ -45,14 +52,8 @@ void fixup_direct_calls(struct jit_trampoline *t, unsigned long target)
 	pthread_mutex_lock(&t->mutex);
 
 	list_for_each_entry_safe(this, next, &t->fixup_site_list, list_node) {
-		unsigned long new_target;
-		void *site_addr;
-
-		site_addr = fixup_site_addr(this);
-		new_target = x86_call_disp(site_addr, (void *) target);
-		cpu_write_u32(site_addr+1, new_target);
-
-		VALGRIND_DISCARD_TRANSLATIONS(site_addr, X86_CALL_INSN_SIZE);
+		if (!this->cu->code_retired)
+			fixup_direct_call(fixup_site_addr(this), (void *) target);
 
 		list_del(&this->list_node);
 		free_fixup_site(this);
@@ -90,24 +91,36 @@ void fixup_static(struct vm_class *vmc)
 		new_target	= vmc->static_values + vmf->offset;
 		mach_insn	= buffer_ptr(this->cu->objcode) + this->mach_offset;
 
-		/* Does the instruction begin with a REX prefix? */
-		if (is_rex_prefix(*mach_insn))
-			skip_count += 1;
-
-		/* Is it an SSE instruction? */
-		if (is_sse_insn(mach_insn + skip_count))
-			skip_count += 4;
-		else
-			skip_count += 2;
-
-		do_fixup_static(mach_insn, skip_count, new_target);
-
 		list_del(&this->vmc_node);
 
 		pthread_mutex_lock(&this->cu->mutex);
+
 		list_del(&this->cu_node);
+
+		if (this->cu->code_retired) {
+			pthread_mutex_unlock(&this->cu->mutex);
+			free(this);
+			continue;
+		}
+
 		pthread_mutex_unlock(&this->cu->mutex);
 
+		/* SSE instructions have a mandatory prefix before REX. */
+		if (is_sse_prefix(mach_insn[skip_count]))
+			skip_count += 1;
+
+		if (is_rex_prefix(mach_insn[skip_count]))
+			skip_count += 1;
+
+		/* Two-byte opcode escape */
+		if (mach_insn[skip_count] == 0x0f)
+			skip_count += 1;
+
+		/* Opcode and ModR/M */
+		skip_count += 2;
+
+		do_fixup_static(mach_insn, skip_count, new_target);
+
 		free(this);
 	}
 
@@ -6,19 +6,56 @@
 #include <stdbool.h>
 
 #define IC_IMM_REG	MACH_REG_xAX
+
+/*
+ * The receiver class is passed in a register that is not used for
+ * passing arguments. On x86-64 %rcx holds the fourth argument.
+ */
+#ifdef CONFIG_X86_32
 #define IC_CLASS_REG	MACH_REG_xCX
+#else
+#define IC_CLASS_REG	MACH_REG_R11
+#endif
+
+/*
+ * Maximum number of receiver classes a polymorphic call site dispatches
+ * on before it goes megamorphic.
+ */
+#define IC_MAX_POLYMORPHIC_ENTRIES	4
 
 struct vm_class;
 struct vm_method;
 struct compilation_unit;
 
+/*
+ * A polymorphic call site. The call instruction at @callsite points to
+ * @stub which compares the receiver class against @classes and jumps to
+ * the matching entry in @targets.
+ */
+struct ic_site {
+	struct vm_method	*method;
+	void			*callsite;
+	void			*stub;
+	unsigned long		stub_size;
+	unsigned int		nr_entries;
+	struct vm_class		*classes[IC_MAX_POLYMORPHIC_ENTRIES];
+	void			*targets[IC_MAX_POLYMORPHIC_ENTRIES];
+	unsigned long		nr_misses;
+};
+
 void *ic_lookup_vtable(struct vm_class *vmc, struct vm_method *vmm);
 bool ic_supports_method(struct vm_method *vmm);
 void *do_ic_setup(struct vm_class *vmc, struct vm_method *i_vmm, void *callsite);
 int convert_ic_calls(struct compilation_unit *cu);
 void *resolve_ic_miss(struct vm_class *vmc, struct vm_method *vmm, void *callsite);
+void *resolve_pic_miss(struct vm_class *vmc, struct ic_site *site, void *callsite);
+void *emit_pic_stub(struct ic_site *site);
 
 void ic_start(void);
 void ic_vcall_stub(void);
+void ic_pic_miss(void);
+#ifdef CONFIG_X86_64
+void ic_miss(void);
+#endif
 
 #endif /* INLINE_CACHE_H */
@@ -100,22 +100,28 @@ enum insn_type {
 	INSN_ADD_REG_REG,
 	INSN_AND_MEMBASE_REG,
 	INSN_AND_REG_REG,
+	INSN_ARRAY_CHECK_MEMBASE_REG,
 	INSN_CALL_REG,
 	INSN_CALL_REL,
+	INSN_CARD_MARK_REG_REG,
+	INSN_CHECKCAST_IMM_REG,
 	INSN_CLTD_REG_REG,	/* CDQ in Intel manuals*/
 	INSN_CMP_IMM_REG,
 	INSN_CMP_MEMBASE_REG,
 	INSN_CMP_REG_REG,
 	INSN_CONV_FPU64_TO_GPR,
 	INSN_CONV_FPU_TO_GPR,
+	INSN_CONV_FPU_TO_GPR_TRUNC,
 	INSN_CONV_GPR_TO_FPU,
 	INSN_CONV_GPR_TO_FPU64,
 	INSN_CONV_XMM64_TO_XMM,
 	INSN_CONV_XMM_TO_XMM64,
 	INSN_DIVSD_XMM_XMM,
 	INSN_DIVSS_XMM_XMM,
+	INSN_DIV_CHECK_REG_REG,
 	INSN_DIV_MEMBASE_REG,
 	INSN_DIV_REG_REG,
+	INSN_FCMP_FLAGS_REG,
 	INSN_FILD_64_MEMBASE,
 	INSN_FISTP_64_MEMBASE,
 	INSN_FLDCW_MEMBASE,
@@ -129,6 +135,12 @@ enum insn_type {
 	INSN_FSTP_MEMBASE,
 	INSN_FSTP_MEMLOCAL,
 	INSN_IC_CALL,
+	INSN_INC_MEMDISP,
+	INSN_INSTANCEOF_IMM_REG,
+	INSN_JAE_BRANCH,
+	INSN_JA_BRANCH,
+	INSN_JBE_BRANCH,
+	INSN_JB_BRANCH,
 	INSN_JE_BRANCH,
 	INSN_JGE_BRANCH,
 	INSN_JG_BRANCH,
@@ -138,6 +150,8 @@ enum insn_type {
 	INSN_JMP_MEMBASE,
 	INSN_JMP_MEMINDEX,
 	INSN_JNE_BRANCH,
+	INSN_MONITOR_ENTER_REG,
+	INSN_MONITOR_EXIT_REG,
 	INSN_MOVSD_MEMBASE_XMM,
 	INSN_MOVSD_MEMDISP_XMM,
 	INSN_MOVSD_MEMINDEX_XMM,
@@ -201,7 +215,9 @@ enum insn_type {
 	INSN_SBB_IMM_REG,
 	INSN_SBB_MEMBASE_REG,
 	INSN_SBB_REG_REG,
+	INSN_SHL_IMM_REG,
 	INSN_SHL_REG_REG,
+	INSN_SHR_IMM_REG,
 	INSN_SHR_REG_REG,
 	INSN_SUBSD_XMM_XMM,
 	INSN_SUBSS_XMM_XMM,
@@ -210,6 +226,10 @@ enum insn_type {
 	INSN_SUB_REG_REG,
 	INSN_TEST_IMM_MEMDISP,
 	INSN_TEST_MEMBASE_REG,
+	INSN_TLAB_ALLOC_ARRAY,
+	INSN_TLAB_ALLOC_OBJECT,
+	INSN_UCOMISD_XMM_XMM,
+	INSN_UCOMISS_XMM_XMM,
 	INSN_XORPD_XMM_XMM,
 	INSN_XOR_MEMBASE_REG,
 	INSN_XOR_REG_REG,
@@ -232,6 +252,7 @@ enum insn_flag_type {
 	INSN_FLAG_KNOWN_BC_OFFSET	= 1U << 2,
 	INSN_FLAG_BACKPATCH_BRANCH	= 1U << 3,
 	INSN_FLAG_BACKPATCH_RESOLUTION	= 1U << 4,
+	INSN_FLAG_GC_MAP		= 1U << 5, /* GC point, see include/jit/gc-map.h */
 };
 
 struct insn {
@@ -290,6 +311,7 @@ struct insn *rel_insn(enum insn_type, unsigned long);
 struct insn *phi_insn(enum insn_type, struct var_info *, unsigned long);
 struct insn *branch_insn(enum insn_type, struct basic_block *);
 struct insn *memlocal_insn(enum insn_type, struct stack_slot *);
+struct insn *memdisp_insn(enum insn_type, unsigned long);
 struct insn *reverse_membase_insn(enum insn_type, struct var_info *, long);
 struct insn *membase_insn(enum insn_type, struct var_info *, long);
 struct insn *ic_call_insn(struct var_info *, unsigned long);
@@ -322,7 +344,17 @@ unsigned long nr_srcs_phi(struct insn *insn);
 
 static inline bool insn_is_call(struct insn *insn)
 {
-	return insn->type == INSN_IC_CALL || insn->type == INSN_CALL_REG || insn->type == INSN_CALL_REL;
+	switch (insn->type) {
+	case INSN_IC_CALL:
+	case INSN_CALL_REG:
+	case INSN_CALL_REL:
+	/* These call into the allocator when the fast path fails. */
+	case INSN_TLAB_ALLOC_ARRAY:
+	case INSN_TLAB_ALLOC_OBJECT:
+		return true;
+	default:
+		return false;
+	}
 }
 
 static inline bool insn_is_call_to(struct insn *insn, void *target)
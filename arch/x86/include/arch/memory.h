@@ -27,4 +27,9 @@ static inline void cpu_write_u32(unsigned char *p, uint32_t val)
 	*((uint32_t*)p) = val;
 }
 
+static inline void cpu_write_u64(unsigned char *p, uint64_t val)
+{
+	*((uint64_t*)p) = val;
+}
+
 #endif
@@ -0,0 +1,10 @@
+#ifndef JATO_X86_PROFILE_H
+#define JATO_X86_PROFILE_H
+
+struct compilation_unit;
+struct buffer;
+
+void emit_entry_counter(struct buffer *buf, struct compilation_unit *cu);
+int insert_backedge_counters(struct compilation_unit *cu);
+
+#endif /* JATO_X86_PROFILE_H */
@@ -98,6 +98,8 @@ struct register_state {
 			unsigned long	esi;
 		};
 	};
+	unsigned long			sp;
+	unsigned long			bp;
 };
 
 static inline enum vm_type reg_default_type(enum machine_reg reg)
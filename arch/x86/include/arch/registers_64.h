@@ -123,6 +123,8 @@ struct register_state {
 			unsigned long	r15;
 		};
 	};
+	unsigned long			sp;
+	unsigned long			bp;
 };
 
 static inline enum vm_type reg_default_type(enum machine_reg reg)
@@ -13,4 +13,15 @@
 # define TEXT_MAP_FLAGS		0
 #endif
 
+/*
+ * Upper bounds for the size of emitted code. Code is emitted directly to
+ * the thread's chunk of the text region so the space must be reserved
+ * before emission starts. The bound for a LIR instruction includes the
+ * slow paths it may emit, the largest of which save and restore all XMM
+ * registers.
+ */
+#define TEXT_MAX_INSN_SIZE		512
+#define TEXT_MAX_METHOD_OVERHEAD	4096
+#define TEXT_MAX_STUB_SIZE		1024
+
 #endif /* JATO_X86_TEXT_H */
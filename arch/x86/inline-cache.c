@@ -5,6 +5,7 @@
 #include "jit/inline-cache.h"
 #include "jit/instruction.h"
 #include "jit/cu-mapping.h"
+#include "jit/text.h"
 
 #include "vm/method.h"
 #include "vm/class.h"
@@ -12,14 +13,25 @@
 #include "vm/die.h"
 
 #include "arch/instruction.h"
+#include "arch/decode.h"
 #include "arch/isa.h"
 
 #include <stdbool.h>
 #include <pthread.h>
+#include <stdlib.h>
 #include <assert.h>
 
+/*
+ * The immediate is loaded with "mov $imm, %eax" on x86-32 and with
+ * "movabs $imm, %rax" on x86-64.
+ */
+#ifdef CONFIG_X86_32
 #define X86_MOV_IMM_REG_INSN_SIZE 	5
 #define X86_MOV_IMM_REG_IMM_OFFSET 	1
+#else
+#define X86_MOV_IMM_REG_INSN_SIZE 	10
+#define X86_MOV_IMM_REG_IMM_OFFSET 	2
+#endif
 #define X86_MOV_EAX_OPC 		0xb8
 
 struct x86_ic {
@@ -41,11 +53,29 @@ static inline bool is_valid_ic(struct x86_ic *ic)
 {
 	if (*(((unsigned char *)ic->fn) - X86_CALL_DISP_OFFSET) != X86_CALL_OPC)
 		return false;
-	if (*(((unsigned char *)ic->imm) - X86_MOV_IMM_REG_IMM_OFFSET) != X86_MOV_EAX_OPC)
+	if (*(((unsigned char *)ic->imm) - 1) != X86_MOV_EAX_OPC)
 		return false;
 	return true;
 }
 
+static unsigned long ic_read_imm(struct x86_ic *ic)
+{
+#ifdef CONFIG_X86_32
+	return *(uint32_t *) ic->imm;
+#else
+	return *(uint64_t *) ic->imm;
+#endif
+}
+
+static void ic_write_imm(struct x86_ic *ic, unsigned long imm)
+{
+#ifdef CONFIG_X86_32
+	cpu_write_u32((void *) ic->imm, imm);
+#else
+	cpu_write_u64((void *) ic->imm, imm);
+#endif
+}
+
 static void patch_this_operand(struct insn *class_insn, struct insn *ic_call_insn)
 {
 	/*
@@ -105,12 +135,13 @@ static void ic_set_to_monomorphic(struct vm_class *vmc, struct vm_method *vmm, v
 		die("Failed to lock ic_patch_lock\n");
 
 	cpu_write_u32((void *) ic.fn, x86_call_disp(callsite, ic_entry_point));
-	cpu_write_u32((void *) ic.imm, (unsigned long) vmc);
+	ic_write_imm(&ic, (unsigned long) vmc);
 
 	if (pthread_mutex_unlock(&ic_patch_lock) != 0)
 		die("Failed to unlock ic_patch_lock\n");
 }
 
+/* Must be called with ic_patch_lock held. */
 static void ic_set_to_megamorphic(struct vm_method *vmm, void *callsite)
 {
 	struct x86_ic ic;
@@ -121,12 +152,92 @@ static void ic_set_to_megamorphic(struct vm_method *vmm, void *callsite)
 	ic_from_callsite(&ic, (unsigned long)callsite);
 	assert(is_valid_ic(&ic));
 
-	if (pthread_mutex_lock(&ic_patch_lock) != 0)
-		die("Failed to lock ic_patch_lock\n");
 	cpu_write_u32((void *) ic.fn, x86_call_disp(callsite, ic_vcall_stub));
-	cpu_write_u32((void *) ic.imm, (uint32_t)(vmm->virtual_index * sizeof(void *)));
-	if (pthread_mutex_unlock(&ic_patch_lock) != 0)
-		die("Failed to unlock ic_patch_lock\n");
+	ic_write_imm(&ic, vmm->virtual_index * sizeof(void *));
+}
+
+/*
+ * Frees the stub of @site once no thread executes it anymore. The call
+ * site must no longer point to the stub.
+ */
+static void ic_retire_stub(struct ic_site *site)
+{
+	if (!site->stub)
+		return;
+
+	jit_text_retire(site->stub, site->stub_size, NULL, NULL);
+
+	site->stub = NULL;
+}
+
+/* Must be called with ic_patch_lock held. */
+static void ic_set_to_polymorphic(struct ic_site *site)
+{
+	void *old_stub = site->stub;
+	unsigned long old_stub_size = site->stub_size;
+	struct x86_ic ic;
+
+	ic_from_callsite(&ic, (unsigned long) site->callsite);
+	assert(is_valid_ic(&ic));
+
+	site->stub = emit_pic_stub(site);
+
+	cpu_write_u32((void *) ic.fn, x86_call_disp(site->callsite, site->stub));
+
+	if (old_stub)
+		jit_text_retire(old_stub, old_stub_size, NULL, NULL);
+}
+
+static void *ic_callsite_target(void *callsite)
+{
+	return (void *) x86_call_target(callsite);
+}
+
+static void trace_ic_transition(void *callsite, struct vm_method *vmm,
+				const char *from, const char *to,
+				struct ic_site *site)
+{
+	struct compilation_unit *cu;
+
+	cu = jit_lookup_cu((unsigned long) callsite);
+
+	trace_printf("[ic] %s.%s%s: call to %s.%s%s at bc %lu: %s -> %s",
+		     cu->method->class->name, cu->method->name, cu->method->type,
+		     vmm->class->name, vmm->name, vmm->type,
+		     jit_lookup_bc_offset(cu, callsite), from, to);
+
+	if (site) {
+		trace_printf(" (%u classes, %lu misses)",
+			     site->nr_entries, site->nr_misses);
+	}
+
+	trace_printf("\n");
+	trace_flush();
+}
+
+/*
+ * Returns the compiled code of @target or NULL if it is not compiled yet.
+ * Call sites are not patched to point to trampolines so that a later miss
+ * can pick up the compiled code.
+ */
+static void *ic_compiled_target(void *target)
+{
+	struct compilation_unit *cu;
+
+	cu = jit_lookup_cu((unsigned long) target);
+	if (!cu || !vm_method_is_compiled(cu->method))
+		return NULL;
+
+	return vm_method_entry_point(cu->method);
+}
+
+static void ic_site_add(struct ic_site *site, struct vm_class *vmc, void *target)
+{
+	assert(site->nr_entries < IC_MAX_POLYMORPHIC_ENTRIES);
+
+	site->classes[site->nr_entries]	= vmc;
+	site->targets[site->nr_entries]	= target;
+	site->nr_entries++;
 }
 
 void *do_ic_setup(struct vm_class *vmc, struct vm_method *i_vmm, void *return_addr)
@@ -156,6 +267,9 @@ void *do_ic_setup(struct vm_class *vmc, struct vm_method *i_vmm, void *return_ad
 
 	if (vm_method_is_compiled(c_vmm)) {
 		ic_set_to_monomorphic(vmc, c_vmm, callsite);
+
+		if (opt_trace_ic)
+			trace_ic_transition(callsite, c_vmm, "unresolved", "monomorphic", NULL);
 	}
 
 	return vm_method_call_ptr(c_vmm);
@@ -209,6 +323,9 @@ int convert_ic_calls(struct compilation_unit *cu)
 		insn_set_bc_offset(imm_insn, bc_offset);
 		insn_set_bc_offset(call_insn, bc_offset);
 
+		/* The call takes over the GC map of the IC call. */
+		call_insn->lir_pos = insn->lir_pos;
+		call_insn->flags |= insn->flags & INSN_FLAG_GC_MAP;
 
 		list_add_tail(&class_insn->insn_list_node, ic_call);
 		list_add_tail(&imm_insn->insn_list_node, ic_call);
@@ -221,11 +338,104 @@ int convert_ic_calls(struct compilation_unit *cu)
 	return 0;
 }
 
+/*
+ * Called from the IC miss handler of a method when a monomorphic call
+ * site sees a new receiver class. @vmm is the method that was cached.
+ */
 void *resolve_ic_miss(struct vm_class *vmc, struct vm_method *vmm, void *return_addr)
 {
 	void *callsite = return_addr - X86_CALL_INSN_SIZE;
+	struct vm_class *cached_vmc;
+	void *target, *compiled;
+	struct ic_site *site;
+	struct x86_ic ic;
+
+	target = ic_lookup_vtable(vmc, vmm);
+
+	compiled = ic_compiled_target(target);
+	if (!compiled)
+		return target;
+
+	if (pthread_mutex_lock(&ic_patch_lock) != 0)
+		die("Failed to lock ic_patch_lock\n");
+
+	/* Another thread might have already changed the call site. */
+	if (ic_callsite_target(callsite) != vm_method_ic_entry_point(vmm))
+		goto out_unlock;
+
+	ic_from_callsite(&ic, (unsigned long) callsite);
+	cached_vmc = (struct vm_class *) ic_read_imm(&ic);
+
+	site = calloc(1, sizeof(*site));
+	if (!site) {
+		ic_set_to_megamorphic(vmm, callsite);
+		if (opt_trace_ic)
+			trace_ic_transition(callsite, vmm, "monomorphic", "megamorphic", NULL);
+		goto out_unlock;
+	}
+
+	site->method	= vmm;
+	site->callsite	= callsite;
+	site->nr_misses	= 1;
+
+	ic_site_add(site, cached_vmc, vm_method_entry_point(vmm));
+	ic_site_add(site, vmc, compiled);
+	ic_set_to_polymorphic(site);
+
+	if (opt_trace_ic)
+		trace_ic_transition(callsite, vmm, "monomorphic", "polymorphic", site);
+
+out_unlock:
+	if (pthread_mutex_unlock(&ic_patch_lock) != 0)
+		die("Failed to unlock ic_patch_lock\n");
 
-	ic_set_to_megamorphic(vmm, callsite);
+	return target;
+}
+
+/*
+ * Called from a polymorphic stub when the receiver class is not in the
+ * stub. The site either grows a new stub or goes megamorphic. Old stubs
+ * are retired and freed once no thread executes them anymore.
+ */
+void *resolve_pic_miss(struct vm_class *vmc, struct ic_site *site, void *return_addr)
+{
+	void *callsite = return_addr - X86_CALL_INSN_SIZE;
+	void *target, *compiled;
+
+	assert(callsite == site->callsite);
+
+	target = ic_lookup_vtable(vmc, site->method);
+
+	if (pthread_mutex_lock(&ic_patch_lock) != 0)
+		die("Failed to lock ic_patch_lock\n");
+
+	if (ic_callsite_target(callsite) != site->stub)
+		goto out_unlock;
+
+	site->nr_misses++;
+
+	compiled = ic_compiled_target(target);
+	if (!compiled)
+		goto out_unlock;
+
+	if (site->nr_entries == IC_MAX_POLYMORPHIC_ENTRIES) {
+		ic_set_to_megamorphic(site->method, callsite);
+		ic_retire_stub(site);
+
+		if (opt_trace_ic)
+			trace_ic_transition(callsite, site->method, "polymorphic", "megamorphic", site);
+		goto out_unlock;
+	}
+
+	ic_site_add(site, vmc, compiled);
+	ic_set_to_polymorphic(site);
+
+	if (opt_trace_ic)
+		trace_ic_transition(callsite, site->method, "polymorphic", "polymorphic", site);
+
+out_unlock:
+	if (pthread_mutex_unlock(&ic_patch_lock) != 0)
+		die("Failed to unlock ic_patch_lock\n");
 
-	return ic_lookup_vtable(vmc, vmm);
+	return target;
 }
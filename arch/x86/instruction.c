@@ -26,6 +26,7 @@
 
 #include "jit/bc-offset-mapping.h"
 #include "jit/compilation-unit.h"
+#include "jit/gc-map.h"
 #include "jit/instruction.h"
 #include "jit/vars.h"
 
@@ -438,6 +439,19 @@ struct insn *memlocal_insn(enum insn_type insn_type, struct stack_slot *slot)
 	return insn;
 }
 
+struct insn *memdisp_insn(enum insn_type insn_type, unsigned long disp)
+{
+	struct insn *insn = alloc_insn(insn_type);
+
+	if (insn) {
+		insn->operand	= (struct operand) {
+			.type		= OPERAND_MEMDISP,
+		};
+		insn->operand.disp	= disp;
+	}
+	return insn;
+}
+
 struct insn *membase_insn(enum insn_type insn_type, struct var_info *src_base_reg, long src_disp)
 {
 	struct insn *insn = alloc_insn(insn_type);
@@ -717,6 +731,30 @@ void ssa_chg_jmp_direction(struct insn *insn, struct basic_block *after_bb,
 			insn->type = INSN_JG_BRANCH;
 		}
 		break;
+	case INSN_JA_BRANCH:
+		if (insn->operand.branch_target == bb) {
+			insn->operand.branch_target = after_bb;
+			insn->type = INSN_JBE_BRANCH;
+		}
+		break;
+	case INSN_JBE_BRANCH:
+		if (insn->operand.branch_target == bb) {
+			insn->operand.branch_target = after_bb;
+			insn->type = INSN_JA_BRANCH;
+		}
+		break;
+	case INSN_JAE_BRANCH:
+		if (insn->operand.branch_target == bb) {
+			insn->operand.branch_target = after_bb;
+			insn->type = INSN_JB_BRANCH;
+		}
+		break;
+	case INSN_JB_BRANCH:
+		if (insn->operand.branch_target == bb) {
+			insn->operand.branch_target = after_bb;
+			insn->type = INSN_JAE_BRANCH;
+		}
+		break;
 	case INSN_JMP_BRANCH:
 		if (insn->operand.branch_target == bb)
 			insn->operand.branch_target = new_bb;
@@ -724,10 +762,31 @@ void ssa_chg_jmp_direction(struct insn *insn, struct basic_block *after_bb,
 	}
 }
 
+/*
+ * The x86-64 emitters store immediates with the 32-bit "mov $imm, mem"
+ * form. Stack slots are always reloaded with 64-bit loads and there is no
+ * emitter for immediate stores to thread local memory, so only 32-bit
+ * stores to memory addressed by a register can take an immediate there.
+ */
+static bool can_store_imm(struct insn *insn)
+{
+#ifdef CONFIG_X86_64
+	if (insn->type != INSN_MOV_REG_MEMBASE)
+		return false;
+
+	return !vm_type_is_int64(insn->src.reg.interval->var_info->vm_type);
+#else
+	return true;
+#endif
+}
+
 int ssa_modify_insn_type(struct insn *insn)
 {
 	switch(insn->type) {
 	case INSN_MOV_REG_MEMBASE:
+		if (!can_store_imm(insn))
+			return -1;
+
 		insn->type = INSN_MOV_IMM_MEMBASE;
 		break;
 
@@ -736,10 +795,16 @@ int ssa_modify_insn_type(struct insn *insn)
 		break;
 
 	case INSN_MOV_REG_THREAD_LOCAL_MEMBASE:
+		if (!can_store_imm(insn))
+			return -1;
+
 		insn->type = INSN_MOV_IMM_THREAD_LOCAL_MEMBASE;
 		break;
 
 	case INSN_MOV_REG_MEMLOCAL:
+		if (!can_store_imm(insn))
+			return -1;
+
 		insn->type = INSN_MOV_IMM_MEMLOCAL;
 		break;
 
@@ -792,22 +857,28 @@ static unsigned long insn_flags[] = {
 	[INSN_ADD_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_AND_MEMBASE_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_AND_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
+	[INSN_ARRAY_CHECK_MEMBASE_REG]		= USE_SRC | USE_DST | DEF_NONE,
 	[INSN_CALL_REG]				= USE_DST | DEF_NONE | TYPE_CALL,
 	[INSN_CALL_REL]				= USE_NONE | DEF_NONE | TYPE_CALL,
+	[INSN_CARD_MARK_REG_REG]		= USE_SRC | USE_DST | DEF_DST,
+	[INSN_CHECKCAST_IMM_REG]		= USE_DST | DEF_xAX | DEF_xCX | DEF_xDX,
 	[INSN_CLTD_REG_REG]			= USE_SRC | DEF_SRC | DEF_DST,
 	[INSN_CMP_IMM_REG]			= USE_DST,
 	[INSN_CMP_MEMBASE_REG]			= USE_SRC | USE_DST,
 	[INSN_CMP_REG_REG]			= USE_SRC | USE_DST,
 	[INSN_CONV_FPU64_TO_GPR]		= USE_SRC | DEF_DST,
 	[INSN_CONV_FPU_TO_GPR]			= USE_SRC | DEF_DST,
+	[INSN_CONV_FPU_TO_GPR_TRUNC]		= USE_SRC | DEF_DST,
 	[INSN_CONV_GPR_TO_FPU64]		= USE_SRC | DEF_DST,
 	[INSN_CONV_GPR_TO_FPU]			= USE_SRC | DEF_DST,
 	[INSN_CONV_XMM64_TO_XMM]		= USE_SRC | DEF_DST,
 	[INSN_CONV_XMM_TO_XMM64]		= USE_SRC | DEF_DST,
 	[INSN_DIVSD_XMM_XMM]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_DIVSS_XMM_XMM]			= USE_SRC | USE_DST | DEF_DST,
+	[INSN_DIV_CHECK_REG_REG]		= USE_SRC | USE_DST | DEF_DST | DEF_xAX | DEF_xDX,
 	[INSN_DIV_MEMBASE_REG]			= USE_SRC | USE_DST | DEF_DST | DEF_xAX | DEF_xDX,
 	[INSN_DIV_REG_REG]			= USE_SRC | USE_DST | DEF_DST | DEF_xAX | DEF_xDX,
+	[INSN_FCMP_FLAGS_REG]			= DEF_DST,
 	[INSN_FILD_64_MEMBASE]			= USE_SRC,
 	[INSN_FISTP_64_MEMBASE]			= USE_SRC | DEF_NONE,
 	[INSN_FLDCW_MEMBASE]			= USE_SRC | DEF_NONE,
@@ -821,6 +892,12 @@ static unsigned long insn_flags[] = {
 	[INSN_FSTP_MEMBASE]			= USE_SRC | DEF_NONE,
 	[INSN_FSTP_MEMLOCAL]			= USE_FP | DEF_NONE,
 	[INSN_IC_CALL]				= USE_SRC | DEF_xAX | DEF_xCX | TYPE_CALL,
+	[INSN_INC_MEMDISP]			= USE_NONE | DEF_NONE,
+	[INSN_INSTANCEOF_IMM_REG]		= USE_DST | DEF_xAX | DEF_xCX | DEF_xDX,
+	[INSN_JAE_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
+	[INSN_JA_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
+	[INSN_JBE_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
+	[INSN_JB_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
 	[INSN_JE_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
 	[INSN_JGE_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
 	[INSN_JG_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
@@ -830,6 +907,8 @@ static unsigned long insn_flags[] = {
 	[INSN_JMP_MEMBASE]			= USE_DST | DEF_NONE | TYPE_BRANCH,
 	[INSN_JMP_MEMINDEX]			= USE_IDX_DST | USE_DST | DEF_NONE | TYPE_BRANCH,
 	[INSN_JNE_BRANCH]			= USE_NONE | DEF_NONE | TYPE_BRANCH,
+	[INSN_MONITOR_ENTER_REG]		= USE_SRC | DEF_xAX | DEF_xCX | DEF_xDX,
+	[INSN_MONITOR_EXIT_REG]			= USE_SRC | DEF_xAX | DEF_xCX | DEF_xDX,
 	[INSN_MOVSD_MEMBASE_XMM]		= USE_SRC | DEF_DST,
 	[INSN_MOVSD_MEMDISP_XMM]		= USE_NONE | DEF_DST,
 	[INSN_MOVSD_MEMINDEX_XMM]		= USE_SRC | USE_IDX_SRC | DEF_DST,
@@ -893,7 +972,9 @@ static unsigned long insn_flags[] = {
 	[INSN_SBB_IMM_REG]			= USE_DST | DEF_DST,
 	[INSN_SBB_MEMBASE_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_SBB_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
+	[INSN_SHL_IMM_REG]			= USE_DST | DEF_DST,
 	[INSN_SHL_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
+	[INSN_SHR_IMM_REG]			= USE_DST | DEF_DST,
 	[INSN_SHR_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_SUBSD_XMM_XMM]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_SUBSS_XMM_XMM]			= USE_SRC | USE_DST | DEF_DST,
@@ -902,6 +983,10 @@ static unsigned long insn_flags[] = {
 	[INSN_SUB_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_TEST_IMM_MEMDISP]			= USE_NONE | DEF_NONE,
 	[INSN_TEST_MEMBASE_REG]			= USE_SRC | USE_DST | DEF_NONE,
+	[INSN_TLAB_ALLOC_ARRAY]			= USE_NONE | DEF_NONE | TYPE_CALL,
+	[INSN_TLAB_ALLOC_OBJECT]		= USE_NONE | DEF_NONE | TYPE_CALL,
+	[INSN_UCOMISD_XMM_XMM]			= USE_SRC | USE_DST,
+	[INSN_UCOMISS_XMM_XMM]			= USE_SRC | USE_DST,
 	[INSN_XORPD_XMM_XMM]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_XOR_MEMBASE_REG]			= USE_SRC | USE_DST | DEF_DST,
 	[INSN_XOR_REG_REG]			= USE_SRC | USE_DST | DEF_DST,
@@ -1115,6 +1200,11 @@ bool insn_is_branch(struct insn *insn)
 	return flags & TYPE_BRANCH;
 }
 
+bool insn_is_safepoint_poll(struct insn *insn)
+{
+	return insn->type == INSN_TEST_IMM_MEMDISP;
+}
+
 bool insn_is_jmp_mem(struct insn *insn)
 {
 	if (!insn)
@@ -1126,6 +1216,92 @@ bool insn_is_jmp_mem(struct insn *insn)
 	return false;
 }
 
+static struct var_info *operand_var(struct use_position *reg)
+{
+	return reg->interval->var_info;
+}
+
+void insn_semantics(struct insn *insn, struct insn_semantics *sem)
+{
+	memset(sem, 0, sizeof(*sem));
+
+	switch (insn->type) {
+	case INSN_ARRAY_CHECK_MEMBASE_REG:
+		sem->type	= INSN_SEM_ARRAY_CHECK;
+		sem->src	= operand_var(&insn->src.base_reg);
+		sem->dest	= operand_var(&insn->dest.reg);
+		break;
+	case INSN_MOV_IMM_REG:
+		sem->type	= INSN_SEM_LOAD_IMM;
+		sem->imm	= insn->src.imm;
+		sem->dest	= operand_var(&insn->dest.reg);
+		break;
+	case INSN_MOV_MEMLOCAL_REG:
+		sem->type	= INSN_SEM_LOAD_LOCAL;
+		sem->slot	= insn->src.slot;
+		sem->dest	= operand_var(&insn->dest.reg);
+		break;
+	case INSN_MOV_MEMBASE_REG:
+		sem->type	= INSN_SEM_LOAD_MEMBASE;
+		sem->src	= operand_var(&insn->src.base_reg);
+		sem->imm	= insn->src.disp;
+		sem->dest	= operand_var(&insn->dest.reg);
+		break;
+	case INSN_MOV_REG_MEMLOCAL:
+		sem->type	= INSN_SEM_STORE_LOCAL;
+		sem->src	= operand_var(&insn->src.reg);
+		sem->slot	= insn->dest.slot;
+		break;
+	case INSN_MOV_IMM_MEMLOCAL:
+		sem->type	= INSN_SEM_STORE_IMM_LOCAL;
+		sem->imm	= insn->src.imm;
+		sem->slot	= insn->dest.slot;
+		break;
+	case INSN_MOVSS_XMM_MEMLOCAL:
+		sem->type	= INSN_SEM_STORE_LOCAL_OTHER;
+		sem->slot	= insn->dest.slot;
+		break;
+	case INSN_MOVSD_XMM_MEMLOCAL:
+		/* Encoded with slot_offset_64() so it covers the next slot too. */
+		sem->type	= INSN_SEM_STORE_LOCAL_WIDE;
+		sem->slot	= insn->dest.slot;
+		break;
+	/*
+	 * INSN_FSTP_*_MEMLOCAL and INSN_POP_MEMLOCAL are only ever used on
+	 * scratch spill slots so they never clobber a local variable.
+	 */
+	case INSN_ADD_IMM_REG:
+		sem->type	= INSN_SEM_ADD_IMM;
+		sem->imm	= insn->src.imm;
+		sem->dest	= operand_var(&insn->dest.reg);
+		break;
+	case INSN_CMP_REG_REG:
+		sem->type	= INSN_SEM_CMP;
+		sem->src	= operand_var(&insn->src.reg);
+		sem->dest	= operand_var(&insn->dest.reg);
+		break;
+	case INSN_JL_BRANCH:
+		sem->type	= INSN_SEM_BRANCH_LT;
+		sem->target	= insn->operand.branch_target;
+		break;
+	case INSN_JGE_BRANCH:
+		sem->type	= INSN_SEM_BRANCH_GE;
+		sem->target	= insn->operand.branch_target;
+		break;
+	case INSN_JG_BRANCH:
+		sem->type	= INSN_SEM_BRANCH_GT;
+		sem->target	= insn->operand.branch_target;
+		break;
+	case INSN_JLE_BRANCH:
+		sem->type	= INSN_SEM_BRANCH_LE;
+		sem->target	= insn->operand.branch_target;
+		break;
+	default:
+		sem->type	= INSN_SEM_OTHER;
+		break;
+	}
+}
+
 unsigned long nr_srcs_phi(struct insn *insn)
 {
 	if (!insn_is_phi(insn))
@@ -363,6 +363,12 @@ static int print_fld_64_memlocal(struct string *str, struct insn *insn)
 	return print_memlocal(str, &insn->operand);
 }
 
+static int print_fcmp_flags_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg(str, &insn->dest);
+}
+
 static int print_fild_64_membase(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -396,6 +402,19 @@ static int print_ic_call(struct string *str, struct insn *insn)
 	return str_append(str, "<%s>", ((struct vm_method *)insn->dest.imm)->name);
 }
 
+static int print_inc_memdisp(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_memdisp(str, &insn->operand);
+}
+
+static int print_instanceof_imm_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	print_imm_reg(str, insn);
+	return str_append(str, "<%s>", ((struct vm_class *)insn->src.imm)->name);
+}
+
 static int print_fstp_64_memlocal(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -432,6 +451,12 @@ static int print_and_reg_reg(struct string *str, struct insn *insn)
 	return print_reg_reg(str, insn);
 }
 
+static int print_array_check_membase_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_membase_reg(str, insn);
+}
+
 static int print_call_reg(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -446,6 +471,19 @@ static int print_call_rel(struct string *str, struct insn *insn)
 	return print_rel(str, &insn->operand);
 }
 
+static int print_card_mark_reg_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg_reg(str, insn);
+}
+
+static int print_checkcast_imm_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	print_imm_reg(str, insn);
+	return str_append(str, "<%s>", ((struct vm_class *)insn->src.imm)->name);
+}
+
 static int print_cltd_reg_reg(struct string *str, struct insn *insn)	/* CDQ in Intel manuals*/
 {
 	print_func_name(str);
@@ -476,12 +514,30 @@ static int print_div_membase_reg(struct string *str, struct insn *insn)
 	return print_membase_reg(str, insn);
 }
 
+static int print_div_check_reg_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg_reg(str, insn);
+}
+
 static int print_div_reg_reg(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
 	return print_reg_reg(str, insn);
 }
 
+static int print_monitor_enter_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg(str, &insn->src);
+}
+
+static int print_monitor_exit_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg(str, &insn->src);
+}
+
 static int print_movss_membase_xmm(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -512,6 +568,12 @@ static int print_conv_fpu_to_gpr(struct string *str, struct insn *insn)
 	return print_reg_reg(str, insn);
 }
 
+static int print_conv_fpu_to_gpr_trunc(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg_reg(str, insn);
+}
+
 static int print_conv_fpu64_to_gpr(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -542,6 +604,30 @@ static int print_conv_xmm64_to_xmm(struct string *str, struct insn *insn)
 	return print_reg_reg(str, insn);
 }
 
+static int print_jae_branch(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_branch(str, &insn->operand);
+}
+
+static int print_ja_branch(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_branch(str, &insn->operand);
+}
+
+static int print_jbe_branch(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_branch(str, &insn->operand);
+}
+
+static int print_jb_branch(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_branch(str, &insn->operand);
+}
+
 static int print_je_branch(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -915,12 +1001,24 @@ static int print_sbb_reg_reg(struct string *str, struct insn *insn)
 	return print_reg_reg(str, insn);
 }
 
+static int print_shl_imm_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_imm_reg(str, insn);
+}
+
 static int print_shl_reg_reg(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
 	return print_reg_reg(str, insn);
 }
 
+static int print_shr_imm_reg(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_imm_reg(str, insn);
+}
+
 static int print_shr_reg_reg(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -957,6 +1055,30 @@ static int print_test_membase_reg(struct string *str, struct insn *insn)
 	return print_membase_reg(str, insn);
 }
 
+static int print_tlab_alloc_array(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_imm(str, &insn->operand);
+}
+
+static int print_tlab_alloc_object(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_imm(str, &insn->operand);
+}
+
+static int print_ucomisd_xmm_xmm(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg_reg(str, insn);
+}
+
+static int print_ucomiss_xmm_xmm(struct string *str, struct insn *insn)
+{
+	print_func_name(str);
+	return print_reg_reg(str, insn);
+}
+
 static int print_xor_membase_reg(struct string *str, struct insn *insn)
 {
 	print_func_name(str);
@@ -1025,22 +1147,28 @@ static print_insn_fn insn_printers[] = {
 	[INSN_ADD_REG_REG] = print_add_reg_reg,
 	[INSN_AND_MEMBASE_REG] = print_and_membase_reg,
 	[INSN_AND_REG_REG] = print_and_reg_reg,
+	[INSN_ARRAY_CHECK_MEMBASE_REG] = print_array_check_membase_reg,
 	[INSN_CALL_REG] = print_call_reg,
 	[INSN_CALL_REL] = print_call_rel,
+	[INSN_CARD_MARK_REG_REG] = print_card_mark_reg_reg,
+	[INSN_CHECKCAST_IMM_REG] = print_checkcast_imm_reg,
 	[INSN_CLTD_REG_REG] = print_cltd_reg_reg,	/* CDQ in Intel manuals*/
 	[INSN_CMP_IMM_REG] = print_cmp_imm_reg,
 	[INSN_CMP_MEMBASE_REG] = print_cmp_membase_reg,
 	[INSN_CMP_REG_REG] = print_cmp_reg_reg,
 	[INSN_CONV_FPU64_TO_GPR] = print_conv_fpu64_to_gpr,
 	[INSN_CONV_FPU_TO_GPR] = print_conv_fpu_to_gpr,
+	[INSN_CONV_FPU_TO_GPR_TRUNC] = print_conv_fpu_to_gpr_trunc,
 	[INSN_CONV_GPR_TO_FPU64] = print_conv_gpr_to_fpu64,
 	[INSN_CONV_GPR_TO_FPU] = print_conv_gpr_to_fpu,
 	[INSN_CONV_XMM64_TO_XMM] = print_conv_xmm64_to_xmm,
 	[INSN_CONV_XMM_TO_XMM64] = print_conv_xmm_to_xmm64,
 	[INSN_DIVSD_XMM_XMM] = print_divsd_xmm_xmm,
 	[INSN_DIVSS_XMM_XMM] = print_divss_xmm_xmm,
+	[INSN_DIV_CHECK_REG_REG] = print_div_check_reg_reg,
 	[INSN_DIV_MEMBASE_REG] = print_div_membase_reg,
 	[INSN_DIV_REG_REG] = print_div_reg_reg,
+	[INSN_FCMP_FLAGS_REG] = print_fcmp_flags_reg,
 	[INSN_FILD_64_MEMBASE] = print_fild_64_membase,
 	[INSN_FISTP_64_MEMBASE] = print_fistp_64_membase,
 	[INSN_FLDCW_MEMBASE] = print_fldcw_membase,
@@ -1054,6 +1182,12 @@ static print_insn_fn insn_printers[] = {
 	[INSN_FSTP_MEMBASE] = print_fstp_membase,
 	[INSN_FSTP_MEMLOCAL] = print_fstp_memlocal,
 	[INSN_IC_CALL] = print_ic_call,
+	[INSN_INC_MEMDISP] = print_inc_memdisp,
+	[INSN_INSTANCEOF_IMM_REG] = print_instanceof_imm_reg,
+	[INSN_JAE_BRANCH] = print_jae_branch,
+	[INSN_JA_BRANCH] = print_ja_branch,
+	[INSN_JBE_BRANCH] = print_jbe_branch,
+	[INSN_JB_BRANCH] = print_jb_branch,
 	[INSN_JE_BRANCH] = print_je_branch,
 	[INSN_JGE_BRANCH] = print_jge_branch,
 	[INSN_JG_BRANCH] = print_jg_branch,
@@ -1063,6 +1197,8 @@ static print_insn_fn insn_printers[] = {
 	[INSN_JMP_MEMBASE] = print_jmp_membase,
 	[INSN_JMP_MEMINDEX] = print_jmp_memindex,
 	[INSN_JNE_BRANCH] = print_jne_branch,
+	[INSN_MONITOR_ENTER_REG] = print_monitor_enter_reg,
+	[INSN_MONITOR_EXIT_REG] = print_monitor_exit_reg,
 	[INSN_MOVSD_MEMBASE_XMM] = print_movsd_membase_xmm,
 	[INSN_MOVSD_MEMDISP_XMM] = print_movsd_memdisp_xmm,
 	[INSN_MOVSD_MEMINDEX_XMM] = print_movsd_memindex_xmm,
@@ -1123,7 +1259,9 @@ static print_insn_fn insn_printers[] = {
 	[INSN_SBB_IMM_REG] = print_sbb_imm_reg,
 	[INSN_SBB_MEMBASE_REG] = print_sbb_membase_reg,
 	[INSN_SBB_REG_REG] = print_sbb_reg_reg,
+	[INSN_SHL_IMM_REG] = print_shl_imm_reg,
 	[INSN_SHL_REG_REG] = print_shl_reg_reg,
+	[INSN_SHR_IMM_REG] = print_shr_imm_reg,
 	[INSN_SHR_REG_REG] = print_shr_reg_reg,
 	[INSN_SUBSD_XMM_XMM] = print_subsd_xmm_xmm,
 	[INSN_SUBSS_XMM_XMM] = print_subss_xmm_xmm,
@@ -1132,6 +1270,10 @@ static print_insn_fn insn_printers[] = {
 	[INSN_SUB_REG_REG] = print_sub_reg_reg,
 	[INSN_TEST_IMM_MEMDISP] = print_test_imm_memdisp,
 	[INSN_TEST_MEMBASE_REG] = print_test_membase_reg,
+	[INSN_TLAB_ALLOC_ARRAY] = print_tlab_alloc_array,
+	[INSN_TLAB_ALLOC_OBJECT] = print_tlab_alloc_object,
+	[INSN_UCOMISD_XMM_XMM] = print_ucomisd_xmm_xmm,
+	[INSN_UCOMISS_XMM_XMM] = print_ucomiss_xmm_xmm,
 	[INSN_XORPD_XMM_XMM] = print_xor_64_xmm_reg_reg,
 	[INSN_XORPS_XMM_XMM] = print_xor_xmm_reg_reg,
 	[INSN_XOR_MEMBASE_REG] = print_xor_membase_reg,
@@ -0,0 +1,133 @@
+/*
+ * Profile counters in compiled code
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "arch/profile.h"
+
+#include "arch/instruction.h"
+
+#include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
+#include "jit/instruction.h"
+#include "jit/emit-code.h"
+
+#include "vm/die.h"
+
+#include <stdlib.h>
+#include <errno.h>
+
+/*
+ * A counter is incremented with a single inc instruction that uses no
+ * registers. It clobbers the flags so it is only placed where they are
+ * dead: at method entry and in the resolution block of a CFG edge.
+ */
+static struct insn *counter_insn(unsigned long *counter)
+{
+	return memdisp_insn(INSN_INC_MEMDISP, (unsigned long) counter);
+}
+
+void emit_entry_counter(struct buffer *buf, struct compilation_unit *cu)
+{
+	struct insn *insn;
+
+	insn = counter_insn(&cu->nr_entries);
+	if (!insn)
+		die("out of memory");
+
+	emit_insn(buf, NULL, insn);
+	free_insn(insn);
+}
+
+static bool is_backedge(struct compilation_unit *cu, struct basic_block *bb,
+			struct basic_block *succ)
+{
+	if (succ == cu->exit_bb || succ == cu->unwind_bb)
+		return false;
+
+	return succ->start <= bb->start;
+}
+
+static unsigned long branch_bc_offset(struct basic_block *bb)
+{
+	struct insn *insn;
+
+	if (list_is_empty(&bb->insn_list))
+		return bb->start;
+
+	insn = list_last_entry(&bb->insn_list, struct insn, insn_list_node);
+
+	return insn->bc_offset;
+}
+
+/*
+ * Adds a counter to every CFG edge that jumps backwards in the bytecode.
+ * Must be called after the data flow has been resolved. The counter
+ * goes to the resolution block of the edge so that branches that take
+ * the edge are redirected through it by the emitter.
+ */
+int insert_backedge_counters(struct compilation_unit *cu)
+{
+	unsigned long nr_backedges = 0;
+	struct basic_block *bb;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		for (unsigned int i = 0; i < bb->nr_successors; i++) {
+			if (is_backedge(cu, bb, bb->successors[i]))
+				nr_backedges++;
+		}
+	}
+
+	if (!nr_backedges)
+		return 0;
+
+	cu->backedge_counters = calloc(nr_backedges, sizeof(struct backedge_counter));
+	if (!cu->backedge_counters)
+		return -ENOMEM;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		for (unsigned int i = 0; i < bb->nr_successors; i++) {
+			struct basic_block *succ = bb->successors[i];
+			struct backedge_counter *counter;
+			struct insn *insn;
+
+			if (!is_backedge(cu, bb, succ))
+				continue;
+
+			counter = &cu->backedge_counters[cu->nr_backedge_counters++];
+			counter->bc_offset		= branch_bc_offset(bb);
+			counter->target_bc_offset	= succ->start;
+
+			insn = counter_insn(&counter->count);
+			if (!insn)
+				return -ENOMEM;
+
+			insn->bc_offset = counter->bc_offset;
+
+			list_add_tail(&insn->insn_list_node, &bb->resolution_blocks[i].insns);
+		}
+	}
+
+	return 0;
+}
@@ -25,6 +25,7 @@
  */
 
 #include "arch/registers.h"
+#include "jit/gc-map.h"
 #include "jit/vars.h"
 #include "vm/system.h"
 
@@ -79,6 +80,31 @@ const char *reg_name(enum machine_reg reg)
 	return register_names[reg];
 }
 
+unsigned long register_state_get(struct register_state *regs, enum machine_reg reg)
+{
+	switch (reg) {
+	case MACH_REG_EAX:
+		return regs->eax;
+	case MACH_REG_ECX:
+		return regs->ecx;
+	case MACH_REG_EDX:
+		return regs->edx;
+	case MACH_REG_EBX:
+		return regs->ebx;
+	case MACH_REG_ESI:
+		return regs->esi;
+	case MACH_REG_EDI:
+		return regs->edi;
+	case MACH_REG_ESP:
+		return regs->sp;
+	case MACH_REG_EBP:
+		return regs->bp;
+	default:
+		assert(!"not a general purpose register");
+		return 0;
+	}
+}
+
 #define GPR_32 (1UL << J_REFERENCE) | (1UL << J_INT)
 #define GPR_16 (1UL << J_SHORT) | (1UL << J_CHAR)
 #define GPR_8 (1UL << J_BYTE) | (1UL << J_BOOLEAN)
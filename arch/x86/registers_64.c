@@ -25,6 +25,7 @@
  */
 
 #include "arch/registers.h"
+#include "jit/gc-map.h"
 #include "jit/vars.h"
 
 #include <assert.h>
@@ -130,6 +131,47 @@ const char *reg_name(enum machine_reg reg)
 	return register_names[reg];
 }
 
+unsigned long register_state_get(struct register_state *regs, enum machine_reg reg)
+{
+	switch (reg) {
+	case MACH_REG_RAX:
+		return regs->rax;
+	case MACH_REG_RCX:
+		return regs->rcx;
+	case MACH_REG_RDX:
+		return regs->rdx;
+	case MACH_REG_RBX:
+		return regs->rbx;
+	case MACH_REG_RSI:
+		return regs->rsi;
+	case MACH_REG_RDI:
+		return regs->rdi;
+	case MACH_REG_R8:
+		return regs->r8;
+	case MACH_REG_R9:
+		return regs->r9;
+	case MACH_REG_R10:
+		return regs->r10;
+	case MACH_REG_R11:
+		return regs->r11;
+	case MACH_REG_R12:
+		return regs->r12;
+	case MACH_REG_R13:
+		return regs->r13;
+	case MACH_REG_R14:
+		return regs->r14;
+	case MACH_REG_R15:
+		return regs->r15;
+	case MACH_REG_RSP:
+		return regs->sp;
+	case MACH_REG_RBP:
+		return regs->bp;
+	default:
+		assert(!"not a general purpose register");
+		return 0;
+	}
+}
+
 #define GPR_64		((1UL << J_LONG)  | (1UL << J_REFERENCE))
 #define GPR_32		((1UL << J_INT)                         )
 #define GPR_16		((1UL << J_SHORT) | (1UL << J_CHAR)     )
@@ -33,6 +33,7 @@
 #include "jit/args.h"
 #include "jit/text.h"
 #include "jit/debug.h"
+#include "jit/gc-map.h"
 
 #include "vm/stack-trace.h"
 #include "vm/method.h"
@@ -144,6 +145,49 @@ unsigned long cu_frame_total_offset(struct compilation_unit *cu)
 	       cu_frame_misc_size(cu);
 }
 
+/*
+ * Returns the lowest address of the part of the JIT stack frame @frame
+ * that is set up by the prolog. Outgoing call arguments are below it.
+ */
+void *jit_frame_bottom(struct compilation_unit *cu, void *frame)
+{
+	return frame - cu_frame_total_offset(cu);
+}
+
+/*
+ * Returns the location where the prolog of @cu saved callee saved
+ * register @reg of the caller or NULL if @reg is not callee saved.
+ */
+unsigned long *jit_frame_callee_save_slot(struct compilation_unit *cu, void *frame, enum machine_reg reg)
+{
+	unsigned long *slot = frame - cu_frame_locals_offset(cu);
+
+	for (unsigned int i = 0; i < NR_CALLEE_SAVE_REGS; i++) {
+		if (callee_save_regs[i] == reg)
+			return slot - i - 1;
+	}
+
+	return NULL;
+}
+
+#ifdef CONFIG_X86_32
+unsigned long *jit_frame_this_slot(struct compilation_unit *cu, void *frame)
+{
+	/* *this is an argument which is on the stack anyway. */
+	return NULL;
+}
+#else
+unsigned long *jit_frame_this_slot(struct compilation_unit *cu, void *frame)
+{
+	unsigned long *slot = frame - cu_frame_locals_offset(cu);
+
+	if (vm_method_is_static(cu->method))
+		return NULL;
+
+	return slot - NR_CALLEE_SAVE_REGS - 1;
+}
+#endif
+
 /*
  * Checks whether given native function was called from jit trampoline
  * code. It checks whether return address points after a relative call
@@ -0,0 +1,16 @@
+#ifndef JATO_ARCH_PROFILE_H
+#define JATO_ARCH_PROFILE_H
+
+struct compilation_unit;
+struct buffer;
+
+static inline void emit_entry_counter(struct buffer *buf, struct compilation_unit *cu)
+{
+}
+
+static inline int insert_backedge_counters(struct compilation_unit *cu)
+{
+	return 0;
+}
+
+#endif /* JATO_ARCH_PROFILE_H */
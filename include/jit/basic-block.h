@@ -145,6 +145,7 @@ struct basic_block *ssa_insert_chg_bb(struct compilation_unit *, struct basic_bl
 struct basic_block *ssa_insert_empty_bb(struct compilation_unit *, struct basic_block *,
 				struct basic_block *, unsigned int);
 bool bb_successors_contains(struct basic_block *, struct basic_block *);
+bool bb_is_loop_header(struct basic_block *);
 int bb_add_mimic_stack_expr(struct basic_block *, struct expression *);
 struct statement *bb_remove_last_stmt(struct basic_block *bb);
 unsigned char *bb_native_ptr(struct basic_block *bb);
@@ -10,9 +10,24 @@
 
 #include "lib/string.h"
 #include <limits.h>
+#include <stdint.h>
 
 #define BC_OFFSET_UNKNOWN ULONG_MAX
 
+/*
+ * Native to bytecode offset table entry. Each entry starts a run of
+ * machine code that belongs to one bytecode offset. The run ends where
+ * the next entry starts. Entries are sorted by native offset and
+ * adjacent entries always have different bytecode offsets.
+ */
+struct bc_offset_entry {
+	uint32_t		native_offset;
+	uint16_t		bc_offset;
+} __attribute__((packed));
+
+/* Bytecode offsets fit in 16 bits, the largest value means unknown. */
+#define BC_OFFSET_ENTRY_UNKNOWN USHRT_MAX
+
 unsigned long jit_lookup_bc_offset(struct compilation_unit *cu,
 				   unsigned char *native_ptr);
 void print_bytecode_offset(unsigned long bc_offset, struct string *str);
@@ -0,0 +1,50 @@
+#ifndef JATO_JIT_CHA_H
+#define JATO_JIT_CHA_H
+
+#include "lib/list.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct compilation_unit;
+struct vm_method;
+struct insn;
+
+/*
+ * A direct call to a virtual method that has no overriding method in any
+ * loaded class. The call site is re-patched to go through the vtable when
+ * a class that overrides @target is linked.
+ */
+struct cha_site {
+	struct vm_method *target;
+
+	/* Compilation unit to which relcall_insn belongs */
+	struct compilation_unit *cu;
+
+	/*
+	 * We need insn pointer because we don't have native pointer at
+	 * instruction selection. mach_offset is filled in after compilation
+	 * is done.
+	 */
+	struct insn *relcall_insn;
+	uint32_t mach_offset;
+
+	/* Links the site to cu->cha_site_list. */
+	struct list_head list_node;
+
+	/*
+	 * Links the site to target->cha_site_list once the compilation unit
+	 * has been emitted.
+	 */
+	struct list_head target_node;
+};
+
+extern bool opt_cha;
+
+bool cha_can_devirtualize(struct vm_method *target, bool *dependent);
+struct cha_site *alloc_cha_site(struct compilation_unit *cu, struct insn *call_insn, struct vm_method *target);
+void cha_register_sites(struct compilation_unit *cu);
+void cha_unregister_sites(struct compilation_unit *cu);
+void cha_method_overridden(struct vm_method *vmm);
+
+#endif /* JATO_JIT_CHA_H */
@@ -22,6 +22,8 @@
 struct buffer;
 struct vm_method;
 struct insn;
+struct bc_offset_entry;
+struct exception_handler;
 enum machine_reg;
 
 enum compilation_state {
@@ -35,6 +37,41 @@ enum {
 	CU_FLAG_REGALLOC_DONE,
 };
 
+/*
+ * Out-of-line code for a rarely taken path of @insn. The fast path is
+ * emitted inline and branches to the slow path which is placed after
+ * the method body. Native addresses within [start, end) are mapped to
+ * the bytecode offset of @insn.
+ */
+struct slow_path {
+	struct compilation_unit *cu;
+	struct insn *insn;
+
+	/* Offset of the branch in the fast path that jumps to the slow path */
+	unsigned long branch_offset;
+
+	/*
+	 * Offset in the fast path where the slow path jumps back to. Defaults
+	 * to the instruction following the branch.
+	 */
+	unsigned long resume_offset;
+
+	unsigned long start;
+	unsigned long end;
+
+	struct list_head list_node;
+};
+
+/*
+ * Number of times the CFG edge from the branch at @bc_offset back to
+ * @target_bc_offset was taken, see -Xprof:counters.
+ */
+struct backedge_counter {
+	unsigned long bc_offset;
+	unsigned long target_bc_offset;
+	unsigned long count;
+};
+
 struct compilation_unit {
 	struct vm_method *method;
 	uint32_t flags;
@@ -56,6 +93,33 @@ struct compilation_unit {
 	/* See enum compilation_state for values */
 	unsigned long state;
 
+	/*
+	 * Background compilation state. Protected by the compile queue
+	 * lock, see jit/compile-queue.c.
+	 */
+	unsigned long compile_queue_hotness;
+	bool compile_queued;
+	bool compile_failed;
+
+	/*
+	 * Set when the machine code has been handed to
+	 * retire_compilation_unit(). Call sites in retired code are no
+	 * longer patched.
+	 */
+	bool code_retired;
+
+	/* Number of bytecode bytes inlined into this method. */
+	unsigned long nr_inlined_bytes;
+
+	/*
+	 * Profile counters that are incremented by the machine code when
+	 * -Xprof:counters is given. The increments are not atomic so
+	 * counts can be lost when several threads run the method.
+	 */
+	unsigned long nr_entries;
+	unsigned long nr_backedge_counters;
+	struct backedge_counter *backedge_counters;
+
 	pthread_mutex_t mutex;
 
 	/* The frame pointer for this method.  */
@@ -113,9 +177,11 @@ struct compilation_unit {
 
 	struct list_head static_fixup_site_list;
 	struct list_head call_fixup_site_list;
+	struct list_head cha_site_list;
 	struct list_head tableswitch_list;
 	struct list_head lookupswitch_list;
 	struct list_head ic_call_list;
+	struct list_head slow_path_list;
 
 	/*
 	 * Entry points to the method's code. These values are
@@ -131,10 +197,11 @@ struct compilation_unit {
 	void *ic_entry_point;
 
 	/*
-	 * This maps bytecode offset to every native address
-	 * inside JIT code.
+	 * This maps native offsets inside JIT code to bytecode offsets.
+	 * See struct bc_offset_entry.
 	 */
-	unsigned long *bc_offset_map;
+	struct bc_offset_entry *bc_offset_map;
+	unsigned long nr_bc_offset_entries;
 
 	/*
 	 * This maps LIR offset to instruction.
@@ -144,11 +211,21 @@ struct compilation_unit {
 	unsigned long last_insn;
 
 	/*
-	 * Contains native pointers of exception handlers. Indices to
-	 * this table are the same as for exception table in code
-	 * attribute.
+	 * GC maps sorted by machine code offset and frame pointer relative
+	 * offsets of stack slots that hold references. Only built when the
+	 * precise collector is enabled. See include/jit/gc-map.h.
+	 */
+	struct gc_map *gc_maps;
+	unsigned long nr_gc_maps;
+	long *gc_slots;
+	unsigned long nr_gc_slots;
+
+	/*
+	 * Contains the exception handlers of the method with their native
+	 * pointers. Indices to this table are the same as for exception
+	 * table in code attribute.
 	 */
-	void **exception_handlers;
+	struct exception_handler *exception_handlers;
 
 	/*
 	 * These stack slot for storing temporary results within one monoburg
@@ -198,8 +275,10 @@ static inline bool compilation_unit_is_compiled(struct compilation_unit *cu)
 }
 
 struct compilation_unit *compilation_unit_alloc(struct vm_method *);
+struct slow_path *alloc_slow_path(struct compilation_unit *, struct insn *, unsigned long);
 int init_stack_slots(struct compilation_unit *cu);
 void free_compilation_unit(struct compilation_unit *);
+void retire_compilation_unit(struct compilation_unit *);
 void shrink_compilation_unit(struct compilation_unit *);
 void resolve_fixup_offsets(struct compilation_unit *);
 struct var_info *get_var(struct compilation_unit *, enum vm_type);
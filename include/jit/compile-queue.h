@@ -0,0 +1,15 @@
+#ifndef JATO_JIT_COMPILE_QUEUE_H
+#define JATO_JIT_COMPILE_QUEUE_H
+
+#include <stdbool.h>
+
+struct compilation_unit;
+
+extern bool opt_background_compilation;
+extern unsigned int opt_nr_compiler_threads;
+
+int init_compile_queue(void);
+bool compile_queue_enabled(void);
+bool compile_queue_submit(struct compilation_unit *cu);
+
+#endif /* JATO_JIT_COMPILE_QUEUE_H */
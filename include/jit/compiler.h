@@ -77,6 +77,7 @@ int allocate_registers(struct compilation_unit *cu);
 int mark_clobbers(struct compilation_unit *cu);
 int insert_spill_reload_insns(struct compilation_unit *cu);
 int emit_machine_code(struct compilation_unit *);
+void *jit_compile_cu(struct compilation_unit *);
 void *jit_magic_trampoline(struct compilation_unit *);
 void jit_no_such_method_stub(void);
 
@@ -111,6 +112,7 @@ bool is_native(unsigned long eip);
 bool is_on_heap(unsigned long addr);
 
 void fixup_direct_calls(struct jit_trampoline *trampoline, unsigned long target);
+void fixup_direct_call(unsigned char *site_addr, void *target);
 
 extern bool opt_trace_method;
 extern regex_t method_trace_regex;
@@ -7,5 +7,6 @@ int add_cu_mapping(unsigned long addr, struct compilation_unit *cu);
 void remove_cu_mapping(unsigned long addr);
 struct compilation_unit *jit_lookup_cu(unsigned long addr);
 void init_cu_mapping(void);
+void thread_init_cu_mapping(void);
 
 #endif
@@ -4,6 +4,7 @@
 #include "jit/stack-slot.h"
 
 struct compilation_unit;
+struct slow_path;
 struct jit_trampoline;
 struct basic_block;
 struct buffer;
@@ -26,9 +27,12 @@ extern void emit_insn(struct buffer *, struct basic_block *, struct insn *);
 extern void emit_nop(struct buffer *buf);
 extern void backpatch_branch_target(struct buffer *buf, struct insn *insn,
 				    unsigned long target_offset);
+extern void emit_slow_path(struct buffer *, struct slow_path *);
 extern void emit_jni_trampoline(struct buffer *, struct vm_method *, void *);
 
 extern void *emit_ic_check(struct buffer *);
 extern void emit_ic_miss_handler(struct buffer *, void *, struct vm_method *);
 
+extern void *emit_vtable_dispatch_stub(unsigned long);
+
 #endif /* JATO_EMIT_CODE_H */
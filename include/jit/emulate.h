@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 int emulate_lcmp(long long value1, long long value2);
+void emulate_division_by_zero(void);
 int32_t emulate_idiv(int32_t value1, int32_t value2);
 int32_t emulate_irem(int32_t value1, int32_t value2);
 long long emulate_ldiv(long long value1, long long value2);
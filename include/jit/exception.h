@@ -2,6 +2,7 @@
 #define JATO_JIT_EXCEPTION_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "cafebabe/code_attribute.h"
 
@@ -21,6 +22,27 @@ struct compilation_unit;
 struct jit_stack_frame;
 struct vm_object;
 struct vm_method;
+struct vm_class;
+
+/*
+ * An entry of the per-method table built by
+ * build_exception_handlers_table(). The catch class is resolved when
+ * the entry is first matched against a thrown exception and then
+ * reused by all later throws.
+ */
+struct exception_handler {
+	unsigned long		start_pc;
+	unsigned long		end_pc;
+	uint16_t		catch_type;
+	struct vm_class		*catch_class;
+	unsigned char		*native_ptr;
+};
+
+/*
+ * -XX:+OmitStackTraceInFastThrow: do not capture the stack trace of
+ * exceptions raised by the VM that are caught by the method raising them.
+ */
+extern bool opt_omit_stack_trace_in_fast_throw;
 
 /*
  * This is a per-thread pointer to a memory location which should be
@@ -53,6 +75,7 @@ unsigned char *throw_exception(struct compilation_unit *cu,
 void throw_from_trampoline(void *ctx, struct vm_object *exception);
 void unwind(void);
 void exception_check(void);
+void exception_throw(void);
 void signal_exception(struct vm_object *obj);
 void signal_new_exception_v(struct vm_class *vmc, const char *template, va_list args);
 void signal_new_exception(struct vm_class *vmc, const char *template, ...);
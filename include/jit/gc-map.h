@@ -4,10 +4,58 @@
 #include <arch/registers.h>
 #include <vm/system.h>
 
+#include <stdbool.h>
+#include <stdint.h>
+
+struct compilation_unit;
+struct register_state;
+struct insn;
+
 #define GC_REGISTER_MAP_SIZE	DIV_ROUND_UP(NR_GP_REGISTERS, BITS_PER_LONG)
 
+/*
+ * Describes which registers hold live references at a GC point of a
+ * method. GC points are the safepoint polls and the calls of a method.
+ * Threads are only stopped for garbage collection at a safepoint poll of
+ * the innermost JIT frame or, for the other JIT frames, at a call.
+ *
+ * Stack slots that hold references are the same for every GC point of a
+ * method, see cu->gc_slots.
+ */
 struct gc_map {
+	/*
+	 * Offset of a safepoint poll or of the return address of a call
+	 * in the machine code.
+	 */
+	uint32_t		mach_offset;
+
+	/* LIR position of the GC point. Only used during compilation. */
+	uint32_t		lir_pos;
+
+	bool			is_call;
+
 	unsigned long		register_map[GC_REGISTER_MAP_SIZE];	/* references in registers */
+
+	/*
+	 * Registers that might contain references that are not tracked
+	 * by the register allocator, such as outgoing call arguments.
+	 */
+	unsigned long		conservative_register_map[GC_REGISTER_MAP_SIZE];
 };
 
+int build_gc_maps(struct compilation_unit *cu);
+void free_gc_maps(struct compilation_unit *cu);
+struct gc_map *gc_map_for_insn(struct compilation_unit *cu, struct insn *insn);
+void gc_map_emitted(struct gc_map *map, struct insn *insn, unsigned long end_offset);
+struct gc_map *gc_map_lookup(struct compilation_unit *cu, unsigned long mach_offset, bool is_call);
+
+/*
+ * Architecture specific
+ */
+bool insn_is_safepoint_poll(struct insn *insn);
+unsigned long register_state_get(struct register_state *regs, enum machine_reg reg);
+unsigned long *jit_frame_callee_save_slot(struct compilation_unit *cu, void *frame, enum machine_reg reg);
+unsigned long *jit_frame_this_slot(struct compilation_unit *cu, void *frame);
+void *jit_frame_bottom(struct compilation_unit *cu, void *frame);
+
 #endif
@@ -0,0 +1,16 @@
+#ifndef JATO_JIT_INLINE_H
+#define JATO_JIT_INLINE_H
+
+#include <stdbool.h>
+
+struct compilation_unit;
+struct parse_context;
+struct vm_method;
+
+extern bool opt_inline_enabled;
+extern unsigned int opt_max_inline_size;
+
+bool can_inline(struct compilation_unit *cu, struct vm_method *target, unsigned char opc);
+int inline_invoke(struct parse_context *ctx, struct vm_method *target);
+
+#endif /* JATO_JIT_INLINE_H */
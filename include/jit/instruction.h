@@ -29,6 +29,39 @@ bool insn_vreg_use(struct use_position *, struct var_info *);
 bool insn_vreg_def(struct use_position *, struct var_info *);
 int insn_operand_use_kind(struct insn *, struct operand *operand);
 
+/*
+ * Architecture independent view of the LIR instructions that SSA
+ * optimizations need to reason about. Everything else is INSN_SEM_OTHER.
+ */
+enum insn_sem_type {
+	INSN_SEM_OTHER,
+	INSN_SEM_ARRAY_CHECK,		/* 0 <= dest < src->array_length */
+	INSN_SEM_LOAD_IMM,		/* imm -> dest */
+	INSN_SEM_LOAD_LOCAL,		/* slot -> dest */
+	INSN_SEM_LOAD_MEMBASE,		/* imm(src) -> dest */
+	INSN_SEM_STORE_LOCAL,		/* src -> slot */
+	INSN_SEM_STORE_IMM_LOCAL,	/* imm -> slot */
+	INSN_SEM_STORE_LOCAL_OTHER,	/* unknown value -> slot */
+	INSN_SEM_STORE_LOCAL_WIDE,	/* unknown value -> slot and the next slot */
+	INSN_SEM_ADD_IMM,		/* old value + imm -> dest */
+	INSN_SEM_CMP,			/* compare dest with src */
+	INSN_SEM_BRANCH_LT,		/* jump to target if dest < src */
+	INSN_SEM_BRANCH_GE,		/* jump to target if dest >= src */
+	INSN_SEM_BRANCH_GT,		/* jump to target if dest > src */
+	INSN_SEM_BRANCH_LE,		/* jump to target if dest <= src */
+};
+
+struct insn_semantics {
+	enum insn_sem_type	type;
+	struct var_info		*src;
+	struct var_info		*dest;
+	struct stack_slot	*slot;
+	struct basic_block	*target;
+	long			imm;
+};
+
+void insn_semantics(struct insn *, struct insn_semantics *);
+
 #define for_each_insn(insn, insn_list) list_for_each_entry(insn, insn_list, insn_list_node)
 
 #define for_each_insn_reverse(insn, insn_list) list_for_each_entry_reverse(insn, insn_list, insn_list_node)
@@ -25,16 +25,6 @@ struct dce {
 	struct dce *next;
 };
 
-struct array_size_acc {
-	bool active;
-	long size;
-};
-
-struct reg_value_acc {
-	bool active;
-	long val;
-};
-
 /*
  * Functions defined in jit/ssa.c
  */
@@ -3,6 +3,8 @@
 
 #include "vm/types.h"
 
+#include <stdbool.h>
+
 struct stack_frame;
 enum machine_reg;
 
@@ -16,6 +18,9 @@ struct stack_slot {
 	   64-bit variable occupies two which gives us a natural mapping for
 	   stack slots.  */
 	unsigned long index;
+
+	/* Set if the slot holds an object reference. See jit/gc-map.c. */
+	bool reference;
 };
 
 struct stack_frame {
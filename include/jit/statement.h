@@ -108,6 +108,8 @@ struct statement {
 		struct /* STMT_INVOKE, STMT_INVOKEVIRTUAL, STMT_INVOKEINTERFACE */ {
 			struct tree_node *args_list;
 			struct vm_method *target_method;
+			/* Devirtualized call that depends on class hierarchy analysis. */
+			bool cha_dependent;
 		};
 
 		/* STMT_EXPRESSION, STMT_ARRAY_CHECK */
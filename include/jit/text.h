@@ -4,12 +4,26 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+enum jit_text_segment {
+	JIT_TEXT_METHODS,	/* method bodies */
+	JIT_TEXT_STUBS,		/* trampolines and dispatch stubs */
+	JIT_TEXT_IC_STUBS,	/* polymorphic inline cache stubs */
+	NR_JIT_TEXT_SEGMENTS,
+};
+
 void jit_text_init(void);
-void jit_text_lock(void);
-void jit_text_unlock(void);
+void *jit_text_begin(enum jit_text_segment type, size_t max_size);
+void jit_text_end(size_t size);
+void jit_text_free(void *start, size_t size);
+void jit_text_retire(void *start, size_t size, void (*release)(void *), void *data);
+void jit_text_collect(bool (*in_use)(void *start, size_t size));
+void jit_text_sweep(void);
 void *jit_text_ptr(void);
+void *jit_text_base(void);
+size_t jit_text_size(void);
 void jit_text_reserve(size_t size);
+size_t jit_text_code_size(enum jit_text_segment type);
+void jit_text_print_stats(void);
 bool is_jit_text(void *);
 
 #endif
-
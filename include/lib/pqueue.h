@@ -24,4 +24,10 @@ static inline bool pqueue_is_empty(struct pqueue *pq)
 	return pq->size == 1;
 }
 
+/* Returns the key of the element that pqueue_remove_top() returns next. */
+static inline unsigned long pqueue_top_key(struct pqueue *pq)
+{
+	return pq->data[1].key;
+}
+
 #endif /* LIB_PQUEUE_H */
@@ -0,0 +1,28 @@
+#ifndef RUNTIME_MEMORY_MANAGEMENT_H
+#define RUNTIME_MEMORY_MANAGEMENT_H
+
+#include "vm/jni.h"
+
+jobject native_vmmanagementfactory_get_memory_pool_names(void);
+jobject native_vmmanagementfactory_get_memory_manager_names(void);
+jobject native_vmmanagementfactory_get_garbage_collector_names(void);
+
+jint native_vmmemorymxbeanimpl_get_object_pending_finalization_count(void);
+jboolean native_vmmemorymxbeanimpl_is_verbose(void);
+void native_vmmemorymxbeanimpl_set_verbose(jboolean verbose);
+
+jobject native_vmmemorypoolmxbeanimpl_get_usage(jobject name);
+jobject native_vmmemorypoolmxbeanimpl_get_peak_usage(jobject name);
+jobject native_vmmemorypoolmxbeanimpl_get_collection_usage(jobject name);
+void native_vmmemorypoolmxbeanimpl_reset_peak_usage(jobject name);
+jobject native_vmmemorypoolmxbeanimpl_get_type(jobject name);
+jboolean native_vmmemorypoolmxbeanimpl_is_valid(jobject name);
+jobject native_vmmemorypoolmxbeanimpl_get_memory_manager_names(jobject name);
+
+jboolean native_vmmemorymanagermxbeanimpl_is_valid(jobject name);
+jobject native_vmmemorymanagermxbeanimpl_get_memory_pool_names(jobject name);
+
+jlong native_vmgarbagecollectormxbeanimpl_get_collection_count(jobject name);
+jlong native_vmgarbagecollectormxbeanimpl_get_collection_time(jobject name);
+
+#endif /* RUNTIME_MEMORY_MANAGEMENT_H */
@@ -6,6 +6,7 @@
 
 #include "vm/jni.h"
 
+struct compilation_unit;
 struct vm_method;
 struct vm_object;
 
@@ -95,4 +96,16 @@ extern void native_call(struct vm_method *method,
 			unsigned long *args,
 			union jvalue *result);
 
+/*
+ * The trampoline of a cold method jumps to interp_entry() instead of to
+ * its machine code, see jit_magic_trampoline(). It passes the arguments
+ * of the call to interp_from_jit() which runs the method in the
+ * interpreter.
+ */
+extern void interp_entry(void);
+extern void *interp_from_jit(struct compilation_unit *cu,
+			     unsigned long *regs,
+			     unsigned long *stack,
+			     union jvalue *result);
+
 #endif
@@ -37,10 +37,11 @@ enum vm_class_kind {
 };
 
 /*
- * NOTE NOTE NOTE! You must update supertype_cache_test() if you change this
- * constant.
+ * Number of entries in the primary supertype display. Classes that are
+ * deeper than this in the hierarchy are checked through the secondary
+ * supertypes instead.
  */
-#define SUPERTYPE_CACHE_SIZE           2
+#define VM_CLASS_DISPLAY_SIZE		8
 
 struct vm_class {
 	/* Compile lock for fast class initialization */
@@ -68,6 +69,16 @@ struct vm_class {
 	unsigned int object_size;
 	unsigned int static_size;
 
+	/*
+	 * The reference fields declared by this class are laid out first
+	 * and next to each other, see buckets_order_fields(). This lets the
+	 * GC find them without looking at the fields.
+	 */
+	unsigned int ref_fields_offset;
+	unsigned int nr_ref_fields;
+	unsigned int static_ref_fields_offset;
+	unsigned int nr_static_ref_fields;
+
 	unsigned int vtable_size;
 	struct vtable vtable;
 
@@ -103,15 +114,32 @@ struct vm_class {
 	struct vm_class *declaring_class;
 	struct vm_class *enclosing_class;
 
+	/*
+	 * The constructor used by the VM to instantiate exceptions of this
+	 * class. It is looked up on the first throw, see new_exception().
+	 */
+	struct vm_method *exception_init;
+
 	struct cafebabe_enclosing_method_attribute enclosing_method_attribute;
 
 	/*
-	 * The supertype cache contains pointers to 'struct vm_class' of
-	 * recently accessed supertypes of this class. The purpose of this
-	 * cache is to speed up subtype checks.
+	 * The primary supertype display holds the superclass chain of this
+	 * class indexed by depth, so that 'primary_supers[vmc->depth] == vmc'
+	 * answers a subclass check against 'vmc' with a single load.
+	 * java.lang.Object is at depth zero.
 	 */
-	const struct vm_class			*supertype_cache[SUPERTYPE_CACHE_SIZE];
-	unsigned int				supertype_cache_ndx;
+	unsigned int				depth;
+	struct vm_class				*primary_supers[VM_CLASS_DISPLAY_SIZE];
+
+	/*
+	 * The secondary supertypes are all the interfaces implemented by
+	 * this class and the superclasses that did not fit in the display.
+	 * The last secondary supertype that matched a subtype check is
+	 * cached in 'secondary_super_cache'.
+	 */
+	unsigned int				nr_secondary_supers;
+	struct vm_class				**secondary_supers;
+	const struct vm_class			*secondary_super_cache;
 };
 
 int vm_class_link(struct vm_class *vmc, const struct cafebabe_class *class);
@@ -206,6 +234,8 @@ struct vm_method *vm_class_get_method(const struct vm_class *vmc,
 	const char *name, const char *type);
 struct vm_method *vm_class_get_method_recursive(const struct vm_class *vmc,
 	const char *name, const char *type);
+struct vm_method *vm_class_get_virtual_method(const struct vm_class *vmc,
+	struct vm_method *vmm);
 
 int vm_class_resolve_method(const struct vm_class *vmc, uint16_t i,
 	struct vm_class **r_vmc, char **r_name, char **r_type);
@@ -219,14 +249,27 @@ struct vm_method *vm_class_resolve_interface_method_recursive(
 
 bool vm_class_is_assignable_from_slow(struct vm_class *vmc, const struct vm_class *from);
 
-static inline bool supertype_cache_test(const struct vm_class *vmc, const struct vm_class *super)
+/*
+ * Returns true if subtype checks against @vmc can be answered from the
+ * primary supertype display alone. Array classes are excluded because
+ * they are covariant in their element type.
+ */
+static inline bool vm_class_is_primary_type(const struct vm_class *vmc)
 {
-	return vmc->supertype_cache[0] == super || vmc->supertype_cache[1] == super;
+	return vmc->kind == VM_CLASS_KIND_REGULAR
+		&& !vm_class_is_interface(vmc)
+		&& vmc->depth < VM_CLASS_DISPLAY_SIZE;
 }
 
 static inline bool vm_class_is_assignable_from(struct vm_class *vmc, const struct vm_class *from)
 {
-	return supertype_cache_test(vmc, from) || vm_class_is_assignable_from_slow(vmc, from);
+	if (vm_class_is_primary_type(vmc))
+		return from->primary_supers[vmc->depth] == vmc;
+
+	if (vmc == from || from->secondary_super_cache == vmc)
+		return true;
+
+	return vm_class_is_assignable_from_slow(vmc, from);
 }
 
 bool vm_class_is_primitive_type_name(const char *class_name);
@@ -0,0 +1,78 @@
+#ifndef JATO_VM_GC_HEAP_H
+#define JATO_VM_GC_HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The heap of the precise garbage collector. It is one contiguous
+ * reservation of max_heap_size bytes split into blocks. A block holds
+ * either small objects of one size class or is part of a large object.
+ * Objects start at granule boundaries and every granule has an allocated
+ * and a mark bit, so that an arbitrary word can be resolved to the object
+ * that contains it.
+ *
+ * In the generational mode the mark bits are sticky. Objects that
+ * survived a collection stay marked and are old, allocated objects that
+ * are not marked are young. A young collection only traces young objects
+ * and frees the unreachable ones, a full collection clears all marks
+ * first.
+ *
+ * None of the functions take locks. The callers serialize access to the
+ * heap, see vm/gc.c. Only gc_heap_mark() may be called concurrently.
+ */
+#define GC_GRANULE_SIZE		16
+#define GC_BLOCK_SIZE		(32 * 1024)
+#define GC_MAX_SMALL_SIZE	8192
+
+/*
+ * Card table of the generational mode. Every card covers GC_CARD_SIZE
+ * bytes of the heap and is dirtied when a reference is stored into an
+ * object that overlaps it. The barrier may use any address inside the
+ * object. The table pointer is biased so that the card of an address is
+ * gc_card_table[addr >> GC_CARD_SHIFT]. It is NULL unless the collector
+ * is generational.
+ */
+#define GC_CARD_SHIFT		9
+#define GC_CARD_SIZE		(1UL << GC_CARD_SHIFT)
+
+#define GC_CARD_CLEAN		0
+#define GC_CARD_DIRTY		1
+
+extern uint8_t *gc_card_table;
+extern unsigned long gc_heap_start_addr;
+extern unsigned long gc_heap_end_addr;
+
+static inline void gc_card_mark(void *p)
+{
+	unsigned long addr = (unsigned long) p;
+
+	if (!gc_card_table)
+		return;
+
+	if (addr >= gc_heap_start_addr && addr < gc_heap_end_addr)
+		gc_card_table[addr >> GC_CARD_SHIFT] = GC_CARD_DIRTY;
+}
+
+int gc_heap_init(unsigned long size);
+int gc_heap_init_cards(unsigned long nursery_size);
+void *gc_heap_alloc(size_t size, bool force);
+void *gc_heap_find_object(unsigned long addr);
+unsigned long gc_heap_object_size(void *obj);
+bool gc_heap_mark(void *obj);
+bool gc_heap_is_marked(void *obj);
+void gc_heap_clear_marks(void);
+void gc_heap_for_each_marked(void (*fn)(void *obj));
+void gc_heap_for_each_dirty(void (*fn)(void *obj), unsigned long part, unsigned long nr_parts);
+void gc_heap_clear_cards(void);
+bool gc_heap_needs_full_gc(void);
+void gc_heap_reset_nursery(void);
+void gc_heap_sweep(bool full);
+
+unsigned long gc_heap_used(void);
+unsigned long gc_heap_committed(void);
+unsigned long gc_heap_allocated(void);
+unsigned long gc_heap_size(void);
+
+#endif /* JATO_VM_GC_HEAP_H */
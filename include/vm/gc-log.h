@@ -0,0 +1,52 @@
+#ifndef JATO_VM_GC_LOG_H
+#define JATO_VM_GC_LOG_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+struct vm_class;
+
+/* Number of classes with the most live bytes that are logged. */
+#define GC_LOG_NR_TOP_CLASSES	10
+
+struct gc_class_stats {
+	struct vm_class		*vmc;
+	unsigned long		nr_objects;
+	unsigned long		nr_bytes;
+};
+
+/*
+ * One collection. Times are in microseconds, @start_us is relative to
+ * the start of the VM.
+ */
+struct gc_event {
+	unsigned long		id;
+	bool			full;
+	unsigned long		start_us;
+	unsigned long		pause_us;
+	unsigned long		safepoint_us;
+	unsigned long		allocated;
+	unsigned long		used_before;
+	unsigned long		used_after;
+	unsigned long		committed;
+	unsigned long		max;
+
+	unsigned int		nr_classes;
+	struct gc_class_stats	classes[GC_LOG_NR_TOP_CLASSES];
+};
+
+extern const char *gc_log_file;
+extern FILE *gc_log;
+
+static inline bool gc_log_enabled(void)
+{
+	return gc_log != NULL;
+}
+
+int gc_log_init(void);
+unsigned long gc_log_uptime_us(void);
+void gc_log_count_object(struct vm_class *vmc, unsigned long size);
+void gc_log_top_classes(struct gc_event *event);
+void gc_log_event(struct gc_event *event);
+
+#endif /* JATO_VM_GC_LOG_H */
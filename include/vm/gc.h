@@ -7,22 +7,48 @@
 #include "vm/object.h"
 
 struct register_state;
+struct vm_class;
 
 extern unsigned long		max_heap_size;
 extern void			*gc_safepoint_page;
 extern bool			newgc_enabled;
+extern bool			gc_generational;
+extern unsigned long		gc_nursery_size;
+extern unsigned int		opt_nr_gc_threads;
 extern bool			verbose_gc;
 extern int			dont_gc;
 
 typedef void (*finalizer_fn)(struct vm_object *object);
 
+/*
+ * Counters of a collector for the java.lang.management beans. Sizes are
+ * in bytes and times in microseconds.
+ */
+struct gc_stats {
+	const char		*name;
+	unsigned long		nr_collections;
+	unsigned long		total_pause_us;
+	unsigned long		used;
+	unsigned long		committed;
+	unsigned long		max;
+	unsigned long		peak_used;
+	unsigned long		used_after_gc;
+	unsigned long		committed_after_gc;
+	unsigned long		nr_pending_finalizers;
+};
+
 struct gc_operations {
 	void *(*gc_alloc)(size_t size);
 	void *(*gc_alloc_noscan)(size_t size);
+	void *(*gc_alloc_many)(size_t size);
+	void *(*gc_alloc_many_noscan)(size_t size);
 	void *(*vm_alloc)(size_t size);
 	void (*vm_free)(void *p);
+	void *(*vm_alloc_static_values)(struct vm_class *vmc, size_t size);
 	int (*gc_register_finalizer)(struct vm_object *object, finalizer_fn finalizer);
 	void (*gc_setup_signals)(void);
+	void (*gc_get_stats)(struct gc_stats *stats);
+	void (*gc_reset_peak)(void);
 };
 
 void gc_setup_boehm(void);
@@ -65,6 +91,11 @@ extern struct gc_operations gc_ops;
  *              scans whole region allocated with vm_alloc() for object
  *              references.
  *
+ * vm_alloc_static_values()
+ *		Allocates the static field values of a class like
+ *              vm_zalloc(). A precise GC only scans the reference
+ *              fields in the region. Can be freed with vm_free().
+ *
  * gc_alloc()   Allocates collectable memory region. Can not be freed
  *              manually. The content is scanned for object references.
  *              This is used to allocate Java objects.
@@ -73,6 +104,18 @@ extern struct gc_operations gc_ops;
  *		Allocates collectable memory region. Can not be freed
  *              manually. The content is NOT scanned for object references.
  *              This is used to allocate memory for primitives.
+ *
+ * gc_alloc_many()
+ *		Allocates a list of collectable memory regions of the same
+ *              size linked through their first word. The content is
+ *              scanned for object references. This is used to refill
+ *              thread-local allocation buffers (see include/vm/tlab.h).
+ *              Optional; the buffers are disabled when it is missing.
+ *
+ * gc_alloc_many_noscan()
+ *		Same as gc_alloc_many() but the content is NOT scanned for
+ *              object references. The regions are cleared apart from the
+ *              link. Required when gc_alloc_many() is provided.
  */
 
 static inline void *gc_alloc(size_t size)
@@ -85,6 +128,16 @@ static inline void *gc_alloc_noscan(size_t size)
 	return gc_ops.gc_alloc_noscan(size);
 }
 
+static inline void *gc_alloc_many(size_t size)
+{
+	return gc_ops.gc_alloc_many(size);
+}
+
+static inline void *gc_alloc_many_noscan(size_t size)
+{
+	return gc_ops.gc_alloc_many_noscan(size);
+}
+
 static inline void *vm_alloc(size_t size)
 {
 	return gc_ops.vm_alloc(size);
@@ -92,6 +145,14 @@ static inline void *vm_alloc(size_t size)
 
 void *vm_zalloc(size_t size);
 
+static inline void *vm_alloc_static_values(struct vm_class *vmc, size_t size)
+{
+	if (gc_ops.vm_alloc_static_values)
+		return gc_ops.vm_alloc_static_values(vmc, size);
+
+	return vm_zalloc(size);
+}
+
 static inline void vm_free(void *ptr)
 {
 	gc_ops.vm_free(ptr);
@@ -110,6 +171,17 @@ gc_setup_signals(void)
 		gc_ops.gc_setup_signals();
 }
 
+static inline void gc_get_stats(struct gc_stats *stats)
+{
+	gc_ops.gc_get_stats(stats);
+}
+
+static inline void gc_reset_peak(void)
+{
+	if (gc_ops.gc_reset_peak)
+		gc_ops.gc_reset_peak();
+}
+
 void gc_safepoint(struct register_state *);
 void suspend_handler(int, siginfo_t *, void *);
 void wakeup_handler(int, siginfo_t *, void *);
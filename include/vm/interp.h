@@ -1,13 +1,27 @@
 #ifndef JATO__VM_INTERP_H
 #define JATO__VM_INTERP_H
 
+#include "jit/compile-queue.h"
+
+#include "vm/method.h"
 #include "vm/jni.h"
 
 #include <stdarg.h>
+#include <stdbool.h>
 
-struct vm_method;
 struct vm_object;
 
+extern bool opt_interp_only;
+extern bool opt_tiered_compilation;
+extern unsigned long opt_compile_threshold;
+
+/*
+ * Loop back branches are much cheaper than invocations so they only
+ * count as a fraction of an invocation towards the compile threshold.
+ */
+#define TIERED_BACKEDGES_PER_INVOCATION	16
+
+void vm_interp_method_a(struct vm_method *method, unsigned long *args, union jvalue *result);
 void vm_interp_method_v(struct vm_method *method, va_list args, union jvalue *result);
 
 static inline void vm_interp_method(struct vm_method *method, ...)
@@ -20,4 +34,51 @@ static inline void vm_interp_method(struct vm_method *method, ...)
 	va_end(args);
 }
 
+static inline bool vm_interp_enabled(void)
+{
+	return opt_interp_only || opt_tiered_compilation;
+}
+
+static inline unsigned long vm_method_hotness(struct vm_method *vmm)
+{
+	return vmm->invocation_count + vmm->backedge_count / TIERED_BACKEDGES_PER_INVOCATION;
+}
+
+static inline bool vm_method_is_hot(struct vm_method *vmm)
+{
+	return vm_method_hotness(vmm) >= opt_compile_threshold;
+}
+
+/*
+ * Returns true if @vmm should be executed by the interpreter instead of
+ * being called through its trampoline. In tiered mode methods are
+ * interpreted until they become hot. Hot methods are then compiled by a
+ * background compiler thread, or by the trampoline if background
+ * compilation is disabled, which patches the call sites to point to the
+ * compiled code.
+ */
+static inline bool vm_method_should_interpret(struct vm_method *vmm)
+{
+	if (!vm_interp_enabled())
+		return false;
+
+	if (vm_method_is_missing(vmm) || vm_method_is_native(vmm) || vm_method_is_abstract(vmm))
+		return false;
+
+	if (opt_interp_only)
+		return true;
+
+	/*
+	 * Optimistic unlocked check. A method that is being compiled
+	 * concurrently is picked up by a later call.
+	 */
+	if (vmm->compilation_unit->state == COMPILATION_STATE_COMPILED)
+		return false;
+
+	if (!vm_method_is_hot(vmm))
+		return true;
+
+	return compile_queue_enabled() && compile_queue_submit(vmm->compilation_unit);
+}
+
 #endif /* JATO__VM_INTERP_H */
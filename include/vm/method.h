@@ -59,8 +59,18 @@ struct vm_method {
 	struct compilation_unit *compilation_unit;
 	struct jit_trampoline *trampoline;
 
+	/* Interpreter profile used to find hot methods in tiered mode. */
+	unsigned long invocation_count;
+	unsigned long backedge_count;
+
 	char flags;
 
+	/*
+	 * Direct calls to this method that must be re-patched if a class
+	 * overriding it is linked. See jit/cha.c.
+	 */
+	struct list_head cha_site_list;
+
 	unsigned int nr_annotations;
 	struct vm_annotation **annotations;
 	bool annotation_initialized;
@@ -69,6 +79,7 @@ struct vm_method {
 #define VM_METHOD_FLAG_VM_NATIVE	(1 << 1)
 #define VM_METHOD_FLAG_TRACE		(1 << 2)
 #define VM_METHOD_FLAG_TRACE_GATE	(1 << 3)
+#define VM_METHOD_FLAG_OVERRIDDEN	(1 << 4)
 
 unsigned int vm_method_arg_stack_count(struct vm_method *vmm);
 
@@ -6,6 +6,7 @@
 #include "arch/atomic.h"
 
 #include <semaphore.h>
+#include <stdbool.h>
 #include <pthread.h>
 
 struct vm_exec_env;
@@ -24,7 +25,31 @@ struct vm_object;
  *
  * For more details see David Dice's work: "Implementing Fast Java
  * Monitors with Relaxed-Locks".
+ *
+ * Monitors which are locked without contention are not inflated. The
+ * owner stores a thin lock word in object.monitor_record instead:
+ *
+ *   | thread id | recursion count | 1 |
+ *
+ * Bit 0 distinguishes lock words from pointers to monitor records. The
+ * recursion count is the number of times the owner re-entered the
+ * monitor. Only the owner modifies a thin lock word so recursive locking
+ * and unlocking are plain stores. A thin lock is inflated when another
+ * thread contends for it, when the recursion count overflows or when the
+ * owner calls wait().
  */
+#define THIN_LOCK_TAG		1UL
+#define THIN_LOCK_COUNT_SHIFT	1
+#define THIN_LOCK_COUNT_BITS	7
+#define THIN_LOCK_COUNT_ONE	(1UL << THIN_LOCK_COUNT_SHIFT)
+#define THIN_LOCK_COUNT_MASK	(((1UL << THIN_LOCK_COUNT_BITS) - 1) << THIN_LOCK_COUNT_SHIFT)
+#define THIN_LOCK_ID_SHIFT	(THIN_LOCK_COUNT_SHIFT + THIN_LOCK_COUNT_BITS)
+
+static inline bool is_thin_lock(void *lock_word)
+{
+	return (unsigned long) lock_word & THIN_LOCK_TAG;
+}
+
 struct vm_monitor_record {
 	/* Holds pointer to struct vm_exec_env */
 	void			*owner;
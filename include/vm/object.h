@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "vm/gc-heap.h"
 #include "vm/monitor.h"
 #include "vm/system.h"
 #include "vm/field.h"
@@ -65,6 +66,7 @@ int init_vm_objects(void);
 struct vm_object *vm_object_alloc(struct vm_class *class);
 struct vm_object *vm_object_alloc_array_raw(struct vm_class *class, size_t elem_size, int count);
 struct vm_object *vm_object_alloc_primitive_array(int type, int count);
+struct vm_class *vm_primitive_array_class(int type);
 struct vm_object *vm_object_alloc_multi_array(struct vm_class *class, int nr_dimensions, ...);
 struct vm_object *vm_object_alloc_array(struct vm_class *class, int count);
 struct vm_object *vm_object_alloc_array_of(struct vm_class *elem_class, int count);
@@ -73,6 +75,11 @@ struct vm_object *vm_object_clone(struct vm_object *obj);
 
 struct vm_object *
 vm_object_alloc_string_from_utf8(const uint8_t bytes[], unsigned int length);
+struct vm_object *
+vm_object_alloc_uninterned_string_from_utf8(const uint8_t bytes[], unsigned int length);
+struct vm_object *
+vm_object_alloc_string_from_utf8_count(const uint8_t bytes[], unsigned int length,
+				       unsigned int count);
 struct vm_object *vm_object_alloc_string_from_c(const char *bytes);
 bool vm_object_is_instance_of(const struct vm_object *obj, struct vm_class *class);
 void vm_object_check_null(struct vm_object *obj);
@@ -162,7 +169,16 @@ DECLARE_FIELD_SETTER(double);
 DECLARE_FIELD_SETTER(float);
 DECLARE_FIELD_SETTER(int);
 DECLARE_FIELD_SETTER(long);
-DECLARE_FIELD_SETTER(object);
+
+static inline void
+field_set_object(struct vm_object *obj, const struct vm_field *field,
+		 jobject value)
+{
+	uint8_t *fields = vm_object_fields(obj);
+
+	*(jobject *) &fields[field->offset] = value;
+	gc_card_mark(obj);
+}
 
 DECLARE_FIELD_GETTER(byte);
 DECLARE_FIELD_GETTER(boolean);
@@ -229,7 +245,15 @@ DECLARE_ARRAY_FIELD_SETTER(double, J_DOUBLE);
 DECLARE_ARRAY_FIELD_SETTER(float, J_FLOAT);
 DECLARE_ARRAY_FIELD_SETTER(int, J_INT);
 DECLARE_ARRAY_FIELD_SETTER(long, J_LONG);
-DECLARE_ARRAY_FIELD_SETTER(object, J_REFERENCE);
+
+static inline void
+array_set_field_object(struct vm_object *obj, int index, jobject value)
+{
+	uint8_t *fields = vm_array_elems(obj);
+
+	*(jobject *) &fields[index * vmtype_get_size(J_REFERENCE)] = value;
+	gc_card_mark(obj);
+}
 
 DECLARE_ARRAY_FIELD_GETTER(byte, J_BYTE);
 DECLARE_ARRAY_FIELD_GETTER(boolean, J_BOOLEAN);
@@ -247,6 +271,7 @@ array_set_field_ptr(struct vm_object *obj, int index, void *value)
 	uint8_t *fields = vm_array_elems(obj);
 
 	*(void **) &fields[index * vmtype_get_size(J_NATIVE_PTR)] = value;
+	gc_card_mark(obj);
 }
 
 static inline void *
@@ -33,6 +33,7 @@ PRELOAD_METHOD(vm_java_lang_Thread, "getName", "()Ljava/lang/String;", vm_java_l
 PRELOAD_METHOD(vm_java_lang_Thread, "isDaemon", "()Z", vm_java_lang_Thread_isDaemon)
 PRELOAD_METHOD(vm_java_lang_ThreadGroup, "<init>", "()V", vm_java_lang_ThreadGroup_init)
 PRELOAD_METHOD(vm_java_lang_ThreadGroup, "addThread", "(Ljava/lang/Thread;)V", vm_java_lang_ThreadGroup_addThread)
+PRELOAD_METHOD(vm_java_lang_Throwable, "fillInStackTrace", "()Ljava/lang/Throwable;", vm_java_lang_Throwable_fillInStackTrace)
 PRELOAD_METHOD(vm_java_lang_Throwable, "getCause", "()Ljava/lang/Throwable;", vm_java_lang_Throwable_getCause)
 PRELOAD_METHOD(vm_java_lang_Throwable, "getStackTrace", "()[Ljava/lang/StackTraceElement;", vm_java_lang_Throwable_getStackTrace)
 PRELOAD_METHOD(vm_java_lang_Throwable, "initCause", "(Ljava/lang/Throwable;)Ljava/lang/Throwable;", vm_java_lang_Throwable_initCause)
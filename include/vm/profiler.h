@@ -0,0 +1,20 @@
+#ifndef JATO_VM_PROFILER_H
+#define JATO_VM_PROFILER_H
+
+#include <stdbool.h>
+
+struct compilation_unit;
+
+/* -Xprof: sample the stacks of all threads */
+extern bool opt_profile;
+
+/* -Xprof:counters: count method entries and backedges in compiled code */
+extern bool opt_profile_counters;
+
+int profiler_init(void);
+void profiler_exit(void);
+void profiler_add_cu(struct compilation_unit *cu);
+void profiler_request_dump(void);
+void profiler_dump(void);
+
+#endif /* JATO_VM_PROFILER_H */
@@ -38,6 +38,23 @@ struct vm_native_stack_entry {
 	void *target;
 } __attribute__((packed));
 
+/*
+ * Interpreted methods run in the native frame of vm_interp_method_a()
+ * so the stack walker can not tell them apart from other VM code. The
+ * interpreter links an entry for every method it runs into a
+ * per-thread stack which the walker matches against native frames.
+ */
+struct interp_frame {
+	struct interp_frame *prev;
+	struct vm_method *method;
+
+	/* Bytecode offset of the instruction being executed. */
+	unsigned long pc;
+
+	/* Native frame in which @method is interpreted. */
+	void *native_frame;
+};
+
 #define VM_NATIVE_STACK_SIZE 256
 #define JNI_STACK_SIZE 1024
 
@@ -50,12 +67,15 @@ extern __thread struct jni_stack_entry jni_stack[JNI_STACK_SIZE];
 extern __thread unsigned long jni_stack_offset;
 extern __thread struct vm_native_stack_entry vm_native_stack[VM_NATIVE_STACK_SIZE];
 extern __thread unsigned long vm_native_stack_offset;
+extern __thread struct interp_frame *interp_frame_top;
 
 int vm_enter_jni(void *caller_frame, struct vm_method *method,
 		 unsigned long return_address);
 int vm_enter_vm_native(void *target, void *stack_ptr);
 unsigned long vm_leave_jni(void);
 void vm_leave_vm_native(void);
+void vm_enter_interp(struct interp_frame *frame);
+void vm_leave_interp(void);
 
 static inline int jni_stack_index(void)
 {
@@ -99,6 +119,7 @@ enum stack_trace_elem_type {
 	STACK_TRACE_ELEM_TYPE_JIT,
 	STACK_TRACE_ELEM_TYPE_JNI,
 	STACK_TRACE_ELEM_TYPE_VM_NATIVE,
+	STACK_TRACE_ELEM_TYPE_INTERP,
 
 	STACK_TRACE_ELEM_TYPE_OTHER, /* All values below this are java */
 	STACK_TRACE_ELEM_TYPE_TRAMPOLINE,
@@ -113,6 +134,9 @@ struct stack_trace_elem {
 	int vm_native_stack_index;
 	int jni_stack_index;
 
+	/* The innermost interpreter frame not yet walked past. */
+	struct interp_frame *interp_frame;
+
 	/*
 	 * If true then @frame has format of struct native_stack_frame
 	 * and struct jit_stack_frame otherwise.
@@ -126,6 +150,10 @@ struct stack_trace_elem {
 	 */
 	void *frame;
 
+	/*
+	 * Set for JNI and interpreter elements. For the latter @addr
+	 * holds the bytecode offset instead of an instruction address.
+	 */
 	struct compilation_unit *cu;
 };
 
@@ -138,6 +166,7 @@ stack_trace_elem_type_is_java(enum stack_trace_elem_type type)
 void init_stack_trace_printing(void);
 void init_stack_trace_elem(struct stack_trace_elem *elem, unsigned long addr,
 			   void *frame);
+int init_stack_trace_elem_native_caller(struct stack_trace_elem *elem);
 int stack_trace_elem_next(struct stack_trace_elem *elem);
 int stack_trace_elem_next_java(struct stack_trace_elem *elem);
 int skip_frames_from_class(struct stack_trace_elem *elem, struct vm_class *class);
@@ -1,9 +1,13 @@
 #ifndef JATO_STRING_H
 #define JATO_STRING_H
 
+#include <stdint.h>
+
 struct vm_object;
 
 void init_literals_hash_map(void);
 struct vm_object *vm_string_intern(struct vm_object *string);
+struct vm_object *vm_string_intern_utf8(const uint8_t *bytes, unsigned int length);
+void vm_string_print_stats(void);
 
 #endif /* JATO_STRING_H */
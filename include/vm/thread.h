@@ -3,6 +3,8 @@
 
 #include "lib/list.h"
 
+#include "vm/tlab.h"
+
 #include "arch/atomic.h"
 #include "arch/registers.h"
 
@@ -61,21 +63,64 @@ struct vm_exec_env {
 	 */
 	struct vm_object *exception;
 
+	/*
+	 * Set while the VM constructs an exception whose stack trace is
+	 * not captured, see -XX:+OmitStackTraceInFastThrow. The stack
+	 * trace of 'stack_trace_pending' is captured when it is thrown
+	 * unless the raising method catches it.
+	 */
+	bool omit_stack_trace;
+	struct vm_object *stack_trace_pending;
+
 	/* Used by classloader when tracing with -Xtrace:classloader */
 	int trace_classloader_level;
 
+	pthread_t posix_id;
+
+	/* Links the execution environment to exec_env_list. */
+	struct list_head list_node;
+
 	/* A semaphore flag used by GC */
 	sig_atomic_t in_safepoint;
 
+	/*
+	 * Set if the thread was stopped by the GC in native code rather
+	 * than at a safepoint poll of JIT code.
+	 */
+	bool stopped_in_native;
+
 	/* Signal register state */
 	struct register_state thread_register_state;
 
+	/*
+	 * Highest address of the thread's stack and the stack pointer at
+	 * which the thread was stopped by the GC. Everything the thread
+	 * references, including the code it executes, is in between while
+	 * it is stopped.
+	 */
+	void *stack_end;
+	void *safepoint_sp;
+
+	/*
+	 * Thin lock word of this thread with zero recursion count. See
+	 * include/vm/monitor.h.
+	 */
+	unsigned long thin_lock_word;
+
 	struct string *trace_buffer;
+
+	/*
+	 * Thread-local allocation buffer. The JIT emits code that pops
+	 * objects from it directly, see emit_tlab_alloc_object().
+	 */
+	struct tlab tlab;
 };
 
 unsigned int vm_nr_threads(void);
+unsigned int vm_nr_exec_envs(void);
 
 extern pthread_key_t current_exec_env_key;
+extern __thread struct vm_exec_env *current_exec_env;
 
 static inline struct vm_exec_env *vm_get_exec_env(void)
 {
@@ -93,6 +138,7 @@ static inline struct vm_thread *vm_thread_self(void)
 }
 
 void init_exec_env(void);
+int init_internal_exec_env(void);
 int init_threading(void);
 int vm_thread_start(struct vm_object *vmthread);
 void vm_thread_wait_for_non_daemons(void);
@@ -111,8 +157,10 @@ void vm_unlock_thread_count(void);
 void vm_thread_collect_vmthread(struct vm_object *object);
 
 extern struct list_head thread_list;
+extern struct list_head exec_env_list;
 extern pthread_mutex_t threads_mutex;
 
 #define vm_thread_for_each(this) list_for_each_entry(this, &thread_list, list_node)
+#define vm_exec_env_for_each(this) list_for_each_entry(this, &exec_env_list, list_node)
 
 #endif
@@ -0,0 +1,41 @@
+#ifndef JATO_VM_TLAB_H
+#define JATO_VM_TLAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Thread-local allocation buffers. Every thread keeps free lists of small
+ * collectable objects which are refilled in bulk from the garbage
+ * collector. Allocating an object is then just a pop from the list for its
+ * size class and does not need to take the collector lock. The JIT inlines
+ * that pop for new, newarray and anewarray.
+ */
+#define TLAB_GRANULE		sizeof(void *)
+#define TLAB_MAX_SIZE		256
+#define TLAB_NR_FREE_LISTS	(TLAB_MAX_SIZE / TLAB_GRANULE + 1)
+
+struct tlab {
+	/*
+	 * Free objects of at least index * TLAB_GRANULE bytes, linked
+	 * through their first word. Objects are cleared apart from the link.
+	 */
+	void			*free_lists[TLAB_NR_FREE_LISTS];
+
+	/*
+	 * Same as above for objects whose content is not scanned by the GC.
+	 * Used for primitive arrays.
+	 */
+	void			*noscan_free_lists[TLAB_NR_FREE_LISTS];
+};
+
+static inline unsigned long tlab_index(size_t size)
+{
+	return (size + TLAB_GRANULE - 1) / TLAB_GRANULE;
+}
+
+bool tlab_enabled(void);
+void *tlab_alloc(size_t size);
+void *tlab_alloc_noscan(size_t size);
+
+#endif /* JATO_VM_TLAB_H */
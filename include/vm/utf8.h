@@ -5,9 +5,38 @@
 
 struct vm_object;
 
+unsigned int utf8_ascii_prefix(const uint8_t *bytes, unsigned int n);
+void bytes_to_chars(uint16_t *chars, const uint8_t *bytes, unsigned int n);
 int utf8_char_count(const uint8_t *bytes, unsigned int n, unsigned int *res);
 struct vm_object *utf8_to_char_array(const uint8_t *bytes, unsigned int n);
+void utf8_decode_chars(uint16_t *chars, const uint8_t *bytes, unsigned int n);
 char *dots_to_slash(const char *utf);
 char *slash_to_dots(const char *utf);
 
+/*
+ * Decodes the character at @bytes[*pos] and advances @pos past it. The
+ * input must have been checked with utf8_char_count().
+ */
+static inline uint16_t utf8_next_char(const uint8_t *bytes, unsigned int *pos)
+{
+	unsigned int i = *pos;
+	uint16_t ch;
+
+	if (!(bytes[i] & 0x80)) {
+		ch = bytes[i];
+		*pos = i + 1;
+	} else if ((bytes[i] & 0xe0) == 0xc0) {
+		ch = (uint16_t) (bytes[i] & 0x1f) << 6;
+		ch += bytes[i + 1] & 0x3f;
+		*pos = i + 2;
+	} else {
+		ch = (uint16_t) (bytes[i] & 0xf) << 12;
+		ch += (uint16_t) (bytes[i + 1] & 0x3f) << 6;
+		ch += bytes[i + 2] & 0x3f;
+		*pos = i + 3;
+	}
+
+	return ch;
+}
+
 #endif /* JATO_VM_UTF8_H */
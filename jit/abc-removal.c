@@ -1,5 +1,5 @@
 /*
- * Conversion from LIR to SSA, optimizations and conversion from SSA to LIR
+ * Array bounds check elimination on SSA form
  * Copyright (c) 2011 Ana Farcasi
  *
  * This file is released under the GPL version 2 with the following
@@ -27,106 +27,1156 @@
  */
 
 #include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
 #include "jit/compiler.h"
 #include "jit/instruction.h"
 #include "jit/ssa.h"
 #include "jit/vars.h"
 
 #include "lib/bitset.h"
-#include "lib/radix-tree.h"
+#include "lib/hash-map.h"
 
-#include <stdio.h>
+#include "vm/object.h"
 
-void abc_removal(struct compilation_unit *cu)
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This pass hoists and removes INSN_SEM_ARRAY_CHECK instructions:
+ *
+ *   - A check at the start of a loop header whose array and index do not
+ *     change in the loop is moved to the end of the loop preheader. The
+ *     header runs every time the loop is entered so the check still runs
+ *     before the side effects of the first iteration. Checks in the body
+ *     of loops that test their condition first are not hoisted because
+ *     the body may not run at all.
+ *
+ * and then removes the ones that can be proven redundant:
+ *
+ *   - A check is covered by a check that dominates it if both test the
+ *     same array and the same index, or constant indices where the
+ *     dominating one is the larger.
+ *
+ *   - A check is covered by a loop test of the canonical form
+ *
+ *	for (i = 0; i < a.length; i++)
+ *		... a[i] ...
+ *
+ *     if every store to the local variable i is either a non-negative
+ *     constant or an increment by one of a value that passed the test.
+ *
+ * Java local variables live in stack slots until register allocation so
+ * SSA does not give us value numbering for them. Two loads of the same
+ * slot are only considered equal if no store to the slot can happen
+ * between them. Exception handlers are not part of the dominator tree so
+ * every non-handler block that a handler jumps back into is conservatively
+ * treated as a store to all slots.
+ */
+
+struct abc_point {
+	struct basic_block	*bb;
+	struct insn		*insn;
+};
+
+struct abc_store {
+	struct abc_point	point;
+	struct insn_semantics	sem;
+
+	/* Next store that clobbers the same slot. */
+	struct abc_store	*next;
+};
+
+enum abc_key_type {
+	ABC_KEY_VAR,
+	ABC_KEY_SLOT,
+	ABC_KEY_CONST,
+};
+
+/*
+ * Values that can be equal at two checks get the same key: the SSA
+ * variable, the slot it was loaded from or any constant.
+ */
+struct abc_key {
+	enum abc_key_type	type;
+	unsigned long		id;
+};
+
+struct abc_check {
+	struct abc_point	point;
+	struct var_info		*array;
+	struct var_info		*index;
+	struct abc_key		array_key;
+	struct abc_key		index_key;
+
+	/* The check with the same keys that this one hides in the table. */
+	struct abc_check	*shadowed;
+	bool			in_table;
+	bool			redundant;
+};
+
+struct abc_loop_test {
+	struct basic_block	*header;
+	struct basic_block	*body;
+	struct abc_point	cmp;
+	struct var_info		*index;
+	struct var_info		*length;
+
+	/* Slot that the index was loaded from. */
+	struct stack_slot	*slot;
+
+	/* Cached result of slot_is_induction(), -1 if not known yet. */
+	int			induction;
+};
+
+struct abc_state {
+	struct compilation_unit	*cu;
+
+	/* Defining instruction of SSA variables, indexed by vreg. */
+	struct abc_point	*defs;
+
+	struct abc_store	*stores;
+	unsigned long		nr_stores;
+
+	/* Stores that clobber each slot, indexed by slot index. */
+	struct abc_store	**slot_stores;
+	unsigned long		nr_slots;
+
+	/* Checks in program order. Checks of a block are contiguous. */
+	struct abc_check	*checks;
+	unsigned long		nr_checks;
+
+	/* Checks of each block, indexed by dfn. */
+	unsigned long		*bb_first_check;
+	unsigned long		*bb_nr_checks;
+
+	/* Loop test at the end of each block, indexed by dfn. */
+	struct abc_loop_test	*loop_tests;
+
+	/* Checks that dominate the block being visited, keyed by values. */
+	struct hash_map		*available;
+
+	/* Variables defined in a loop header that can move out of the loop. */
+	struct bitset		*invariant;
+
+	/* Non-handler blocks that exception handlers jump back into. */
+	struct basic_block	**reentries;
+	unsigned long		nr_reentries;
+
+	struct bitset		*visited;
+	struct basic_block	**worklist;
+	unsigned long		nr_worklist;
+};
+
+static bool bb_is_eh(struct compilation_unit *cu, struct basic_block *bb)
+{
+	return !bb->dfn && cu->entry_bb != bb;
+}
+
+static bool bb_dominates(struct basic_block *a, struct basic_block *b)
+{
+	return a == b || test_bit(b->dominators->bits, a->dfn);
+}
+
+static bool insn_before(struct insn *a, struct insn *b)
+{
+	return a->lir_pos < b->lir_pos;
+}
+
+static struct abc_store *slot_stores(struct abc_state *state, struct stack_slot *slot)
+{
+	if (slot->index >= state->nr_slots)
+		return NULL;
+
+	return state->slot_stores[slot->index];
+}
+
+static bool slot_is_arg(struct stack_slot *slot)
+{
+	return slot->index < slot->parent->nr_args;
+}
+
+static struct abc_point *var_def(struct abc_state *state, struct var_info *var)
+{
+	struct abc_point *def;
+
+	if (var->vreg >= state->cu->ssa_nr_vregs)
+		return NULL;
+
+	def = &state->defs[var->vreg];
+	if (!def->insn || bb_is_eh(state->cu, def->bb))
+		return NULL;
+
+	return def;
+}
+
+static bool var_is_const(struct abc_state *state, struct var_info *var, int32_t *value)
+{
+	struct insn_semantics sem;
+	struct abc_point *def;
+
+	def = var_def(state, var);
+	if (!def)
+		return false;
+
+	insn_semantics(def->insn, &sem);
+	if (sem.type != INSN_SEM_LOAD_IMM)
+		return false;
+
+	*value = sem.imm;
+
+	return true;
+}
+
+static void visit_start(struct abc_state *state)
+{
+	bitset_clear_all(state->visited);
+	state->nr_worklist = 0;
+}
+
+static void visit_push(struct abc_state *state, struct basic_block *bb,
+		       struct basic_block *avoid)
+{
+	if (bb == avoid || bb_is_eh(state->cu, bb))
+		return;
+
+	if (test_bit(state->visited->bits, bb->dfn))
+		return;
+
+	set_bit(state->visited->bits, bb->dfn);
+	state->worklist[state->nr_worklist++] = bb;
+}
+
+static void visit_push_successors(struct abc_state *state, struct basic_block *bb,
+				  struct basic_block *avoid)
+{
+	for (unsigned long i = 0; i < bb->nr_successors; i++)
+		visit_push(state, bb->successors[i], avoid);
+}
+
+/*
+ * Returns true if @target can be reached from the blocks on the worklist
+ * without entering @avoid.
+ */
+static bool visit_reaches(struct abc_state *state, struct basic_block *target,
+			  struct basic_block *avoid)
+{
+	while (state->nr_worklist) {
+		struct basic_block *bb;
+
+		bb = state->worklist[--state->nr_worklist];
+		if (bb == target)
+			return true;
+
+		visit_push_successors(state, bb, avoid);
+	}
+
+	return false;
+}
+
+/*
+ * Adds a change of value at @bb before @insn (or at the start of @bb if
+ * @insn is NULL) as a source for visit_reaches(). Returns true if the
+ * change is trivially visible at @q without going through @p.
+ */
+static bool add_source(struct abc_state *state, struct basic_block *bb,
+		       struct insn *insn, struct abc_point *p, struct abc_point *q)
+{
+	if (bb == p->bb && (!insn || insn_before(insn, p->insn)))
+		return false;
+
+	if (bb == q->bb && (!insn || insn_before(insn, q->insn)))
+		return true;
+
+	if (insn)
+		visit_push_successors(state, bb, p->bb);
+	else
+		visit_push(state, bb, p->bb);
+
+	return false;
+}
+
+static bool add_reentry_sources(struct abc_state *state, struct abc_point *p,
+				struct abc_point *q)
+{
+	for (unsigned long i = 0; i < state->nr_reentries; i++) {
+		if (add_source(state, state->reentries[i], NULL, p, q))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns true if every path that reaches @q goes through @p first.
+ */
+static bool point_dominates(struct abc_state *state, struct abc_point *p,
+			    struct abc_point *q)
+{
+	if (p->bb == q->bb) {
+		if (!insn_before(p->insn, q->insn))
+			return false;
+	} else if (!bb_dominates(p->bb, q->bb))
+		return false;
+
+	if (!state->nr_reentries)
+		return true;
+
+	visit_start(state);
+
+	if (add_reentry_sources(state, p, q))
+		return false;
+
+	return !visit_reaches(state, q->bb, p->bb);
+}
+
+/*
+ * Returns true if @slot can not be changed between the last execution of
+ * @p and @q. Callers must make sure that @p dominates @q.
+ */
+static bool path_free(struct abc_state *state, struct abc_point *p,
+		      struct abc_point *q, struct stack_slot *slot)
+{
+	struct abc_store *store;
+
+	visit_start(state);
+
+	for (store = slot_stores(state, slot); store; store = store->next) {
+		if (bb_is_eh(state->cu, store->point.bb))
+			continue;
+
+		if (add_source(state, store->point.bb, store->point.insn, p, q))
+			return false;
+	}
+
+	if (add_reentry_sources(state, p, q))
+		return false;
+
+	return !visit_reaches(state, q->bb, p->bb);
+}
+
+/*
+ * Returns the slot @var was loaded from if the slot still holds the same
+ * value at @at.
+ */
+static struct stack_slot *var_slot(struct abc_state *state, struct var_info *var,
+				   struct abc_point *at)
+{
+	struct insn_semantics sem;
+	struct abc_point *def;
+
+	def = var_def(state, var);
+	if (!def)
+		return NULL;
+
+	insn_semantics(def->insn, &sem);
+	if (sem.type != INSN_SEM_LOAD_LOCAL)
+		return NULL;
+
+	if (!path_free(state, def, at, sem.slot))
+		return NULL;
+
+	return sem.slot;
+}
+
+/*
+ * Returns true if @a at @p has the same value as @b at @q. Callers must
+ * make sure that @p dominates @q.
+ */
+static bool same_value(struct abc_state *state,
+		       struct var_info *a, struct abc_point *p,
+		       struct var_info *b, struct abc_point *q)
+{
+	struct stack_slot *slot;
+
+	if (a == b)
+		return true;
+
+	slot = var_slot(state, a, p);
+	if (!slot || var_slot(state, b, q) != slot)
+		return false;
+
+	return path_free(state, p, q, slot);
+}
+
+static bool covered_by_check(struct abc_state *state, struct abc_check *check,
+			     struct abc_check *dom)
+{
+	int32_t dom_index, index;
+
+	if (!point_dominates(state, &dom->point, &check->point))
+		return false;
+
+	if (!same_value(state, dom->array, &dom->point, check->array, &check->point))
+		return false;
+
+	if (var_is_const(state, dom->index, &dom_index)
+	    && var_is_const(state, check->index, &index))
+		return index >= 0 && index <= dom_index;
+
+	return same_value(state, dom->index, &dom->point, check->index, &check->point);
+}
+
+/*
+ * Returns true if the last exit from @test->header before reaching @bb
+ * was always the edge on which the test holds.
+ */
+static bool guarded_by_test(struct abc_state *state, struct abc_loop_test *test,
+			    struct basic_block *bb)
+{
+	struct basic_block *header = test->header;
+
+	if (bb == header || !bb_dominates(header, bb))
+		return false;
+
+	visit_start(state);
+
+	for (unsigned long i = 0; i < header->nr_successors; i++) {
+		if (header->successors[i] != test->body)
+			visit_push(state, header->successors[i], header);
+	}
+
+	for (unsigned long i = 0; i < state->nr_reentries; i++)
+		visit_push(state, state->reentries[i], header);
+
+	return !visit_reaches(state, bb, header);
+}
+
+/*
+ * Returns true if @slot holds a value that passed @test at @at.
+ */
+static bool slot_passed_test(struct abc_state *state, struct abc_loop_test *test,
+			     struct stack_slot *slot, struct abc_point *at)
+{
+	if (!guarded_by_test(state, test, at->bb))
+		return false;
+
+	if (!point_dominates(state, &test->cmp, at))
+		return false;
+
+	return path_free(state, &test->cmp, at, slot);
+}
+
+/*
+ * Returns true if every value ever stored to @slot is non-negative,
+ * assuming the loop test keeps values that passed it below INT32_MAX.
+ */
+static bool slot_is_induction(struct abc_state *state, struct abc_loop_test *test,
+			      struct stack_slot *slot)
+{
+	struct abc_store *store;
+
+	if (slot_is_arg(slot))
+		return false;
+
+	for (store = slot_stores(state, slot); store; store = store->next) {
+		struct use_position *use;
+		struct insn_semantics sem;
+		struct abc_point *def;
+		int32_t value;
+
+		switch (store->sem.type) {
+		case INSN_SEM_STORE_IMM_LOCAL:
+			if ((int32_t) store->sem.imm < 0)
+				return false;
+			continue;
+		case INSN_SEM_STORE_LOCAL:
+			break;
+		default:
+			return false;
+		}
+
+		if (var_is_const(state, store->sem.src, &value)) {
+			if (value < 0)
+				return false;
+			continue;
+		}
+
+		def = var_def(state, store->sem.src);
+		if (!def)
+			return false;
+
+		insn_semantics(def->insn, &sem);
+		if (sem.type != INSN_SEM_ADD_IMM || sem.imm != 1)
+			return false;
+
+		if (hash_map_get(state->cu->insn_add_ons, def->insn, (void **) &use))
+			return false;
+
+		if (var_slot(state, use->interval->var_info, def) != slot)
+			return false;
+
+		if (!slot_passed_test(state, test, slot, def))
+			return false;
+	}
+
+	return true;
+}
+
+static bool find_loop_test(struct abc_state *state, struct basic_block *bb,
+			   struct abc_loop_test *test)
+{
+	struct insn_semantics branch, cmp, load;
+	struct insn *last, *prev;
+	struct abc_point *def;
+
+	if (bb_is_eh(state->cu, bb) || list_is_empty(&bb->insn_list))
+		return false;
+
+	last = list_last_entry(&bb->insn_list, struct insn, insn_list_node);
+	if (last->insn_list_node.prev == &bb->insn_list)
+		return false;
+
+	prev = prev_insn(last);
+
+	insn_semantics(last, &branch);
+	insn_semantics(prev, &cmp);
+
+	if (cmp.type != INSN_SEM_CMP || bb->nr_successors != 2)
+		return false;
+
+	if (bb->successors[0] == bb->successors[1])
+		return false;
+
+	test->header	= bb;
+	test->cmp.bb	= bb;
+	test->cmp.insn	= prev;
+
+	switch (branch.type) {
+	case INSN_SEM_BRANCH_LT:
+	case INSN_SEM_BRANCH_GE:
+		test->index	= cmp.dest;
+		test->length	= cmp.src;
+		break;
+	case INSN_SEM_BRANCH_GT:
+	case INSN_SEM_BRANCH_LE:
+		test->index	= cmp.src;
+		test->length	= cmp.dest;
+		break;
+	default:
+		return false;
+	}
+
+	switch (branch.type) {
+	case INSN_SEM_BRANCH_LT:
+	case INSN_SEM_BRANCH_GT:
+		test->body = branch.target;
+		break;
+	default:
+		if (bb->successors[0] == branch.target)
+			test->body = bb->successors[1];
+		else
+			test->body = bb->successors[0];
+		break;
+	}
+
+	if (test->body == bb)
+		return false;
+
+	if (test->index->vm_type != J_INT || test->length->vm_type != J_INT)
+		return false;
+
+	def = var_def(state, test->index);
+	if (!def)
+		return false;
+
+	insn_semantics(def->insn, &load);
+	if (load.type != INSN_SEM_LOAD_LOCAL)
+		return false;
+
+	test->slot	= load.slot;
+	test->induction	= -1;
+
+	return true;
+}
+
+static void find_loop_tests(struct abc_state *state)
+{
+	struct basic_block *bb;
+
+	for_each_basic_block(bb, &state->cu->bb_list) {
+		struct abc_loop_test *test;
+
+		if (bb_is_eh(state->cu, bb))
+			continue;
+
+		test = &state->loop_tests[bb->dfn];
+		if (!find_loop_test(state, bb, test))
+			test->header = NULL;
+	}
+}
+
+static bool covered_by_loop_test(struct abc_state *state, struct abc_check *check,
+				 struct abc_loop_test *test)
+{
+	struct insn_semantics sem;
+	struct stack_slot *slot;
+	struct abc_point *def;
+
+	if (check->index_key.type != ABC_KEY_SLOT
+	    || check->index_key.id != test->slot->index)
+		return false;
+
+	slot = var_slot(state, check->index, &check->point);
+	if (slot != test->slot)
+		return false;
+
+	if (var_slot(state, test->index, &test->cmp) != slot)
+		return false;
+
+	def = var_def(state, test->length);
+	if (!def)
+		return false;
+
+	insn_semantics(def->insn, &sem);
+	if (sem.type != INSN_SEM_LOAD_MEMBASE
+	    || sem.imm != offsetof(struct vm_array, array_length))
+		return false;
+
+	if (!slot_passed_test(state, test, slot, &check->point))
+		return false;
+
+	if (!same_value(state, sem.src, &test->cmp, check->array, &check->point))
+		return false;
+
+	if (test->induction < 0)
+		test->induction = slot_is_induction(state, test, slot);
+
+	return test->induction;
+}
+
+/*
+ * Returns true if @check is covered by @dom, the closest check with the
+ * same keys that dominates it, or by a loop test that dominates it.
+ */
+static bool check_is_redundant(struct abc_state *state, struct abc_check *check,
+			       struct abc_check *dom)
+{
+	struct compilation_unit *cu = state->cu;
+	struct basic_block *bb;
+	int32_t index;
+
+	if (var_is_const(state, check->index, &index) && index < 0)
+		return false;
+
+	if (dom && covered_by_check(state, check, dom))
+		return true;
+
+	for (bb = check->point.bb; bb != cu->entry_bb; ) {
+		struct abc_loop_test *test;
+
+		bb = cu->doms[bb->dfn];
+
+		test = &state->loop_tests[bb->dfn];
+		if (test->header && covered_by_loop_test(state, check, test))
+			return true;
+	}
+
+	return false;
+}
+
+static unsigned long check_key_hash(const void *key)
+{
+	const struct abc_check *check = key;
+
+	return (check->array_key.id * 31 + check->array_key.type) * 31
+		+ check->index_key.id * 7 + check->index_key.type;
+}
+
+static bool same_key(const struct abc_key *a, const struct abc_key *b)
+{
+	return a->type == b->type && a->id == b->id;
+}
+
+static bool check_key_equals(const void *a, const void *b)
+{
+	const struct abc_check *x = a, *y = b;
+
+	return same_key(&x->array_key, &y->array_key)
+		&& same_key(&x->index_key, &y->index_key);
+}
+
+static struct key_operations check_key = {
+	.hash	= check_key_hash,
+	.equals	= check_key_equals,
+};
+
+static void visit_check(struct abc_state *state, struct abc_check *check)
+{
+	struct abc_check *dom;
+
+	if (hash_map_get(state->available, check, (void **) &dom))
+		dom = NULL;
+
+	check->redundant = check_is_redundant(state, check, dom);
+
+	/*
+	 * A constant index is only worth remembering if it is larger than
+	 * the one it hides. Other redundant checks are still closer to the
+	 * checks they dominate than the check that covers them.
+	 */
+	if (check->redundant && check->index_key.type == ABC_KEY_CONST)
+		return;
+
+	check->shadowed	= dom;
+	check->in_table	= !hash_map_put(state->available, check, check);
+}
+
+static void leave_check(struct abc_state *state, struct abc_check *check)
+{
+	if (!check->in_table)
+		return;
+
+	if (check->shadowed)
+		hash_map_put(state->available, check, check->shadowed);
+	else
+		hash_map_remove(state->available, check);
+}
+
+/*
+ * Visits the dominator tree in preorder. When a check is visited, the
+ * table holds the closest dominating check for every pair of keys.
+ */
+static void visit_dom_tree(struct abc_state *state, struct basic_block *bb)
+{
+	unsigned long first, last;
+
+	first	= state->bb_first_check[bb->dfn];
+	last	= first + state->bb_nr_checks[bb->dfn];
+
+	for (unsigned long i = first; i < last; i++)
+		visit_check(state, &state->checks[i]);
+
+	for (unsigned long i = 0; i < bb->nr_dom_successors; i++)
+		visit_dom_tree(state, bb->dom_successors[i]);
+
+	for (unsigned long i = last; i > first; i--)
+		leave_check(state, &state->checks[i - 1]);
+}
+
+static void value_key(struct abc_state *state, struct var_info *var,
+		      struct abc_key *key)
+{
+	struct insn_semantics sem;
+	struct abc_point *def;
+
+	key->type	= ABC_KEY_VAR;
+	key->id		= (unsigned long) var;
+
+	def = var_def(state, var);
+	if (!def)
+		return;
+
+	insn_semantics(def->insn, &sem);
+
+	switch (sem.type) {
+	case INSN_SEM_LOAD_IMM:
+		key->type	= ABC_KEY_CONST;
+		key->id		= 0;
+		break;
+	case INSN_SEM_LOAD_LOCAL:
+		key->type	= ABC_KEY_SLOT;
+		key->id		= sem.slot->index;
+		break;
+	default:
+		break;
+	}
+}
+
+static void add_store(struct abc_state *state, struct basic_block *bb,
+		      struct insn *insn, struct insn_semantics *sem,
+		      unsigned long index)
+{
+	struct abc_store *store = &state->stores[state->nr_stores++];
+
+	store->point.bb		= bb;
+	store->point.insn	= insn;
+	store->sem		= *sem;
+	store->next		= state->slot_stores[index];
+
+	state->slot_stores[index] = store;
+}
+
+static void add_insn(struct abc_state *state, struct basic_block *bb,
+		     struct insn *insn)
+{
+	struct use_position *regs[MAX_REG_OPERANDS];
+	struct insn_semantics sem;
+	int nr_defs;
+
+	nr_defs = insn_defs_reg(insn, regs);
+	for (int i = 0; i < nr_defs; i++) {
+		struct var_info *var = regs[i]->interval->var_info;
+
+		if (interval_has_fixed_reg(var->interval))
+			continue;
+
+		if (var->vreg >= state->cu->ssa_nr_vregs)
+			continue;
+
+		state->defs[var->vreg].bb	= bb;
+		state->defs[var->vreg].insn	= insn;
+	}
+
+	insn_semantics(insn, &sem);
+
+	switch (sem.type) {
+	case INSN_SEM_STORE_LOCAL_WIDE:
+		add_store(state, bb, insn, &sem, sem.slot->index + 1);
+		/* Fall through */
+	case INSN_SEM_STORE_LOCAL:
+	case INSN_SEM_STORE_IMM_LOCAL:
+	case INSN_SEM_STORE_LOCAL_OTHER:
+		add_store(state, bb, insn, &sem, sem.slot->index);
+		break;
+	case INSN_SEM_ARRAY_CHECK: {
+		struct abc_check *check;
+
+		if (bb_is_eh(state->cu, bb))
+			break;
+
+		check = &state->checks[state->nr_checks++];
+		check->point.bb		= bb;
+		check->point.insn	= insn;
+		check->array		= sem.src;
+		check->index		= sem.dest;
+		check->shadowed		= NULL;
+		check->in_table		= false;
+		check->redundant	= false;
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+static bool bb_is_reentry(struct compilation_unit *cu, struct basic_block *bb)
+{
+	if (bb_is_eh(cu, bb))
+		return false;
+
+	for (unsigned long i = 0; i < bb->nr_predecessors; i++) {
+		if (bb_is_eh(cu, bb->predecessors[i]))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Collects definitions, stores, checks and reentries. Called again after
+ * hoisting because instructions may have moved to other blocks.
+ */
+static void scan_insns(struct abc_state *state)
 {
+	struct compilation_unit *cu = state->cu;
 	struct basic_block *bb;
+	struct insn *insn;
+
+	recompute_insn_positions(cu);
+
+	memset(state->defs, 0, cu->ssa_nr_vregs * sizeof(struct abc_point));
+	memset(state->slot_stores, 0, state->nr_slots * sizeof(struct abc_store *));
+
+	state->nr_stores	= 0;
+	state->nr_checks	= 0;
+	state->nr_reentries	= 0;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		unsigned long first = state->nr_checks;
+
+		if (bb_is_reentry(cu, bb))
+			state->reentries[state->nr_reentries++] = bb;
+
+		for_each_insn(insn, &bb->insn_list)
+			add_insn(state, bb, insn);
+
+		if (bb_is_eh(cu, bb))
+			continue;
+
+		state->bb_first_check[bb->dfn]	= first;
+		state->bb_nr_checks[bb->dfn]	= state->nr_checks - first;
+	}
+
+	for (unsigned long i = 0; i < state->nr_checks; i++) {
+		struct abc_check *check = &state->checks[i];
+
+		value_key(state, check->array, &check->array_key);
+		value_key(state, check->index, &check->index_key);
+	}
+}
+
+/*
+ * Returns the only block outside the loop of @header that jumps to it, if
+ * that block always continues to @header and hoisted instructions can be
+ * appended to it.
+ */
+static struct basic_block *loop_preheader(struct abc_state *state,
+					  struct basic_block *header)
+{
+	struct basic_block *preheader = NULL;
+	struct bitset *loop = header->natural_loop;
+	struct insn *last;
+
+	for (unsigned long i = 0; i < header->nr_predecessors; i++) {
+		struct basic_block *pred = header->predecessors[i];
+
+		if (bb_is_eh(state->cu, pred))
+			return NULL;
+
+		if (test_bit(loop->bits, pred->dfn) || pred == preheader)
+			continue;
+
+		if (preheader)
+			return NULL;
+
+		preheader = pred;
+	}
+
+	if (!preheader || preheader->nr_successors != 1)
+		return NULL;
+
+	if (list_is_empty(&preheader->insn_list))
+		return preheader;
+
+	last = bb_last_insn(preheader);
+	if (insn_is_branch(last) && !insn_is_jmp_branch(last))
+		return NULL;
+
+	return preheader;
+}
+
+static bool loop_has_reentry(struct abc_state *state, struct bitset *loop)
+{
+	for (unsigned long i = 0; i < state->nr_reentries; i++) {
+		if (test_bit(loop->bits, state->reentries[i]->dfn))
+			return true;
+	}
+
+	return false;
+}
+
+static bool slot_is_loop_invariant(struct abc_state *state, struct bitset *loop,
+				   struct stack_slot *slot)
+{
+	struct abc_store *store;
+
+	for (store = slot_stores(state, slot); store; store = store->next) {
+		struct basic_block *bb = store->point.bb;
+
+		if (!bb_is_eh(state->cu, bb) && test_bit(loop->bits, bb->dfn))
+			return false;
+	}
+
+	return true;
+}
+
+static bool var_is_loop_invariant(struct abc_state *state, struct bitset *loop,
+				  struct var_info *var)
+{
+	struct abc_point *def;
+
+	def = var_def(state, var);
+	if (!def)
+		return false;
+
+	if (!test_bit(loop->bits, def->bb->dfn))
+		return true;
+
+	return test_bit(state->invariant->bits, var->vreg);
+}
+
+static void move_to_preheader(struct basic_block *preheader, struct insn *insn)
+{
+	struct insn *last;
+
+	list_del(&insn->insn_list_node);
+
+	if (list_is_empty(&preheader->insn_list)) {
+		list_add_tail(&insn->insn_list_node, &preheader->insn_list);
+		return;
+	}
+
+	last = bb_last_insn(preheader);
+	if (insn_is_jmp_branch(last))
+		list_add(&insn->insn_list_node, last->insn_list_node.prev);
+	else
+		list_add_tail(&insn->insn_list_node, &preheader->insn_list);
+}
+
+static void hoist_def(struct abc_state *state, struct basic_block *header,
+		      struct basic_block *preheader, struct var_info *var)
+{
+	struct abc_point *def = var_def(state, var);
+
+	if (def->bb != header)
+		return;
+
+	move_to_preheader(preheader, def->insn);
+	def->bb = preheader;
+}
+
+/*
+ * Moves the checks at the start of @header whose operands do not change
+ * in the loop to the preheader. Only phis and loads can come before them.
+ * Returns true if anything was moved.
+ */
+static bool hoist_header_checks(struct abc_state *state, struct basic_block *header)
+{
+	struct bitset *loop = header->natural_loop;
+	struct basic_block *preheader;
 	struct insn *insn, *tmp;
-	struct reg_value_acc regs_value[cu->ssa_nr_vregs];
-	struct array_size_acc arrays_value[cu->ssa_nr_vregs];
-	int index = 0, nr_array_check = 0;
+	bool hoisted = false;
 
-	for (unsigned i = 0; i < cu->ssa_nr_vregs; i++) {
-		regs_value[i].active = false;
+	preheader = loop_preheader(state, header);
+	if (!preheader || loop_has_reentry(state, loop))
+		return false;
 
-		arrays_value[i].active = false;
+	bitset_clear_all(state->invariant);
+
+	list_for_each_entry_safe(insn, tmp, &header->insn_list, insn_list_node) {
+		struct insn_semantics sem;
+
+		if (insn_is_phi(insn))
+			continue;
+
+		insn_semantics(insn, &sem);
+
+		switch (sem.type) {
+		case INSN_SEM_LOAD_IMM:
+			break;
+		case INSN_SEM_LOAD_LOCAL:
+			if (!slot_is_loop_invariant(state, loop, sem.slot))
+				continue;
+			break;
+		case INSN_SEM_ARRAY_CHECK:
+			if (!var_is_loop_invariant(state, loop, sem.src)
+			    || !var_is_loop_invariant(state, loop, sem.dest))
+				return hoisted;
+
+			hoist_def(state, header, preheader, sem.src);
+			hoist_def(state, header, preheader, sem.dest);
+			move_to_preheader(preheader, insn);
+			hoisted = true;
+			continue;
+		default:
+			return hoisted;
+		}
+
+		if (var_def(state, sem.dest))
+			set_bit(state->invariant->bits, sem.dest->vreg);
 	}
 
-	for_each_basic_block(bb, &cu->bb_list)
-		list_for_each_entry(insn, &bb->insn_list, insn_list_node)
-			if (insn_is_call_to(insn, vm_object_alloc_primitive_array))
-				nr_array_check++;
+	return hoisted;
+}
+
+static bool hoist_checks(struct abc_state *state)
+{
+	struct basic_block *bb;
+	bool hoisted = false;
 
-	struct insn *delete[nr_array_check];
+	for_each_basic_block(bb, &state->cu->bb_list) {
+		if (bb_is_eh(state->cu, bb) || !bb->natural_loop)
+			continue;
+
+		if (hoist_header_checks(state, bb))
+			hoisted = true;
+	}
+
+	return hoisted;
+}
+
+static int init_abc_state(struct abc_state *state, struct compilation_unit *cu)
+{
+	unsigned long nr_insns = 0;
+	struct basic_block *bb;
+	struct insn *insn;
+
+	state->cu = cu;
 
 	for_each_basic_block(bb, &cu->bb_list) {
-		list_for_each_entry_safe(insn, tmp, &bb->insn_list, insn_list_node) {
-			if (insn_is_mov_imm_reg(insn)) {
-				uint32_t reg = insn->dest.reg.interval->var_info->vreg;
-
-				regs_value[reg].active = true;
-				regs_value[reg].val = insn->src.imm;
-			}
-
-			if (insn_is_call_to(insn, vm_object_alloc_primitive_array)) {
-				struct insn *insn_push_size, *insn_mov_eax_array;
-				uint32_t size_reg, array_reg;
-
-				insn_push_size = list_entry(insn->insn_list_node.prev->prev->prev,
-								struct insn, insn_list_node);
-				size_reg = insn_push_size->src.reg.interval->var_info->vreg;
-
-				insn_mov_eax_array = list_entry(insn->insn_list_node.next,
-								struct insn, insn_list_node);
-				array_reg = insn_mov_eax_array->dest.reg.interval->var_info->vreg;
-
-				if (regs_value[size_reg].active) {
-					arrays_value[array_reg].active = true;
-					arrays_value[array_reg].size = regs_value[size_reg].val;
-				}
-			}
-
-			if (insn_is_call_to(insn, vm_object_check_array)) {
-				struct insn *insn_push_index, *insn_push_array;
-				uint32_t index_reg, array_reg;
-
-				insn_push_index = list_entry(insn->insn_list_node.prev->prev,
-								struct insn, insn_list_node);
-				index_reg = insn_push_index->src.reg.interval->var_info->vreg;
-
-				insn_push_array = list_entry(insn->insn_list_node.prev,
-								struct insn, insn_list_node);
-				array_reg = insn_push_array->src.reg.interval->var_info->vreg;
-
-				if (regs_value[index_reg].active && arrays_value[array_reg].active) {
-					if (regs_value[index_reg].val < arrays_value[array_reg].size)
-						delete[index++] = insn;
-				}
-			}
+		for_each_insn(insn, &bb->insn_list) {
+			struct insn_semantics sem;
+
+			nr_insns++;
+
+			insn_semantics(insn, &sem);
+			if (sem.slot && sem.slot->index + 2 > state->nr_slots)
+				state->nr_slots = sem.slot->index + 2;
 		}
 	}
 
-	for (int i = 0; i < index; i++) {
-		struct insn *insn_push_index, *insn_push_array,
-			*insn, *insn_args_cleanup,
-			*insn_exception_test1, *insn_exception_test2;
-
-		insn = delete[i];
-		insn_push_index = list_entry(insn->insn_list_node.prev->prev,
-					struct insn, insn_list_node);
-		insn_push_array = list_entry(insn->insn_list_node.prev,
-					struct insn, insn_list_node);
-		insn_args_cleanup = list_entry(insn->insn_list_node.next,
-					struct insn, insn_list_node);
-		insn_exception_test1 = list_entry(insn->insn_list_node.next->next,
-					struct insn, insn_list_node);
-		insn_exception_test2 = list_entry(insn->insn_list_node.next->next->next,
-					struct insn, insn_list_node);
-
-		remove_insn(insn);
-		remove_insn(insn_push_index);
-		remove_insn(insn_push_array);
-		remove_insn(insn_args_cleanup);
-		remove_insn(insn_exception_test1);
-		remove_insn(insn_exception_test2);
+	state->defs		= calloc(cu->ssa_nr_vregs, sizeof(struct abc_point));
+	state->stores		= malloc(2 * nr_insns * sizeof(struct abc_store));
+	state->slot_stores	= calloc(state->nr_slots, sizeof(struct abc_store *));
+	state->checks		= malloc(nr_insns * sizeof(struct abc_check));
+	state->bb_first_check	= calloc(cu->nr_bb, sizeof(unsigned long));
+	state->bb_nr_checks	= calloc(cu->nr_bb, sizeof(unsigned long));
+	state->loop_tests	= calloc(cu->nr_bb, sizeof(struct abc_loop_test));
+	state->available	= alloc_hash_map(&check_key);
+	state->invariant	= alloc_bitset(cu->ssa_nr_vregs);
+	state->reentries	= malloc(cu->nr_bb * sizeof(struct basic_block *));
+	state->worklist		= malloc(cu->nr_bb * sizeof(struct basic_block *));
+	state->visited		= alloc_bitset(cu->nr_bb);
+
+	if (!state->defs || !state->stores || !state->checks
+	    || (state->nr_slots && !state->slot_stores)
+	    || !state->bb_first_check || !state->bb_nr_checks
+	    || !state->loop_tests || !state->available || !state->invariant
+	    || !state->reentries || !state->worklist || !state->visited)
+		return -ENOMEM;
+
+	scan_insns(state);
+
+	return 0;
+}
+
+static void free_abc_state(struct abc_state *state)
+{
+	free(state->defs);
+	free(state->stores);
+	free(state->slot_stores);
+	free(state->checks);
+	free(state->bb_first_check);
+	free(state->bb_nr_checks);
+	free(state->loop_tests);
+	if (state->available)
+		free_hash_map(state->available);
+	free(state->invariant);
+	free(state->reentries);
+	free(state->worklist);
+	free(state->visited);
+}
+
+void abc_removal(struct compilation_unit *cu)
+{
+	struct abc_state state = { 0 };
+
+	/*
+	 * Bounds check elimination is an optimization so just leave the
+	 * checks alone if we run out of memory.
+	 */
+	if (init_abc_state(&state, cu))
+		goto out;
+
+	if (hoist_checks(&state))
+		scan_insns(&state);
+
+	find_loop_tests(&state);
+
+	visit_dom_tree(&state, cu->entry_bb);
+
+	/*
+	 * Redundancy is decided on the original set of checks. This is safe
+	 * because a removed check is itself covered by one that executes
+	 * before it and strict dominance can not form a cycle.
+	 */
+	for (unsigned long i = 0; i < state.nr_checks; i++) {
+		if (state.checks[i].redundant)
+			remove_insn(state.checks[i].point.insn);
 	}
+out:
+	free_abc_state(&state);
 }
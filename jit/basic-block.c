@@ -389,6 +389,19 @@ struct basic_block *ssa_insert_empty_bb(struct compilation_unit *cu,
 	return new_bb;
 }
 
+/*
+ * Returns true if @bb is the target of a backward branch. Every loop has
+ * at least one such basic block.
+ */
+bool bb_is_loop_header(struct basic_block *bb)
+{
+	for (unsigned long i = 0; i < bb->nr_predecessors; i++)
+		if (bb->predecessors[i]->start >= bb->start)
+			return true;
+
+	return false;
+}
+
 bool bb_successors_contains(struct basic_block *bb, struct basic_block *lookup_bb)
 {
 	for (unsigned long i = 0; i < bb->nr_successors; i++)
@@ -27,6 +27,7 @@
 #include "jit/bc-offset-mapping.h"
 
 #include <stdlib.h>
+#include <assert.h>
 #include <errno.h>
 #include <stdio.h>
 
@@ -57,43 +58,82 @@ void tree_patch_bc_offset(struct tree_node *node, unsigned long bc_offset)
 		tree_patch_bc_offset(node->kids[i], bc_offset);
 }
 
+static void add_bc_offset_entry(struct compilation_unit *cu, unsigned long native_offset,
+				unsigned long bc_offset)
+{
+	struct bc_offset_entry *last;
+	uint16_t bc;
+
+	bc = bc_offset == BC_OFFSET_UNKNOWN ? BC_OFFSET_ENTRY_UNKNOWN : bc_offset;
+
+	if (cu->nr_bc_offset_entries) {
+		last = &cu->bc_offset_map[cu->nr_bc_offset_entries - 1];
+
+		assert(last->native_offset <= native_offset);
+
+		/* An instruction that emitted no code is covered by the
+		 * one that follows it. */
+		if (last->native_offset == native_offset) {
+			cu->nr_bc_offset_entries--;
+			add_bc_offset_entry(cu, native_offset, bc_offset);
+			return;
+		}
+
+		if (last->bc_offset == bc)
+			return;
+	}
+
+	last = &cu->bc_offset_map[cu->nr_bc_offset_entries++];
+	last->native_offset = native_offset;
+	last->bc_offset = bc;
+}
+
 /**
  * Constructs native to bytecode offset translation table.
  * Must be called after compiltion is finished.
+ *
+ * Machine code is laid out as the basic block bodies, followed by the
+ * exit, unwind and resolution blocks, followed by the slow paths. Only
+ * basic block instructions and slow paths have a bytecode offset so
+ * the table stores one entry for every change of bytecode offset
+ * instead of one for every byte of code.
  */
 int build_bc_offset_map(struct compilation_unit *cu)
 {
-	unsigned long code_size;
+	unsigned long max_entries;
 	struct basic_block *bb;
+	struct slow_path *sp;
 	struct insn *insn;
-	struct insn *prev_insn;
 
-	code_size = buffer_offset(cu->objcode);
-	cu->bc_offset_map = malloc(sizeof(unsigned long) * code_size);
+	if (buffer_offset(cu->objcode) > UINT32_MAX)
+		return -EINVAL;
+
+	max_entries = 1;
+
+	for_each_basic_block(bb, &cu->bb_list)
+		max_entries += list_size(&bb->insn_list);
+
+	list_for_each_entry(sp, &cu->slow_path_list, list_node)
+		max_entries += 2;
+
+	cu->bc_offset_map = malloc(sizeof(struct bc_offset_entry) * max_entries);
 	if (!cu->bc_offset_map)
 		return -ENOMEM;
 
-	/* Set all fields to unknown (ULONG_MAX) by default. */
-	memset(cu->bc_offset_map, 0xff, sizeof(unsigned long) * code_size);
-
-	prev_insn = NULL;
+	cu->nr_bc_offset_entries = 0;
 
 	for_each_basic_block(bb, &cu->bb_list) {
-		for_each_insn(insn, &bb->insn_list) {
-			/* We put bc-offset mapping not only for the
-			 * insn offset but also for the offset of last
-			 * insn byte. That's because for call site
-			 * bc-offset we pall for return address - 1.
-			 */
-			if (prev_insn)
-				cu->bc_offset_map[insn->mach_offset - 1] =
-					insn_get_bc_offset(prev_insn);
-
-			cu->bc_offset_map[insn->mach_offset] =
-				insn_get_bc_offset(insn);
-
-			prev_insn = insn;
-		}
+		for_each_insn(insn, &bb->insn_list)
+			add_bc_offset_entry(cu, insn->mach_offset, insn_get_bc_offset(insn));
+	}
+
+	add_bc_offset_entry(cu, cu->exit_bb->mach_offset, BC_OFFSET_UNKNOWN);
+
+	/* Out-of-line slow paths belong to the instruction they were
+	 * emitted for. */
+	list_for_each_entry(sp, &cu->slow_path_list, list_node) {
+		add_bc_offset_entry(cu, sp->start, insn_get_bc_offset(sp->insn));
+		add_bc_offset_entry(cu, sp->end, BC_OFFSET_UNKNOWN);
 	}
 
 	return 0;
@@ -105,13 +145,18 @@ int build_bc_offset_map(struct compilation_unit *cu)
  *                                 instruction originates.
  * @cu: compilation unit of method containing @native_ptr.
  * @native_ptr: native instruction pointer to be translated.
+ *
+ * Every byte of an instruction maps to the bytecode offset of that
+ * instruction so a return address - 1 maps to its call site.
  */
 unsigned long
 jit_lookup_bc_offset(struct compilation_unit *cu, unsigned char *native_ptr)
 {
+	unsigned long low, high;
 	unsigned long native_addr;
 	unsigned long method_addr;
 	unsigned long offset;
+	uint16_t bc_offset;
 
 	if (!cu->bc_offset_map)
 		return BC_OFFSET_UNKNOWN;
@@ -126,7 +171,27 @@ jit_lookup_bc_offset(struct compilation_unit *cu, unsigned char *native_ptr)
 	if (offset >= buffer_offset(cu->objcode))
 		return BC_OFFSET_UNKNOWN;
 
-	return cu->bc_offset_map[offset];
+	/* Find the last entry that starts at or before @offset. */
+	low = 0;
+	high = cu->nr_bc_offset_entries;
+
+	while (low < high) {
+		unsigned long mid = (low + high) / 2;
+
+		if (cu->bc_offset_map[mid].native_offset <= offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (!low)
+		return BC_OFFSET_UNKNOWN;
+
+	bc_offset = cu->bc_offset_map[low - 1].bc_offset;
+	if (bc_offset == BC_OFFSET_ENTRY_UNKNOWN)
+		return BC_OFFSET_UNKNOWN;
+
+	return bc_offset;
 }
 
 void print_bytecode_offset(unsigned long bytecode_offset, struct string *str)
@@ -0,0 +1,265 @@
+/*
+ * Class hierarchy analysis
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "jit/cha.h"
+
+#include "jit/compilation-unit.h"
+#include "jit/compiler.h"
+#include "jit/emit-code.h"
+
+#include "arch/instruction.h"
+
+#include "vm/class.h"
+#include "vm/method.h"
+#include "vm/stdlib.h"
+#include "vm/die.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/*
+ * An invokevirtual whose target has no overriding method in any loaded
+ * class always ends up in the target so it is compiled as a direct call
+ * instead of a vtable dispatch. The call site is recorded on the target
+ * method. When the class loader links a class that overrides the target,
+ * every recorded call site is patched to call a stub that does the
+ * vtable dispatch. This happens before any instance of the new class
+ * exists so the direct calls are correct up to that point and there is
+ * nothing to deoptimize in running frames.
+ */
+
+bool opt_cha = true;
+
+/*
+ * Protects VM_METHOD_FLAG_OVERRIDDEN, vmm->cha_site_list and
+ * cu->cha_site_list of emitted compilation units.
+ */
+static pthread_mutex_t cha_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Vtable dispatch stubs indexed by vtable index. */
+static void **dispatch_stubs;
+static unsigned long nr_dispatch_stubs;
+
+static bool vm_method_is_overridden(struct vm_method *vmm)
+{
+	return vmm->flags & VM_METHOD_FLAG_OVERRIDDEN;
+}
+
+/*
+ * Returns true if an invokevirtual of @target can be compiled as a direct
+ * call. @dependent is set if the direct call is only valid as long as no
+ * class overrides @target and the call site must be recorded with
+ * alloc_cha_site().
+ */
+bool cha_can_devirtualize(struct vm_method *target, bool *dependent)
+{
+	if (!opt_cha)
+		return false;
+
+	if (vm_method_is_missing(target) || vm_method_is_static(target))
+		return false;
+
+	if (vm_method_is_abstract(target) || vm_method_is_native(target))
+		return false;
+
+	if (vm_class_is_interface(target->class))
+		return false;
+
+	if (vm_method_is_final(target) || vm_method_is_private(target) ||
+	    vm_class_is_final(target->class)) {
+		*dependent = false;
+		return true;
+	}
+
+	/*
+	 * Optimistic unlocked check. A class that overrides the method
+	 * while the caller is being compiled is picked up by
+	 * cha_register_sites().
+	 */
+	if (vm_method_is_overridden(target))
+		return false;
+
+	*dependent = true;
+	return true;
+}
+
+struct cha_site *
+alloc_cha_site(struct compilation_unit *cu, struct insn *call_insn,
+	       struct vm_method *target)
+{
+	struct cha_site *site;
+
+	site = zalloc(sizeof(*site));
+	if (!site)
+		return NULL;
+
+	site->target = target;
+	site->cu = cu;
+	site->relcall_insn = call_insn;
+
+	INIT_LIST_HEAD(&site->target_node);
+	list_add(&site->list_node, &cu->cha_site_list);
+
+	return site;
+}
+
+static void free_cha_site(struct cha_site *site)
+{
+	list_del(&site->target_node);
+	list_del(&site->list_node);
+	free(site);
+}
+
+static unsigned char *cha_site_addr(struct cha_site *site)
+{
+	return buffer_ptr(site->cu->objcode) + site->mach_offset;
+}
+
+static void *vtable_dispatch_stub(unsigned long virtual_index)
+{
+	if (virtual_index >= nr_dispatch_stubs) {
+		unsigned long new_size = virtual_index + 1;
+		void **new_stubs;
+
+		new_stubs = realloc(dispatch_stubs, new_size * sizeof(void *));
+		if (!new_stubs)
+			error("out of memory");
+
+		for (unsigned long i = nr_dispatch_stubs; i < new_size; i++)
+			new_stubs[i] = NULL;
+
+		dispatch_stubs = new_stubs;
+		nr_dispatch_stubs = new_size;
+	}
+
+	if (!dispatch_stubs[virtual_index])
+		dispatch_stubs[virtual_index] = emit_vtable_dispatch_stub(virtual_index);
+
+	return dispatch_stubs[virtual_index];
+}
+
+/*
+ * Must be called with cha_mutex held.
+ */
+static void invalidate_cha_site(struct cha_site *site)
+{
+	struct jit_trampoline *trampoline = site->target->trampoline;
+	struct fixup_site *this, *next;
+	unsigned char *site_addr;
+	void *stub;
+
+	site_addr = cha_site_addr(site);
+	stub = vtable_dispatch_stub(site->target->virtual_index);
+
+	/*
+	 * If the target was not compiled when the call site was emitted
+	 * the call goes through the trampoline which patches it again
+	 * once the target is compiled. Remove the trampoline fixup site
+	 * so that the vtable dispatch is not undone.
+	 */
+	pthread_mutex_lock(&trampoline->mutex);
+
+	list_for_each_entry_safe(this, next, &trampoline->fixup_site_list, list_node) {
+		if (fixup_site_addr(this) != site_addr)
+			continue;
+
+		list_del(&this->list_node);
+		free_fixup_site(this);
+		break;
+	}
+
+	fixup_direct_call(site_addr, stub);
+
+	pthread_mutex_unlock(&trampoline->mutex);
+}
+
+/*
+ * Records the call sites of a compilation unit on their target methods.
+ * This must be called after the code has been emitted and before it is
+ * executed.
+ */
+void cha_register_sites(struct compilation_unit *cu)
+{
+	struct cha_site *site, *next;
+
+	if (list_is_empty(&cu->cha_site_list))
+		return;
+
+	pthread_mutex_lock(&cha_mutex);
+
+	list_for_each_entry_safe(site, next, &cu->cha_site_list, list_node) {
+		site->mach_offset = site->relcall_insn->mach_offset;
+
+		if (vm_method_is_overridden(site->target)) {
+			invalidate_cha_site(site);
+			free_cha_site(site);
+			continue;
+		}
+
+		list_add(&site->target_node, &site->target->cha_site_list);
+	}
+
+	pthread_mutex_unlock(&cha_mutex);
+}
+
+/*
+ * Forgets the call sites of a compilation unit so that they are not
+ * patched after its code has been freed.
+ */
+void cha_unregister_sites(struct compilation_unit *cu)
+{
+	struct cha_site *site, *next;
+
+	pthread_mutex_lock(&cha_mutex);
+
+	list_for_each_entry_safe(site, next, &cu->cha_site_list, list_node)
+		free_cha_site(site);
+
+	pthread_mutex_unlock(&cha_mutex);
+}
+
+/*
+ * Called by the class loader when a class that overrides @vmm is linked.
+ */
+void cha_method_overridden(struct vm_method *vmm)
+{
+	struct cha_site *site, *next;
+
+	pthread_mutex_lock(&cha_mutex);
+
+	if (vm_method_is_overridden(vmm))
+		goto out_unlock;
+
+	vmm->flags |= VM_METHOD_FLAG_OVERRIDDEN;
+
+	list_for_each_entry_safe(site, next, &vmm->cha_site_list, target_node) {
+		invalidate_cha_site(site);
+		free_cha_site(site);
+	}
+
+out_unlock:
+	pthread_mutex_unlock(&cha_mutex);
+}
@@ -29,10 +29,14 @@
 
 #include "jit/args.h"
 #include "jit/basic-block.h"
+#include "jit/cha.h"
 #include "jit/compilation-unit.h"
+#include "jit/cu-mapping.h"
+#include "jit/gc-map.h"
 #include "jit/instruction.h"
 #include "jit/stack-slot.h"
 #include "jit/statement.h"
+#include "jit/text.h"
 #include "jit/vars.h"
 #include "lib/buffer.h"
 #include "vm/method.h"
@@ -122,9 +126,11 @@ struct compilation_unit *compilation_unit_alloc(struct vm_method *method)
 
 		INIT_LIST_HEAD(&cu->static_fixup_site_list);
 		INIT_LIST_HEAD(&cu->call_fixup_site_list);
+		INIT_LIST_HEAD(&cu->cha_site_list);
 		INIT_LIST_HEAD(&cu->tableswitch_list);
 		INIT_LIST_HEAD(&cu->lookupswitch_list);
 		INIT_LIST_HEAD(&cu->ic_call_list);
+		INIT_LIST_HEAD(&cu->slow_path_list);
 
 		cu->lir_insn_map = NULL;
 
@@ -164,7 +170,7 @@ static void free_var_infos(struct compilation_unit *cu, struct var_info *var_inf
 	}
 }
 
-static void free_bc_offset_map(unsigned long *map)
+static void free_bc_offset_map(struct bc_offset_entry *map)
 {
 	free(map);
 }
@@ -206,6 +212,26 @@ static void free_lir_insn_map(struct compilation_unit *cu)
 	free_radix_tree(cu->lir_insn_map);
 }
 
+struct slow_path *alloc_slow_path(struct compilation_unit *cu,
+				  struct insn *insn, unsigned long branch_offset)
+{
+	struct slow_path *sp;
+
+	sp = arena_alloc(cu->arena, sizeof *sp);
+	if (!sp)
+		return NULL;
+
+	sp->cu = cu;
+	sp->insn = insn;
+	sp->branch_offset = branch_offset;
+	sp->resume_offset = branch_offset + 4;
+	sp->start = sp->end = 0;
+
+	list_add_tail(&sp->list_node, &cu->slow_path_list);
+
+	return sp;
+}
+
 /* Free everything that is not required at run-time.  */
 void shrink_compilation_unit(struct compilation_unit *cu)
 {
@@ -223,6 +249,9 @@ void shrink_compilation_unit(struct compilation_unit *cu)
 	free(cu->doms);
 	cu->doms = NULL;
 
+	/* Slow path descriptors are allocated from the arena. */
+	INIT_LIST_HEAD(&cu->slow_path_list);
+
 	if (cu->arena)
 		arena_delete(cu->arena);
 	cu->arena = NULL;
@@ -233,6 +262,7 @@ void free_compilation_unit(struct compilation_unit *cu)
 	struct basic_block *bb, *tmp_bb;
 
 	free_call_fixup_sites(cu);
+	cha_unregister_sites(cu);
 	shrink_compilation_unit(cu);
 
 	list_for_each_entry_safe(bb, tmp_bb, &cu->bb_list, bb_list_node)
@@ -248,10 +278,40 @@ void free_compilation_unit(struct compilation_unit *cu)
 	free_tableswitch_list(cu);
 	free_lir_insn_map(cu);
 	free(cu->exception_handlers);
+	free(cu->backedge_counters);
+	free_gc_maps(cu);
 	free_constant_pool(cu->pool_head);
 	free(cu);
 }
 
+static void release_compilation_unit_code(void *arg)
+{
+	struct compilation_unit *cu = arg;
+
+	remove_cu_mapping((unsigned long) cu->entry_point);
+}
+
+/**
+ * retire_compilation_unit - free the machine code of a compilation unit
+ * @cu: compilation unit whose method can no longer be called
+ *
+ * The code is freed and unmapped once no thread executes it or has a
+ * frame of it on the stack. The compilation unit itself is kept because
+ * fixup sites of the methods and classes that the code refers to still
+ * point to it.
+ */
+void retire_compilation_unit(struct compilation_unit *cu)
+{
+	cha_unregister_sites(cu);
+
+	pthread_mutex_lock(&cu->mutex);
+	cu->code_retired = true;
+	pthread_mutex_unlock(&cu->mutex);
+
+	jit_text_retire(buffer_ptr(cu->objcode), buffer_offset(cu->objcode),
+			release_compilation_unit_code, cu);
+}
+
 unsigned long compilation_unit_get_state(struct compilation_unit *cu)
 {
 	unsigned long ret;
@@ -0,0 +1,225 @@
+/*
+ * Background compilation of hot methods
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "jit/compile-queue.h"
+#include "jit/compilation-unit.h"
+#include "jit/compiler.h"
+#include "jit/exception.h"
+
+#include "lib/pqueue.h"
+
+#include "vm/interp.h"
+#include "vm/method.h"
+#include "vm/thread.h"
+#include "vm/die.h"
+
+#include <pthread.h>
+#include <limits.h>
+#include <unistd.h>
+
+/*
+ * In tiered mode methods that become hot are put into a queue from which
+ * a pool of compiler threads picks them up. The threads calling the method
+ * keep interpreting it until compilation finishes and the trampoline is
+ * patched. Unrelated methods are compiled in parallel and the hottest
+ * method is always compiled first.
+ *
+ * The queue is a priority queue keyed by the hotness of a method when it
+ * was queued. Methods keep getting hotter while they wait so a method is
+ * queued again whenever its hotness has doubled. The entries it leaves
+ * behind are skipped when they reach the top of the queue.
+ */
+
+#define MAX_COMPILER_THREADS	16
+
+bool opt_background_compilation = true;
+unsigned int opt_nr_compiler_threads;
+
+static pthread_mutex_t compile_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t compile_queue_cond = PTHREAD_COND_INITIALIZER;
+static struct pqueue *compile_queue;
+
+static unsigned int nr_compiler_threads;
+
+bool compile_queue_enabled(void)
+{
+	return nr_compiler_threads > 0;
+}
+
+/* The top of a pqueue is the entry with the lowest key. */
+static inline unsigned long compile_queue_key(unsigned long hotness)
+{
+	return ULONG_MAX - hotness;
+}
+
+static struct compilation_unit *compile_queue_take(void)
+{
+	while (!pqueue_is_empty(compile_queue)) {
+		struct compilation_unit *cu;
+		unsigned long key;
+
+		key = pqueue_top_key(compile_queue);
+		cu = pqueue_remove_top(compile_queue);
+
+		if (key != compile_queue_key(cu->compile_queue_hotness))
+			continue;
+
+		/* Makes the older entries of @cu stale. */
+		cu->compile_queue_hotness = ULONG_MAX;
+
+		return cu;
+	}
+
+	return NULL;
+}
+
+static void *compiler_thread(void *arg)
+{
+	if (init_internal_exec_env())
+		die("out of memory");
+
+	for (;;) {
+		struct compilation_unit *cu;
+		void *entry;
+
+		pthread_mutex_lock(&compile_queue_mutex);
+
+		while (!(cu = compile_queue_take()))
+			pthread_cond_wait(&compile_queue_cond, &compile_queue_mutex);
+
+		pthread_mutex_unlock(&compile_queue_mutex);
+
+		entry = jit_compile_cu(cu);
+		if (entry)
+			fixup_direct_calls(cu->method->trampoline, (unsigned long) entry);
+		else
+			clear_exception();
+
+		pthread_mutex_lock(&compile_queue_mutex);
+
+		/*
+		 * If compilation fails the next call compiles the method
+		 * in the calling thread which then sees the exception.
+		 */
+		cu->compile_failed = entry == NULL;
+		cu->compile_queued = false;
+
+		pthread_mutex_unlock(&compile_queue_mutex);
+	}
+
+	return NULL;
+}
+
+/**
+ * compile_queue_submit - queues @cu for background compilation
+ *
+ * Returns true if @cu is waiting for or being compiled by a compiler
+ * thread in which case the caller should keep interpreting the method.
+ */
+bool compile_queue_submit(struct compilation_unit *cu)
+{
+	unsigned long hotness = vm_method_hotness(cu->method);
+	bool ret;
+
+	/*
+	 * Avoid the lock for methods that are already in the queue unless
+	 * their priority needs to be raised.
+	 */
+	if (cu->compile_queued && hotness / 2 < cu->compile_queue_hotness)
+		return true;
+
+	pthread_mutex_lock(&compile_queue_mutex);
+
+	if (cu->compile_failed || cu->state == COMPILATION_STATE_COMPILED) {
+		ret = false;
+		goto out_unlock;
+	}
+
+	if (!cu->compile_queued || hotness / 2 >= cu->compile_queue_hotness) {
+		if (pqueue_insert(compile_queue, compile_queue_key(hotness), cu)) {
+			/* Out of memory, compile in the calling thread. */
+			ret = cu->compile_queued;
+			goto out_unlock;
+		}
+
+		cu->compile_queued = true;
+		cu->compile_queue_hotness = hotness;
+		pthread_cond_signal(&compile_queue_cond);
+	}
+
+	ret = true;
+
+out_unlock:
+	pthread_mutex_unlock(&compile_queue_mutex);
+
+	return ret;
+}
+
+static unsigned int default_nr_compiler_threads(void)
+{
+	long nr_cpus;
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_cpus < 2)
+		return 1;
+
+	return nr_cpus / 2;
+}
+
+int init_compile_queue(void)
+{
+	unsigned int nr_threads;
+
+	if (!opt_tiered_compilation || !opt_background_compilation)
+		return 0;
+
+	compile_queue = pqueue_alloc();
+	if (!compile_queue)
+		return -1;
+
+	nr_threads = opt_nr_compiler_threads;
+	if (!nr_threads)
+		nr_threads = default_nr_compiler_threads();
+
+	if (nr_threads > MAX_COMPILER_THREADS)
+		nr_threads = MAX_COMPILER_THREADS;
+
+	for (unsigned int i = 0; i < nr_threads; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, compiler_thread, NULL))
+			break;
+
+		pthread_detach(thread);
+
+		nr_compiler_threads++;
+	}
+
+	if (!nr_compiler_threads)
+		return -1;
+
+	return 0;
+}
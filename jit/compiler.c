@@ -10,16 +10,20 @@
 
 #include "arch/inline-cache.h"
 #include "arch/peephole.h"
+#include "arch/profile.h"
 
 #include "jit/compilation-unit.h"
 #include "jit/statement.h"
 #include "jit/bc-offset-mapping.h"
 #include "jit/exception.h"
+#include "jit/gc-map.h"
 #include "jit/perf-map.h"
 #include "jit/subroutine.h"
 
 #include "vm/class.h"
+#include "vm/gc.h"
 #include "vm/method.h"
+#include "vm/profiler.h"
 #include "vm/trace.h"
 
 #include <errno.h>
@@ -153,9 +157,21 @@ int compile(struct compilation_unit *cu)
 	if (err)
 		goto out;
 
+	if (opt_profile_counters) {
+		err = insert_backedge_counters(cu);
+		if (err)
+			goto out;
+	}
+
 	if (opt_trace_regalloc)
 		trace_regalloc(cu);
 
+	if (newgc_enabled) {
+		err = build_gc_maps(cu);
+		if (err)
+			goto out;
+	}
+
 	err = convert_ic_calls(cu);
 	if (err)
 		goto out;
@@ -180,6 +196,9 @@ int compile(struct compilation_unit *cu)
 	resolve_fixup_offsets(cu);
 
 	perf_append_cu(cu);
+
+	if (opt_profile_counters)
+		profiler_add_cu(cu);
   out:
 	if (opt_trace_compile)
 		trace_flush();
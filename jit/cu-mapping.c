@@ -26,59 +26,524 @@
 
 #include "jit/compilation-unit.h"
 #include "jit/cu-mapping.h"
+#include "jit/text.h"
+
+#include "arch/cmpxchg.h"
+#include "arch/memory.h"
+
+#include "lib/bitset.h"
 
-#include "vm/alloc.h"
-#include "lib/radix-tree.h"
-#include "lib/buffer.h"
 #include "vm/die.h"
 
 #include <pthread.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Compilation units are looked up by native address on every frame of
+ * stack walks and exception unwinding so lookups must not contend on a
+ * lock. Only method entry addresses are stored, together with the
+ * compilation unit, in immutable arrays sorted by address: one array for
+ * each page of JIT text and one for addresses outside of it such as VM
+ * native functions. A lookup returns the entry with the highest address
+ * that is not above the looked up address.
+ *
+ * A method can span several pages so a lookup that finds no entry on the
+ * page of the address continues on the nearest preceding page that has
+ * entries. Writers keep a bitmap of such pages, and a bitmap of its
+ * non-zero words, so that the page is found in a bounded number of steps
+ * however much empty text lies in between.
+ *
+ * Writers replace an array with an updated copy. The old array is freed
+ * once every reader that might have seen it has finished. Readers only
+ * write to their own reader record, which tells writers the epoch in
+ * which the lookup started.
+ */
+
+#define CU_MAP_PAGE_SHIFT	12
+
+#define BITS_TO_LONGS(nr)	(((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+#define CU_MAP_READER_ALIGN	64
+
+struct cu_map_entry {
+	unsigned long		addr;
+	struct compilation_unit	*cu;
+};
+
+struct cu_map_array {
+	/* Link and epoch of arrays that are waiting to be freed. */
+	struct cu_map_array	*next;
+	unsigned long		epoch;
+
+	unsigned long		nr_entries;
+	struct cu_map_entry	entries[];
+};
+
+struct cu_map_reader {
+	/* Epoch in which the current lookup started, zero if none. */
+	volatile unsigned long	epoch;
+
+	/* Lookups can nest when a signal interrupts a lookup. */
+	volatile unsigned int	nesting;
+
+	/* Owning thread or NULL if the record is free. */
+	void			*owner;
+
+	struct cu_map_reader	*next;
+} __attribute__((aligned(CU_MAP_READER_ALIGN)));
+
+static unsigned long text_start;
+static unsigned long nr_text_pages;
+static struct cu_map_array **text_map;
+static unsigned long *text_page_bits;
+static unsigned long *text_word_bits;
+static struct cu_map_array *native_map;
+
+/* Serializes writers and protects cu_map_epoch and cu_map_garbage. */
+static pthread_mutex_t cu_map_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long cu_map_epoch = 1;
+static struct cu_map_array *cu_map_garbage;
+
+/* Reader records are never freed, only reused. */
+static struct cu_map_reader *cu_map_readers;
+
+static pthread_once_t cu_map_reader_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cu_map_reader_key;
+static __thread struct cu_map_reader *this_reader;
+
+static void cu_map_reader_destructor(void *p)
+{
+	struct cu_map_reader *reader = p;
+
+	reader->owner = NULL;
+}
+
+static struct cu_map_reader *alloc_cu_map_reader(void)
+{
+	struct cu_map_reader *reader, *head;
+
+	for (reader = cu_map_readers; reader; reader = reader->next) {
+		if (!cmpxchg_ptr(&reader->owner, NULL, &this_reader))
+			return reader;
+	}
+
+	if (posix_memalign((void **) &reader, CU_MAP_READER_ALIGN, sizeof *reader))
+		die("out of memory");
+
+	memset(reader, 0, sizeof *reader);
+	reader->owner = &this_reader;
+
+	do {
+		head = cu_map_readers;
+		reader->next = head;
+	} while (cmpxchg_ptr(&cu_map_readers, head, reader) != head);
+
+	return reader;
+}
+
+static void create_cu_map_reader_key(void)
+{
+	if (pthread_key_create(&cu_map_reader_key, cu_map_reader_destructor) != 0)
+		die("pthread_key_create");
+}
+
+/**
+ * thread_init_cu_mapping - sets up the current thread for lookups
+ *
+ * Lookups can run in signal handlers, for example the one of the
+ * sampling profiler, where allocating memory is not allowed. Every
+ * thread that can look up compilation units must therefore call this
+ * when it starts. It can be called before init_cu_mapping().
+ */
+void thread_init_cu_mapping(void)
+{
+	struct cu_map_reader *reader;
+
+	if (this_reader)
+		return;
+
+	if (pthread_once(&cu_map_reader_key_once, create_cu_map_reader_key) != 0)
+		die("pthread_once");
+
+	reader = alloc_cu_map_reader();
+	this_reader = reader;
+
+	if (pthread_setspecific(cu_map_reader_key, reader) != 0)
+		die("pthread_setspecific");
+}
+
+static struct cu_map_reader *cu_map_reader(void)
+{
+	struct cu_map_reader *reader = this_reader;
+
+	if (!reader)
+		die("thread_init_cu_mapping() was not called by this thread");
+
+	return reader;
+}
+
+static void cu_map_read_lock(struct cu_map_reader *reader)
+{
+	/*
+	 * A signal that interrupts the outermost lookup after the nesting
+	 * count is incremented but before the epoch is stored publishes the
+	 * epoch itself. The outermost lookup then stores its own epoch,
+	 * which is not newer, over it.
+	 */
+	if (reader->nesting++ && reader->epoch)
+		return;
+
+	reader->epoch = *(volatile unsigned long *) &cu_map_epoch;
+
+	/* Make the epoch visible before any array is loaded. */
+	smp_mb();
+}
+
+static void cu_map_read_unlock(struct cu_map_reader *reader)
+{
+	if (--reader->nesting)
+		return;
+
+	/* Finish loading from the arrays before the epoch is cleared. */
+	smp_mb();
+
+	reader->epoch = 0;
+}
+
+/*
+ * Frees the arrays that no reader can be using anymore. Must be called
+ * with cu_map_mutex held.
+ */
+static void cu_map_reclaim(void)
+{
+	struct cu_map_array *array, **prev;
+	struct cu_map_reader *reader;
+	unsigned long oldest = ~0UL;
+
+	for (reader = cu_map_readers; reader; reader = reader->next) {
+		unsigned long epoch = reader->epoch;
+
+		if (epoch && epoch < oldest)
+			oldest = epoch;
+	}
+
+	prev = &cu_map_garbage;
+
+	while ((array = *prev)) {
+		if (array->epoch < oldest) {
+			*prev = array->next;
+			free(array);
+		} else
+			prev = &array->next;
+	}
+}
+
+/*
+ * Replaces the array in @slot with @array. Must be called with
+ * cu_map_mutex held.
+ */
+static void cu_map_publish(struct cu_map_array **slot, struct cu_map_array *array)
+{
+	struct cu_map_array *old = *slot;
+
+	/* Make the contents of the array visible before the array. */
+	smp_wmb();
+
+	*(struct cu_map_array * volatile *) slot = array;
+
+	if (!old)
+		return;
+
+	/*
+	 * Readers that start after the epoch is advanced see the new
+	 * array. Make sure that readers that have not announced their
+	 * epoch yet see it too before the reader records are checked.
+	 */
+	old->epoch = cu_map_epoch++;
+	old->next = cu_map_garbage;
+	cu_map_garbage = old;
+
+	smp_mb();
+
+	cu_map_reclaim();
+}
+
+static struct cu_map_array *alloc_cu_map_array(unsigned long nr_entries)
+{
+	struct cu_map_array *array;
+
+	array = malloc(sizeof *array + nr_entries * sizeof(struct cu_map_entry));
+	if (!array)
+		return NULL;
+
+	array->next		= NULL;
+	array->epoch		= 0;
+	array->nr_entries	= nr_entries;
+
+	return array;
+}
 
 /*
- * A radix tree is used to associate native method addresses with
- * compilation unit. Only method entry address is stored in the tree
- * structure, so that inserting and removing compilation unit mapping
- * is fast.
+ * Returns the index of the first entry whose address is above @addr.
  */
-static struct radix_tree *cu_map;
-static pthread_rwlock_t cu_map_rwlock = PTHREAD_RWLOCK_INITIALIZER;
+static unsigned long cu_map_array_search(struct cu_map_array *array, unsigned long addr)
+{
+	unsigned long low = 0, high = array->nr_entries;
+
+	while (low < high) {
+		unsigned long mid = low + (high - low) / 2;
+
+		if (array->entries[mid].addr <= addr)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low;
+}
+
+static struct compilation_unit *
+cu_map_array_lookup(struct cu_map_array *array, unsigned long addr)
+{
+	unsigned long idx;
+
+	if (!array)
+		return NULL;
+
+	idx = cu_map_array_search(array, addr);
+	if (idx == 0)
+		return NULL;
+
+	return array->entries[idx - 1].cu;
+}
+
+static bool is_text_addr(unsigned long addr)
+{
+	return addr >= text_start && ((addr - text_start) >> CU_MAP_PAGE_SHIFT) < nr_text_pages;
+}
+
+/*
+ * Updates the page bitmaps after the array of the text page of @addr was
+ * replaced. Must be called with cu_map_mutex held.
+ */
+static void cu_map_update_page_bits(unsigned long addr)
+{
+	unsigned long page, word;
 
-#define BITS_PER_LEVEL 6
+	if (!is_text_addr(addr))
+		return;
+
+	page = (addr - text_start) >> CU_MAP_PAGE_SHIFT;
+	word = page / BITS_PER_LONG;
+
+	if (text_map[page])
+		set_bit(text_page_bits, page);
+	else
+		clear_bit(text_page_bits, page);
+
+	if (text_page_bits[word])
+		set_bit(text_word_bits, word);
+	else
+		clear_bit(text_word_bits, word);
+}
+
+static struct cu_map_array **cu_map_slot(unsigned long addr)
+{
+	if (is_text_addr(addr))
+		return &text_map[(addr - text_start) >> CU_MAP_PAGE_SHIFT];
+
+	return &native_map;
+}
 
 void init_cu_mapping(void)
 {
-	int key_bits = sizeof(unsigned long) * 8;
+	text_start	= (unsigned long) jit_text_base();
+	nr_text_pages	= jit_text_size() >> CU_MAP_PAGE_SHIFT;
 
-	cu_map = alloc_radix_tree(BITS_PER_LEVEL, key_bits);
-	if (!cu_map)
+	text_map = calloc(nr_text_pages, sizeof *text_map);
+	if (!text_map)
 		die("out of memory");
+
+	text_page_bits = calloc(BITS_TO_LONGS(nr_text_pages), sizeof(unsigned long));
+	text_word_bits = calloc(BITS_TO_LONGS(BITS_TO_LONGS(nr_text_pages)), sizeof(unsigned long));
+	if (!text_page_bits || !text_word_bits)
+		die("out of memory");
+
+	thread_init_cu_mapping();
 }
 
 int add_cu_mapping(unsigned long addr, struct compilation_unit *cu)
 {
-	int result;
+	struct cu_map_array **slot, *old, *new;
+	unsigned long idx, nr_entries;
+	bool replace;
 
-	pthread_rwlock_wrlock(&cu_map_rwlock);
-	result = radix_tree_insert(cu_map, addr, cu);
-	pthread_rwlock_unlock(&cu_map_rwlock);
+	pthread_mutex_lock(&cu_map_mutex);
 
-	return result;
+	slot = cu_map_slot(addr);
+	old = *slot;
+
+	nr_entries = old ? old->nr_entries : 0;
+	idx = old ? cu_map_array_search(old, addr) : 0;
+
+	replace = idx > 0 && old->entries[idx - 1].addr == addr;
+	if (replace)
+		idx--;
+
+	new = alloc_cu_map_array(replace ? nr_entries : nr_entries + 1);
+	if (!new) {
+		pthread_mutex_unlock(&cu_map_mutex);
+		return -ENOMEM;
+	}
+
+	if (old) {
+		memcpy(new->entries, old->entries, idx * sizeof(struct cu_map_entry));
+		memcpy(&new->entries[idx + 1], &old->entries[replace ? idx + 1 : idx],
+		       (nr_entries - idx - replace) * sizeof(struct cu_map_entry));
+	}
+
+	new->entries[idx].addr	= addr;
+	new->entries[idx].cu	= cu;
+
+	cu_map_publish(slot, new);
+	cu_map_update_page_bits(addr);
+
+	pthread_mutex_unlock(&cu_map_mutex);
+
+	return 0;
 }
 
 void remove_cu_mapping(unsigned long addr)
 {
-	pthread_rwlock_wrlock(&cu_map_rwlock);
-	radix_tree_remove(cu_map, addr);
-	pthread_rwlock_unlock(&cu_map_rwlock);
+	struct cu_map_array **slot, *old, *new = NULL;
+	unsigned long idx;
+
+	pthread_mutex_lock(&cu_map_mutex);
+
+	slot = cu_map_slot(addr);
+	old = *slot;
+
+	if (!old)
+		goto out_unlock;
+
+	idx = cu_map_array_search(old, addr);
+	if (idx == 0 || old->entries[idx - 1].addr != addr)
+		goto out_unlock;
+
+	idx--;
+
+	if (old->nr_entries > 1) {
+		new = alloc_cu_map_array(old->nr_entries - 1);
+		if (!new)
+			die("out of memory");
+
+		memcpy(new->entries, old->entries, idx * sizeof(struct cu_map_entry));
+		memcpy(&new->entries[idx], &old->entries[idx + 1],
+		       (old->nr_entries - idx - 1) * sizeof(struct cu_map_entry));
+	}
+
+	cu_map_publish(slot, new);
+	cu_map_update_page_bits(addr);
+
+out_unlock:
+	pthread_mutex_unlock(&cu_map_mutex);
+}
+
+static unsigned long highest_bit(unsigned long word)
+{
+	return BITS_PER_LONG - 1 - __builtin_clzl(word);
+}
+
+/* Returns the bits of @word up to and including bit @bit. */
+static unsigned long bits_upto(unsigned long word, unsigned long bit)
+{
+	return word & (~0UL >> (BITS_PER_LONG - 1 - bit));
+}
+
+/*
+ * Returns the nearest page below @page that has entries or -1 if there is
+ * none. The bitmaps can change under the reader so a page that is found
+ * may have lost its entries meanwhile, the caller then continues below it.
+ */
+static long prev_text_page(unsigned long page)
+{
+	unsigned long word, bits, group;
+
+	if (page == 0)
+		return -1;
+
+	page--;
+	word = page / BITS_PER_LONG;
+
+	bits = bits_upto(*(volatile unsigned long *) &text_page_bits[word], page % BITS_PER_LONG);
+	if (bits)
+		return word * BITS_PER_LONG + highest_bit(bits);
+
+	if (word == 0)
+		return -1;
+
+	word--;
+	group = word / BITS_PER_LONG;
+
+	bits = bits_upto(*(volatile unsigned long *) &text_word_bits[group], word % BITS_PER_LONG);
+
+	while (!bits) {
+		if (group == 0)
+			return -1;
+
+		bits = *(volatile unsigned long *) &text_word_bits[--group];
+	}
+
+	word = group * BITS_PER_LONG + highest_bit(bits);
+
+	bits = *(volatile unsigned long *) &text_page_bits[word];
+	if (!bits)
+		return prev_text_page(word * BITS_PER_LONG);
+
+	return word * BITS_PER_LONG + highest_bit(bits);
+}
+
+/*
+ * Entries of JIT text are looked up on the page of @addr first and then
+ * on the nearest preceding page with entries because the method that
+ * contains @addr can start on an earlier page.
+ */
+static struct compilation_unit *lookup_text(unsigned long addr)
+{
+	long page = (addr - text_start) >> CU_MAP_PAGE_SHIFT;
+	struct compilation_unit *cu;
+
+	do {
+		struct cu_map_array *array;
+
+		array = *(struct cu_map_array * volatile *) &text_map[page];
+
+		cu = cu_map_array_lookup(array, addr);
+		if (cu)
+			return cu;
+
+		page = prev_text_page(page);
+	} while (page >= 0);
+
+	return NULL;
 }
 
 struct compilation_unit *jit_lookup_cu(unsigned long addr)
 {
+	struct cu_map_reader *reader = cu_map_reader();
 	struct compilation_unit *cu;
 
-	pthread_rwlock_rdlock(&cu_map_rwlock);
-	cu = radix_tree_lookup_prev(cu_map, addr);
-	pthread_rwlock_unlock(&cu_map_rwlock);
+	cu_map_read_lock(reader);
+
+	if (is_text_addr(addr))
+		cu = lookup_text(addr);
+	else
+		cu = cu_map_array_lookup(*(struct cu_map_array * volatile *) &native_map, addr);
+
+	cu_map_read_unlock(reader);
 
 	return cu;
 }
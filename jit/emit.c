@@ -8,19 +8,24 @@
  */
 
 #include "arch/inline-cache.h"
+#include "arch/profile.h"
+#include "arch/text.h"
 
 #include "lib/buffer.h"
 #include "vm/class.h"
 #include "vm/method.h"
 #include "vm/object.h"
+#include "vm/profiler.h"
 #include "vm/die.h"
 #include "vm/vm.h"
 
 #include "jit/compilation-unit.h"
 #include "jit/basic-block.h"
+#include "jit/cha.h"
 #include "jit/compiler.h"
 #include "jit/emit-code.h"
 #include "jit/exception.h"
+#include "jit/gc-map.h"
 #include "jit/gdb.h"
 #include "jit/instruction.h"
 #include "jit/statement.h"
@@ -137,7 +142,14 @@ void emit_body(struct basic_block *bb, struct buffer *buf)
 	bb->is_emitted = true;
 
 	for_each_insn(insn, &bb->insn_list) {
+		struct gc_map *map = NULL;
+
+		if (insn->flags & INSN_FLAG_GC_MAP)
+			map = gc_map_for_insn(bb->b_parent, insn);
+
 		emit_insn(buf, bb, insn);
+
+		gc_map_emitted(map, insn, buffer_offset(buf));
 	}
 
 	if (opt_trace_machine_code)
@@ -167,6 +179,17 @@ static void emit_resolution_blocks(struct basic_block *bb, struct buffer *buf)
 	}
 }
 
+static void emit_slow_paths(struct compilation_unit *cu)
+{
+	struct slow_path *sp;
+
+	list_for_each_entry(sp, &cu->slow_path_list, list_node) {
+		sp->start = buffer_offset(cu->objcode);
+		emit_slow_path(cu->objcode, sp);
+		sp->end = buffer_offset(cu->objcode);
+	}
+}
+
 static void process_call_fixup_sites(struct compilation_unit *cu)
 {
 	struct fixup_site *site, *next;
@@ -180,6 +203,27 @@ static void process_call_fixup_sites(struct compilation_unit *cu)
 	}
 }
 
+/*
+ * Returns an upper bound for the size of the machine code of @cu.
+ */
+static unsigned long max_machine_code_size(struct compilation_unit *cu)
+{
+	unsigned long nr_insns = 0;
+	struct basic_block *bb;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		nr_insns += list_size(&bb->insn_list) + 1;
+
+		for (unsigned int i = 0; i < bb->nr_successors; i++)
+			nr_insns += list_size(&bb->resolution_blocks[i].insns) + 1;
+	}
+
+	nr_insns += list_size(&cu->exit_bb->insn_list) + 1;
+	nr_insns += list_size(&cu->unwind_bb->insn_list) + 1;
+
+	return TEXT_MAX_METHOD_OVERHEAD + nr_insns * TEXT_MAX_INSN_SIZE;
+}
+
 int emit_machine_code(struct compilation_unit *cu)
 {
 	unsigned long frame_size;
@@ -192,9 +236,7 @@ int emit_machine_code(struct compilation_unit *cu)
 	if (!buf)
 		return warn("out of memory"), -ENOMEM;
 
-	jit_text_lock();
-
-	buf->buf = jit_text_ptr();
+	buf->buf = jit_text_begin(JIT_TEXT_METHODS, max_machine_code_size(cu));
 	cu->objcode = buf;
 
 	frame_size = frame_locals_size(cu->stack_frame);
@@ -213,6 +255,9 @@ int emit_machine_code(struct compilation_unit *cu)
 	if (method_is_synchronized(cu->method))
 		emit_monitorenter(cu, frame_size);
 
+	if (opt_profile_counters)
+		emit_entry_counter(cu->objcode, cu);
+
 	if (opt_trace_invoke)
 		emit_trace_invoke(cu->objcode, cu);
 
@@ -235,6 +280,8 @@ int emit_machine_code(struct compilation_unit *cu)
 		emit_resolution_blocks(bb, cu->objcode);
 	}
 
+	emit_slow_paths(cu);
+
 	for_each_basic_block(bb, &cu->bb_list) {
 		backpatch_branches(bb, cu->objcode);
 	}
@@ -251,9 +298,13 @@ int emit_machine_code(struct compilation_unit *cu)
 		emit_ic_miss_handler(buf, ic_check, cu->method);
 	}
 
-	jit_text_reserve(buffer_offset(cu->objcode));
+	jit_text_end(buffer_offset(cu->objcode));
 
-	jit_text_unlock();
+	/*
+	 * This can emit vtable dispatch stubs so it must be called after
+	 * the code of this method has been committed.
+	 */
+	cha_register_sites(cu);
 
 	gdb_register_method(cu->method);
 
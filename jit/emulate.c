@@ -100,66 +100,86 @@ int emulate_dcmpg(double value1, double value2)
 	return __emulate_dcmpx(value1, value2);
 }
 
+void emulate_division_by_zero(void)
+{
+	signal_new_exception(vm_java_lang_ArithmeticException, "division by zero");
+}
+
+/*
+ * MIN_VALUE / -1 overflows in C but Java defines the result as MIN_VALUE
+ * with a zero remainder, which is what negation gives.
+ */
+
 int32_t emulate_idiv(int32_t value1, int32_t value2)
 {
 	if (value2 == 0) {
-		signal_new_exception(vm_java_lang_ArithmeticException, "division by zero");
+		emulate_division_by_zero();
 		return 0;
 	}
 
+	if (value2 == -1)
+		return -(uint32_t) value1;
+
 	return value1 / value2;
 }
 
 int32_t emulate_irem(int32_t value1, int32_t value2)
 {
 	if (value2 == 0) {
-		signal_new_exception(vm_java_lang_ArithmeticException, "division by zero");
+		emulate_division_by_zero();
 		return 0;
 	}
 
+	if (value2 == -1)
+		return 0;
+
 	return value1 % value2;
 }
 
 long long emulate_ldiv(long long value1, long long value2)
 {
 	if (value2 == 0) {
-		signal_new_exception(vm_java_lang_ArithmeticException,
-					"division by zero");
+		emulate_division_by_zero();
 		return 0;
 	}
 
+	if (value2 == -1)
+		return -(unsigned long long) value1;
+
 	return value1 / value2;
 }
 
 long long emulate_lrem(long long value1, long long value2)
 {
 	if (value2 == 0) {
-		signal_new_exception(vm_java_lang_ArithmeticException,
-					"division by zero");
+		emulate_division_by_zero();
 		return 0;
 	}
 
+	if (value2 == -1)
+		return 0;
+
 	return value1 % value2;
 }
 
 int32_t emulate_ishl(int32_t value1, int32_t value2)
 {
-	return value1 << (value2 & 0x3f);
+	return (uint32_t) value1 << (value2 & 0x1f);
 }
 
 int32_t emulate_ishr(int32_t value1, int32_t value2)
 {
-	return value1 >> (value2 & 0x3f);
+	return value1 >> (value2 & 0x1f);
 }
 
 int32_t emulate_iushr(int32_t value1, int32_t value2)
 {
-	return (uint32_t) value1 >> (value2 & 0x3f);
+	return (uint32_t) value1 >> (value2 & 0x1f);
 }
 
 int64_t emulate_lshl(int64_t value1, int32_t value2)
 {
-	return value1 << (value2 & 0x3f);
+	return (uint64_t) value1 << (value2 & 0x3f);
 }
 
 int64_t emulate_lshr(int64_t value1, int32_t value2)
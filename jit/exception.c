@@ -50,6 +50,8 @@
 #include "arch/instruction.h"
 #include <errno.h>
 
+bool opt_omit_stack_trace_in_fast_throw;
+
 __thread void *exception_guard = NULL;
 __thread void *trampoline_exception_guard = NULL;
 
@@ -78,10 +80,117 @@ void thread_init_exceptions(void)
 	vm_get_exec_env()->exception = NULL;
 }
 
+static struct vm_class *
+handler_catch_class(struct compilation_unit *cu, struct exception_handler *handler)
+{
+	struct vm_class *catch_class;
+
+	catch_class = handler->catch_class;
+	if (catch_class)
+		return catch_class;
+
+	/*
+	 * Resolving the same class again is harmless so threads that
+	 * race here need no lock.
+	 */
+	catch_class = vm_class_resolve_class(cu->method->class,
+					     handler->catch_type);
+	handler->catch_class = catch_class;
+
+	return catch_class;
+}
+
+/**
+ * find_handler - return exception handler for given @exception_class
+ *                and @bc_offset of source.
+ */
+static struct exception_handler *find_handler(struct compilation_unit *cu,
+	struct vm_class *exception_class, unsigned long bc_offset)
+{
+	int size;
+	int i;
+
+	size = cu->method->code_attribute.exception_table_length;
+
+	for (i = 0; i < size; i++) {
+		struct exception_handler *handler = &cu->exception_handlers[i];
+		struct vm_class *catch_class;
+
+		if (bc_offset < handler->start_pc || bc_offset >= handler->end_pc)
+			continue;
+
+		/* This matches to everything. */
+		if (handler->catch_type == 0)
+			return handler;
+
+		catch_class = handler_catch_class(cu, handler);
+		if (catch_class && vm_class_is_assignable_from(catch_class, exception_class))
+			return handler;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns true if an exception of class @vmc signalled now is caught by
+ * a typed handler of the jitted method that raised it, that is, the
+ * nearest java method on the stack. Handlers that match everything are
+ * not counted because they are used for finally blocks and for
+ * unlocking monitors, which rethrow the exception.
+ */
+static bool caught_by_raising_method(struct vm_class *vmc)
+{
+	struct exception_handler *handler;
+	struct stack_trace_elem elem;
+	struct compilation_unit *cu;
+	unsigned long bc_offset;
+
+	init_stack_trace_elem_current(&elem);
+
+	if (stack_trace_elem_next_java(&elem))
+		return false;
+
+	if (elem.type != STACK_TRACE_ELEM_TYPE_JIT)
+		return false;
+
+	cu = jit_lookup_cu(elem.addr);
+	if (!cu || !cu->exception_handlers)
+		return false;
+
+	bc_offset = jit_lookup_bc_offset(cu, (unsigned char *) elem.addr);
+	if (bc_offset == BC_OFFSET_UNKNOWN)
+		return false;
+
+	handler = find_handler(cu, vmc, bc_offset);
+
+	return handler && handler->catch_type != 0;
+}
+
+static struct vm_method *exception_init(struct vm_class *vmc)
+{
+	struct vm_method *vmm;
+
+	vmm = vmc->exception_init;
+	if (vmm)
+		return vmm;
+
+	vmm = vm_class_get_method(vmc, "<init>", "(Ljava/lang/String;)V");
+	if (!vmm)
+		vmm = vm_class_get_method(vmc, "<init>", "()V");
+
+	if (!vmm)
+		error("constructor not found for %s", vmc->name);
+
+	vmc->exception_init = vmm;
+
+	return vmm;
+}
+
 static struct vm_object *
-new_exception(struct vm_class *vmc, const char *message)
+new_exception(struct vm_class *vmc, const char *message, bool omit_stack_trace)
 {
 	struct vm_object *message_str;
+	struct vm_exec_env *ee;
 	struct vm_method *vmm;
 	struct vm_object *obj;
 
@@ -97,18 +206,18 @@ new_exception(struct vm_class *vmc, const char *message)
 			return rethrow_exception();
 	}
 
-	vmm = vm_class_get_method(vmc, "<init>", "(Ljava/lang/String;)V");
-	if (vmm) {
-		vm_call_method(vmm, obj, message_str);
+	vmm = exception_init(vmc);
 
-		return obj;
-	}
+	ee = vm_get_exec_env();
+	ee->omit_stack_trace = omit_stack_trace;
 
-	vmm = vm_class_get_method(vmc, "<init>", "()V");
-	if (!vmm)
-		error("constructor not found for %s", vmc->name);
+	/* The implicit 'this' is counted in args_count. */
+	if (vmm->args_count == 2)
+		vm_call_method(vmm, obj, message_str);
+	else
+		vm_call_method(vmm, obj);
 
-	vm_call_method(vmm, obj);
+	ee->omit_stack_trace = false;
 
 	return obj;
 }
@@ -132,6 +241,7 @@ void signal_exception(struct vm_object *exception)
 void signal_new_exception_v(struct vm_class *vmc, const char *template, va_list args)
 {
 	struct vm_object *exception;
+	bool omit_stack_trace;
 	char *msg = NULL;
 
 	if (template) {
@@ -139,12 +249,22 @@ void signal_new_exception_v(struct vm_class *vmc, const char *template, va_list
 			error("asprintf");
 	}
 
-	exception = new_exception(vmc, msg);
+	omit_stack_trace = opt_omit_stack_trace_in_fast_throw &&
+		caught_by_raising_method(vmc);
+
+	exception = new_exception(vmc, msg, omit_stack_trace);
 	free(msg);
 	if (!exception)
 		die("out of memory");
 
 	signal_exception(exception);
+
+	/*
+	 * The guess of caught_by_raising_method() is checked against the
+	 * exact address of the throw by throw_from_jit().
+	 */
+	if (omit_stack_trace)
+		vm_get_exec_env()->stack_trace_pending = exception;
 }
 
 void signal_new_exception(struct vm_class *vmc, const char *template, ...)
@@ -205,7 +325,7 @@ void signal_new_exception_with_cause(struct vm_class *vmc,
 		return;
 	}
 
-	exception = new_exception(vmc, msg);
+	exception = new_exception(vmc, msg, false);
 	free(msg);
 	if (!exception)
 		return; /* rethrow */
@@ -266,57 +386,36 @@ int build_exception_handlers_table(struct compilation_unit *cu)
 	if (size == 0)
 		return 0;
 
-	cu->exception_handlers = malloc(sizeof(void *) * size);
+	cu->exception_handlers = malloc(sizeof(struct exception_handler) * size);
 	if (!cu->exception_handlers)
 		return -ENOMEM;
 
 	for (i = 0; i < size; i++) {
 		struct cafebabe_code_attribute_exception *eh
 			= &method->code_attribute.exception_table[i];
+		struct exception_handler *handler = &cu->exception_handlers[i];
 
-		cu->exception_handlers[i] = eh_native_ptr(cu, eh);
+		handler->start_pc	= eh->start_pc;
+		handler->end_pc		= eh->end_pc;
+		handler->catch_type	= eh->catch_type;
+		handler->catch_class	= NULL;
+		handler->native_ptr	= eh_native_ptr(cu, eh);
 	}
 
 	return 0;
 }
 
-/**
- * find_handler - return native pointer to exception handler for given
- *                @exception_class and @bc_offset of source.
+/*
+ * Captures the stack trace of @exception whose capture was skipped by
+ * new_exception() because it was expected to be caught where it was
+ * raised but it was not.
  */
-static unsigned char *find_handler(struct compilation_unit *cu,
-	struct vm_class *exception_class, unsigned long bc_offset)
+static void fill_in_stack_trace(struct vm_object *exception)
 {
-	struct cafebabe_code_attribute_exception *eh;
-	struct vm_method *method;
-	int size;
-	int i;
-
-	method = cu->method;
-	size = method->code_attribute.exception_table_length;
-
-	for (i = 0; i < size; i++) {
-		struct vm_class *catch_class;
-
-		eh = &method->code_attribute.exception_table[i];
-		if (!exception_covers(eh, bc_offset))
-			continue;
-
-		/* This matches to everything. */
-		if (eh->catch_type == 0)
-			break;
-
-		catch_class = vm_class_resolve_class(method->class,
-			eh->catch_type);
-
-		if (vm_class_is_assignable_from(catch_class, exception_class))
-			break;
-	}
-
-	if (i < size)
-		return cu->exception_handlers[i];
+	vm_call_method(vm_java_lang_Throwable_fillInStackTrace, exception);
 
-	return NULL;
+	if (exception_occurred())
+		clear_exception();
 }
 
 static bool
@@ -351,15 +450,20 @@ unsigned char *
 throw_from_jit(struct compilation_unit *cu, struct jit_stack_frame *frame,
 	       unsigned char *native_ptr)
 {
+	struct exception_handler *handler;
 	struct vm_object *exception;
 	unsigned long bc_offset;
-	unsigned char *eh_ptr;
+	struct vm_exec_env *ee;
+	bool trace_pending;
 
-	eh_ptr = NULL;
+	ee = vm_get_exec_env();
 
-	exception = exception_occurred();
+	exception = ee->exception;
 	assert(exception != NULL);
 
+	trace_pending = ee->stack_trace_pending == exception;
+	ee->stack_trace_pending = NULL;
+
 	if (!vm_class_is_assignable_from(vm_java_lang_Throwable, exception->class)) {
 		signal_new_exception(vm_java_lang_Error, "Object %p (%s) not throwable",
 				     exception, exception->class->name);
@@ -371,17 +475,22 @@ throw_from_jit(struct compilation_unit *cu, struct jit_stack_frame *frame,
 
 	clear_exception();
 
+	handler = NULL;
+
 	bc_offset = jit_lookup_bc_offset(cu, native_ptr);
-	if (bc_offset != BC_OFFSET_UNKNOWN) {
-		eh_ptr = find_handler(cu, exception->class, bc_offset);
-		if (eh_ptr != NULL) {
-			signal_exception(exception);
+	if (bc_offset != BC_OFFSET_UNKNOWN)
+		handler = find_handler(cu, exception->class, bc_offset);
 
-			if (opt_trace_exceptions)
-				trace_exception_handler(cu, eh_ptr);
+	if (trace_pending && (!handler || handler->catch_type == 0))
+		fill_in_stack_trace(exception);
 
-			return eh_ptr;
-		}
+	if (handler) {
+		signal_exception(exception);
+
+		if (opt_trace_exceptions)
+			trace_exception_handler(cu, handler->native_ptr);
+
+		return handler->native_ptr;
 	}
 
 	signal_exception(exception);
@@ -0,0 +1,317 @@
+/*
+ * GC maps
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "jit/gc-map.h"
+
+#include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
+#include "jit/instruction.h"
+#include "jit/stack-slot.h"
+#include "jit/vars.h"
+
+#include "arch/instruction.h"
+#include "arch/stack-frame.h"
+
+#include "lib/bitset.h"
+
+#include "vm/types.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+
+/*
+ * The maps are built after register allocation when the live intervals
+ * of the method are still around. A reference is live at a safepoint
+ * poll if its interval covers the position of the poll. At a call the
+ * reference must also survive the call so its interval must cover the
+ * position after the call, too. Calls clobber all caller saved registers
+ * so references that live across a call are either in callee saved
+ * registers or spilled.
+ */
+
+static bool insn_is_gc_point(struct insn *insn)
+{
+	if (insn_is_safepoint_poll(insn))
+		return true;
+
+	switch (insn->type) {
+	case INSN_TLAB_ALLOC_ARRAY:
+	case INSN_TLAB_ALLOC_OBJECT:
+		/* The slow path call is not at the position of the insn. */
+		return false;
+	default:
+		return insn_is_call(insn);
+	}
+}
+
+/*
+ * Returns the stack slot that @insn stores a reference to or loads a
+ * reference from. This also catches the spill slots of references.
+ */
+static struct stack_slot *insn_reference_slot(struct insn *insn)
+{
+	struct insn_semantics sem;
+
+	insn_semantics(insn, &sem);
+
+	switch (sem.type) {
+	case INSN_SEM_LOAD_LOCAL:
+		if (sem.dest->vm_type == J_REFERENCE)
+			return sem.slot;
+		break;
+	case INSN_SEM_STORE_LOCAL:
+		if (sem.src->vm_type == J_REFERENCE)
+			return sem.slot;
+		break;
+	default:
+		break;
+	}
+
+	return NULL;
+}
+
+static void gc_map_add_interval(struct live_interval *it, unsigned long *reg_map)
+{
+	if (it->reg == MACH_REG_UNASSIGNED || it->reg >= NR_GP_REGISTERS)
+		return;
+
+	set_bit(reg_map, it->reg);
+}
+
+static void build_register_map(struct compilation_unit *cu, struct gc_map *map)
+{
+	unsigned long pos = map->lir_pos;
+	struct var_info *var;
+	unsigned int i;
+
+	for_each_variable(var, cu->var_infos) {
+		struct live_interval *it = var->interval, *child, *after;
+
+		if (var->vm_type != J_REFERENCE || interval_has_fixed_reg(it))
+			continue;
+
+		child = interval_child_at(it, pos);
+		if (!child)
+			continue;
+
+		if (map->is_call) {
+			after = interval_child_at(it, pos + 1);
+			if (!after)
+				continue;
+
+			gc_map_add_interval(after, map->register_map);
+		}
+
+		gc_map_add_interval(child, map->register_map);
+	}
+
+	if (map->is_call)
+		return;
+
+	/*
+	 * Fixed registers are not typed. They hold call arguments that
+	 * are already set up when the poll before a call is reached.
+	 */
+	for (i = 0; i < NR_GP_REGISTERS; i++) {
+		struct var_info *fixed = cu->fixed_var_infos[i];
+
+		if (!fixed || !interval_covers(fixed->interval, pos))
+			continue;
+
+		set_bit(map->conservative_register_map, i);
+	}
+}
+
+static int build_gc_slots(struct compilation_unit *cu)
+{
+	struct stack_frame *frame = cu->stack_frame;
+	unsigned long nr_slots = 0, i;
+	struct stack_slot *slot;
+
+	if (cu->exception_spill_slot)
+		cu->exception_spill_slot->reference = true;
+
+	for (i = 0; i < frame->nr_local_slots; i++) {
+		if (get_local_slot(frame, i)->reference)
+			nr_slots++;
+	}
+
+	for (slot = frame->spill_slots; slot != NULL; slot = slot->next) {
+		if (slot->reference)
+			nr_slots++;
+	}
+
+	if (!nr_slots)
+		return 0;
+
+	cu->gc_slots = malloc(nr_slots * sizeof(long));
+	if (!cu->gc_slots)
+		return -ENOMEM;
+
+	for (i = 0; i < frame->nr_local_slots; i++) {
+		slot = get_local_slot(frame, i);
+
+		if (slot->reference)
+			cu->gc_slots[cu->nr_gc_slots++] = (long) slot_offset(slot);
+	}
+
+	for (slot = frame->spill_slots; slot != NULL; slot = slot->next) {
+		if (slot->reference)
+			cu->gc_slots[cu->nr_gc_slots++] = (long) slot_offset(slot);
+	}
+
+	return 0;
+}
+
+int build_gc_maps(struct compilation_unit *cu)
+{
+	unsigned long nr_maps = 0;
+	struct basic_block *bb;
+	struct insn *insn;
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		for_each_insn(insn, &bb->insn_list) {
+			struct stack_slot *slot;
+
+			slot = insn_reference_slot(insn);
+			if (slot)
+				slot->reference = true;
+
+			if (insn_is_gc_point(insn))
+				nr_maps++;
+		}
+	}
+
+	if (nr_maps) {
+		cu->gc_maps = calloc(nr_maps, sizeof(struct gc_map));
+		if (!cu->gc_maps)
+			return -ENOMEM;
+	}
+
+	for_each_basic_block(bb, &cu->bb_list) {
+		for_each_insn(insn, &bb->insn_list) {
+			struct gc_map *map;
+
+			if (!insn_is_gc_point(insn))
+				continue;
+
+			map = &cu->gc_maps[cu->nr_gc_maps++];
+			map->lir_pos = insn->lir_pos;
+			map->is_call = insn_is_call(insn);
+
+			build_register_map(cu, map);
+
+			insn->flags |= INSN_FLAG_GC_MAP;
+		}
+	}
+
+	return build_gc_slots(cu);
+}
+
+void free_gc_maps(struct compilation_unit *cu)
+{
+	free(cu->gc_maps);
+	cu->gc_maps = NULL;
+	cu->nr_gc_maps = 0;
+
+	free(cu->gc_slots);
+	cu->gc_slots = NULL;
+	cu->nr_gc_slots = 0;
+}
+
+/*
+ * Returns the GC map of @insn. Must be called before the instruction is
+ * emitted because ->lir_pos shares storage with ->mach_offset.
+ */
+struct gc_map *gc_map_for_insn(struct compilation_unit *cu, struct insn *insn)
+{
+	unsigned long low = 0, high = cu->nr_gc_maps;
+
+	assert(insn->flags & INSN_FLAG_GC_MAP);
+
+	while (low < high) {
+		unsigned long mid = (low + high) / 2;
+		struct gc_map *map = &cu->gc_maps[mid];
+
+		if (map->lir_pos == insn->lir_pos)
+			return map;
+
+		if (map->lir_pos < insn->lir_pos)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return NULL;
+}
+
+/*
+ * Records the machine code offset of a GC point. @end_offset is the
+ * offset right after the emitted instruction which is the return address
+ * for calls.
+ */
+void gc_map_emitted(struct gc_map *map, struct insn *insn, unsigned long end_offset)
+{
+	if (!map)
+		return;
+
+	if (map->is_call)
+		map->mach_offset = end_offset;
+	else
+		map->mach_offset = insn->mach_offset;
+}
+
+/*
+ * Returns the GC map of the safepoint poll at @mach_offset or of the call
+ * that returns to @mach_offset. The maps are emitted in the same order as
+ * they are built so they are sorted by ->mach_offset, too.
+ */
+struct gc_map *gc_map_lookup(struct compilation_unit *cu, unsigned long mach_offset, bool is_call)
+{
+	unsigned long low = 0, high = cu->nr_gc_maps;
+
+	while (low < high) {
+		unsigned long mid = (low + high) / 2;
+
+		if (cu->gc_maps[mid].mach_offset < mach_offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; low < cu->nr_gc_maps; low++) {
+		struct gc_map *map = &cu->gc_maps[low];
+
+		if (map->mach_offset != mach_offset)
+			break;
+
+		if (map->is_call == is_call)
+			return map;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,655 @@
+/*
+ * Inlining of small statically bound methods
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "jit/inline.h"
+
+#include "jit/bytecode-to-ir.h"
+#include "jit/compilation-unit.h"
+#include "jit/expression.h"
+#include "jit/statement.h"
+
+#include "vm/bytecode.h"
+#include "vm/class.h"
+#include "vm/field.h"
+#include "vm/method.h"
+#include "vm/opcodes.h"
+#include "vm/die.h"
+
+#include "lib/stack.h"
+
+#include <errno.h>
+
+/*
+ * Small methods that are bound at compile time are inlined by converting
+ * their bytecode directly into the caller's basic block. Only straight-line
+ * methods without branches, exception handlers or local variable stores
+ * are inlined and the only exception an inlined method may throw is
+ * NullPointerException on its receiver. The receiver is checked before
+ * the method body so the exception is raised at the call site with the
+ * same stack trace as if the method had been called. All instructions of
+ * an inlined method are attributed to the invoke instruction in the
+ * caller.
+ */
+
+bool opt_inline_enabled = true;
+unsigned int opt_max_inline_size = 35;
+
+/* How many levels of nested invocations are inlined into a method. */
+#define MAX_INLINE_DEPTH	3
+
+/* How many bytecode bytes in total are inlined into a method. */
+#define MAX_INLINED_BYTES	1000
+
+struct inline_chain {
+	struct vm_method		*method;
+	struct inline_chain		*parent;
+};
+
+static unsigned int method_nr_arg_slots(struct vm_method *vmm)
+{
+	struct vm_method_arg *arg;
+	unsigned int nr_slots;
+
+	nr_slots = vm_method_is_static(vmm) ? 0 : 1;
+
+	list_for_each_entry(arg, &vmm->args, list_node) {
+		enum vm_type type = arg->type_info.vm_type;
+
+		nr_slots += (type == J_LONG || type == J_DOUBLE) ? 2 : 1;
+	}
+
+	return nr_slots;
+}
+
+static unsigned int method_nr_arg_values(struct vm_method *vmm)
+{
+	return (vm_method_is_static(vmm) ? 0 : 1) + list_size(&vmm->args);
+}
+
+static struct vm_method *
+resolve_invoke_target(struct vm_method *vmm, unsigned char opc, uint16_t idx)
+{
+	uint16_t access_flags;
+
+	access_flags = opc == OPC_INVOKEVIRTUAL ? 0 : CAFEBABE_CLASS_ACC_STATIC;
+
+	return vm_class_resolve_method_recursive(vmm->class, idx, access_flags);
+}
+
+static bool is_statically_bound(struct vm_method *vmm, unsigned char opc)
+{
+	if (opc != OPC_INVOKEVIRTUAL)
+		return true;
+
+	return vm_method_is_final(vmm) || vm_method_is_private(vmm)
+		|| vm_class_is_final(vmm->class);
+}
+
+static enum vm_type load_type(unsigned char opc)
+{
+	switch (opc) {
+	case OPC_ILOAD:
+	case OPC_ILOAD_0 ... OPC_ILOAD_3:
+		return J_INT;
+	case OPC_LLOAD:
+	case OPC_LLOAD_0 ... OPC_LLOAD_3:
+		return J_LONG;
+	case OPC_FLOAD:
+	case OPC_FLOAD_0 ... OPC_FLOAD_3:
+		return J_FLOAT;
+	case OPC_DLOAD:
+	case OPC_DLOAD_0 ... OPC_DLOAD_3:
+		return J_DOUBLE;
+	default:
+		return J_REFERENCE;
+	}
+}
+
+static unsigned int load_index(const unsigned char *code, unsigned long pc)
+{
+	unsigned char opc = code[pc];
+
+	if (opc >= OPC_ILOAD_0 && opc <= OPC_ALOAD_3)
+		return (opc - OPC_ILOAD_0) % 4;
+
+	return read_u8(&code[pc + 1]);
+}
+
+static bool is_inlineable(struct vm_method *vmm, struct inline_chain *chain,
+			  unsigned int depth);
+
+/*
+ * Checks that the body of @vmm only contains instructions that we know how
+ * to inline. The operand stack is simulated to track which values are the
+ * receiver of @vmm.
+ */
+static bool is_inlineable_body(struct vm_method *vmm, struct inline_chain *chain,
+			       unsigned int depth)
+{
+	struct cafebabe_code_attribute *code_attribute = &vmm->code_attribute;
+	unsigned int nr_slots = method_nr_arg_slots(vmm);
+	const unsigned char *code = code_attribute->code;
+	bool stack[code_attribute->max_stack + 1];
+	enum vm_type slot_types[nr_slots + 1];
+	struct inline_chain this_chain;
+	struct vm_method_arg *arg;
+	unsigned int slot = 0;
+	unsigned long pc = 0;
+	unsigned int sp = 0;
+
+	if (!vm_method_is_static(vmm))
+		slot_types[slot++] = J_REFERENCE;
+
+	list_for_each_entry(arg, &vmm->args, list_node) {
+		enum vm_type type = mimic_stack_type(arg->type_info.vm_type);
+
+		slot_types[slot++] = type;
+		if (type == J_LONG || type == J_DOUBLE)
+			slot_types[slot++] = J_VOID;
+	}
+
+	this_chain.method = vmm;
+	this_chain.parent = chain;
+
+	while (pc < code_attribute->code_length) {
+		unsigned char opc = code[pc];
+		struct vm_method *target;
+		struct vm_field *vmf;
+		unsigned int idx, nr;
+
+		switch (opc) {
+		case OPC_NOP:
+			break;
+		case OPC_ILOAD:
+		case OPC_LLOAD:
+		case OPC_FLOAD:
+		case OPC_DLOAD:
+		case OPC_ALOAD:
+		case OPC_ILOAD_0 ... OPC_ALOAD_3:
+			idx = load_index(code, pc);
+			if (idx >= nr_slots || slot_types[idx] != load_type(opc))
+				return false;
+
+			if (sp >= code_attribute->max_stack)
+				return false;
+
+			stack[sp++] = idx == 0 && !vm_method_is_static(vmm);
+			break;
+		case OPC_ACONST_NULL:
+		case OPC_ICONST_M1 ... OPC_DCONST_1:
+		case OPC_BIPUSH:
+		case OPC_SIPUSH:
+			if (sp >= code_attribute->max_stack)
+				return false;
+
+			stack[sp++] = false;
+			break;
+		case OPC_IADD:
+		case OPC_ISUB:
+		case OPC_IMUL:
+		case OPC_IAND:
+		case OPC_IOR:
+		case OPC_IXOR:
+		case OPC_LADD:
+		case OPC_LSUB:
+		case OPC_LAND:
+		case OPC_LOR:
+		case OPC_LXOR:
+			if (sp < 2)
+				return false;
+
+			stack[--sp - 1] = false;
+			break;
+		case OPC_GETFIELD:
+		case OPC_PUTFIELD:
+			vmf = vm_class_resolve_field_recursive(vmm->class, read_u16(&code[pc + 1]));
+			if (!vmf || vm_field_is_static(vmf))
+				return false;
+
+			nr = opc == OPC_GETFIELD ? 1 : 2;
+			if (sp < nr || !stack[sp - nr])
+				return false;
+
+			sp -= nr;
+
+			if (opc == OPC_GETFIELD)
+				stack[sp++] = false;
+			break;
+		case OPC_GETSTATIC:
+		case OPC_PUTSTATIC:
+			vmf = vm_class_resolve_field_recursive(vmm->class, read_u16(&code[pc + 1]));
+			if (!vmf || !vm_field_is_static(vmf))
+				return false;
+
+			if (vmf->class->state != VM_CLASS_INITIALIZED)
+				return false;
+
+			if (opc == OPC_GETSTATIC) {
+				if (sp >= code_attribute->max_stack)
+					return false;
+
+				stack[sp++] = false;
+			} else {
+				if (sp < 1)
+					return false;
+
+				sp--;
+			}
+			break;
+		case OPC_INVOKESTATIC:
+		case OPC_INVOKESPECIAL:
+		case OPC_INVOKEVIRTUAL:
+			target = resolve_invoke_target(vmm, opc, read_u16(&code[pc + 1]));
+			if (!target || vm_method_is_missing(target))
+				return false;
+
+			if (!is_statically_bound(target, opc))
+				return false;
+
+			nr = method_nr_arg_values(target);
+			if (sp < nr)
+				return false;
+
+			/*
+			 * A nested call may only throw NullPointerException if
+			 * its receiver is our receiver which is checked
+			 * before our body.
+			 */
+			if (!vm_method_is_static(target) && !stack[sp - nr])
+				return false;
+
+			if (!is_inlineable(target, &this_chain, depth + 1))
+				return false;
+
+			sp -= nr;
+
+			if (method_return_type(target) != J_VOID)
+				stack[sp++] = false;
+			break;
+		case OPC_IRETURN:
+		case OPC_LRETURN:
+		case OPC_FRETURN:
+		case OPC_DRETURN:
+		case OPC_ARETURN:
+			return sp == 1 && pc + 1 == code_attribute->code_length;
+		case OPC_RETURN:
+			return sp == 0 && pc + 1 == code_attribute->code_length;
+		default:
+			return false;
+		}
+
+		pc += bc_insn_size(code, pc);
+	}
+
+	return false;
+}
+
+static bool is_inlineable(struct vm_method *vmm, struct inline_chain *chain,
+			  unsigned int depth)
+{
+	struct inline_chain *this;
+
+	if (depth > MAX_INLINE_DEPTH)
+		return false;
+
+	if (vm_method_is_native(vmm) || vm_method_is_abstract(vmm))
+		return false;
+
+	if (method_is_synchronized(vmm))
+		return false;
+
+	if (vmm->flags & (VM_METHOD_FLAG_TRACE | VM_METHOD_FLAG_TRACE_GATE))
+		return false;
+
+	if (vmm->code_attribute.code_length > opt_max_inline_size)
+		return false;
+
+	if (vmm->code_attribute.exception_table_length)
+		return false;
+
+	/* Calling a static method initializes its class. */
+	if (vm_method_is_static(vmm) && vmm->class->state != VM_CLASS_INITIALIZED)
+		return false;
+
+	for (this = chain; this; this = this->parent) {
+		if (this->method == vmm)
+			return false;
+	}
+
+	return is_inlineable_body(vmm, chain, depth);
+}
+
+/**
+ * can_inline - checks if a call to @target can be inlined
+ * @cu: compilation unit of the caller
+ * @target: the resolved invocation target
+ * @opc: the invoke instruction
+ */
+bool can_inline(struct compilation_unit *cu, struct vm_method *target, unsigned char opc)
+{
+	struct inline_chain chain;
+
+	if (!opt_inline_enabled || opt_trace_invoke)
+		return false;
+
+	if (vm_method_is_missing(target) || !is_statically_bound(target, opc))
+		return false;
+
+	if (cu->nr_inlined_bytes + target->code_attribute.code_length > MAX_INLINED_BYTES)
+		return false;
+
+	chain.method = cu->method;
+	chain.parent = NULL;
+
+	return is_inlineable(target, &chain, 1);
+}
+
+static int null_check_receiver(struct parse_context *ctx, struct expression *receiver)
+{
+	struct expression *nullcheck;
+	struct statement *stmt;
+
+	nullcheck = null_check_expr(expr_get(receiver));
+	if (!nullcheck)
+		return warn("out of memory"), -ENOMEM;
+
+	stmt = alloc_statement(STMT_EXPRESSION);
+	if (!stmt) {
+		expr_put(nullcheck);
+		return warn("out of memory"), -ENOMEM;
+	}
+
+	stmt->expression = &nullcheck->node;
+	convert_statement(ctx, stmt);
+
+	return 0;
+}
+
+static int convert_store(struct parse_context *ctx, struct expression *dest,
+			 struct expression *src)
+{
+	struct statement *stmt;
+
+	if (!dest)
+		return warn("out of memory"), -ENOMEM;
+
+	stmt = alloc_statement(STMT_STORE);
+	if (!stmt) {
+		expr_put(dest);
+		return warn("out of memory"), -ENOMEM;
+	}
+
+	stmt->store_dest = &dest->node;
+	stmt->store_src = &src->node;
+	convert_statement(ctx, stmt);
+
+	return 0;
+}
+
+static struct expression *stack_value(struct expression *expr)
+{
+	if (expr)
+		expr->vm_type = mimic_stack_type(expr->vm_type);
+
+	return expr;
+}
+
+static enum binary_operator binop(unsigned char opc)
+{
+	switch (opc) {
+	case OPC_IADD:
+	case OPC_LADD:
+		return OP_ADD;
+	case OPC_ISUB:
+	case OPC_LSUB:
+		return OP_SUB;
+	case OPC_IMUL:
+		return OP_MUL;
+	case OPC_IAND:
+	case OPC_LAND:
+		return OP_AND;
+	case OPC_IOR:
+	case OPC_LOR:
+		return OP_OR;
+	default:
+		return OP_XOR;
+	}
+}
+
+static struct expression *const_expr(const unsigned char *code, unsigned long pc)
+{
+	unsigned char opc = code[pc];
+
+	switch (opc) {
+	case OPC_ACONST_NULL:
+		return value_expr(J_REFERENCE, 0);
+	case OPC_ICONST_M1 ... OPC_ICONST_5:
+		return value_expr(J_INT, opc - OPC_ICONST_0);
+	case OPC_LCONST_0:
+	case OPC_LCONST_1:
+		return value_expr(J_LONG, opc - OPC_LCONST_0);
+	case OPC_FCONST_0 ... OPC_FCONST_2:
+		return fvalue_expr(J_FLOAT, opc - OPC_FCONST_0);
+	case OPC_DCONST_0:
+	case OPC_DCONST_1:
+		return fvalue_expr(J_DOUBLE, opc - OPC_DCONST_0);
+	case OPC_BIPUSH:
+		return value_expr(J_INT, (int8_t) code[pc + 1]);
+	default:
+		return value_expr(J_INT, read_s16(&code[pc + 1]));
+	}
+}
+
+/*
+ * Converts the body of @vmm with arguments @values, one expression per
+ * argument, and returns the return value in @result.
+ */
+static int convert_inline_body(struct parse_context *ctx, struct vm_method *vmm,
+			       struct expression **values, struct expression **result)
+{
+	struct cafebabe_code_attribute *code_attribute = &vmm->code_attribute;
+	unsigned int nr_slots = method_nr_arg_slots(vmm);
+	struct expression *stack[code_attribute->max_stack + 1];
+	struct expression *slots[nr_slots + 1];
+	const unsigned char *code = code_attribute->code;
+	struct vm_method_arg *arg;
+	unsigned int slot = 0;
+	unsigned long pc = 0;
+	unsigned int sp = 0;
+	unsigned int i = 0;
+	int err = 0;
+
+	*result = NULL;
+
+	ctx->cu->nr_inlined_bytes += code_attribute->code_length;
+
+	if (!vm_method_is_static(vmm))
+		slots[slot++] = get_pure_expr(ctx, values[i++]);
+
+	list_for_each_entry(arg, &vmm->args, list_node) {
+		enum vm_type type = arg->type_info.vm_type;
+
+		slots[slot++] = get_pure_expr(ctx, values[i++]);
+		if (type == J_LONG || type == J_DOUBLE)
+			slots[slot++] = NULL;
+	}
+
+	if (!vm_method_is_static(vmm)) {
+		err = null_check_receiver(ctx, slots[0]);
+		if (err)
+			goto out;
+	}
+
+	while (pc < code_attribute->code_length) {
+		unsigned char opc = code[pc];
+		struct expression *value, *left, *right;
+		struct vm_method *target;
+		struct vm_field *vmf;
+
+		switch (opc) {
+		case OPC_NOP:
+			break;
+		case OPC_ILOAD:
+		case OPC_LLOAD:
+		case OPC_FLOAD:
+		case OPC_DLOAD:
+		case OPC_ALOAD:
+		case OPC_ILOAD_0 ... OPC_ALOAD_3:
+			stack[sp++] = expr_get(slots[load_index(code, pc)]);
+			break;
+		case OPC_ACONST_NULL:
+		case OPC_ICONST_M1 ... OPC_DCONST_1:
+		case OPC_BIPUSH:
+		case OPC_SIPUSH:
+			value = const_expr(code, pc);
+			if (!value)
+				goto out_of_memory;
+
+			stack[sp++] = value;
+			break;
+		case OPC_IADD:
+		case OPC_ISUB:
+		case OPC_IMUL:
+		case OPC_IAND:
+		case OPC_IOR:
+		case OPC_IXOR:
+		case OPC_LADD:
+		case OPC_LSUB:
+		case OPC_LAND:
+		case OPC_LOR:
+		case OPC_LXOR:
+			right = stack[--sp];
+			left = stack[--sp];
+
+			value = binop_expr(left->vm_type, binop(opc), left, right);
+			if (!value)
+				goto out_of_memory;
+
+			stack[sp++] = value;
+			break;
+		case OPC_GETFIELD:
+			vmf = vm_class_resolve_field_recursive(vmm->class, read_u16(&code[pc + 1]));
+
+			value = instance_field_expr(vm_field_type(vmf), vmf, stack[--sp]);
+			if (!value)
+				goto out_of_memory;
+
+			stack[sp++] = stack_value(dup_expr(ctx, value));
+			break;
+		case OPC_PUTFIELD:
+			vmf = vm_class_resolve_field_recursive(vmm->class, read_u16(&code[pc + 1]));
+
+			value = stack[--sp];
+			err = convert_store(ctx, instance_field_expr(vm_field_type(vmf), vmf, stack[--sp]), value);
+			if (err)
+				goto out;
+			break;
+		case OPC_GETSTATIC:
+			vmf = vm_class_resolve_field_recursive(vmm->class, read_u16(&code[pc + 1]));
+
+			value = class_field_expr(vm_field_type(vmf), vmf);
+			if (!value)
+				goto out_of_memory;
+
+			stack[sp++] = stack_value(dup_expr(ctx, value));
+			break;
+		case OPC_PUTSTATIC:
+			vmf = vm_class_resolve_field_recursive(vmm->class, read_u16(&code[pc + 1]));
+
+			err = convert_store(ctx, class_field_expr(vm_field_type(vmf), vmf), stack[--sp]);
+			if (err)
+				goto out;
+			break;
+		case OPC_INVOKESTATIC:
+		case OPC_INVOKESPECIAL:
+		case OPC_INVOKEVIRTUAL:
+			target = resolve_invoke_target(vmm, opc, read_u16(&code[pc + 1]));
+
+			sp -= method_nr_arg_values(target);
+
+			err = convert_inline_body(ctx, target, &stack[sp], &value);
+			if (err)
+				goto out;
+
+			if (value)
+				stack[sp++] = value;
+			break;
+		case OPC_IRETURN:
+		case OPC_LRETURN:
+		case OPC_FRETURN:
+		case OPC_DRETURN:
+		case OPC_ARETURN:
+			*result = stack[--sp];
+			goto out;
+		case OPC_RETURN:
+			goto out;
+		default:
+			error("unexpected opcode %d in inlined method", opc);
+		}
+
+		pc += bc_insn_size(code, pc);
+	}
+
+	goto out;
+
+out_of_memory:
+	warn("out of memory");
+	err = -ENOMEM;
+out:
+	for (i = 0; i < nr_slots; i++) {
+		if (slots[i])
+			expr_put(slots[i]);
+	}
+
+	return err;
+}
+
+/**
+ * inline_invoke - inlines a call to @target into the current basic block
+ *
+ * The arguments are popped from the mimic stack and the return value, if
+ * any, is pushed to it. The caller must have checked the call with
+ * can_inline().
+ */
+int inline_invoke(struct parse_context *ctx, struct vm_method *target)
+{
+	unsigned int nr_values = method_nr_arg_values(target);
+	struct expression *values[nr_values + 1];
+	struct expression *result;
+	int err;
+
+	for (unsigned int i = nr_values; i > 0; i--)
+		values[i - 1] = stack_pop(ctx->bb->mimic_stack);
+
+	err = convert_inline_body(ctx, target, values, &result);
+	if (err)
+		return err;
+
+	if (result)
+		convert_expression(ctx, result);
+
+	return 0;
+}
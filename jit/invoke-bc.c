@@ -13,6 +13,8 @@
 #include "jit/statement.h"
 #include "jit/compiler.h"
 #include "jit/args.h"
+#include "jit/cha.h"
+#include "jit/inline.h"
 
 #include "vm/bytecode.h"
 #include "vm/method.h"
@@ -232,16 +234,53 @@ failed:
 	return err;
 }
 
+/*
+ * Converts invokevirtual of a method that is not overridden by any loaded
+ * class to a direct call like invokespecial. See jit/cha.c for details.
+ */
+static int convert_devirtualized_invoke(struct parse_context *ctx,
+					struct vm_method *invoke_target,
+					bool cha_dependent)
+{
+	struct statement *stmt;
+	int err;
+
+	stmt = invoke_stmt(ctx, STMT_INVOKE, invoke_target);
+	if (!stmt)
+		return warn("out of memory"), -ENOMEM;
+
+	stmt->cha_dependent = cha_dependent;
+
+	err = convert_and_add_args(ctx, invoke_target, stmt);
+	if (err)
+		goto failed;
+
+	null_check_this_arg(to_expr(stmt->args_list));
+
+	insert_invoke_stmt(ctx, stmt);
+	return 0;
+      failed:
+	free_statement(stmt);
+	return err;
+}
+
 int convert_invokevirtual(struct parse_context *ctx)
 {
 	struct vm_method *invoke_target;
 	struct statement *stmt;
+	bool cha_dependent;
 	int err = -ENOMEM;
 
 	invoke_target = resolve_invoke_target(ctx, 0);
 	if (!invoke_target)
 		return warn("unable to resolve invocation target"), -EINVAL;
 
+	if (can_inline(ctx->cu, invoke_target, OPC_INVOKEVIRTUAL))
+		return inline_invoke(ctx, invoke_target);
+
+	if (cha_can_devirtualize(invoke_target, &cha_dependent))
+		return convert_devirtualized_invoke(ctx, invoke_target, cha_dependent);
+
 	stmt = invoke_stmt(ctx, STMT_INVOKEVIRTUAL, invoke_target);
 	if (!stmt)
 		return warn("out of memory"), -ENOMEM;
@@ -267,6 +306,9 @@ int convert_invokespecial(struct parse_context *ctx)
 	if (!invoke_target)
 		return warn("unable to resolve invocation target"), -EINVAL;
 
+	if (can_inline(ctx->cu, invoke_target, OPC_INVOKESPECIAL))
+		return inline_invoke(ctx, invoke_target);
+
 	stmt = invoke_stmt(ctx, STMT_INVOKE, invoke_target);
 	if (!stmt)
 		return warn("out of memory"), -ENOMEM;
@@ -294,6 +336,9 @@ int convert_invokestatic(struct parse_context *ctx)
 	if (!invoke_target)
 		return warn("unable to resolve invocation target"), -EINVAL;
 
+	if (can_inline(ctx->cu, invoke_target, OPC_INVOKESTATIC))
+		return inline_invoke(ctx, invoke_target);
+
 	stmt = invoke_stmt(ctx, STMT_INVOKE, invoke_target);
 	if (!stmt)
 		return warn("out of memory"), -ENOMEM;
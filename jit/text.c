@@ -30,27 +30,468 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdio.h>
 
 #include "arch/text.h"
 #include "jit/text.h"
 
+#include "lib/list.h"
+
 #include "vm/system.h"
 #include "vm/alloc.h"
 #include "vm/die.h"
 
 #define MAX_TEXT_SIZE (256 * 1024 * 1024) /* 256 MB */
 
+/*
+ * Machine code is emitted to per-thread chunks of the text region so that
+ * threads compiling unrelated methods don't serialize on a global lock.
+ * The lock is only taken to carve a new chunk from the region or to take
+ * over a chunk from the pool of partially used chunks. The page after
+ * each chunk is left inaccessible so that overrunning a chunk faults
+ * instead of corrupting code of another thread. Stubs are emitted by
+ * every thread but are small and quick to emit, so they go to a chunk
+ * shared by all threads under the lock instead.
+ */
+#define TEXT_CHUNK_SIZE (1024 * 1024) /* 1 MB */
+
+/*
+ * Trampolines and inline cache stubs are small and are emitted by every
+ * thread that links classes or runs call sites so their chunks are only
+ * a few pages. Otherwise the space reserved for them would grow with the
+ * number of threads rather than with the amount of code.
+ */
+#define TEXT_STUB_CHUNK_SIZE (16 * 1024) /* 16 KB */
+
+/*
+ * Chunks with less free space than this are retired instead of being put
+ * back to the pool when their thread moves on to another chunk.
+ */
+#define TEXT_CHUNK_MIN_FREE 4096
+
+enum text_chunk_state {
+	CHUNK_OWNED,		/* current chunk of a thread */
+	CHUNK_POOLED,		/* waiting in the pool for a thread */
+	CHUNK_RETIRED,		/* full, only waiting for its code to be freed */
+};
+
+struct text_segment;
+
+struct jit_text_chunk {
+	struct text_segment	*segment;
+	void			*start;
+	unsigned long		size;
+
+	/*
+	 * Bytes handed out including alignment padding, bytes of emitted
+	 * code and number of allocations. These are only updated by the
+	 * thread that owns the chunk or with jit_text_mutex held for shared
+	 * chunks.
+	 */
+	unsigned long		used;
+	unsigned long		code_size;
+	unsigned long		nr_allocs;
+
+	/* Same as above for freed code, protected by jit_text_mutex. */
+	unsigned long		freed;
+	unsigned long		freed_code_size;
+	unsigned long		nr_frees;
+
+	/*
+	 * Same as above for code emitted to freed space of the chunk,
+	 * protected by jit_text_mutex. See take_free_block().
+	 */
+	unsigned long		reused;
+	unsigned long		reused_code_size;
+	unsigned long		nr_reuses;
+
+	enum text_chunk_state	state;
+
+	struct list_head	list_node;
+	struct list_head	pool_node;
+};
+
+/*
+ * Freed space of a chunk that is not at its end. Adjacent free blocks are
+ * merged.
+ */
+struct text_block {
+	struct jit_text_chunk	*chunk;
+	void			*start;
+	unsigned long		size;
+
+	struct list_head	list_node;
+};
+
+/*
+ * The text region is split into segments so that method bodies, which
+ * live as long as their class, are not interleaved with short-lived
+ * inline cache stubs. Freed code goes to the free list of its segment
+ * from which new code is emitted first. A chunk whose code has all been
+ * freed is reset and put back to the pool of its segment.
+ */
+struct text_segment {
+	const char		*name;
+	void			*start;
+	unsigned long		size;
+
+	/* Size of the chunks carved for threads emitting to the segment. */
+	unsigned long		chunk_size;
+
+	/*
+	 * Set for segments whose code is emitted by all threads to one
+	 * chunk, 'shared_chunk', with jit_text_mutex held from
+	 * jit_text_begin() to jit_text_end().
+	 */
+	bool			shared;
+	struct jit_text_chunk	*shared_chunk;
+
+	/* End of the part of the segment that has been carved into chunks. */
+	unsigned long		offset;
+
+	struct list_head	chunks;
+	struct list_head	pool;
+
+	/* Free blocks sorted by address, protected by jit_text_mutex. */
+	struct list_head	free_blocks;
+	unsigned long		nr_free_blocks;
+
+	unsigned long		nr_frees;
+	unsigned long		freed_size;
+};
+
+static struct text_segment segments[NR_JIT_TEXT_SEGMENTS] = {
+	[JIT_TEXT_METHODS] = {
+		.name		= "methods",
+		.size		= 192 * 1024 * 1024,
+		.chunk_size	= TEXT_CHUNK_SIZE,
+	},
+	[JIT_TEXT_STUBS] = {
+		.name		= "stubs",
+		.size		= 32 * 1024 * 1024,
+		.chunk_size	= TEXT_STUB_CHUNK_SIZE,
+		.shared		= true,
+	},
+	[JIT_TEXT_IC_STUBS] = {
+		.name		= "inline cache stubs",
+		.size		= 32 * 1024 * 1024,
+		.chunk_size	= TEXT_STUB_CHUNK_SIZE,
+		.shared		= true,
+	},
+};
+
+/*
+ * Code that is no longer reachable but might still be executed by some
+ * thread. See jit_text_retire().
+ */
+struct retired_code {
+	void			*start;
+	unsigned long		size;
+	void			(*release)(void *);
+	void			*data;
+
+	/* Set when no thread was found to execute the code. */
+	bool			dead;
+
+	struct list_head	list_node;
+};
+
+/* Protects the segments, the chunk lists and retired_code_list. */
 static pthread_mutex_t jit_text_mutex = PTHREAD_MUTEX_INITIALIZER;
-static unsigned long jit_text_offset;
 static void *jit_text;
 
+static struct list_head retired_code_list = LIST_HEAD_INIT(retired_code_list);
+static unsigned long nr_retired;
+
+static pthread_key_t jit_text_chunk_key;
+
+static __thread struct jit_text_chunk *current_chunks[NR_JIT_TEXT_SEGMENTS];
+static __thread struct jit_text_chunk *current_chunk;
+static __thread struct text_block *current_block;
+static __thread struct text_segment *current_segment;
+static __thread unsigned long current_reservation;
+
+static unsigned long chunk_free_space(struct jit_text_chunk *chunk)
+{
+	return chunk->size - chunk->used;
+}
+
+static bool chunk_is_empty(struct jit_text_chunk *chunk)
+{
+	return chunk->freed == chunk->used + chunk->reused;
+}
+
+static bool block_in_chunk(struct text_block *block, struct jit_text_chunk *chunk)
+{
+	return block->start >= chunk->start && block->start < chunk->start + chunk->size;
+}
+
+static void free_block(struct text_block *block)
+{
+	list_del(&block->list_node);
+	block->chunk->segment->nr_free_blocks--;
+	free(block);
+}
+
+/*
+ * Must be called with jit_text_mutex held.
+ */
+static void reset_chunk(struct jit_text_chunk *chunk)
+{
+	struct text_block *block, *next;
+
+	/* The free blocks of an emptied chunk are part of its free end now. */
+	if (chunk->freed) {
+		list_for_each_entry_safe(block, next, &chunk->segment->free_blocks, list_node) {
+			if (block_in_chunk(block, chunk))
+				free_block(block);
+		}
+	}
+
+	chunk->used		= 0;
+	chunk->code_size	= 0;
+	chunk->nr_allocs	= 0;
+	chunk->freed		= 0;
+	chunk->freed_code_size	= 0;
+	chunk->nr_frees		= 0;
+	chunk->reused		= 0;
+	chunk->reused_code_size	= 0;
+	chunk->nr_reuses	= 0;
+}
+
+/*
+ * Adds @size bytes at @start to the free list of the segment of @chunk
+ * and merges it with adjacent free blocks of the same chunk. Must be
+ * called with jit_text_mutex held.
+ */
+static void add_free_block(struct jit_text_chunk *chunk, void *start, unsigned long size)
+{
+	struct text_segment *segment = chunk->segment;
+	struct text_block *block, *prev = NULL, *next = NULL;
+
+	list_for_each_entry(block, &segment->free_blocks, list_node) {
+		if (block->start > start) {
+			next = block;
+			break;
+		}
+		prev = block;
+	}
+
+	if (prev && prev->chunk == chunk && prev->start + prev->size == start) {
+		prev->size += size;
+
+		if (next && next->chunk == chunk && start + size == next->start) {
+			prev->size += next->size;
+			free_block(next);
+		}
+		return;
+	}
+
+	if (next && next->chunk == chunk && start + size == next->start) {
+		next->start = start;
+		next->size += size;
+		return;
+	}
+
+	block = malloc(sizeof *block);
+	if (!block) {
+		/* Leak the space. */
+		return;
+	}
+
+	block->chunk	= chunk;
+	block->start	= start;
+	block->size	= size;
+
+	if (next)
+		list_add_tail(&block->list_node, &next->list_node);
+	else
+		list_add_tail(&block->list_node, &segment->free_blocks);
+
+	segment->nr_free_blocks++;
+}
+
+/*
+ * Takes the first free block of @segment that has room for @size bytes
+ * off the free list. The block is accounted as reused space of its chunk
+ * until jit_text_end() gives back what was not used. Must be called with
+ * jit_text_mutex held.
+ */
+static struct text_block *take_free_block(struct text_segment *segment, unsigned long size)
+{
+	struct text_block *block;
+
+	list_for_each_entry(block, &segment->free_blocks, list_node) {
+		if (block->size < size)
+			continue;
+
+		list_del(&block->list_node);
+		segment->nr_free_blocks--;
+
+		block->chunk->reused += block->size;
+
+		return block;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns a chunk that is no longer used by its thread to the pool so
+ * that another thread can fill it up. Must be called with jit_text_mutex
+ * held.
+ */
+static void release_chunk(struct jit_text_chunk *chunk)
+{
+	if (chunk_is_empty(chunk))
+		reset_chunk(chunk);
+
+	if (chunk_free_space(chunk) < TEXT_CHUNK_MIN_FREE) {
+		chunk->state = CHUNK_RETIRED;
+		return;
+	}
+
+	chunk->state = CHUNK_POOLED;
+	list_add_tail(&chunk->pool_node, &chunk->segment->pool);
+}
+
+static void jit_text_chunk_destructor(void *p)
+{
+	struct jit_text_chunk **chunks = p;
+	unsigned int i;
+
+	pthread_mutex_lock(&jit_text_mutex);
+
+	for (i = 0; i < NR_JIT_TEXT_SEGMENTS; i++) {
+		if (chunks[i])
+			release_chunk(chunks[i]);
+	}
+
+	pthread_mutex_unlock(&jit_text_mutex);
+}
+
+/*
+ * Carves a chunk of at least @size bytes from the unused end of @segment.
+ * When the segment can't fit a whole chunk anymore, the chunk is shrunk
+ * to what is left. Returns NULL if not even @size bytes are left.
+ */
+static struct jit_text_chunk *
+carve_chunk(struct text_segment *segment, unsigned long size)
+{
+	struct jit_text_chunk *chunk;
+	unsigned long chunk_size;
+	unsigned long page_size;
+	unsigned long left;
+
+	page_size = getpagesize();
+	size = ALIGN(size, page_size);
+
+	segment->offset = ALIGN(segment->offset, page_size);
+
+	left = 0;
+	if (segment->offset + page_size < segment->size)
+		left = segment->size - segment->offset - page_size;
+
+	if (size > left)
+		return NULL;
+
+	chunk_size = ALIGN(segment->chunk_size, page_size);
+	if (size < chunk_size)
+		size = min(chunk_size, left);
+
+	chunk = malloc(sizeof *chunk);
+	if (!chunk)
+		die("out of memory");
+
+	chunk->segment		= segment;
+	chunk->start		= segment->start + segment->offset;
+	chunk->size		= size;
+	chunk->state		= CHUNK_OWNED;
+
+	reset_chunk(chunk);
+
+	if (mprotect(chunk->start + size, page_size, PROT_NONE))
+		die("mprotect");
+
+	segment->offset += size + page_size;
+
+	list_add_tail(&chunk->list_node, &segment->chunks);
+
+	return chunk;
+}
+
+static struct jit_text_chunk *
+get_chunk(struct text_segment *segment, unsigned long size)
+{
+	struct jit_text_chunk *chunk;
+
+	list_for_each_entry(chunk, &segment->pool, pool_node) {
+		if (chunk_free_space(chunk) >= size) {
+			list_del(&chunk->pool_node);
+			chunk->state = CHUNK_OWNED;
+			return chunk;
+		}
+	}
+
+	chunk = carve_chunk(segment, size);
+	if (chunk)
+		return chunk;
+
+	/*
+	 * The segment is used up. Fall back to the tails of retired chunks
+	 * which are too small to be pooled but might still fit the code.
+	 */
+	list_for_each_entry(chunk, &segment->chunks, list_node) {
+		if (chunk->state == CHUNK_RETIRED && chunk_free_space(chunk) >= size) {
+			chunk->state = CHUNK_OWNED;
+			return chunk;
+		}
+	}
+
+	die("JIT text segment for %s exhausted", segment->name);
+}
+
+static void refill_chunk(enum jit_text_segment type, unsigned long size)
+{
+	pthread_mutex_lock(&jit_text_mutex);
+
+	if (current_chunks[type])
+		release_chunk(current_chunks[type]);
+
+	current_chunks[type] = get_chunk(&segments[type], size);
+
+	pthread_mutex_unlock(&jit_text_mutex);
+
+	if (pthread_setspecific(jit_text_chunk_key, current_chunks) != 0)
+		die("pthread_setspecific");
+}
+
 void jit_text_init(void)
 {
+	unsigned long offset = 0;
+	unsigned int i;
+
 	jit_text = mmap(NULL, MAX_TEXT_SIZE,
 			PROT_READ | PROT_WRITE | PROT_EXEC,
 			MAP_PRIVATE | MAP_ANONYMOUS | TEXT_MAP_FLAGS, -1, 0);
 	if (jit_text == MAP_FAILED)
 		die("mmap");
+
+	for (i = 0; i < NR_JIT_TEXT_SEGMENTS; i++) {
+		struct text_segment *segment = &segments[i];
+
+		segment->start = jit_text + offset;
+		INIT_LIST_HEAD(&segment->chunks);
+		INIT_LIST_HEAD(&segment->pool);
+		INIT_LIST_HEAD(&segment->free_blocks);
+
+		offset += segment->size;
+	}
+
+	assert(offset <= MAX_TEXT_SIZE);
+
+	if (pthread_key_create(&jit_text_chunk_key, jit_text_chunk_destructor) != 0)
+		die("pthread_key_create");
 }
 
 bool is_jit_text(void *p)
@@ -58,28 +499,419 @@ bool is_jit_text(void *p)
 	return p >= jit_text && p <= (jit_text + MAX_TEXT_SIZE);
 }
 
-void jit_text_lock(void)
+/**
+ * jit_text_begin - start emitting code to the current thread's chunk
+ * @type: segment of the text region the code is emitted to
+ * @max_size: upper bound of the size of the code that is emitted
+ *
+ * Returns a pointer to at least @max_size bytes of text. The caller
+ * must call jit_text_end() with the actual code size before emitting
+ * more code.
+ */
+void *jit_text_begin(enum jit_text_segment type, size_t max_size)
+{
+	struct text_segment *segment = &segments[type];
+	unsigned long needed;
+
+	assert(current_reservation == 0);
+
+	current_segment = segment;
+	current_reservation = max_size;
+
+	/*
+	 * Free blocks start aligned. The unlocked check avoids the lock for
+	 * segments without freed code.
+	 */
+	if (!list_is_empty(&segment->free_blocks)) {
+		pthread_mutex_lock(&jit_text_mutex);
+
+		current_block = take_free_block(segment, ALIGN(max_size, TEXT_ALIGNMENT));
+		if (current_block) {
+			if (!segment->shared)
+				pthread_mutex_unlock(&jit_text_mutex);
+
+			return current_block->start;
+		}
+
+		if (!segment->shared)
+			pthread_mutex_unlock(&jit_text_mutex);
+	} else if (segment->shared)
+		pthread_mutex_lock(&jit_text_mutex);
+
+	/* Leave room for aligning the end of the code. */
+	needed = max_size + TEXT_ALIGNMENT;
+
+	if (segment->shared) {
+		if (!segment->shared_chunk || chunk_free_space(segment->shared_chunk) < needed) {
+			if (segment->shared_chunk)
+				release_chunk(segment->shared_chunk);
+
+			segment->shared_chunk = get_chunk(segment, needed);
+		}
+
+		current_chunk = segment->shared_chunk;
+	} else {
+		if (!current_chunks[type] || chunk_free_space(current_chunks[type]) < needed)
+			refill_chunk(type, needed);
+
+		current_chunk = current_chunks[type];
+	}
+
+	return current_chunk->start + current_chunk->used;
+}
+
+/*
+ * Gives back the part of the current free block that was not used for
+ * code. Must be called with jit_text_mutex held.
+ */
+static void end_free_block(struct text_block *block, size_t size)
+{
+	struct jit_text_chunk *chunk = block->chunk;
+	unsigned long used;
+
+	used = ALIGN(size, TEXT_ALIGNMENT);
+
+	chunk->reused_code_size += size;
+	chunk->nr_reuses++;
+
+	if (block->size > used) {
+		chunk->reused -= block->size - used;
+		add_free_block(chunk, block->start + used, block->size - used);
+	}
+
+	free(block);
+}
+
+void jit_text_end(size_t size)
+{
+	struct jit_text_chunk *chunk = current_chunk;
+	struct text_block *block = current_block;
+
+	if (size > current_reservation)
+		die("emitted %zu bytes of code but reserved only %lu", size, current_reservation);
+
+	current_reservation = 0;
+	current_chunk = NULL;
+	current_block = NULL;
+
+	if (block) {
+		if (!current_segment->shared)
+			pthread_mutex_lock(&jit_text_mutex);
+
+		end_free_block(block, size);
+
+		if (!current_segment->shared)
+			pthread_mutex_unlock(&jit_text_mutex);
+	} else {
+		chunk->used += ALIGN(size, TEXT_ALIGNMENT);
+		chunk->code_size += size;
+		chunk->nr_allocs++;
+	}
+
+	if (current_segment->shared)
+		pthread_mutex_unlock(&jit_text_mutex);
+
+	current_segment = NULL;
+}
+
+static struct text_segment *text_segment_of(void *p)
+{
+	unsigned int i;
+
+	for (i = 0; i < NR_JIT_TEXT_SEGMENTS; i++) {
+		struct text_segment *segment = &segments[i];
+
+		if (p >= segment->start && p < segment->start + segment->size)
+			return segment;
+	}
+
+	return NULL;
+}
+
+static struct jit_text_chunk *text_chunk_of(void *p)
+{
+	struct text_segment *segment;
+	struct jit_text_chunk *chunk;
+
+	segment = text_segment_of(p);
+	if (!segment)
+		return NULL;
+
+	list_for_each_entry(chunk, &segment->chunks, list_node) {
+		if (p >= chunk->start && p < chunk->start + chunk->size)
+			return chunk;
+	}
+
+	return NULL;
+}
+
+/*
+ * Must be called with jit_text_mutex held.
+ */
+static void do_jit_text_free(void *start, unsigned long size)
+{
+	struct jit_text_chunk *chunk;
+
+	chunk = text_chunk_of(start);
+	if (!chunk)
+		die("freeing %p which is not JIT code", start);
+
+	chunk->freed += ALIGN(size, TEXT_ALIGNMENT);
+	chunk->freed_code_size += size;
+	chunk->nr_frees++;
+
+	chunk->segment->nr_frees++;
+	chunk->segment->freed_size += size;
+
+	add_free_block(chunk, start, ALIGN(size, TEXT_ALIGNMENT));
+
+	/*
+	 * The owner of a chunk resets it when it moves on to another chunk.
+	 * Emptied chunks that nobody owns are reset here and become
+	 * available for new code again.
+	 */
+	if (chunk->state == CHUNK_OWNED || !chunk_is_empty(chunk))
+		return;
+
+	reset_chunk(chunk);
+
+	if (chunk->state == CHUNK_RETIRED) {
+		chunk->state = CHUNK_POOLED;
+		list_add(&chunk->pool_node, &chunk->segment->pool);
+	}
+}
+
+/**
+ * jit_text_free - free code that no thread can execute anymore
+ * @start: start of the code as returned by jit_text_begin()
+ * @size: size of the code as passed to jit_text_end()
+ *
+ * Code that might still be executed by other threads must be handed to
+ * jit_text_retire() instead.
+ */
+void jit_text_free(void *start, size_t size)
+{
+	pthread_mutex_lock(&jit_text_mutex);
+	do_jit_text_free(start, size);
+	pthread_mutex_unlock(&jit_text_mutex);
+}
+
+/**
+ * jit_text_retire - free code once no thread executes it
+ * @start: start of the code as returned by jit_text_begin()
+ * @size: size of the code as passed to jit_text_end()
+ * @release: called before the code is freed, can be NULL
+ * @data: argument for @release
+ *
+ * The code must no longer be reachable, that is, all call sites and
+ * tables that pointed to it must have been updated. Threads that were
+ * already executing the code or have a frame of it on the stack are
+ * looked for by jit_text_collect() and the code is freed by
+ * jit_text_sweep() after they are gone.
+ */
+void jit_text_retire(void *start, size_t size, void (*release)(void *), void *data)
 {
-	if (pthread_mutex_lock(&jit_text_mutex) != 0)
-		die("pthread_mutex_lock");
+	struct retired_code *code;
+
+	code = malloc(sizeof *code);
+	if (!code) {
+		/* Leak the code. */
+		return;
+	}
+
+	code->start	= start;
+	code->size	= size;
+	code->release	= release;
+	code->data	= data;
+	code->dead	= false;
+
+	pthread_mutex_lock(&jit_text_mutex);
+	list_add_tail(&code->list_node, &retired_code_list);
+	nr_retired++;
+	pthread_mutex_unlock(&jit_text_mutex);
 }
 
-void jit_text_unlock(void)
+/**
+ * jit_text_collect - find retired code that is no longer executed
+ * @in_use: returns true if some thread executes code in the given range
+ *
+ * This is called by the garbage collector while all other threads are
+ * stopped. One of them might hold jit_text_mutex in which case nothing
+ * is collected until the next stop.
+ */
+void jit_text_collect(bool (*in_use)(void *start, size_t size))
 {
-	if (pthread_mutex_unlock(&jit_text_mutex) != 0)
-		die("pthread_mutex_lock");
+	struct retired_code *code;
+
+	if (pthread_mutex_trylock(&jit_text_mutex) != 0)
+		return;
+
+	list_for_each_entry(code, &retired_code_list, list_node) {
+		if (!code->dead && !in_use(code->start, code->size))
+			code->dead = true;
+	}
+
+	pthread_mutex_unlock(&jit_text_mutex);
 }
 
+/**
+ * jit_text_sweep - free retired code found dead by jit_text_collect()
+ *
+ * This must be called after the other threads have been resumed because
+ * the release functions may take locks that a stopped thread holds.
+ */
+void jit_text_sweep(void)
+{
+	struct retired_code *code, *next;
+	struct list_head dead_list;
+
+	INIT_LIST_HEAD(&dead_list);
+
+	pthread_mutex_lock(&jit_text_mutex);
+
+	list_for_each_entry_safe(code, next, &retired_code_list, list_node) {
+		if (code->dead)
+			list_move(&code->list_node, &dead_list);
+	}
+
+	pthread_mutex_unlock(&jit_text_mutex);
+
+	list_for_each_entry_safe(code, next, &dead_list, list_node) {
+		if (code->release)
+			code->release(code->data);
+
+		pthread_mutex_lock(&jit_text_mutex);
+		do_jit_text_free(code->start, code->size);
+		nr_retired--;
+		pthread_mutex_unlock(&jit_text_mutex);
+
+		list_del(&code->list_node);
+		free(code);
+	}
+}
+
+/*
+ * Returns the end of the part of the text region that has been handed
+ * out so far.
+ */
 void *jit_text_ptr(void)
 {
-	return jit_text + jit_text_offset;
+	struct text_segment *segment;
+	int i;
+
+	for (i = NR_JIT_TEXT_SEGMENTS - 1; i > 0; i--) {
+		if (segments[i].offset)
+			break;
+	}
+
+	segment = &segments[i];
+
+	return segment->start + segment->offset;
+}
+
+void *jit_text_base(void)
+{
+	return jit_text;
+}
+
+size_t jit_text_size(void)
+{
+	return MAX_TEXT_SIZE;
 }
 
+/*
+ * Reserves @size bytes directly from the method segment of the text
+ * region. This is for allocations that are not code such as the GDB
+ * symbol file.
+ */
 void jit_text_reserve(size_t size)
 {
-	jit_text_offset += ALIGN(size, TEXT_ALIGNMENT);
+	struct text_segment *segment = &segments[JIT_TEXT_METHODS];
+
+	pthread_mutex_lock(&jit_text_mutex);
+
+	segment->offset += ALIGN(size, TEXT_ALIGNMENT);
+
+	assert(segment->offset < segment->size);
+
+	pthread_mutex_unlock(&jit_text_mutex);
+}
+
+static void print_segment_stats(struct text_segment *segment)
+{
+	unsigned long total_size = 0, total_used = 0, total_code = 0, total_wasted = 0;
+	struct jit_text_chunk *chunk;
+	unsigned int nr_chunks = 0;
+
+	fprintf(stderr, "  %s: %lu KB of %lu KB handed out, %lu frees, %lu KB freed, %lu free blocks\n",
+		segment->name, segment->offset / 1024, segment->size / 1024,
+		segment->nr_frees, segment->freed_size / 1024, segment->nr_free_blocks);
+
+	list_for_each_entry(chunk, &segment->chunks, list_node) {
+		unsigned long code_size, wasted;
+
+		code_size = chunk->code_size + chunk->reused_code_size - chunk->freed_code_size;
+
+		/*
+		 * Alignment padding, free blocks that are too small for the
+		 * code emitted since they were freed and the unused tail of
+		 * retired chunks can't be used for code.
+		 */
+		wasted = chunk->used - code_size;
+		if (chunk->state == CHUNK_RETIRED)
+			wasted += chunk_free_space(chunk);
+
+		fprintf(stderr, "    chunk %p: %lu KB, %lu%% used, %lu methods and stubs, %lu bytes fragmented%s\n",
+			chunk->start, chunk->size / 1024,
+			chunk->used * 100 / chunk->size,
+			chunk->nr_allocs + chunk->nr_reuses - chunk->nr_frees,
+			wasted, chunk->state == CHUNK_RETIRED ? ", retired" : "");
+
+		nr_chunks++;
+		total_size += chunk->size;
+		total_used += chunk->used;
+		total_code += code_size;
+		total_wasted += wasted;
+	}
+
+	if (nr_chunks)
+		fprintf(stderr, "    total: %u chunks, %lu KB, %lu KB code, %lu%% used, %lu%% fragmented\n",
+			nr_chunks, total_size / 1024, total_code / 1024,
+			total_used * 100 / total_size, total_wasted * 100 / total_size);
+}
+
+/*
+ * Returns the size of the code in @type that has not been freed.
+ */
+size_t jit_text_code_size(enum jit_text_segment type)
+{
+	struct text_segment *segment = &segments[type];
+	struct jit_text_chunk *chunk;
+	size_t ret = 0;
+
+	pthread_mutex_lock(&jit_text_mutex);
+
+	list_for_each_entry(chunk, &segment->chunks, list_node)
+		ret += chunk->code_size + chunk->reused_code_size - chunk->freed_code_size;
+
+	pthread_mutex_unlock(&jit_text_mutex);
+
+	return ret;
+}
+
+void jit_text_print_stats(void)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&jit_text_mutex);
+
+	fprintf(stderr, "JIT code cache: %lu KB, %lu retired code blocks waiting to be freed\n",
+		(unsigned long) MAX_TEXT_SIZE / 1024, nr_retired);
+
+	for (i = 0; i < NR_JIT_TEXT_SEGMENTS; i++)
+		print_segment_stats(&segments[i]);
 
-	assert(jit_text_offset < MAX_TEXT_SIZE);
+	pthread_mutex_unlock(&jit_text_mutex);
 }
 
 void *alloc_pages(int n)
@@ -32,6 +32,8 @@
 #include "jit/exception.h"
 
 #include "vm/stack-trace.h"
+#include "vm/interp.h"
+#include "vm/call.h"
 #include "vm/natives.h"
 #include "vm/preload.h"
 #include "vm/method.h"
@@ -91,33 +93,21 @@ static void *jit_java_trampoline(struct compilation_unit *cu)
 	return cu_entry_point(cu);
 }
 
-void *jit_magic_trampoline(struct compilation_unit *cu)
+/**
+ * jit_compile_cu - compiles @cu unless another thread already did it
+ *
+ * Returns the entry point of the compiled method or NULL with exception
+ * signalled. Call sites are not fixed up.
+ */
+void *jit_compile_cu(struct compilation_unit *cu)
 {
-	struct vm_method *method = cu->method;
-	unsigned long state;
 	void *ret;
 
-	if (opt_trace_magic_trampoline)
-		trace_magic_trampoline(cu);
-
-	if (vm_method_is_static(method)) {
-		/* This is for "invokestatic"... */
-		if (vm_class_ensure_init(method->class))
-			return rethrow_exception();
-	}
-
-	state = compilation_unit_get_state(cu);
-
-	if (cu->state == COMPILATION_STATE_COMPILED) {
-		ret = cu_entry_point(cu);
-		goto out_fixup;
-	}
-
 	pthread_mutex_lock(&cu->compile_mutex);
 
 	if (cu->state == COMPILATION_STATE_COMPILED) {
 		ret = cu_entry_point(cu);
-		goto out_unlock_fixup;
+		goto out_unlock;
 	}
 
 	assert(cu->state == COMPILATION_STATE_INITIAL);
@@ -136,10 +126,44 @@ void *jit_magic_trampoline(struct compilation_unit *cu)
 
 	shrink_compilation_unit(cu);
 
-out_unlock_fixup:
+out_unlock:
 	pthread_mutex_unlock(&cu->compile_mutex);
 
-out_fixup:
+	return ret;
+}
+
+void *jit_magic_trampoline(struct compilation_unit *cu)
+{
+	struct vm_method *method = cu->method;
+	unsigned long state;
+	void *ret;
+
+	if (opt_trace_magic_trampoline)
+		trace_magic_trampoline(cu);
+
+	if (vm_method_is_static(method)) {
+		/* This is for "invokestatic"... */
+		if (vm_class_ensure_init(method->class))
+			return rethrow_exception();
+	}
+
+	/*
+	 * Cold methods are interpreted and their call sites are left
+	 * pointing to the trampoline until they become hot. A hot method
+	 * is compiled here or submitted to the compile queue in which
+	 * case it is interpreted until a compiler thread fixes up the
+	 * call sites.
+	 */
+	if (vm_method_should_interpret(method))
+		return (void *) interp_entry;
+
+	state = compilation_unit_get_state(cu);
+
+	if (cu->state == COMPILATION_STATE_COMPILED)
+		ret = cu_entry_point(cu);
+	else
+		ret = jit_compile_cu(cu);
+
 	if (!ret)
 		return rethrow_exception();
 
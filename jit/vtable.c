@@ -27,6 +27,7 @@
 #include "jit/vtable.h"
 #include "jit/compilation-unit.h"
 #include "vm/class.h"
+#include "vm/call.h"
 #include <stdlib.h>
 
 void vtable_init(struct vtable *vtable, unsigned int nr_methods)
@@ -55,6 +56,10 @@ void fixup_vtable(struct compilation_unit *cu, struct vm_object *this,
 	struct vm_method *vmm = cu->method;
 	int index = vmm->virtual_index;
 
+	/* The method is interpreted, see jit_magic_trampoline(). */
+	if (target == (void *) interp_entry)
+		return;
+
 	/*
 	 * A method can be invoked by invokevirtual and invokespecial. For
 	 * example, a public method p() in class A is normally invoked with
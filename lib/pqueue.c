@@ -47,7 +47,7 @@ void pqueue_free(struct pqueue *pq)
 
 static inline int pqueue_compare(unsigned long a, unsigned long b)
 {
-	return (int)(b - a);
+	return (b > a) - (b < a);
 }
 
 int pqueue_insert(struct pqueue *pq, unsigned long key, void *value)
@@ -32,20 +32,26 @@
 #include "vm/gc.h"
 #include "vm/errors.h"
 
-#include "../boehmgc/include/gc.h"
-
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdio.h>
 
 jlong native_vmruntime_free_memory(void)
 {
-	return GC_get_free_bytes();
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return stats.committed - stats.used;
 }
 
 jlong native_vmruntime_total_memory(void)
 {
-	return GC_get_heap_size();
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return stats.committed;
 }
 
 jlong native_vmruntime_max_memory(void)
@@ -50,6 +50,9 @@ void java_lang_VMSystem_arraycopy(jobject src, jint src_start, jobject dest, jin
 		vm_array_elems(src) + src_start * elem_size,
 		len * elem_size);
 
+	if (elem_type == J_REFERENCE)
+		gc_card_mark(dest);
+
 	return;
 }
 
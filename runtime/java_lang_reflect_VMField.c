@@ -473,6 +473,9 @@ void java_lang_reflect_VMField_set(struct vm_object *this, struct vm_object *o,
 		}
 
 		object_to_jvalue(field_get_object_ptr(o, vmf->offset), type, value_obj);
+
+		if (type == J_REFERENCE)
+			gc_card_mark(o);
 	}
 }
 
@@ -0,0 +1,250 @@
+/*
+ * Natives of the java.lang.management memory and garbage collector beans
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "runtime/memory-management.h"
+
+#include "vm/classloader.h"
+#include "vm/preload.h"
+#include "vm/object.h"
+#include "vm/errors.h"
+#include "vm/class.h"
+#include "vm/call.h"
+#include "vm/gc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The VM has one memory pool, the Java heap, which is managed by one
+ * garbage collector. The collector is named after the GC that is in use,
+ * see struct gc_stats.
+ */
+#define HEAP_POOL_NAME		"Heap"
+
+static struct vm_method *memory_usage_init;
+
+static struct vm_object *string_array(const char *s)
+{
+	struct vm_object *array, *string;
+
+	array = vm_object_alloc_array(vm_array_of_java_lang_String, s ? 1 : 0);
+	if (!array || !s)
+		return array;
+
+	string = vm_object_alloc_string_from_c(s);
+	if (!string)
+		return NULL;
+
+	array_set_field_ptr(array, 0, string);
+
+	return array;
+}
+
+static bool string_equals(struct vm_object *string, const char *s)
+{
+	bool ret;
+	char *cstr;
+
+	if (!string)
+		return false;
+
+	cstr = vm_string_to_cstr(string);
+	if (!cstr)
+		return false;
+
+	ret = !strcmp(cstr, s);
+	free(cstr);
+
+	return ret;
+}
+
+static bool is_heap_pool(struct vm_object *name)
+{
+	return string_equals(name, HEAP_POOL_NAME);
+}
+
+static bool is_collector(struct vm_object *name)
+{
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return string_equals(name, stats.name);
+}
+
+static unsigned int pack_jlong(unsigned long *args, unsigned int idx, jlong value)
+{
+	memcpy(&args[idx], &value, sizeof(value));
+
+	return idx + sizeof(value) / sizeof(unsigned long);
+}
+
+static struct vm_object *
+new_memory_usage(jlong init, jlong used, jlong committed, jlong max)
+{
+	unsigned long args[1 + 4 * sizeof(jlong) / sizeof(unsigned long)];
+	struct vm_object *result;
+	struct vm_class *vmc;
+	unsigned int idx = 1;
+
+	if (!memory_usage_init) {
+		vmc = classloader_load(NULL, "java/lang/management/MemoryUsage");
+		if (!vmc || vm_class_ensure_init(vmc))
+			return rethrow_exception();
+
+		memory_usage_init = vm_class_get_method(vmc, "<init>", "(JJJJ)V");
+		if (!memory_usage_init)
+			return throw_internal_error();
+	}
+
+	result = vm_object_alloc(memory_usage_init->class);
+	if (!result)
+		return rethrow_exception();
+
+	args[0] = (unsigned long) result;
+	idx = pack_jlong(args, idx, init);
+	idx = pack_jlong(args, idx, used);
+	idx = pack_jlong(args, idx, committed);
+	pack_jlong(args, idx, max);
+
+	vm_call_method_a(memory_usage_init, args, NULL);
+
+	return result;
+}
+
+jobject native_vmmanagementfactory_get_memory_pool_names(void)
+{
+	return string_array(HEAP_POOL_NAME);
+}
+
+jobject native_vmmanagementfactory_get_memory_manager_names(void)
+{
+	/* The collector is reported as a garbage collector bean. */
+	return string_array(NULL);
+}
+
+jobject native_vmmanagementfactory_get_garbage_collector_names(void)
+{
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return string_array(stats.name);
+}
+
+jint native_vmmemorymxbeanimpl_get_object_pending_finalization_count(void)
+{
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return stats.nr_pending_finalizers;
+}
+
+jboolean native_vmmemorymxbeanimpl_is_verbose(void)
+{
+	return verbose_gc;
+}
+
+void native_vmmemorymxbeanimpl_set_verbose(jboolean verbose)
+{
+	verbose_gc = verbose;
+}
+
+jobject native_vmmemorypoolmxbeanimpl_get_usage(jobject name)
+{
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return new_memory_usage(0, stats.used, stats.committed, stats.max);
+}
+
+jobject native_vmmemorypoolmxbeanimpl_get_peak_usage(jobject name)
+{
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return new_memory_usage(0, stats.peak_used, stats.committed, stats.max);
+}
+
+jobject native_vmmemorypoolmxbeanimpl_get_collection_usage(jobject name)
+{
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return new_memory_usage(0, stats.used_after_gc, stats.committed_after_gc, stats.max);
+}
+
+void native_vmmemorypoolmxbeanimpl_reset_peak_usage(jobject name)
+{
+	gc_reset_peak();
+}
+
+jobject native_vmmemorypoolmxbeanimpl_get_type(jobject name)
+{
+	return vm_object_alloc_string_from_c("HEAP");
+}
+
+jboolean native_vmmemorypoolmxbeanimpl_is_valid(jobject name)
+{
+	return is_heap_pool(name);
+}
+
+jobject native_vmmemorypoolmxbeanimpl_get_memory_manager_names(jobject name)
+{
+	return native_vmmanagementfactory_get_garbage_collector_names();
+}
+
+jboolean native_vmmemorymanagermxbeanimpl_is_valid(jobject name)
+{
+	return is_collector(name);
+}
+
+jobject native_vmmemorymanagermxbeanimpl_get_memory_pool_names(jobject name)
+{
+	return native_vmmanagementfactory_get_memory_pool_names();
+}
+
+jlong native_vmgarbagecollectormxbeanimpl_get_collection_count(jobject name)
+{
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return stats.nr_collections;
+}
+
+jlong native_vmgarbagecollectormxbeanimpl_get_collection_time(jobject name)
+{
+	struct gc_stats stats;
+
+	gc_get_stats(&stats);
+
+	return stats.total_pause_us / 1000;
+}
@@ -63,7 +63,7 @@ struct vm_object *native_vmstackwalker_getclasscontext(void)
 	idx = 0;
 
 	for (i = 0; i < depth; i++, stack_trace_elem_next_java(&st_elem)) {
-		cu = jit_lookup_cu(st_elem.addr);
+		cu = stack_trace_elem_get_cu(&st_elem);
 		if (!cu)
 			error("no compilation_unit mapping for %lx", st_elem.addr);
 
@@ -136,6 +136,8 @@ void sun_misc_Unsafe_putObject(jobject this, jobject obj, jlong offset, jobject
 	struct vm_object **value_p = (void *) obj + offset;
 
 	*value_p	= value;
+
+	gc_card_mark(obj);
 }
 
 void sun_misc_Unsafe_putObjectVolatile(jobject this, jobject obj, jlong offset, jobject value)
@@ -145,6 +147,8 @@ void sun_misc_Unsafe_putObjectVolatile(jobject this, jobject obj, jlong offset,
 	mb();
 
 	*value_p	= value;
+
+	gc_card_mark(obj);
 }
 
 jint native_unsafe_compare_and_swap_int(struct vm_object *this,
@@ -173,7 +177,12 @@ jint native_unsafe_compare_and_swap_object(struct vm_object *this,
 {
 	void *p = (void *) obj + offset;
 
-	return cmpxchg_ptr(p, expect, update) == expect;
+	if (cmpxchg_ptr(p, expect, update) != expect)
+		return 0;
+
+	gc_card_mark(obj);
+
+	return 1;
 }
 
 void native_unsafe_park(struct vm_object *this, jboolean isAbsolute,
@@ -21,6 +21,8 @@ save_signal_registers(struct register_state *regs, mcontext_t *mcontext)
 	regs->edx	= gregs[REG_EDX];
 	regs->esi	= gregs[REG_ESI];
 	regs->edi	= gregs[REG_EDI];
+	regs->sp	= gregs[REG_ESP];
+	regs->bp	= gregs[REG_EBP];
 }
 
 #endif /* X86_SIGNAL_32_H */
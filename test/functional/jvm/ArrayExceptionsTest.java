@@ -199,6 +199,128 @@ public class ArrayExceptionsTest extends TestCase {
         assertTrue(caught);
     }
 
+    public static void testArrayBoundsCheckInLoop() {
+        int array[] = { 1, 2, 3, 4 };
+        int sum = 0;
+        int i = 0;
+
+        try {
+            for (;;)
+                sum += array[i++];
+        } catch (ArrayIndexOutOfBoundsException e) {
+            assertEquals(10, sum);
+            assertEquals(5, i);
+            return;
+        }
+    }
+
+    public static void testCountedLoopKeepsOtherBoundsChecks() {
+        int array[] = new int[4];
+        boolean caught = false;
+
+        for (int i = 0; i < array.length; i++)
+            array[i] = i;
+
+        try {
+            for (int i = 0; i < array.length; i++)
+                array[i + 1] = array[i];
+        } catch (ArrayIndexOutOfBoundsException e) {
+            caught = true;
+        }
+
+        assertTrue(caught);
+        assertEquals(0, array[3]);
+    }
+
+    public static void testEliminatedCheckKeepsOutOfRangeAccessInSameLoop() {
+        int a[] = { 1, 2, 3, 4 };
+        int b[] = new int[3];
+        boolean caught = false;
+        int sum = 0;
+        int i = 0;
+
+        try {
+            for (i = 0; i < a.length; i++) {
+                /* Both checks of a[i] are covered by the loop test. */
+                sum += a[i];
+                b[i] = a[i];
+            }
+        } catch (ArrayIndexOutOfBoundsException e) {
+            caught = true;
+        }
+
+        assertTrue(caught);
+        assertEquals(3, i);
+        assertEquals(10, sum);
+        assertEquals(3, b[2]);
+    }
+
+    /*
+     * Both checks test the same registers so they share their stub. Each
+     * exception must still be caught by the handler around its own check
+     * and carry the index of that check.
+     */
+    private static int loadFromEither(int[] array, int i, int j) {
+        try {
+            return array[i];
+        } catch (ArrayIndexOutOfBoundsException e) {
+            assertEquals(i + " > 1", e.getMessage());
+        }
+
+        try {
+            return array[j];
+        } catch (ArrayIndexOutOfBoundsException e) {
+            assertEquals(j + " > 1", e.getMessage());
+            return -1;
+        }
+    }
+
+    public static void testSharedBoundsCheckStub() {
+        int[] array = new int[] { 1, 2 };
+
+        assertEquals(1, loadFromEither(array, 0, 1));
+        assertEquals(2, loadFromEither(array, 2, 1));
+        assertEquals(-1, loadFromEither(array, 3, -1));
+    }
+
+    /*
+     * With -Xssa the check of array[k] at the start of the loop is moved in
+     * front of the loop. It must still throw before the first iteration has
+     * any effect.
+     */
+    private static int sumElementTimes(int[] array, int k, int n) {
+        int sum = 0;
+        int i = 0;
+
+        try {
+            do {
+                sum += array[k];
+            } while (++i < n);
+        } catch (ArrayIndexOutOfBoundsException e) {
+            assertEquals(k + " > " + (array.length - 1), e.getMessage());
+            return -1 - sum;
+        }
+
+        return sum;
+    }
+
+    public static void testHoistedBoundsCheck() {
+        int[] array = new int[] { 1, 2, 3 };
+        boolean caught = false;
+
+        assertEquals(6, sumElementTimes(array, 1, 3));
+        assertEquals(-1, sumElementTimes(array, 3, 3));
+        assertEquals(-1, sumElementTimes(array, -1, 3));
+
+        try {
+            sumElementTimes(null, 0, 1);
+        } catch (NullPointerException e) {
+            caught = true;
+        }
+
+        assertTrue(caught);
+    }
+
     public static void main(String args[]) {
         testArrayLoad();
         testArrayStore();
@@ -207,5 +329,10 @@ public class ArrayExceptionsTest extends TestCase {
         testNewarrayThrowsNegativeArraySizeException();
         testMultianewarrayThrowsNegativeArraySizeException();
         testArrayBoundsCheck();
+        testArrayBoundsCheckInLoop();
+        testCountedLoopKeepsOtherBoundsChecks();
+        testEliminatedCheckKeepsOutOfRangeAccessInSameLoop();
+        testSharedBoundsCheckStub();
+        testHoistedBoundsCheck();
     }
 }
@@ -0,0 +1,55 @@
+package jvm;
+
+public class DevirtualizationTest extends TestCase {
+    static class Base {
+        int value() { return 1; }
+        int twice() { return value() * 2; }
+    }
+
+    static class Middle extends Base {
+    }
+
+    static class Derived extends Middle {
+        int value() { return 3; }
+    }
+
+    static int callValue(Base base) {
+        return base.value();
+    }
+
+    /*
+     * Derived is linked when this method is compiled which happens on
+     * the first call, after the call sites of Base.value() have been
+     * compiled as direct calls.
+     */
+    static Base newDerived() {
+        return new Derived();
+    }
+
+    public static void testOverrideLinkedLater() {
+        Base middle = new Middle();
+
+        assertEquals(1, callValue(middle));
+        assertEquals(2, middle.twice());
+
+        Base derived = newDerived();
+
+        assertEquals(3, callValue(derived));
+        assertEquals(6, derived.twice());
+        assertEquals(1, callValue(middle));
+        assertEquals(2, middle.twice());
+    }
+
+    public static void testNullReceiver() {
+        try {
+            callValue(null);
+            fail();
+        } catch (NullPointerException e) {
+        }
+    }
+
+    public static void main(String[] args) {
+        testOverrideLinkedLater();
+        testNullReceiver();
+    }
+}
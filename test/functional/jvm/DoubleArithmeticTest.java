@@ -138,6 +138,27 @@ public class DoubleArithmeticTest extends TestCase {
     }
 
 
+    public static void testDoubleComparisonWithNaN() {
+        double nan = Double.NaN;
+        double zero = 0.0;
+        double one = 1.0;
+
+        assertFalse(nan < one);
+        assertFalse(one < nan);
+        assertFalse(nan <= one);
+        assertFalse(one <= nan);
+        assertFalse(nan > one);
+        assertFalse(one > nan);
+        assertFalse(nan >= one);
+        assertFalse(one >= nan);
+
+        assertFalse(nan == nan);
+        assertTrue(nan != nan);
+        assertTrue(one == one);
+        assertFalse(one != one);
+        assertTrue(-zero == zero);
+    }
+
     public static void main(String[] args) {
         testDoubleAddition();
         testDoubleAdditionLocalSlot();
@@ -148,5 +169,6 @@ public class DoubleArithmeticTest extends TestCase {
         testDoubleRemainder();
         testDoubleNegation();
         testDoubleComparison();
+        testDoubleComparisonWithNaN();
     }
 }
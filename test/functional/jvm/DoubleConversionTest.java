@@ -52,6 +52,11 @@ public class DoubleConversionTest extends TestCase {
         assertEquals(-1000, d2i(-1000.0101));
         assertEquals(-2147483648, d2i(-2147483648.0));
         assertEquals(2147483647, d2i(2147483647.0));
+        assertEquals(0, d2i(-0.5));
+        assertEquals(Integer.MIN_VALUE, d2i(-2147483649.0));
+        assertEquals(Integer.MAX_VALUE, d2i(2147483648.0));
+        assertEquals(Integer.MIN_VALUE, d2i(-Double.MAX_VALUE));
+        assertEquals(Integer.MAX_VALUE, d2i(Double.MAX_VALUE));
     }
 
     public static double l2d(long val) {
@@ -81,6 +86,10 @@ public class DoubleConversionTest extends TestCase {
         assertEquals(2147483647L, d2l(2147483647.0));
         assertEquals(-9223372036854775808L, d2l(-9223372036854775808.0));
         assertEquals(9223372036854775807L, d2l(9223372036854775807.0));
+        assertEquals(0L, d2l(-0.5));
+        assertEquals(-4294967296L, d2l(-4294967296.0));
+        assertEquals(Long.MIN_VALUE, d2l(-1.0e20));
+        assertEquals(Long.MAX_VALUE, d2l(1.0e20));
     }
 
     public static void main(String[] args) {
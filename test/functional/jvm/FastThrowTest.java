@@ -0,0 +1,105 @@
+package jvm;
+
+public class FastThrowTest extends TestCase {
+    static final int NR_THROWS = 10000;
+
+    static int divide(int a, int b) {
+        return a / b;
+    }
+
+    static int length(Object[] array) {
+        return array.length;
+    }
+
+    public static void testCaughtByRaisingMethod() {
+        Object[] array = null;
+        int caught = 0;
+
+        for (int i = 0; i < NR_THROWS; i++) {
+            try {
+                caught += array.length;
+            } catch (ArithmeticException e) {
+                fail();
+            } catch (NullPointerException e) {
+                caught++;
+            }
+        }
+
+        assertEquals(NR_THROWS, caught);
+    }
+
+    public static void testHandlersAreMatchedByClass() {
+        int[] array = new int[1];
+        int npes = 0, divs = 0, aioobes = 0;
+
+        for (int i = 0; i < 3 * NR_THROWS; i++) {
+            try {
+                switch (i % 3) {
+                case 0:
+                    length(null);
+                    break;
+                case 1:
+                    divide(i, 0);
+                    break;
+                case 2:
+                    array[i] = i;
+                    break;
+                }
+            } catch (NullPointerException e) {
+                npes++;
+            } catch (ArithmeticException e) {
+                divs++;
+            } catch (RuntimeException e) {
+                assertTrue(e instanceof ArrayIndexOutOfBoundsException);
+                aioobes++;
+            }
+        }
+
+        assertEquals(NR_THROWS, npes);
+        assertEquals(NR_THROWS, divs);
+        assertEquals(NR_THROWS, aioobes);
+    }
+
+    public static void testUncaughtByRaisingMethodHasStackTrace() {
+        StackTraceElement[] st = null;
+
+        try {
+            divide(1, 0);
+        } catch (ArithmeticException e) {
+            st = e.getStackTrace();
+        }
+
+        assertNotNull(st);
+        assertTrue(st.length > 0);
+        assertEquals("divide", st[0].getMethodName());
+    }
+
+    static int divideInFinally(int a, int b) {
+        try {
+            return a / b;
+        } finally {
+            a = 0;
+        }
+    }
+
+    public static void testRethrownFromFinallyHasStackTrace() {
+        StackTraceElement[] st = null;
+
+        try {
+            divideInFinally(1, 0);
+        } catch (ArithmeticException e) {
+            st = e.getStackTrace();
+        }
+
+        assertNotNull(st);
+        assertTrue(st.length > 0);
+        assertEquals("divideInFinally", st[0].getMethodName());
+    }
+
+    public static void main(String[] args) {
+        testCaughtByRaisingMethod();
+        testHandlersAreMatchedByClass();
+        testUncaughtByRaisingMethodHasStackTrace();
+        testRethrownFromFinallyHasStackTrace();
+    }
+}
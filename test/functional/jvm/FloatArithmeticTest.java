@@ -136,6 +136,27 @@ public class FloatArithmeticTest extends TestCase {
         assertTrue(one >= one);
     }
 
+    public static void testFloatComparisonWithNaN() {
+        float nan = Float.NaN;
+        float zero = 0.0f;
+        float one = 1.0f;
+
+        assertFalse(nan < one);
+        assertFalse(one < nan);
+        assertFalse(nan <= one);
+        assertFalse(one <= nan);
+        assertFalse(nan > one);
+        assertFalse(one > nan);
+        assertFalse(nan >= one);
+        assertFalse(one >= nan);
+
+        assertFalse(nan == nan);
+        assertTrue(nan != nan);
+        assertTrue(one == one);
+        assertFalse(one != one);
+        assertTrue(-zero == zero);
+    }
+
     public static void main(String[] args) {
         testFloatAddition();
         testFloatAdditionLocalSlot();
@@ -146,5 +167,6 @@ public class FloatArithmeticTest extends TestCase {
         testFloatRemainder();
         testFloatNegation();
         testFloatComparison();
+        testFloatComparisonWithNaN();
     }
 }
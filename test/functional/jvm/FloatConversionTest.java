@@ -52,6 +52,11 @@ public class FloatConversionTest extends TestCase {
         assertEquals(-1000, f2i(-1000.0101f));
         assertEquals(-2147483648, f2i(-2147483648.0f));
         assertEquals(2147483647, f2i(2147483647.0f));
+        assertEquals(0, f2i(-0.5f));
+        assertEquals(Integer.MIN_VALUE, f2i(-3.0e9f));
+        assertEquals(Integer.MAX_VALUE, f2i(3.0e9f));
+        assertEquals(Integer.MIN_VALUE, f2i(-Float.MAX_VALUE));
+        assertEquals(Integer.MAX_VALUE, f2i(Float.MAX_VALUE));
     }
 
     public static float l2f(long val) {
@@ -81,6 +86,10 @@ public class FloatConversionTest extends TestCase {
         assertEquals(2147483648L, f2l(2147483647.0f));
         assertEquals(-9223372036854775808L, f2l(-9223372036854775808.0f));
         assertEquals(9223372036854775807L, f2l(9223372036854775807.0f));
+        assertEquals(0L, f2l(-0.5f));
+        assertEquals(3000000000L, f2l(3.0e9f));
+        assertEquals(Long.MIN_VALUE, f2l(-1.0e20f));
+        assertEquals(Long.MAX_VALUE, f2l(1.0e20f));
     }
 
     public static void main(String[] args) {
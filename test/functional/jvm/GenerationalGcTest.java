@@ -0,0 +1,163 @@
+package jvm;
+
+import java.util.concurrent.atomic.AtomicReference;
+
+/**
+ * Checks that young objects that are only reachable from old objects
+ * survive young collections. The old objects are created first and
+ * promoted by the collections that the garbage triggers. The young
+ * objects are then stored into them through putfield, aastore,
+ * System.arraycopy() and sun.misc.Unsafe so that every write barrier is
+ * exercised.
+ */
+public class GenerationalGcTest extends TestCase {
+    static class Node {
+        Node next;
+        int value;
+
+        Node(Node next, int value) {
+            this.next = next;
+            this.value = value;
+        }
+    }
+
+    static class Holder {
+        Node node;
+        Object[] array;
+    }
+
+    static Node makeList(int length) {
+        Node head = null;
+
+        for (int i = 0; i < length; i++)
+            head = new Node(head, i);
+
+        return head;
+    }
+
+    static int sum(Node node) {
+        int result = 0;
+
+        for (; node != null; node = node.next)
+            result += node.value;
+
+        return result;
+    }
+
+    static void makeGarbage(int count) {
+        for (int i = 0; i < count; i++) {
+            Object[] garbage = new Object[16];
+            garbage[0] = new int[64];
+        }
+    }
+
+    public static void testFieldStoreIntoOldObject() {
+        Holder holder = new Holder();
+
+        makeGarbage(100000);
+
+        for (int i = 0; i < 100; i++) {
+            holder.node = makeList(100);
+            makeGarbage(10000);
+            assertEquals(4950, sum(holder.node));
+        }
+    }
+
+    /*
+     * The markers let the test runner check that a young collection ran
+     * between the store and the check when run with -verbose:gc.
+     */
+    public static void testFieldStoreSurvivesYoungCollection() {
+        Holder holder = new Holder();
+
+        makeGarbage(100000);
+
+        holder.node = makeList(100);
+        System.err.println("young list stored");
+
+        makeGarbage(100000);
+
+        System.err.println("young list checked");
+        assertEquals(4950, sum(holder.node));
+    }
+
+    public static void testArrayStoreIntoOldArray() {
+        Node[] nodes = new Node[1000];
+
+        makeGarbage(100000);
+
+        for (int i = 0; i < nodes.length; i++) {
+            nodes[i] = makeList(10);
+            makeGarbage(100);
+        }
+
+        for (int i = 0; i < nodes.length; i++)
+            assertEquals(45, sum(nodes[i]));
+    }
+
+    public static void testLargeOldArray() {
+        /* Spans many cards and more than one heap block. */
+        Node[] nodes = new Node[64 * 1024];
+
+        makeGarbage(100000);
+
+        for (int i = 0; i < nodes.length; i += 1024)
+            nodes[i] = new Node(null, i);
+
+        makeGarbage(100000);
+
+        for (int i = 0; i < nodes.length; i += 1024)
+            assertEquals(i, nodes[i].value);
+    }
+
+    public static void testArraycopyIntoOldArray() {
+        Object[] old = new Object[100];
+
+        makeGarbage(100000);
+
+        Object[] young = new Object[100];
+        for (int i = 0; i < young.length; i++)
+            young[i] = makeList(10);
+
+        System.arraycopy(young, 0, old, 0, young.length);
+        young = null;
+
+        makeGarbage(100000);
+
+        for (int i = 0; i < old.length; i++)
+            assertEquals(45, sum((Node) old[i]));
+    }
+
+    public static void testUnsafeStoreIntoOldObject() {
+        AtomicReference<Node> ref = new AtomicReference<Node>();
+
+        makeGarbage(100000);
+
+        Node list = makeList(100);
+        assertTrue(ref.compareAndSet(null, list));
+        list = null;
+
+        makeGarbage(100000);
+
+        assertEquals(4950, sum(ref.get()));
+    }
+
+    public static void testOldGarbageIsReclaimed() {
+        /* Old objects only die in full collections. */
+        for (int i = 0; i < 100; i++) {
+            Holder holder = new Holder();
+            holder.array = new Object[64 * 1024];
+            makeGarbage(10000);
+        }
+    }
+
+    public static void main(String[] args) {
+        testFieldStoreIntoOldObject();
+        testFieldStoreSurvivesYoungCollection();
+        testArrayStoreIntoOldArray();
+        testLargeOldArray();
+        testArraycopyIntoOldArray();
+        testUnsafeStoreIntoOldObject();
+        testOldGarbageIsReclaimed();
+    }
+}
@@ -14,6 +14,44 @@ public class GetstaticPatchingTest extends TestCase {
         }
     }
 
+    private static class FloatFieldClass {
+        static float x;
+
+        static {
+            x = 1.5f;
+            clinit_run = true;
+        }
+    }
+
+    private static void testFloatGetstaticPatching() {
+        clinit_run = false;
+        assertEquals(1.5f, FloatFieldClass.x);
+        assertTrue(clinit_run);
+
+        clinit_run = false;
+        assertEquals(1.5f, FloatFieldClass.x);
+        assertFalse(clinit_run);
+    }
+
+    private static class DoubleFieldClass {
+        static double x;
+
+        static {
+            x = 2.5;
+            clinit_run = true;
+        }
+    }
+
+    private static void testDoubleGetstaticPatching() {
+        clinit_run = false;
+        assertEquals(2.5, DoubleFieldClass.x);
+        assertTrue(clinit_run);
+
+        clinit_run = false;
+        assertEquals(2.5, DoubleFieldClass.x);
+        assertFalse(clinit_run);
+    }
+
     public static void main(String[] args) {
         assertFalse(clinit_run);
         /* Should trap, therefore clinit_run becomes true */
@@ -25,5 +63,8 @@ public class GetstaticPatchingTest extends TestCase {
         assertEquals(1, X.x);
         assertEquals(2, X.y);
         assertFalse(clinit_run);
+
+        testFloatGetstaticPatching();
+        testDoubleGetstaticPatching();
     }
 }
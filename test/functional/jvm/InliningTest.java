@@ -0,0 +1,102 @@
+package jvm;
+
+public class InliningTest extends TestCase {
+    static final class Point {
+        private int x;
+        private int y;
+        private long weight;
+        private byte tag;
+        private char name;
+
+        Point(int x, int y) {
+            this.x = x;
+            this.y = y;
+        }
+
+        int getX() { return x; }
+        int getY() { return y; }
+        void setX(int x) { this.x = x; }
+        int sum() { return getX() + getY(); }
+        long getWeight() { return weight; }
+        void setWeight(long weight) { this.weight = weight; }
+        byte getTag() { return tag; }
+        void setTag(byte tag) { this.tag = tag; }
+        char getName() { return name; }
+        void setName(char name) { this.name = name; }
+        Point self() { return this; }
+    }
+
+    static class Counter {
+        private static int count;
+
+        static int getCount() { return count; }
+        static void setCount(int value) { count = value; }
+        static int answer() { return 42; }
+        static long add(long a, long b) { return a + b; }
+        static int mask(int value, int mask) { return value & mask; }
+        static void nothing() { }
+    }
+
+    public static void testGetterAndSetter() {
+        Point p = new Point(1, 2);
+
+        assertEquals(1, p.getX());
+        assertEquals(2, p.getY());
+        p.setX(10);
+        assertEquals(10, p.getX());
+        assertEquals(12, p.sum());
+        assertEquals(p, p.self());
+    }
+
+    public static void testWideAndNarrowFields() {
+        Point p = new Point(0, 0);
+
+        p.setWeight(0x100000000L);
+        assertEquals(0x100000000L, p.getWeight());
+        p.setTag((byte) -1);
+        assertEquals(-1, p.getTag());
+        p.setName((char) 0xffff);
+        assertEquals((char) 0xffff, p.getName());
+    }
+
+    public static void testStaticMethods() {
+        Counter.setCount(5);
+        assertEquals(5, Counter.getCount());
+        assertEquals(42, Counter.answer());
+        assertEquals(0x100000001L, Counter.add(0x100000000L, 1L));
+        assertEquals(0x0f, Counter.mask(0xff, 0x0f));
+        Counter.nothing();
+    }
+
+    public static void testNullReceiver() {
+        Point p = null;
+
+        try {
+            p.getX();
+            fail();
+        } catch (NullPointerException e) {
+        }
+
+        try {
+            p.setX(1);
+            fail();
+        } catch (NullPointerException e) {
+        }
+
+        try {
+            p.self();
+            fail();
+        } catch (NullPointerException e) {
+        }
+    }
+
+    public static void main(String[] args) {
+        /* Static methods are only inlined when their class is initialized. */
+        Counter.setCount(0);
+
+        testGetterAndSetter();
+        testWideAndNarrowFields();
+        testStaticMethods();
+        testNullReceiver();
+    }
+}
@@ -0,0 +1,135 @@
+package jvm;
+
+public class InstanceofTest extends TestCase {
+    static interface Shape { }
+    static interface Polygon extends Shape { }
+
+    static class Base { }
+    static class Square extends Base implements Polygon { }
+
+    static class Level1 { }
+    static class Level2 extends Level1 { }
+    static class Level3 extends Level2 { }
+    static class Level4 extends Level3 { }
+    static class Level5 extends Level4 { }
+    static class Level6 extends Level5 { }
+    static class Level7 extends Level6 { }
+    static class Level8 extends Level7 { }
+    static class Level9 extends Level8 { }
+    static class Level10 extends Level9 implements Shape { }
+
+    public static void testInstanceofClass() {
+        Object o = new Square();
+
+        assertTrue(o instanceof Object);
+        assertTrue(o instanceof Base);
+        assertTrue(o instanceof Square);
+        assertFalse(o instanceof Level1);
+        assertFalse(new Base() instanceof Square);
+        assertFalse(new Object() instanceof Base);
+    }
+
+    public static void testInstanceofInterface() {
+        Object o = new Square();
+
+        assertTrue(o instanceof Polygon);
+        assertTrue(o instanceof Shape);
+        assertFalse(new Base() instanceof Shape);
+
+        /* Second round hits the secondary supertype cache. */
+        assertTrue(o instanceof Polygon);
+        assertTrue(o instanceof Shape);
+        assertFalse(new Base() instanceof Shape);
+    }
+
+    public static void testInstanceofDeepHierarchy() {
+        Object o = new Level10();
+
+        assertTrue(o instanceof Level1);
+        assertTrue(o instanceof Level8);
+        assertTrue(o instanceof Level9);
+        assertTrue(o instanceof Level10);
+        assertTrue(o instanceof Shape);
+        assertFalse(new Level8() instanceof Level9);
+        assertFalse(new Level9() instanceof Level10);
+        assertFalse(new Square() instanceof Level9);
+    }
+
+    public static void testInstanceofArray() {
+        Object strings = new String[1];
+        Object ints = new int[1];
+        Object matrix = new int[1][1];
+
+        assertTrue(strings instanceof String[]);
+        assertTrue(strings instanceof Object[]);
+        assertTrue(strings instanceof Comparable[]);
+        assertTrue(strings instanceof Cloneable);
+        assertFalse(strings instanceof Integer[]);
+
+        assertTrue(ints instanceof int[]);
+        assertFalse(ints instanceof long[]);
+        assertFalse(ints instanceof Object[]);
+
+        assertTrue(matrix instanceof Object[]);
+        assertTrue(matrix instanceof int[][]);
+        assertFalse(matrix instanceof long[][]);
+
+        assertTrue(new Level10[1] instanceof Level9[]);
+        assertFalse(new Level9[1] instanceof Level10[]);
+    }
+
+    public static void testInstanceofNull() {
+        Object o = null;
+
+        assertFalse(o instanceof Object);
+        assertFalse(o instanceof Shape);
+        assertFalse(o instanceof Level10);
+        assertFalse(o instanceof Object[]);
+    }
+
+    private static boolean castFails(Object o, int kind) {
+        try {
+            switch (kind) {
+            case 0:
+                takeObject((Base) o);
+                break;
+            case 1:
+                takeObject((Shape) o);
+                break;
+            case 2:
+                takeObject((Level9) o);
+                break;
+            case 3:
+                takeObject((Object[]) o);
+                break;
+            }
+        } catch (ClassCastException e) {
+            return true;
+        }
+        return false;
+    }
+
+    public static void testCheckcast() {
+        assertFalse(castFails(null, 0));
+        assertFalse(castFails(null, 1));
+        assertFalse(castFails(new Square(), 0));
+        assertFalse(castFails(new Square(), 1));
+        assertFalse(castFails(new Level10(), 1));
+        assertFalse(castFails(new Level10(), 2));
+        assertFalse(castFails(new String[1], 3));
+
+        assertTrue(castFails(new Object(), 0));
+        assertTrue(castFails(new Base(), 1));
+        assertTrue(castFails(new Level8(), 2));
+        assertTrue(castFails(new int[1], 3));
+    }
+
+    public static void main(String[] args) {
+        testInstanceofClass();
+        testInstanceofInterface();
+        testInstanceofDeepHierarchy();
+        testInstanceofArray();
+        testInstanceofNull();
+        testCheckcast();
+    }
+}
@@ -114,6 +114,40 @@ public class IntegerArithmeticTest extends TestCase {
         return dividend / divisor;
     }
 
+    public static void testIntegerDivisionOverflow() {
+        assertEquals(Integer.MIN_VALUE, div(Integer.MIN_VALUE, -1));
+        assertEquals(0, rem(Integer.MIN_VALUE, -1));
+    }
+
+    public static void testIntegerDivisionByConstant() {
+        int[] values = { 0, 1, -1, 7, -7, 100, -100, 12345678, -12345678,
+                         Integer.MAX_VALUE, Integer.MIN_VALUE };
+
+        for (int i = 0; i < values.length; i++) {
+            int x = values[i];
+
+            assertEquals(div(x, 1), x / 1);
+            assertEquals(div(x, -1), x / -1);
+            assertEquals(div(x, 2), x / 2);
+            assertEquals(div(x, -2), x / -2);
+            assertEquals(div(x, 8), x / 8);
+            assertEquals(div(x, 3), x / 3);
+            assertEquals(div(x, -3), x / -3);
+            assertEquals(div(x, 7), x / 7);
+            assertEquals(div(x, 10), x / 10);
+            assertEquals(div(x, -1000), x / -1000);
+            assertEquals(div(x, Integer.MAX_VALUE), x / Integer.MAX_VALUE);
+            assertEquals(div(x, Integer.MIN_VALUE), x / Integer.MIN_VALUE);
+
+            assertEquals(rem(x, 2), x % 2);
+            assertEquals(rem(x, -8), x % -8);
+            assertEquals(rem(x, 3), x % 3);
+            assertEquals(rem(x, -7), x % -7);
+            assertEquals(rem(x, 10), x % 10);
+            assertEquals(rem(x, Integer.MIN_VALUE), x % Integer.MIN_VALUE);
+        }
+    }
+
     public static void testIntegerRemainder() {
         assertEquals( 1, rem( 3, -2));
         assertEquals(-1, rem(-3,  2));
@@ -154,6 +188,18 @@ public class IntegerArithmeticTest extends TestCase {
         assertEquals(2, shl(1, 33));
     }
 
+    public static void testIntegerShiftByConstant() {
+        int x = -12345;
+
+        assertEquals(shl(x, 3), x << 3);
+        assertEquals(shl(x, 33), x << 33);
+        assertEquals(shr(x, 3), x >> 3);
+        assertEquals(shr(x, 35), x >> 35);
+        assertEquals(ushr(x, 3), x >>> 3);
+        assertEquals(ushr(x, -29), x >>> -29);
+        assertEquals(x, x << 32);
+    }
+
     public static int shl(int value, int distance) {
         return value << distance;
     }
@@ -263,11 +309,14 @@ public class IntegerArithmeticTest extends TestCase {
         testIntegerMultiplication();
         testIntegerMultiplicationOverflow();
         testIntegerDivision();
+        testIntegerDivisionOverflow();
+        testIntegerDivisionByConstant();
         testIntegerRemainder();
         testIntegerNegation();
         testIntegerNegationOverflow();
         testIntegerLeftShift();
         testIntegerLeftShiftDistanceIsMasked();
+        testIntegerShiftByConstant();
         testIntegerRightShift();
         testIntegerRightShiftDistanceIsMasked();
         testIntegerRightShiftSignExtends();
@@ -119,6 +119,32 @@ public class LongArithmeticTest extends TestCase {
         return dividend / divisor;
     }
 
+    public static void testLongDivisionOverflow() {
+        assertEquals(Long.MIN_VALUE, div(Long.MIN_VALUE, -1));
+        assertEquals(0, rem(Long.MIN_VALUE, -1));
+    }
+
+    public static void testLongDivisionByConstant() {
+        long[] values = { 0, 1, -1, 7, -7, 0x123456789L, -0x123456789L,
+                          Long.MAX_VALUE, Long.MIN_VALUE };
+
+        for (int i = 0; i < values.length; i++) {
+            long x = values[i];
+
+            assertEquals(div(x, 1), x / 1);
+            assertEquals(div(x, -1), x / -1);
+            assertEquals(div(x, 4), x / 4);
+            assertEquals(div(x, -4), x / -4);
+            assertEquals(div(x, 10), x / 10);
+            assertEquals(div(x, 0x100000000L), x / 0x100000000L);
+            assertEquals(div(x, Long.MIN_VALUE), x / Long.MIN_VALUE);
+
+            assertEquals(rem(x, 4), x % 4);
+            assertEquals(rem(x, -10), x % -10);
+            assertEquals(rem(x, Long.MIN_VALUE), x % Long.MIN_VALUE);
+        }
+    }
+
     public static void testLongRemainder() {
         assertEquals( 1, rem( 3, -2));
         assertEquals(-1, rem(-3,  2));
@@ -269,6 +295,8 @@ public class LongArithmeticTest extends TestCase {
         testLongMultiplication();
         testLongMultiplicationOverflow();
         testLongDivision();
+        testLongDivisionOverflow();
+        testLongDivisionByConstant();
         testLongRemainder();
         testLongNegation();
         testLongNegationOverflow();
@@ -0,0 +1,133 @@
+package jvm;
+
+import java.io.BufferedReader;
+import java.io.File;
+import java.io.FileReader;
+import java.io.IOException;
+import java.lang.management.GarbageCollectorMXBean;
+import java.lang.management.ManagementFactory;
+import java.lang.management.MemoryMXBean;
+import java.lang.management.MemoryPoolMXBean;
+import java.lang.management.MemoryType;
+import java.lang.management.MemoryUsage;
+import java.util.List;
+
+/**
+ * Checks the memory and garbage collector beans that are backed by the
+ * collector statistics of the VM.
+ */
+public class MemoryMXBeanTest extends TestCase {
+    static void makeGarbage(int count) {
+        for (int i = 0; i < count; i++) {
+            Object[] garbage = new Object[16];
+            garbage[0] = new int[64];
+        }
+    }
+
+    public static void testHeapMemoryUsage() {
+        MemoryMXBean memory = ManagementFactory.getMemoryMXBean();
+        MemoryUsage usage = memory.getHeapMemoryUsage();
+
+        assertTrue(usage.getUsed() > 0);
+        assertTrue(usage.getCommitted() >= usage.getUsed());
+        assertTrue(usage.getMax() >= usage.getCommitted());
+    }
+
+    public static void testHeapPool() {
+        List<MemoryPoolMXBean> pools = ManagementFactory.getMemoryPoolMXBeans();
+
+        assertEquals(1, pools.size());
+
+        MemoryPoolMXBean heap = pools.get(0);
+
+        assertEquals(MemoryType.HEAP, heap.getType());
+        assertTrue(heap.isValid());
+        assertTrue(heap.getPeakUsage().getUsed() >= heap.getUsage().getUsed());
+    }
+
+    public static void testCollectionCount() {
+        List<GarbageCollectorMXBean> collectors = ManagementFactory.getGarbageCollectorMXBeans();
+
+        assertEquals(1, collectors.size());
+
+        GarbageCollectorMXBean collector = collectors.get(0);
+        long count = collector.getCollectionCount();
+
+        assertTrue(collector.isValid());
+        assertTrue(collector.getCollectionTime() >= 0);
+
+        /* Allocates more than the 32 MB heap of the -Xnewgc run. */
+        makeGarbage(200000);
+
+        assertTrue(collector.getCollectionCount() > count);
+    }
+
+    static String readFirstLine(String path) throws IOException {
+        BufferedReader reader = new BufferedReader(new FileReader(path));
+        try {
+            return reader.readLine();
+        } finally {
+            reader.close();
+        }
+    }
+
+    static long longField(String record, String name) {
+        String key = "\"" + name + "\":";
+        int start = record.indexOf(key);
+
+        assertTrue(start >= 0);
+
+        start += key.length();
+
+        int end = start;
+        while (end < record.length() && Character.isDigit(record.charAt(end)))
+            end++;
+
+        return Long.parseLong(record.substring(start, end));
+    }
+
+    /*
+     * The -Xloggc run passes the log file in the jvm.MemoryMXBeanTest.gclog
+     * property. Records are written after the world is resumed, by the
+     * collecting thread or by the next allocation under Boehm GC, so the
+     * first one may show up a bit late.
+     */
+    public static void testCollectionLog() throws Exception {
+        String path = System.getProperty("jvm.MemoryMXBeanTest.gclog");
+        if (path == null)
+            return;
+
+        String record = null;
+        for (int i = 0; i < 100 && record == null; i++) {
+            record = readFirstLine(path);
+            if (record == null)
+                Thread.sleep(10);
+        }
+        new File(path).delete();
+
+        assertNotNull(record);
+        assertTrue(record.startsWith("{\"gc\":"));
+        assertTrue(record.endsWith("]}"));
+
+        assertTrue(longField(record, "start_us") > 0);
+        assertTrue(longField(record, "pause_us") >= longField(record, "safepoint_us"));
+        assertTrue(longField(record, "used_before") <= longField(record, "max"));
+        assertTrue(longField(record, "used_after") <= longField(record, "committed"));
+        assertTrue(longField(record, "committed") <= longField(record, "max"));
+    }
+
+    public static void testVerbose() {
+        MemoryMXBean memory = ManagementFactory.getMemoryMXBean();
+
+        memory.setVerbose(false);
+        assertFalse(memory.isVerbose());
+    }
+
+    public static void main(String[] args) throws Exception {
+        testHeapMemoryUsage();
+        testHeapPool();
+        testCollectionCount();
+        testCollectionLog();
+        testVerbose();
+    }
+}
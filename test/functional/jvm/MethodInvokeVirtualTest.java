@@ -45,6 +45,36 @@ public class MethodInvokeVirtualTest extends TestCase {
     }
   }
 
+  public static void testPolymorphicCallSite() {
+    Fruit[] fruits = { new Apple(), new Orange(), new Banana() };
+    String[] names = { "Apple", "Orange", "Banana" };
+
+    for (int i = 0; i < NUM_CALLS; i++) {
+      int n = i % fruits.length;
+
+      assertEquals(names[n], polymorphicWrapper(fruits[n]));
+    }
+  }
+
+  public static void testMegamorphicCallSite() {
+    Fruit[] fruits = { new Apple(), new Orange(), new Banana(), new Cherry(), new Lemon(), new Apple() };
+    String[] names = { "Apple", "Orange", "Banana", "Cherry", "Lemon", "Apple" };
+
+    for (int i = 0; i < NUM_CALLS; i++) {
+      int n = i % fruits.length;
+
+      assertEquals(names[n], megamorphicWrapper(fruits[n]));
+    }
+  }
+
+  public static String polymorphicWrapper(Fruit f) {
+    return f.name();
+  }
+
+  public static String megamorphicWrapper(Fruit f) {
+    return f.name();
+  }
+
   public static String appleWrapper(Fruit f) {
     return f.name();
   }
@@ -58,6 +88,8 @@ public class MethodInvokeVirtualTest extends TestCase {
     testCallSiteWithCacheHitType();
     testCallSiteWithCacheMissType();
     testCallSiteWithNull();
+    testPolymorphicCallSite();
+    testMegamorphicCallSite();
   }
 
   public interface IFruit {
@@ -78,5 +110,17 @@ public class MethodInvokeVirtualTest extends TestCase {
   public static class Orange extends Fruit {
     public String name() { return "Orange"; }
   }
+
+  public static class Banana extends Fruit {
+    public String name() { return "Banana"; }
+  }
+
+  public static class Cherry extends Fruit {
+    public String name() { return "Cherry"; }
+  }
+
+  public static class Lemon extends Fruit {
+    public String name() { return "Lemon"; }
+  }
 }
 
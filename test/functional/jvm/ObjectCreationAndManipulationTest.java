@@ -152,6 +152,44 @@ public class ObjectCreationAndManipulationTest extends TestCase {
 
     private static int sideEffectCounter;
 
+    public static void testManySmallObjectsAreCleared() {
+        for (int i = 0; i < 10000; i++) {
+            InstanceFields fields = new InstanceFields();
+            assertEquals(0, fields.field);
+            fields.field = i;
+
+            int[] ints = new int[i % 16];
+            assertEquals(i % 16, ints.length);
+            for (int j = 0; j < ints.length; j++) {
+                assertEquals(0, ints[j]);
+                ints[j] = -1;
+            }
+
+            Object[] objects = new Object[i % 8];
+            assertEquals(i % 8, objects.length);
+            for (int j = 0; j < objects.length; j++) {
+                assertNull(objects[j]);
+                objects[j] = fields;
+            }
+        }
+    }
+
+    public static void testSmallArrayClasses() {
+        assertEquals("[B", new byte[3].getClass().getName());
+        assertEquals("[J", new long[3].getClass().getName());
+        assertEquals("[Ljava.lang.String;", new String[3].getClass().getName());
+        assertEquals(0, new double[0].length);
+        assertEquals(100000, new byte[100000].length);
+    }
+
+    public static void testNewRunsClassInitializer() {
+        assertEquals(0, LazilyInitializedClass.initialized);
+        new LazilyInitializedClass();
+        assertEquals(1, LazilyInitializedClass.initialized);
+        new LazilyInitializedClass();
+        assertEquals(1, LazilyInitializedClass.initialized);
+    }
+
     private static int sideEffect() {
         sideEffectCounter++;
         return 0;
@@ -196,6 +234,9 @@ public class ObjectCreationAndManipulationTest extends TestCase {
         testCheckCast();
         testArrayLoadSideEffectBug();
         testArrayStoreSideEffectBug();
+        testManySmallObjectsAreCleared();
+        testSmallArrayClasses();
+        testNewRunsClassInitializer();
     }
 
     private static class InitializingClass {
@@ -213,4 +254,12 @@ public class ObjectCreationAndManipulationTest extends TestCase {
     private static class InstanceFields {
         public int field;
     };
+
+    private static class LazilyInitializedClass {
+        public static int initialized;
+
+        static {
+            initialized++;
+        }
+    };
 }
@@ -0,0 +1,121 @@
+package jvm;
+
+/**
+ * Checks that objects that are reachable from JIT frames, fields, arrays
+ * and static fields survive garbage collection and that unreachable
+ * objects are reclaimed. Run with a small heap so that the collector has
+ * to run many times.
+ */
+public class PreciseGcTest extends TestCase {
+    static class Node {
+        Node next;
+        int value;
+        long padding;
+
+        Node(Node next, int value) {
+            this.next = next;
+            this.value = value;
+        }
+    }
+
+    static Node staticList;
+
+    static Node makeList(int length) {
+        Node head = null;
+
+        for (int i = 0; i < length; i++)
+            head = new Node(head, i);
+
+        return head;
+    }
+
+    static int sum(Node node) {
+        int result = 0;
+
+        for (; node != null; node = node.next)
+            result += node.value;
+
+        return result;
+    }
+
+    static void makeGarbage(int count) {
+        for (int i = 0; i < count; i++) {
+            Object[] garbage = new Object[16];
+            garbage[0] = new int[64];
+        }
+    }
+
+    public static void testLocalsSurvive() {
+        Node list = makeList(1000);
+        int expected = sum(list);
+
+        makeGarbage(100000);
+
+        assertEquals(expected, sum(list));
+    }
+
+    public static void testLiveAcrossLoop() {
+        Node list = makeList(100);
+        int total = 0;
+
+        for (int i = 0; i < 1000; i++) {
+            Object[] garbage = new Object[32];
+            total += sum(list);
+        }
+
+        assertEquals(1000 * sum(list), total);
+    }
+
+    public static void testStaticsSurvive() {
+        staticList = makeList(1000);
+
+        makeGarbage(100000);
+
+        assertEquals(499500, sum(staticList));
+
+        staticList = null;
+    }
+
+    public static void testArraysSurvive() {
+        Node[] nodes = new Node[100];
+
+        for (int i = 0; i < nodes.length; i++)
+            nodes[i] = makeList(10);
+
+        makeGarbage(100000);
+
+        for (int i = 0; i < nodes.length; i++)
+            assertEquals(45, sum(nodes[i]));
+    }
+
+    public static void testStringsSurvive() {
+        StringBuilder builder = new StringBuilder();
+
+        for (int i = 0; i < 100; i++)
+            builder.append(i % 10);
+
+        String s = builder.toString();
+
+        makeGarbage(100000);
+
+        assertEquals(100, s.length());
+        assertEquals('9', s.charAt(99));
+    }
+
+    public static void testGarbageIsReclaimed() {
+        /* Allocates far more than the maximum heap size. */
+        for (int i = 0; i < 1000; i++) {
+            int[] garbage = new int[64 * 1024];
+            garbage[0] = i;
+        }
+    }
+
+    public static void main(String[] args) {
+        testLocalsSurvive();
+        testLiveAcrossLoop();
+        testStaticsSurvive();
+        testArraysSurvive();
+        testStringsSurvive();
+        testGarbageIsReclaimed();
+    }
+}
@@ -0,0 +1,21 @@
+package jvm;
+
+/**
+ * Keeps fib() busy long enough for the sampling profiler to see it. The
+ * profiles printed at exit are checked by tools/test.py.
+ */
+public class ProfilerTest extends TestCase {
+    public static int fib(int n) {
+        if (n <= 2)
+            return 1;
+
+        return fib(n-1) + fib(n-2);
+    }
+
+    public static void main(String[] args) {
+        long start = System.currentTimeMillis();
+
+        while (System.currentTimeMillis() - start < 1000)
+            assertEquals(6765, fib(20));
+    }
+}
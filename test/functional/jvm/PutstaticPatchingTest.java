@@ -29,6 +29,66 @@ public class PutstaticPatchingTest extends TestCase {
         assertFalse(clinit_run);
     }
 
+    private static class FloatX {
+        static float x;
+        static float y;
+
+        static {
+            x = 1.0f;
+            y = 2.0f;
+            clinit_run = true;
+        }
+    }
+
+    private static void testClassInitOnFloatPutstatic() {
+        float f = 3.0f;
+
+        clinit_run = false;
+        /* Should trap, therefore clinit_run becomes true */
+        FloatX.x = f;
+        assertTrue(clinit_run);
+        assertEquals(3.0f, FloatX.x);
+        assertEquals(2.0f, FloatX.y);
+
+        clinit_run = false;
+        /* Should not trap, therefore clinit_run remains false */
+        FloatX.x = f + 1.0f;
+        FloatX.y = f;
+        assertFalse(clinit_run);
+        assertEquals(4.0f, FloatX.x);
+        assertEquals(3.0f, FloatX.y);
+    }
+
+    private static class DoubleX {
+        static double x;
+        static double y;
+
+        static {
+            x = 1.0;
+            y = 2.0;
+            clinit_run = true;
+        }
+    }
+
+    private static void testClassInitOnDoublePutstatic() {
+        double d = 3.0;
+
+        clinit_run = false;
+        /* Should trap, therefore clinit_run becomes true */
+        DoubleX.x = d;
+        assertTrue(clinit_run);
+        assertEquals(3.0, DoubleX.x);
+        assertEquals(2.0, DoubleX.y);
+
+        clinit_run = false;
+        /* Should not trap, therefore clinit_run remains false */
+        DoubleX.x = d + 1.0;
+        DoubleX.y = d;
+        assertFalse(clinit_run);
+        assertEquals(4.0, DoubleX.x);
+        assertEquals(3.0, DoubleX.y);
+    }
+
     private static class DoubleFieldClass {
         public static double x;
     };
@@ -58,6 +118,8 @@ public class PutstaticPatchingTest extends TestCase {
 
     public static void main(String[] args) {
         testClassInitOnPutstatic();
+        testClassInitOnFloatPutstatic();
+        testClassInitOnDoublePutstatic();
         testDoublePutstaticPatching();
         testFloatPutstaticPatching();
         testIntPutstaticPatching();
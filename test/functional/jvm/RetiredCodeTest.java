@@ -0,0 +1,37 @@
+package jvm;
+
+/**
+ * Checks that the machine code of class initializers is freed once they
+ * have run. This test is run with -XX:+PrintCodeCache and the code cache
+ * statistics are expected to show freed method code. The garbage makes
+ * the collector look for retired code that is no longer executed.
+ */
+public class RetiredCodeTest extends TestCase {
+    static class Initialized {
+        static int value;
+
+        static {
+            for (int i = 0; i < 10; i++)
+                value += i;
+        }
+    }
+
+    static void makeGarbage(int count) {
+        for (int i = 0; i < count; i++) {
+            byte[] garbage = new byte[1024 * 1024];
+            garbage[0] = 1;
+        }
+    }
+
+    public static void testInitializerRunsOnce() {
+        assertEquals(45, Initialized.value);
+
+        makeGarbage(256);
+
+        assertEquals(45, Initialized.value);
+    }
+
+    public static void main(String[] args) {
+        testInitializerRunsOnce();
+    }
+}
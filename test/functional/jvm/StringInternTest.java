@@ -0,0 +1,60 @@
+package jvm;
+
+public class StringInternTest extends TestCase {
+    static final int NR_THREADS = 8;
+    static final int NR_STRINGS = 2000;
+
+    public static void testLiteralsAreInterned() {
+        String s = "intern";
+
+        assertSame(s, "intern");
+        assertSame(s, new String("intern").intern());
+        assertSame("æøå", new String("æøå").intern());
+        assertSame("", new String("").intern());
+    }
+
+    public static void testStringsWithSameHashCode() {
+        String a = "Aa";
+        String b = "BB";
+
+        assertEquals(a.hashCode(), b.hashCode());
+        assertSame(a, new String("Aa").intern());
+        assertSame(b, new String("BB").intern());
+        assertFalse(a == b);
+    }
+
+    public static void testConcurrentIntern() throws Exception {
+        final String[][] results = new String[NR_THREADS][NR_STRINGS];
+        Thread[] threads = new Thread[NR_THREADS];
+
+        for (int i = 0; i < threads.length; i++) {
+            final int id = i;
+
+            threads[i] = new Thread(new Runnable() {
+                public void run() {
+                    for (int j = 0; j < NR_STRINGS; j++)
+                        results[id][j] = new String("string-" + j).intern();
+                }
+            });
+        }
+
+        for (int i = 0; i < threads.length; i++)
+            threads[i].start();
+
+        for (int i = 0; i < threads.length; i++)
+            threads[i].join();
+
+        for (int j = 0; j < NR_STRINGS; j++) {
+            assertEquals("string-" + j, results[0][j]);
+
+            for (int i = 1; i < threads.length; i++)
+                assertSame(results[0][j], results[i][j]);
+        }
+    }
+
+    public static void main(String[] args) throws Exception {
+        testLiteralsAreInterned();
+        testStringsWithSameHashCode();
+        testConcurrentIntern();
+    }
+}
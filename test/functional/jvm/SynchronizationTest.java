@@ -87,12 +87,97 @@ public class SynchronizationTest extends TestCase {
         assertEquals(3, staticSynchronizedMethod(3));
     }
 
+    private static int lockRecursively(Object obj, int depth) {
+        synchronized (obj) {
+            if (depth == 0)
+                return 0;
+
+            return lockRecursively(obj, depth - 1) + 1;
+        }
+    }
+
+    public static void testDeepRecursiveLocking() {
+        Object obj = new Object();
+
+        /* Deep enough to overflow the recursion count of a thin lock */
+        assertEquals(1000, lockRecursively(obj, 1000));
+        assertEquals(3, lockRecursively(obj, 3));
+    }
+
+    public static void testNotifyWithoutOwningThrows() throws Exception {
+        final Object obj = new Object();
+        final boolean[] caught = new boolean[1];
+
+        Thread t = new Thread() {
+            public void run() {
+                try {
+                    obj.notify();
+                } catch (IllegalMonitorStateException e) {
+                    caught[0] = true;
+                }
+            }
+        };
+
+        synchronized (obj) {
+            t.start();
+            t.join();
+        }
+
+        assertTrue(caught[0]);
+    }
+
+    private static int counter;
+
+    public static void testContendedLocking() throws Exception {
+        final Object lock = new Object();
+        Thread[] threads = new Thread[4];
+
+        counter = 0;
+
+        for (int i = 0; i < threads.length; i++) {
+            threads[i] = new Thread() {
+                public void run() {
+                    for (int j = 0; j < 10000; j++) {
+                        synchronized (lock) {
+                            counter++;
+                        }
+                    }
+                }
+            };
+            threads[i].start();
+        }
+
+        for (int i = 0; i < threads.length; i++)
+            threads[i].join();
+
+        assertEquals(threads.length * 10000, counter);
+    }
+
+    public static void testWaitOnThinLock() throws Exception {
+        Object obj = new Object();
+
+        synchronized (obj) {
+            synchronized (obj) {
+                obj.wait(1);
+            }
+            obj.notifyAll();
+        }
+
+        synchronized (obj) {
+            obj.notify();
+        }
+    }
+
 
-    public static void main(String[] args) {
+    public static void main(String[] args) throws Exception {
         testMonitorEnterAndExit();
         testStaticSynchronizedMethod();
         testSynchronizedMethod();
         testStaticSynchronizedExceptingMethod();
         testSynchronizedExceptingMethod();
+        testDeepRecursiveLocking();
+        testNotifyWithoutOwningThrows();
+        testContendedLocking();
+        testWaitOnThinLock();
     }
 }
@@ -0,0 +1,56 @@
+package jvm;
+
+/**
+ * Checks that methods called from JIT code are interpreted while they
+ * are cold. This test is run with -XX:+TieredCompilation and
+ * -XX:+PrintCompilation and hot() is expected to be compiled but the
+ * methods it calls only once are not.
+ */
+public class TieredCompilationTest extends TestCase {
+    static final int LAST = 1000;
+
+    int value = 1;
+
+    static long cold(Object o, int a, long b, float c, double d, int e, int f, int g, int h, int i) {
+        assertNotNull(o);
+        return a + b + (long) c + (long) d + e + f + g + h + i;
+    }
+
+    double coldVirtual(double d) {
+        return d + value;
+    }
+
+    static void coldThrows() {
+        throw new IllegalStateException();
+    }
+
+    static long hot(int n) {
+        if (n < LAST)
+            return n;
+
+        long result = cold("x", 1, 2L, 3.0f, 4.0, 5, 6, 7, 8, 9);
+        result += (long) new TieredCompilationTest().coldVirtual(1.0);
+
+        try {
+            coldThrows();
+            fail();
+        } catch (IllegalStateException e) {
+            result++;
+        }
+
+        return result;
+    }
+
+    public static void testColdMethodsAreInterpreted() {
+        long result = 0;
+
+        for (int n = 0; n <= LAST; n++)
+            result = hot(n);
+
+        assertEquals(48, result);
+    }
+
+    public static void main(String[] args) {
+        testColdMethodsAreInterpreted();
+    }
+}
@@ -183,6 +183,14 @@ public class JNITest extends TestCase {
     assertEquals("TESTSTRING", staticToUpper("testString"));
   }
 
+  public static void testNewStringUTFIsNotInterned() {
+    String s = staticToUpper("interned");
+
+    assertEquals("INTERNED", s);
+    assertFalse(s == "INTERNED");
+    assertSame("INTERNED", s.intern());
+  }
+
   public static void testJNIEnvIsInitializedCorrectly() {
     assertTrue(staticTestJNIEnvIsInitializedCorrectly());
   }
@@ -410,6 +418,7 @@ public class JNITest extends TestCase {
     testReturnPassedFloat();
     testReturnPassedDouble();
     testStringManipulation();
+    testNewStringUTFIsNotInterned();
     testJNIEnvIsInitializedCorrectly();
     testGetVersion();
     testDefineClass();
@@ -341,9 +341,9 @@ static void init(void)
 	}
 
 	arch_init();
-	init_literals_hash_map();
 
 	gc_init();
+	init_literals_hash_map();
 	init_exec_env();
 	vm_reference_init();
 
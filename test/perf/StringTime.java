@@ -0,0 +1,61 @@
+import java.lang.reflect.Method;
+
+/*
+ * Measures how fast the VM turns strings from class files into
+ * java.lang.String objects. Reflection creates a new String for the
+ * name of every method it returns.
+ */
+public class StringTime {
+  private static final int NUM_ITERATIONS = 10000;
+
+  private static long start, stop;
+
+  /* Short names like the ones found in constant pools. */
+  public static class ShortNames {
+    public void get() { }
+    public void set() { }
+    public void run() { }
+    public void size() { }
+    public void equals2() { }
+    public void hashCode2() { }
+    public void toString2() { }
+    public void iterator() { }
+  }
+
+  /* Long names like strings passed to JNI NewStringUTF(). */
+  public static class LongNames {
+    public void aVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTF1() { }
+    public void aVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTF2() { }
+    public void aVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTF3() { }
+    public void aVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTF4() { }
+    public void aVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTF5() { }
+    public void aVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTF6() { }
+    public void aVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTF7() { }
+    public void aVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTFaVeryLongMethodNameThatIsAboutAsLongAsTheStringsPassedToNewStringUTF8() { }
+  }
+
+  private static int names(Class<?> klass) {
+    int length = 0;
+
+    for (Method m : klass.getDeclaredMethods())
+      length += m.getName().length();
+
+    return length;
+  }
+
+  private static void profile(String name, Class<?> klass) {
+    int length = names(klass);
+
+    start = System.nanoTime();
+    for (int i = 0; i < NUM_ITERATIONS; ++i) {
+      names(klass);
+    }
+    stop = System.nanoTime();
+    System.out.println(name + " = " + (stop - start)/NUM_ITERATIONS + "ns (" + length + " chars)");
+  }
+
+  public static void main(String[] args) {
+    profile("ShortStrings", ShortNames.class);
+    profile("LongStrings", LongNames.class);
+  }
+}
@@ -0,0 +1,119 @@
+#include "jit/bc-offset-mapping.h"
+#include "jit/compilation-unit.h"
+#include "jit/basic-block.h"
+#include "jit/instruction.h"
+
+#include "lib/buffer.h"
+
+#include "vm/method.h"
+
+#include <libharness.h>
+#include <string.h>
+
+#define CODE_SIZE 64
+
+static struct cafebabe_method_info method_info;
+static struct vm_method method = { .method = &method_info };
+
+static struct compilation_unit *alloc_test_cu(void)
+{
+	unsigned char code[CODE_SIZE];
+	struct compilation_unit *cu;
+	struct basic_block *bb;
+
+	memset(code, 0, sizeof(code));
+
+	cu = compilation_unit_alloc(&method);
+	cu->objcode = alloc_buffer();
+	append_buffer_str(cu->objcode, code, sizeof(code));
+
+	bb = alloc_basic_block(cu, 0, 10);
+	list_add_tail(&bb->bb_list_node, &cu->bb_list);
+
+	return cu;
+}
+
+static struct insn *
+add_insn(struct compilation_unit *cu, unsigned long mach_offset, unsigned long bc_offset)
+{
+	struct basic_block *bb;
+	struct insn *insn;
+
+	bb = list_first_entry(&cu->bb_list, struct basic_block, bb_list_node);
+
+	insn = alloc_insn(INSN_SETL);
+	insn->mach_offset = mach_offset;
+	insn_set_bc_offset(insn, bc_offset);
+
+	bb_add_insn(bb, insn);
+
+	return insn;
+}
+
+static unsigned long lookup(struct compilation_unit *cu, unsigned long offset)
+{
+	return jit_lookup_bc_offset(cu, buffer_ptr(cu->objcode) + offset);
+}
+
+void test_every_byte_of_insn_maps_to_its_bc_offset(void)
+{
+	struct compilation_unit *cu = alloc_test_cu();
+
+	add_insn(cu, 4, 0);
+	add_insn(cu, 9, 3);
+	cu->exit_bb->mach_offset = 16;
+
+	build_bc_offset_map(cu);
+
+	assert_int_equals(BC_OFFSET_UNKNOWN, lookup(cu, 3));
+	assert_int_equals(0, lookup(cu, 4));
+	assert_int_equals(0, lookup(cu, 8));
+	assert_int_equals(3, lookup(cu, 9));
+	assert_int_equals(3, lookup(cu, 15));
+	assert_int_equals(BC_OFFSET_UNKNOWN, lookup(cu, 16));
+	assert_int_equals(BC_OFFSET_UNKNOWN, lookup(cu, CODE_SIZE));
+
+	free_compilation_unit(cu);
+}
+
+void test_insns_of_same_bc_offset_share_one_entry(void)
+{
+	struct compilation_unit *cu = alloc_test_cu();
+
+	add_insn(cu, 0, 1);
+	add_insn(cu, 2, 1);
+	add_insn(cu, 5, 1);
+	add_insn(cu, 5, 2);
+	cu->exit_bb->mach_offset = 8;
+
+	build_bc_offset_map(cu);
+
+	assert_int_equals(3, cu->nr_bc_offset_entries);
+	assert_int_equals(1, lookup(cu, 4));
+	assert_int_equals(2, lookup(cu, 5));
+
+	free_compilation_unit(cu);
+}
+
+void test_slow_path_maps_to_bc_offset_of_its_insn(void)
+{
+	struct compilation_unit *cu = alloc_test_cu();
+	struct slow_path *sp;
+	struct insn *insn;
+
+	insn = add_insn(cu, 0, 7);
+	cu->exit_bb->mach_offset = 8;
+
+	sp = alloc_slow_path(cu, insn, 0);
+	sp->start = 32;
+	sp->end = 40;
+
+	build_bc_offset_map(cu);
+
+	assert_int_equals(BC_OFFSET_UNKNOWN, lookup(cu, 31));
+	assert_int_equals(7, lookup(cu, 32));
+	assert_int_equals(7, lookup(cu, 39));
+	assert_int_equals(BC_OFFSET_UNKNOWN, lookup(cu, 40));
+
+	free_compilation_unit(cu);
+}
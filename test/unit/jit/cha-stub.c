@@ -0,0 +1,5 @@
+#include "jit/cha.h"
+
+void cha_unregister_sites(struct compilation_unit *cu)
+{
+}
@@ -0,0 +1,11 @@
+#include "jit/compile-queue.h"
+
+bool compile_queue_enabled(void)
+{
+	return false;
+}
+
+bool compile_queue_submit(struct compilation_unit *cu)
+{
+	return false;
+}
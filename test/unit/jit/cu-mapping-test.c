@@ -0,0 +1,108 @@
+#include "jit/cu-mapping.h"
+#include "jit/text.h"
+
+#include <libharness.h>
+#include <stdbool.h>
+
+static struct compilation_unit *cu1 = (void *) 0x1000;
+static struct compilation_unit *cu2 = (void *) 0x2000;
+
+static unsigned long text_addr(unsigned long offset)
+{
+	static bool initialized;
+
+	if (!initialized) {
+		if (!jit_text_base())
+			jit_text_init();
+		init_cu_mapping();
+		initialized = true;
+	}
+
+	return (unsigned long) jit_text_base() + offset;
+}
+
+void test_lookup_returns_cu_of_preceding_entry(void)
+{
+	unsigned long entry1 = text_addr(0x10000);
+	unsigned long entry2 = text_addr(0x10040);
+
+	add_cu_mapping(entry1, cu1);
+	add_cu_mapping(entry2, cu2);
+
+	assert_ptr_equals(NULL, jit_lookup_cu(entry1 - 1));
+	assert_ptr_equals(cu1, jit_lookup_cu(entry1));
+	assert_ptr_equals(cu1, jit_lookup_cu(entry2 - 1));
+	assert_ptr_equals(cu2, jit_lookup_cu(entry2));
+
+	remove_cu_mapping(entry1);
+	remove_cu_mapping(entry2);
+}
+
+void test_lookup_finds_cu_that_starts_on_earlier_page(void)
+{
+	unsigned long entry = text_addr(0x20ff0);
+
+	add_cu_mapping(entry, cu1);
+
+	assert_ptr_equals(cu1, jit_lookup_cu(entry + 0x3000));
+
+	remove_cu_mapping(entry);
+}
+
+void test_lookup_skips_empty_pages(void)
+{
+	unsigned long entry1 = text_addr(0x40010);
+	unsigned long entry2 = text_addr(0x80000);
+	unsigned long addr = text_addr(0x4000000);
+
+	add_cu_mapping(entry1, cu1);
+	add_cu_mapping(entry2, cu2);
+
+	assert_ptr_equals(cu2, jit_lookup_cu(addr));
+
+	remove_cu_mapping(entry2);
+
+	assert_ptr_equals(cu1, jit_lookup_cu(addr));
+	assert_ptr_equals(NULL, jit_lookup_cu(entry1 - 1));
+
+	remove_cu_mapping(entry1);
+
+	assert_ptr_equals(NULL, jit_lookup_cu(addr));
+}
+
+void test_removed_entry_is_not_found(void)
+{
+	unsigned long entry1 = text_addr(0x30000);
+	unsigned long entry2 = text_addr(0x30100);
+
+	add_cu_mapping(entry1, cu1);
+	add_cu_mapping(entry2, cu2);
+	remove_cu_mapping(entry2);
+
+	assert_ptr_equals(cu1, jit_lookup_cu(entry2));
+
+	remove_cu_mapping(entry1);
+
+	assert_ptr_equals(NULL, jit_lookup_cu(entry2));
+}
+
+void test_lookup_outside_of_jit_text(void)
+{
+	static char native_function[16];
+	unsigned long entry = (unsigned long) native_function;
+
+	text_addr(0);
+
+	add_cu_mapping(entry, cu1);
+
+	assert_ptr_equals(cu1, jit_lookup_cu(entry));
+	assert_ptr_equals(cu1, jit_lookup_cu(entry + 8));
+
+	add_cu_mapping(entry, cu2);
+
+	assert_ptr_equals(cu2, jit_lookup_cu(entry));
+
+	remove_cu_mapping(entry);
+
+	assert_ptr_equals(NULL, jit_lookup_cu(entry));
+}
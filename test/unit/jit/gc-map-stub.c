@@ -0,0 +1,5 @@
+#include "jit/gc-map.h"
+
+void free_gc_maps(struct compilation_unit *cu)
+{
+}
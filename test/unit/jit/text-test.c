@@ -0,0 +1,98 @@
+#include "jit/text.h"
+
+#include <libharness.h>
+#include <stdbool.h>
+
+static unsigned int nr_released;
+
+static void init_text(void)
+{
+	if (!jit_text_base())
+		jit_text_init();
+}
+
+static void *emit_code(enum jit_text_segment type, size_t size)
+{
+	void *code;
+
+	code = jit_text_begin(type, size);
+	jit_text_end(size);
+
+	return code;
+}
+
+static bool code_in_use(void *start, size_t size)
+{
+	return true;
+}
+
+static bool code_not_in_use(void *start, size_t size)
+{
+	return false;
+}
+
+static void release_code(void *data)
+{
+	nr_released++;
+}
+
+void test_retired_code_is_freed_once_no_longer_in_use(void)
+{
+	size_t code_size;
+	void *code;
+
+	init_text();
+
+	emit_code(JIT_TEXT_IC_STUBS, 64);
+	code = emit_code(JIT_TEXT_IC_STUBS, 128);
+	code_size = jit_text_code_size(JIT_TEXT_IC_STUBS);
+
+	jit_text_retire(code, 128, release_code, NULL);
+
+	jit_text_collect(code_in_use);
+	jit_text_sweep();
+
+	assert_int_equals(0, nr_released);
+	assert_int_equals(code_size, jit_text_code_size(JIT_TEXT_IC_STUBS));
+
+	jit_text_collect(code_not_in_use);
+	jit_text_sweep();
+
+	assert_int_equals(1, nr_released);
+	assert_int_equals(code_size - 128, jit_text_code_size(JIT_TEXT_IC_STUBS));
+}
+
+void test_freed_code_is_reused(void)
+{
+	void *code, *reused;
+
+	init_text();
+
+	code = emit_code(JIT_TEXT_STUBS, 64);
+	emit_code(JIT_TEXT_STUBS, 64);
+
+	jit_text_free(code, 64);
+
+	reused = emit_code(JIT_TEXT_STUBS, 48);
+	assert_ptr_equals(code, reused);
+
+	reused = emit_code(JIT_TEXT_STUBS, 16);
+	assert_ptr_equals(code + 48, reused);
+}
+
+void test_adjacent_free_blocks_are_merged(void)
+{
+	void *code1, *code2, *reused;
+
+	init_text();
+
+	code1 = emit_code(JIT_TEXT_STUBS, 64);
+	code2 = emit_code(JIT_TEXT_STUBS, 64);
+	emit_code(JIT_TEXT_STUBS, 64);
+
+	jit_text_free(code2, 64);
+	jit_text_free(code1, 64);
+
+	reused = emit_code(JIT_TEXT_STUBS, 128);
+	assert_ptr_equals(code1, reused);
+}
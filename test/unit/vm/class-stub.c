@@ -74,3 +74,9 @@ struct vm_method *vm_class_get_method_recursive(const struct vm_class *vmc,
 {
 	return NULL;
 }
+
+struct vm_method *vm_class_get_virtual_method(const struct vm_class *vmc,
+	struct vm_method *vmm)
+{
+	return vmm;
+}
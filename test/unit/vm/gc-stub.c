@@ -5,6 +5,10 @@
 
 void *gc_safepoint_page;
 
+uint8_t *gc_card_table;
+unsigned long gc_heap_start_addr;
+unsigned long gc_heap_end_addr;
+
 void *do_gc_alloc(size_t size)
 {
 	return zalloc(size);
@@ -0,0 +1,12 @@
+#include "vm/interp.h"
+
+#include <stdio.h>
+
+bool opt_interp_only;
+bool opt_tiered_compilation;
+unsigned long opt_compile_threshold;
+
+void vm_interp_method_a(struct vm_method *method, unsigned long *args, union jvalue *result)
+{
+	NOT_IMPLEMENTED;
+}
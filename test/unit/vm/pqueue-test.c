@@ -25,6 +25,7 @@
  */
 
 #include <libharness.h>
+#include <limits.h>
 
 #include "lib/pqueue.h"
 
@@ -88,3 +89,18 @@ void test_pqueue_returns_highest_priority_element_first(void)
 
 	teardown();
 }
+
+void test_pqueue_orders_keys_that_are_far_apart(void)
+{
+	setup();
+
+	pqueue_insert(pqueue, ULONG_MAX, (void *) 2UL);
+	pqueue_insert(pqueue, 0UL, (void *) 0UL);
+	pqueue_insert(pqueue, ULONG_MAX / 2, (void *) 1UL);
+
+	assert_ptr_equals((void *) 0UL, pqueue_remove_top(pqueue));
+	assert_ptr_equals((void *) 1UL, pqueue_remove_top(pqueue));
+	assert_ptr_equals((void *) 2UL, pqueue_remove_top(pqueue));
+
+	teardown();
+}
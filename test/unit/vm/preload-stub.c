@@ -61,6 +61,7 @@ struct vm_class *vm_java_lang_InterruptedException;
 struct vm_class *vm_java_lang_ClassFormatError;
 
 struct vm_method *vm_java_lang_Throwable_initCause;
+struct vm_method *vm_java_lang_Throwable_fillInStackTrace;
 struct vm_method *vm_java_lang_Throwable_getCause;
 struct vm_method *vm_java_lang_Throwable_stackTraceString;
 struct vm_method *vm_java_lang_Throwable_getStackTrace;
@@ -6,6 +6,8 @@ import multiprocessing
 import subprocess
 import platform
 import argparse
+import tempfile
+import re
 import time
 import sys
 import os
@@ -16,18 +18,41 @@ CLASSPATH_DIR = os.popen('tools/classpath-config').read().strip()
 
 NO_SYSTEM_CLASSLOADER = [ "-bootclasspath", TEST_DIR + ":" + CLASSPATH_DIR + "/share/classpath/glibj.zip", "-Djava.library.path=" + CLASSPATH_DIR + "/lib/classpath/", "-Xnosystemclassloader" ]
 
+GC_LOG = os.path.join(tempfile.gettempdir(), "jato-gc-%d.log" % os.getpid())
+BOEHM_GC_LOG = os.path.join(tempfile.gettempdir(), "jato-boehm-gc-%d.log" % os.getpid())
+
+# Profiles of jvm.ProfilerTest must list fib() first.
+PROFILE_TOP_FIB = r"^   self   total  method\n *[0-9.]+% +[0-9.]+%  jvm/ProfilerTest\.fib\(I\)I$"
+COUNTERS_TOP_FIB = r"^     entries    backedges  method\n *[1-9][0-9]* +[0-9]+  jvm/ProfilerTest\.fib\(I\)I$"
+
+# The polymorphic call site of jvm.MethodInvokeVirtualTest must go through a PIC stub.
+IC_POLYMORPHIC = r"\[ic\] jvm/MethodInvokeVirtualTest\.polymorphicWrapper.*: monomorphic -> polymorphic"
+
+# Class initializers of jvm.RetiredCodeTest must be freed from the code cache.
+METHOD_CODE_FREED = r"^  methods: [0-9]+ KB of [0-9]+ KB handed out, [1-9][0-9]* frees"
+
+# Methods that jvm.TieredCompilationTest calls only once from JIT code must not be compiled.
+COLD_NOT_COMPILED = r"\A(?![\s\S]*jvm/TieredCompilationTest\.cold)[\s\S]*jvm/TieredCompilationTest\.hot \("
+
+# A young collection must run between the store and the check of jvm.GenerationalGcTest.
+YOUNG_GC_AFTER_STORE = r"^young list stored$[\s\S]*^\[GC [\s\S]*^young list checked$"
+
 TESTS = [
   #                            Exit
   #  Test                      Code  Extra VM arguments       Architectures
   # ========================== ====  =======================  =============
+  #
+  # An optional fifth element is a regular expression that the standard
+  # error output of the test must match.
   ( "jvm/EntryTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm/EntryTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xint" ], [ "i386", "x86_64" ] )
-, ( "jvm/EntryTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xssa" ], [ "i386" ] )
+, ( "jvm/EntryTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xssa" ], [ "i386", "x86_64" ] )
 , ( "jvm/EntryTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnewgc" ], [ "i386", "x86_64" ] )
 , ( "jvm/ExitStatusIsZeroTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm/ExitStatusIsOneTest", 1, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm/ArgsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ArrayExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.ArrayExceptionsTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xssa" ], [ "i386", "x86_64" ] )
 , ( "jvm.ArrayMemberTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ArrayTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.BranchTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
@@ -38,30 +63,61 @@ TESTS = [
 , ( "jvm.CloneTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ControlTransferTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ConversionTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.DevirtualizationTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.DevirtualizationTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnocha" ], [ "i386", "x86_64" ] )
 , ( "jvm.DoubleArithmeticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.DoubleConversionTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.DupTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.ExceptionsTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=2" ], [ "i386", "x86_64" ] )
 , ( "jvm.ExceptionHandlerTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.FastThrowFallbackTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+OmitStackTraceInFastThrow" ], [ "i386", "x86_64" ] )
+, ( "jvm.FastThrowTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.FastThrowTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+OmitStackTraceInFastThrow" ], [ "i386", "x86_64" ] )
 , ( "jvm.FibonacciTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.FibonacciTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+PrintCodeCache" ], [ "i386", "x86_64" ] )
+, ( "jvm.FibonacciTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xprof" ], [ "i386", "x86_64" ] )
+, ( "jvm.FibonacciTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xprof:counters" ], [ "i386", "x86_64" ] )
 , ( "jvm.FinallyTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.FloatArithmeticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.FloatConversionTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.GcTortureTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.GcTortureTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnewgc" ], [ "i386", "x86_64" ] )
+, ( "jvm.GcTortureTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+UseGenerationalGC" ], [ "i386", "x86_64" ] )
+, ( "jvm.GcTortureTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnewgc", "-XX:ParallelGCThreads=4" ], [ "i386", "x86_64" ] )
+, ( "jvm.GenerationalGcTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.GenerationalGcTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+UseGenerationalGC", "-Xmx32m", "-Xmn1m" ], [ "i386", "x86_64" ] )
+, ( "jvm.GenerationalGcTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+UseGenerationalGC", "-Xmx32m", "-Xmn1m", "-verbose:gc" ], [ "i386", "x86_64" ], YOUNG_GC_AFTER_STORE )
 , ( "jvm.GetstaticPatchingTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.InliningTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.InliningTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnoinline" ], [ "i386", "x86_64" ] )
+, ( "jvm.InstanceofTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.IntegerArithmeticExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.IntegerArithmeticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.IntegerArithmeticTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xint" ], [ "i386", "x86_64" ] )
+, ( "jvm.IntegerArithmeticTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=2" ], [ "i386", "x86_64" ] )
 , ( "jvm.InterfaceFieldInheritanceTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.InterfaceInheritanceTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.InvokeinterfaceTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.InvokeinterfaceTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=2" ], [ "i386", "x86_64" ] )
 , ( "jvm.InvokeResultTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.InvokeTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.InvokestaticPatchingTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.LoadConstantsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.LongArithmeticExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.LongArithmeticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.LongArithmeticTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xint" ], [ "i386", "x86_64" ] )
+, ( "jvm.LongArithmeticTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=2" ], [ "i386", "x86_64" ] )
+, ( "jvm.MemoryMXBeanTest", 0, [ ], [ "i386", "x86_64" ] )
+, ( "jvm.MemoryMXBeanTest", 0, [ "-Xmx32m", "-Xloggc:" + BOEHM_GC_LOG, "-Djvm.MemoryMXBeanTest.gclog=" + BOEHM_GC_LOG ], [ "i386", "x86_64" ] )
+, ( "jvm.MemoryMXBeanTest", 0, [ "-Xnewgc", "-Xmx32m", "-Xloggc:" + GC_LOG, "-Djvm.MemoryMXBeanTest.gclog=" + GC_LOG ], [ "i386", "x86_64" ] )
 , ( "jvm.MethodInvocationAndReturnTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.MethodInvokeVirtualTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.MethodInvokeVirtualTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnewgc" ], [ "i386", "x86_64" ] )
+, ( "jvm.MethodInvokeVirtualTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xtrace:ic" ], [ "i386", "x86_64" ], IC_POLYMORPHIC )
+, ( "jvm.MethodInvokeVirtualTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=2" ], [ "i386", "x86_64" ] )
+, ( "jvm.MethodInvokeVirtualTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=2", "-XX:CICompilerCount=4" ], [ "i386", "x86_64" ] )
+, ( "jvm.MethodInvokeVirtualTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=2", "-Xbatch" ], [ "i386", "x86_64" ] )
 , ( "jvm.MethodInvocationExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.MultithreadingTest", 0, [ ], [ "i386", "x86_64" ] )
 , ( "jvm.MethodOverridingFinal", 1, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
@@ -73,17 +129,34 @@ TESTS = [
 , ( "jvm.ParameterPassingTest", 100, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.ParameterPassingLivenessTest", 1, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.PopTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.PreciseGcTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.PreciseGcTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnewgc", "-Xmx32m" ], [ "i386", "x86_64" ] )
+, ( "jvm.PreciseGcTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+UseGenerationalGC", "-Xmx32m" ], [ "i386", "x86_64" ] )
+, ( "jvm.PreciseGcTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+UseGenerationalGC", "-Xmx32m", "-XX:ParallelGCThreads=4" ], [ "i386", "x86_64" ] )
 , ( "jvm.PrintTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.ProfilerTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnoinline", "-Xprof" ], [ "i386", "x86_64" ], PROFILE_TOP_FIB )
+, ( "jvm.ProfilerTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnoinline", "-Xprof:counters" ], [ "i386", "x86_64" ], COUNTERS_TOP_FIB )
 , ( "jvm.PutfieldTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.PutstaticPatchingTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.PutstaticTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.RegisterAllocatorTortureTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.RetiredCodeTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xmx32m", "-XX:+PrintCodeCache" ], [ "i386", "x86_64" ], METHOD_CODE_FREED )
+, ( "jvm.RetiredCodeTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xnewgc", "-Xmx32m", "-XX:+PrintCodeCache" ], [ "i386", "x86_64" ], METHOD_CODE_FREED )
 , ( "jvm.StackTraceTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386" ] )
+, ( "jvm.StackTraceTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation" ], [ "i386" ] )
+, ( "jvm.StringInternTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.StringInternTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+PrintStringTableStatistics" ], [ "i386", "x86_64" ] )
 , ( "jvm.StringTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.SubroutineTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.SwitchTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.SwitchTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xint" ], [ "i386", "x86_64" ] )
+, ( "jvm.SwitchTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=2" ], [ "i386", "x86_64" ] )
+, ( "jvm.SwitchTest", 0, NO_SYSTEM_CLASSLOADER + [ "-Xprof:counters" ], [ "i386", "x86_64" ] )
 , ( "jvm.SynchronizationExceptionsTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.SynchronizationTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.TieredCompilationTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
+, ( "jvm.TieredCompilationTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=100", "-Xbatch", "-XX:+PrintCompilation" ], [ "i386", "x86_64" ], COLD_NOT_COMPILED )
+, ( "jvm.TieredCompilationTest", 0, NO_SYSTEM_CLASSLOADER + [ "-XX:+TieredCompilation", "-XX:CompileThreshold=100", "-XX:CICompilerCount=4" ], [ "i386", "x86_64" ] )
 , ( "jvm.TrampolineBackpatchingTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.VirtualAbstractInterfaceMethodTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
 , ( "jvm.WideTest", 0, NO_SYSTEM_CLASSLOADER, [ "i386", "x86_64" ] )
@@ -120,7 +193,7 @@ def guess_arch():
 ARCH = guess_arch()
 
 def is_test_supported(t):
-  klass, expected_retval, extra_args, archs = t
+  archs = t[3]
   return ARCH in archs
 
 def success(s):
@@ -155,12 +228,20 @@ def main():
   tests = filter(lambda t: is_test_supported(t) != opts.skipped, TESTS)
 
   def do_work(t):
-    klass, expected_retval, extra_args, archs = t
-    fnull = open(os.devnull, "w")
+    klass, expected_retval, extra_args, archs = t[:4]
+    expected_output = t[4] if len(t) > 4 else None
     progress(len(tests) - q.qsize(), len(tests), klass)
     command = ["./jato", "-cp", TEST_DIR ] + extra_args + [ klass ]
-    retval = subprocess.call(command, stderr = fnull)
-    if retval != expected_retval:
+    if expected_output:
+      proc = subprocess.Popen(command, stderr = subprocess.PIPE)
+      output = proc.communicate()[1]
+      retval = proc.returncode
+      passed = retval == expected_retval and re.search(expected_output, output, re.MULTILINE)
+    else:
+      fnull = open(os.devnull, "w")
+      retval = subprocess.call(command, stderr = fnull)
+      passed = retval == expected_retval
+    if not passed:
       if not opts.skipped:
         print "%s: Test FAILED%20s" % (klass, "")
       results.put(False)
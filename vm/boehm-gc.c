@@ -1,9 +1,188 @@
+#include "jit/text.h"
+
 #include "vm/gc.h"
+#include "vm/gc-log.h"
 
 #include "../boehmgc/include/gc.h"
 
+#include <pthread.h>
+#include <setjmp.h>
 #include <stdio.h>
 
+/*
+ * Boehm GC calls this hook with the allocation lock held at the start of
+ * every full collection. There is no hook for the end so the thread that
+ * allocates next completes the log record. That is the thread that
+ * triggered the collection in the common case.
+ */
+extern void (*GC_start_call_back)(void);
+
+static pthread_mutex_t		gc_event_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct gc_event		gc_event;
+static volatile bool		gc_event_pending;
+
+static unsigned long gc_used_bytes(void)
+{
+	return GC_get_heap_size() - GC_get_free_bytes();
+}
+
+/* Called with gc_event_mutex held. */
+static void gc_event_finish(void)
+{
+	if (!gc_event_pending || GC_gc_no < gc_event.id)
+		return;
+
+	gc_event.pause_us	= gc_log_uptime_us() - gc_event.start_us;
+	gc_event.used_after	= gc_used_bytes();
+	gc_event.committed	= GC_get_heap_size();
+
+	gc_log_event(&gc_event);
+
+	gc_event_pending = false;
+}
+
+static void gc_start_callback(void)
+{
+	pthread_mutex_lock(&gc_event_mutex);
+
+	gc_event_finish();
+
+	gc_event = (struct gc_event) {
+		.id		= GC_gc_no + 1,
+		.full		= true,
+		.start_us	= gc_log_uptime_us(),
+		.allocated	= GC_get_bytes_since_gc(),
+		.used_before	= gc_used_bytes(),
+		.max		= max_heap_size,
+	};
+	gc_event_pending = true;
+
+	pthread_mutex_unlock(&gc_event_mutex);
+}
+
+/*
+ * Boehm GC keeps its thread table private. This mirrors the beginning of
+ * struct GC_Thread_Rep in boehmgc/include/private/pthread_support.h up to
+ * the fields that locate the stack of a stopped thread.
+ */
+#define GC_THREAD_TABLE_SZ	128
+#define GC_THREAD_FINISHED	1
+#define GC_MAIN_THREAD		4
+
+struct gc_thread {
+	struct gc_thread	*next;
+	pthread_t		id;
+	struct {
+		GC_word		last_stop_count;
+		void		*stack_ptr;
+	} stop_info;
+	short			flags;
+	short			thread_blocked;
+	void			*stack_end;
+};
+
+extern struct gc_thread *volatile GC_threads[GC_THREAD_TABLE_SZ];
+
+/*
+ * Boehm GC calls this hook to push the thread stacks while the world is
+ * stopped. It is wrapped to find the retired JIT code that is no longer
+ * executed. The code is freed by the thread that allocates next because
+ * the release functions may take locks that a stopped thread holds.
+ */
+extern void (*GC_push_other_roots)(void);
+
+static void			(*gc_push_thread_stacks)(void);
+static void			*gc_collector_sp;
+static volatile bool		jit_text_sweep_pending;
+
+static bool stack_uses_code(void *lo, void *hi, void *start, size_t size)
+{
+	unsigned long *p;
+
+	for (p = lo; (void *) p < hi; p++) {
+		void *addr = (void *) *p;
+
+		if (addr >= start && addr <= start + size)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns true if a thread might be executing code in the given range or
+ * has a frame of it on the stack. The stacks are scanned conservatively
+ * between the same bounds as GC_push_all_stacks() uses. A stopped thread
+ * saves its stack pointer in the suspend signal handler so the
+ * interrupted instruction pointer saved by the kernel is included.
+ */
+static bool code_in_use(void *start, size_t size)
+{
+	pthread_t self = pthread_self();
+	unsigned int i;
+
+	for (i = 0; i < GC_THREAD_TABLE_SZ; i++) {
+		struct gc_thread *p;
+
+		for (p = GC_threads[i]; p; p = p->next) {
+			void *lo, *hi;
+
+			if (p->flags & GC_THREAD_FINISHED)
+				continue;
+
+			if (pthread_equal(p->id, self))
+				lo = gc_collector_sp;
+			else
+				lo = p->stop_info.stack_ptr;
+
+			if (p->flags & GC_MAIN_THREAD)
+				hi = GC_stackbottom;
+			else
+				hi = p->stack_end;
+
+			if (!lo || !hi)
+				return true;
+
+			if (stack_uses_code(lo, hi, start, size))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+static void gc_push_other_roots(void)
+{
+	jmp_buf regs;
+
+	gc_push_thread_stacks();
+
+	/*
+	 * Spill the callee-saved registers of the collecting thread so
+	 * that they are scanned with the rest of its stack.
+	 */
+	setjmp(regs);
+	gc_collector_sp = &regs;
+
+	jit_text_collect(code_in_use);
+	jit_text_sweep_pending = true;
+}
+
+static inline void gc_check_event(void)
+{
+	if (jit_text_sweep_pending) {
+		jit_text_sweep_pending = false;
+		jit_text_sweep();
+	}
+
+	if (!gc_event_pending)
+		return;
+
+	pthread_mutex_lock(&gc_event_mutex);
+	gc_event_finish();
+	pthread_mutex_unlock(&gc_event_mutex);
+}
+
 static void *gc_out_of_memory(size_t nr)
 {
 	if (verbose_gc)
@@ -31,6 +210,7 @@ static void *do_gc_malloc(size_t size)
 	void *p;
 
 	p = GC_malloc(size);
+	gc_check_event();
 	if (!p)
 		return NULL;
 
@@ -44,6 +224,7 @@ static void *do_gc_malloc_noscan(size_t size)
 	void *p;
 
 	p = GC_malloc_atomic(size);
+	gc_check_event();
 	if (!p)
 		return NULL;
 
@@ -52,11 +233,45 @@ static void *do_gc_malloc_noscan(size_t size)
 	return p;
 }
 
+static void *do_gc_malloc_many(size_t size)
+{
+	void *result;
+
+	result = GC_malloc_many(size);
+	gc_check_event();
+
+	return result;
+}
+
+/*
+ * Boehm GC exports GC_malloc_many() only for the scanned object kind. The
+ * generic variant is not in the public header and the pointer-free kind is
+ * private to the collector so both are declared here.
+ */
+#define GC_KIND_PTRFREE		0
+
+extern void GC_generic_malloc_many(size_t lb, int k, void **result);
+
+static void *do_gc_malloc_many_noscan(size_t size)
+{
+	void *result, **p;
+
+	GC_generic_malloc_many(size, GC_KIND_PTRFREE, &result);
+	gc_check_event();
+
+	/* Pointer-free objects are not cleared by the collector. */
+	for (p = result; p; p = *p)
+		memset(p + 1, 0, size - sizeof(*p));
+
+	return result;
+}
+
 static void *do_gc_malloc_uncollectable(size_t size)
 {
 	void *p;
 
 	p = GC_malloc_uncollectable(size);
+	gc_check_event();
 	if (!p)
 		return NULL;
 
@@ -70,14 +285,33 @@ static void do_gc_free(void *ptr)
 	GC_free(ptr);
 }
 
+static void do_gc_get_stats(struct gc_stats *stats)
+{
+	*stats = (struct gc_stats) {
+		.name			= "Boehm",
+		.nr_collections		= GC_gc_no,
+		.used			= GC_get_heap_size() - GC_get_free_bytes(),
+		.committed		= GC_get_heap_size(),
+		.max			= max_heap_size,
+	};
+
+	/* Boehm GC doesn't keep these. */
+	stats->peak_used		= stats->used;
+	stats->used_after_gc		= stats->used;
+	stats->committed_after_gc	= stats->committed;
+}
+
 void gc_setup_boehm(void)
 {
 	gc_ops		= (struct gc_operations) {
 		.gc_alloc		= do_gc_malloc,
 		.gc_alloc_noscan	= do_gc_malloc_noscan,
+		.gc_alloc_many		= do_gc_malloc_many,
+		.gc_alloc_many_noscan	= do_gc_malloc_many_noscan,
 		.vm_alloc		= do_gc_malloc_uncollectable,
 		.vm_free		= do_gc_free,
-		.gc_register_finalizer	= do_gc_register_finalizer
+		.gc_register_finalizer	= do_gc_register_finalizer,
+		.gc_get_stats		= do_gc_get_stats,
 	};
 
 	GC_set_warn_proc(gc_ignore_warnings);
@@ -91,4 +325,10 @@ void gc_setup_boehm(void)
 	GC_INIT();
 
 	GC_set_max_heap_size(max_heap_size);
+
+	gc_push_thread_stacks	= GC_push_other_roots;
+	GC_push_other_roots	= gc_push_other_roots;
+
+	if (gc_log_enabled())
+		GC_start_call_back = gc_start_callback;
 }
@@ -32,6 +32,7 @@
 
 #include "vm/call.h"
 #include "vm/class.h"
+#include "vm/interp.h"
 #include "vm/method.h"
 #include "vm/object.h"
 #include "vm/stack-trace.h"
@@ -51,7 +52,10 @@ call_method_a(struct vm_method *method, void *target, unsigned long *args,
 	exception = exception_occurred();
 	clear_exception();
 
-	native_call(method, target, args, result);
+	if (vm_method_should_interpret(method))
+		vm_interp_method_a(method, args, result);
+	else
+		native_call(method, target, args, result);
 
 	if (!exception_occurred() && exception)
 		signal_exception(exception);
@@ -76,19 +80,24 @@ void vm_call_method_this_a(struct vm_method *method,
 			   unsigned long *args,
 			   union jvalue *result)
 {
+	struct vm_method *vmm;
 	void *target;
 
 	assert(args[0] == (unsigned long) this);
 
-	if (vm_class_is_interface(method->class)) {
-		struct vm_method *vmm
-			= vm_class_get_method_recursive(this->class, method->name, method->type);
+	/*
+	 * The interpreter needs the method that the call dispatches to
+	 * which can not be recovered from a vtable entry.
+	 */
+	if (vm_class_is_interface(method->class) || vm_interp_enabled()) {
+		vmm = vm_class_get_virtual_method(this->class, method);
 		target = vm_method_call_ptr(vmm);
 	} else {
+		vmm = method;
 		target = this->class->vtable.native_ptr[method->virtual_index];
 	}
 
-	call_method_a(method, target, args, result);
+	call_method_a(vmm, target, args, result);
 }
 
 void vm_call_method_a(struct vm_method *method, unsigned long *args,
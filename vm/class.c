@@ -36,8 +36,10 @@
 #include "cafebabe/stream.h"
 #include "cafebabe/class.h"
 
+#include "jit/compilation-unit.h"
 #include "jit/exception.h"
 #include "jit/compiler.h"
+#include "jit/cha.h"
 #include "jit/vtable.h"
 #include "jit/cu-mapping.h"
 
@@ -118,6 +120,9 @@ setup_vtable(struct vm_class *vmc)
 					vmm->name, vmm->type);
 			if (vmm2) {
 				vmm->virtual_index = vmm2->virtual_index;
+
+				if (!vm_method_is_static(vmm) && !vm_method_is_static(vmm2))
+					cha_method_overridden(vmm2);
 				continue;
 			}
 		}
@@ -165,6 +170,79 @@ int vm_class_setup_object(struct vm_class *vmc)
 	return 0;
 }
 
+static void vm_class_setup_primary_supers(struct vm_class *vmc)
+{
+	struct vm_class *super = vmc->super;
+
+	if (super) {
+		vmc->depth = super->depth + 1;
+		memcpy(vmc->primary_supers, super->primary_supers,
+		       sizeof(vmc->primary_supers));
+	} else {
+		vmc->depth = 0;
+		memset(vmc->primary_supers, 0, sizeof(vmc->primary_supers));
+	}
+
+	if (vmc->depth < VM_CLASS_DISPLAY_SIZE)
+		vmc->primary_supers[vmc->depth] = vmc;
+}
+
+static void add_secondary_super(struct vm_class *vmc, struct vm_class *super)
+{
+	for (unsigned int i = 0; i < vmc->nr_secondary_supers; ++i) {
+		if (vmc->secondary_supers[i] == super)
+			return;
+	}
+
+	vmc->secondary_supers[vmc->nr_secondary_supers++] = super;
+}
+
+/*
+ * Collects the interfaces implemented by the class, directly or through
+ * its supertypes, and the superclasses that are too deep for the display.
+ */
+static int vm_class_setup_secondary_supers(struct vm_class *vmc)
+{
+	struct vm_class *super = vmc->super;
+	unsigned int max_supers = 0;
+
+	if (super)
+		max_supers += super->nr_secondary_supers + 1;
+
+	for (unsigned int i = 0; i < vmc->nr_interfaces; ++i)
+		max_supers += vmc->interfaces[i]->nr_secondary_supers + 1;
+
+	vmc->nr_secondary_supers = 0;
+	vmc->secondary_supers = NULL;
+	vmc->secondary_super_cache = NULL;
+
+	if (!max_supers)
+		return 0;
+
+	vmc->secondary_supers = malloc(sizeof(*vmc->secondary_supers) * max_supers);
+	if (!vmc->secondary_supers)
+		return -ENOMEM;
+
+	if (super) {
+		if (super->depth >= VM_CLASS_DISPLAY_SIZE)
+			add_secondary_super(vmc, super);
+
+		for (unsigned int i = 0; i < super->nr_secondary_supers; ++i)
+			add_secondary_super(vmc, super->secondary_supers[i]);
+	}
+
+	for (unsigned int i = 0; i < vmc->nr_interfaces; ++i) {
+		struct vm_class *vmi = vmc->interfaces[i];
+
+		add_secondary_super(vmc, vmi);
+
+		for (unsigned int j = 0; j < vmi->nr_secondary_supers; ++j)
+			add_secondary_super(vmc, vmi->secondary_supers[j]);
+	}
+
+	return 0;
+}
+
 static int vm_class_link_common(struct vm_class *vmc)
 {
 	int err;
@@ -215,13 +293,14 @@ static void bucket_order_fields(struct field_bucket *bucket,
 }
 
 static void buckets_order_fields(struct field_bucket buckets[VM_TYPE_MAX],
-	unsigned int *ref_size, unsigned int *size)
+	unsigned int *ref_offset, unsigned int *size)
 {
 	unsigned int offset = *size;
 
 	/* We need to align here, because offset might be non-zero from the
 	 * parent class. */
 	offset = ALIGN(offset, sizeof(void *));
+	*ref_offset = offset;
 	bucket_order_fields(&buckets[J_REFERENCE], sizeof(void *), &offset);
 
 	/* Align with 8-byte boundary here. We don't need to align anything
@@ -368,10 +447,15 @@ int vm_class_link(struct vm_class *vmc, const struct cafebabe_class *class)
 		vmc->interfaces[i] = vmi;
 	}
 
+	vm_class_setup_primary_supers(vmc);
+
+	if (vm_class_setup_secondary_supers(vmc))
+		goto error_free_interfaces;
+
 	vmc->nr_fields = class->fields_count;
 	vmc->fields = vm_alloc(sizeof(*vmc->fields) * class->fields_count);
 	if (!vmc->fields)
-		goto error_free_interfaces;
+		goto error_free_secondary_supers;
 
 	for (uint16_t i = 0; i < vmc->nr_fields; ++i) {
 		struct vm_field *vmf = &vmc->fields[i];
@@ -424,12 +508,14 @@ int vm_class_link(struct vm_class *vmc, const struct cafebabe_class *class)
 		bucket->fields[bucket->nr++] = vmf;
 	}
 
-	unsigned int tmp;
-	buckets_order_fields(field_buckets[0], &tmp, &vmc->static_size);
-	buckets_order_fields(field_buckets[1], &tmp, &vmc->object_size);
+	buckets_order_fields(field_buckets[0], &vmc->static_ref_fields_offset, &vmc->static_size);
+	buckets_order_fields(field_buckets[1], &vmc->ref_fields_offset, &vmc->object_size);
+
+	vmc->nr_static_ref_fields = field_buckets[0][J_REFERENCE].nr;
+	vmc->nr_ref_fields = field_buckets[1][J_REFERENCE].nr;
 
 	/* XXX: only static fields, right size, etc. */
-	vmc->static_values = vm_zalloc(vmc->static_size);
+	vmc->static_values = vm_alloc_static_values(vmc, vmc->static_size);
 	if (!vmc->static_values)
 		goto error_free_buckets;
 
@@ -591,6 +677,8 @@ error_free_buckets:
 	free_buckets(2, VM_TYPE_MAX, field_buckets);
 error_free_fields:
 	vm_free(vmc->fields);
+error_free_secondary_supers:
+	free(vmc->secondary_supers);
 error_free_interfaces:
 	free(vmc->interfaces);
 error_free_name:
@@ -623,6 +711,11 @@ int vm_class_link_primitive_class(struct vm_class *vmc, const char *class_name)
 	vmc->fields = NULL;
 	vmc->methods = NULL;
 
+	vm_class_setup_primary_supers(vmc);
+	vmc->nr_secondary_supers = 0;
+	vmc->secondary_supers = NULL;
+	vmc->secondary_super_cache = NULL;
+
 	vmc->object_size = 0;
 	vmc->static_size = 0;
 
@@ -661,6 +754,15 @@ int vm_class_link_array_class(struct vm_class *vmc, struct vm_class *elem_class,
 	vmc->fields = NULL;
 	vmc->methods = NULL;
 
+	/*
+	 * Refer to the interfaces directly because java.lang.Cloneable may
+	 * not be loaded yet when the first array classes are linked.
+	 */
+	vm_class_setup_primary_supers(vmc);
+	vmc->nr_secondary_supers = vmc->nr_interfaces;
+	vmc->secondary_supers = vmc->interfaces;
+	vmc->secondary_super_cache = NULL;
+
 	vmc->object_size = 0;
 	vmc->static_size = 0;
 
@@ -692,6 +794,24 @@ int vm_class_ensure_object(struct vm_class *vmc)
 	return 0;
 }
 
+/*
+ * The class initializer is called exactly once so its machine code is
+ * dead once it returns. The method is only reachable through its
+ * trampoline which is not called again.
+ */
+static void vm_class_retire_clinit(struct vm_method *vmm)
+{
+	struct compilation_unit *cu = vmm->compilation_unit;
+
+	/* Wait for a compiler thread that is still compiling it. */
+	pthread_mutex_lock(&cu->compile_mutex);
+
+	if (cu->state == COMPILATION_STATE_COMPILED && !cu->code_retired)
+		retire_compilation_unit(cu);
+
+	pthread_mutex_unlock(&cu->compile_mutex);
+}
+
 int vm_class_init(struct vm_class *vmc)
 {
 	struct vm_object *exception;
@@ -746,6 +866,7 @@ int vm_class_init(struct vm_class *vmc)
 				= vm_method_trampoline_ptr(&vmc->methods[i]);
 
 			clinit_trampoline();
+			vm_class_retire_clinit(&vmc->methods[i]);
 			if (exception_occurred())
 				goto error;
 		}
@@ -1017,6 +1138,25 @@ struct vm_method *vm_class_get_method_recursive(const struct vm_class *vmc,
 	return NULL;
 }
 
+/*
+ * Returns the method that a virtual invocation of @vmm dispatches to when
+ * the receiver is an instance of @vmc.
+ */
+struct vm_method *vm_class_get_virtual_method(const struct vm_class *vmc,
+	struct vm_method *vmm)
+{
+	struct vm_method *target;
+
+	if (!method_is_virtual(vmm) || vm_method_is_final(vmm) || vmc == vmm->class)
+		return vmm;
+
+	target = vm_class_get_method_recursive(vmc, vmm->name, vmm->type);
+	if (!target)
+		return vmm;
+
+	return target;
+}
+
 static struct vm_method *vm_class_get_interface_method_recursive(
 	const struct vm_class *vmc, const char *name, const char *type)
 {
@@ -1233,79 +1373,50 @@ bool vm_class_is_anonymous(const struct vm_class *vmc)
 	return is_numeric(separator + 1);
 }
 
-static void supertype_cache_update(struct vm_class *vmc, const struct vm_class *super)
-{
-	unsigned int ndx = vmc->supertype_cache_ndx++ % SUPERTYPE_CACHE_SIZE;
-
-	vmc->supertype_cache[ndx]       = super;
-}
-
-static bool vm_class_is_subclass_of(const struct vm_class *vmc, const struct vm_class *from)
+static bool vm_class_is_instance_of_array(struct vm_class *vmc, const struct vm_class *from)
 {
-	struct vm_class *super = from->super;
-
-	while (super) {
-		if (vmc == super)
-			return true;
-
-		super = super->super;
-	}
-
-	return false;
-}
-
-static bool vm_class_is_assignable_from_nocache(const struct vm_class *vmc, const struct vm_class *from);
+	struct vm_class *vmc_el, *from_el;
 
-static bool vm_class_is_instance_of_array(const struct vm_class *vmc, const struct vm_class *from)
-{
 	if (!vm_class_is_array_class(from))
 		return false;
 
-	struct vm_class *vmc_el = vm_class_get_array_element_class(vmc);
+	vmc_el = vm_class_get_array_element_class(vmc);
+	from_el = vm_class_get_array_element_class(from);
 
-	struct vm_class *from_el = vm_class_get_array_element_class(vmc);
+	/* Arrays of primitive types are only assignable to themselves. */
+	if (vm_class_is_primitive_class(vmc_el) || vm_class_is_primitive_class(from_el))
+		return vmc_el == from_el;
 
-	return vm_class_is_assignable_from_nocache(vmc_el, from_el);
+	return vm_class_is_assignable_from(vmc_el, from_el);
 }
 
-static bool vm_class_implements(const struct vm_class *vmc, const struct vm_class *from)
+/* Reference: http://download.oracle.com/javase/1.5.0/docs/api/java/lang/Class.html#isAssignableFrom(java.lang.Class) */
+bool vm_class_is_assignable_from_slow(struct vm_class *vmc, const struct vm_class *from)
 {
-	for (unsigned int i = 0; i < from->nr_interfaces; ++i) {
-		if (vmc == from->interfaces[i] || vm_class_implements(vmc, from->interfaces[i]))
-			return true;
-	}
+	struct vm_class *mutable_from = (struct vm_class *) from;
 
-	if (from->super)
-		return vm_class_implements(vmc, from->super);
+	if (vm_class_is_primary_type(vmc))
+		return from->primary_supers[vmc->depth] == vmc;
 
-	return false;
-}
-
-static bool vm_class_is_assignable_from_nocache(const struct vm_class *vmc, const struct vm_class *from)
-{
 	if (vmc == from)
 		return true;
 
-	if (vm_class_is_interface(vmc))
-		return vm_class_implements(vmc, from);
-
-	if (vm_class_is_array_class(vmc))
-		return vm_class_is_instance_of_array(vmc, from);
-
-	return vm_class_is_subclass_of(vmc, from);
-}
-
-/* Reference: http://download.oracle.com/javase/1.5.0/docs/api/java/lang/Class.html#isAssignableFrom(java.lang.Class) */
-bool vm_class_is_assignable_from_slow(struct vm_class *vmc, const struct vm_class *from)
-{
-	bool ret;
-
-	ret = vm_class_is_assignable_from_nocache(vmc, from);
+	for (unsigned int i = 0; i < from->nr_secondary_supers; ++i) {
+		if (from->secondary_supers[i] == vmc)
+			goto found;
+	}
 
-	if (ret)
-		supertype_cache_update(vmc, from);
+	if (vm_class_is_array_class(vmc) && vm_class_is_instance_of_array(vmc, from))
+		goto found;
 
-	return ret;
+	return false;
+found:
+	/*
+	 * Racing updates are harmless: the cache only ever holds some
+	 * supertype of 'from'.
+	 */
+	mutable_from->secondary_super_cache = vmc;
+	return true;
 }
 
 char *vm_class_get_array_element_class_name(const char *class_name)
@@ -1352,8 +1463,13 @@ struct vm_class *vm_class_get_array_class(struct vm_class *element_class)
 	struct vm_class *result;
 	char *name;
 
-	if (!asprintf(&name, "[L%s;", element_class->name))
-		return throw_oom_error();
+	if (vm_class_is_array_class(element_class)) {
+		if (!asprintf(&name, "[%s", element_class->name))
+			return throw_oom_error();
+	} else {
+		if (!asprintf(&name, "[L%s;", element_class->name))
+			return throw_oom_error();
+	}
 
 	result = classloader_load(element_class->classloader, name);
 	free(name);
@@ -0,0 +1,694 @@
+/*
+ * Heap of the precise garbage collector
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "vm/gc-heap.h"
+
+#include "lib/bitset.h"
+
+#include "arch/cmpxchg.h"
+
+#include "vm/system.h"
+
+#include <sys/mman.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+/*
+ * Small objects are allocated from segregated free lists, one per size
+ * class, which are rebuilt by every sweep. Large objects take a span of
+ * whole blocks. Blocks that become empty are returned to the kernel so
+ * that the resident size of the heap follows the live data.
+ *
+ * The generational mode does not move objects. A young collection marks
+ * from the roots and from the old objects on dirty cards without tracing
+ * through old objects and sweeps without clearing the mark bits, so the
+ * survivors are promoted in place. Young objects can't be copied out of
+ * a nursery because native and interpreter frames are scanned
+ * conservatively and any object they might point to has to stay put.
+ * Young collections are cheaper than full ones because they only trace
+ * and sweep the young objects, not because they copy fewer bytes.
+ */
+
+enum gc_block_kind {
+	GC_BLOCK_FREE,
+	GC_BLOCK_SMALL,
+	GC_BLOCK_LARGE,
+	GC_BLOCK_LARGE_CONT,
+};
+
+struct gc_block {
+	unsigned char		kind;
+	unsigned char		size_class;
+
+	/* First block of the span for GC_BLOCK_LARGE_CONT blocks. */
+	unsigned long		head;
+
+	/* Number of blocks in the span for GC_BLOCK_LARGE blocks. */
+	unsigned long		nr_blocks;
+};
+
+#define GC_NR_GRANULES_PER_BLOCK	(GC_BLOCK_SIZE / GC_GRANULE_SIZE)
+#define GC_MAX_SMALL_GRANULES		(GC_MAX_SMALL_SIZE / GC_GRANULE_SIZE)
+#define GC_NR_SIZE_CLASSES		32
+
+/* Minimum number of blocks that may be in use before a collection. */
+#define GC_MIN_THRESHOLD		64
+
+static void			*heap_start;
+static unsigned long		nr_blocks;
+static struct gc_block		*blocks;
+
+static unsigned long		*alloc_bits;
+static unsigned long		*mark_bits;
+static unsigned long		bitmap_size;
+
+static unsigned long		size_classes[GC_NR_SIZE_CLASSES];
+static unsigned char		size_class_index[GC_MAX_SMALL_GRANULES + 1];
+static void			*free_lists[GC_NR_SIZE_CLASSES];
+
+static unsigned long		nr_used_blocks;
+static unsigned long		used_bytes;
+static unsigned long		initial_threshold;
+static unsigned long		threshold;
+
+static uint8_t			*cards;
+static unsigned long		nr_cards;
+
+/* Bytes allocated since the last collection and the limit for them. */
+static unsigned long		young_bytes;
+static unsigned long		nursery_size;
+
+/* Bytes allocated since the heap was created. */
+static unsigned long		allocated_bytes;
+
+uint8_t				*gc_card_table;
+unsigned long			gc_heap_start_addr;
+unsigned long			gc_heap_end_addr;
+
+/* Hint for the search of free blocks. */
+static unsigned long		next_free_block;
+
+static void *block_addr(unsigned long idx)
+{
+	return heap_start + idx * GC_BLOCK_SIZE;
+}
+
+static unsigned long addr_to_granule(void *p)
+{
+	return (p - heap_start) / GC_GRANULE_SIZE;
+}
+
+static void *mmap_noreserve(unsigned long size)
+{
+	void *p;
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+
+	return p;
+}
+
+/*
+ * The size classes are multiples of the granule up to 128 bytes and then
+ * four classes per power of two, which bounds internal fragmentation to
+ * 25%.
+ */
+static void init_size_classes(void)
+{
+	unsigned long size, step, idx = 0, granules;
+
+	for (size = GC_GRANULE_SIZE; size <= 128; size += GC_GRANULE_SIZE)
+		size_classes[idx++] = size;
+
+	size = 128;
+
+	for (step = 32; idx < GC_NR_SIZE_CLASSES; step *= 2) {
+		for (unsigned int i = 0; i < 4; i++) {
+			size += step;
+			size_classes[idx++] = size;
+		}
+	}
+
+	assert(size_classes[GC_NR_SIZE_CLASSES - 1] == GC_MAX_SMALL_SIZE);
+
+	idx = 0;
+	for (granules = 0; granules <= GC_MAX_SMALL_GRANULES; granules++) {
+		while (size_classes[idx] < granules * GC_GRANULE_SIZE)
+			idx++;
+
+		size_class_index[granules] = idx;
+	}
+}
+
+int gc_heap_init(unsigned long size)
+{
+	nr_blocks = size / GC_BLOCK_SIZE;
+	if (!nr_blocks)
+		return -EINVAL;
+
+	heap_start = mmap_noreserve(nr_blocks * GC_BLOCK_SIZE);
+	if (!heap_start)
+		return -ENOMEM;
+
+	gc_heap_start_addr	= (unsigned long) heap_start;
+	gc_heap_end_addr	= (unsigned long) block_addr(nr_blocks);
+
+	blocks = mmap_noreserve(nr_blocks * sizeof(struct gc_block));
+	if (!blocks)
+		return -ENOMEM;
+
+	bitmap_size = nr_blocks * GC_NR_GRANULES_PER_BLOCK / BITS_PER_LONG * sizeof(unsigned long);
+
+	alloc_bits = mmap_noreserve(bitmap_size);
+	if (!alloc_bits)
+		return -ENOMEM;
+
+	mark_bits = mmap_noreserve(bitmap_size);
+	if (!mark_bits)
+		return -ENOMEM;
+
+	init_size_classes();
+
+	initial_threshold = max(nr_blocks / 8, (unsigned long) GC_MIN_THRESHOLD);
+	threshold = initial_threshold = min(initial_threshold, nr_blocks);
+
+	return 0;
+}
+
+/*
+ * Enables the generational mode. A young collection is due when
+ * @size bytes have been allocated since the last collection.
+ */
+int gc_heap_init_cards(unsigned long size)
+{
+	nr_cards = nr_blocks * (GC_BLOCK_SIZE / GC_CARD_SIZE);
+
+	cards = mmap_noreserve(nr_cards);
+	if (!cards)
+		return -ENOMEM;
+
+	gc_card_table = (void *) ((unsigned long) cards - (gc_heap_start_addr >> GC_CARD_SHIFT));
+
+	nursery_size = size;
+
+	return 0;
+}
+
+static long find_free_blocks(unsigned long count)
+{
+	unsigned long idx, run = 0;
+
+	for (idx = next_free_block; idx < nr_blocks; idx++) {
+		if (blocks[idx].kind != GC_BLOCK_FREE) {
+			run = 0;
+			continue;
+		}
+
+		if (++run == count)
+			return idx - count + 1;
+	}
+
+	run = 0;
+
+	for (idx = 0; idx < nr_blocks; idx++) {
+		if (blocks[idx].kind != GC_BLOCK_FREE) {
+			run = 0;
+			continue;
+		}
+
+		if (++run == count)
+			return idx - count + 1;
+	}
+
+	return -1;
+}
+
+static bool may_use_blocks(unsigned long count, bool force)
+{
+	if (nr_used_blocks + count > nr_blocks)
+		return false;
+
+	return force || nr_used_blocks + count <= threshold;
+}
+
+/*
+ * Carves a fresh block into cells of the size class and puts them on the
+ * free list.
+ */
+static bool refill_free_list(unsigned int class, bool force)
+{
+	unsigned long size = size_classes[class];
+	unsigned long nr_cells, i;
+	void *start;
+	long idx;
+
+	if (!may_use_blocks(1, force))
+		return false;
+
+	idx = find_free_blocks(1);
+	if (idx < 0)
+		return false;
+
+	blocks[idx].kind	= GC_BLOCK_SMALL;
+	blocks[idx].size_class	= class;
+	nr_used_blocks++;
+	next_free_block		= idx + 1;
+
+	start = block_addr(idx);
+	nr_cells = GC_BLOCK_SIZE / size;
+
+	for (i = nr_cells; i > 0; i--) {
+		void **cell = start + (i - 1) * size;
+
+		*cell = free_lists[class];
+		free_lists[class] = cell;
+	}
+
+	return true;
+}
+
+static void *alloc_small(size_t size, bool force)
+{
+	unsigned int class;
+	void **cell;
+
+	class = size_class_index[DIV_ROUND_UP(size, GC_GRANULE_SIZE)];
+
+	if (!free_lists[class] && !refill_free_list(class, force))
+		return NULL;
+
+	cell = free_lists[class];
+	free_lists[class] = *cell;
+
+	memset(cell, 0, size_classes[class]);
+	set_bit(alloc_bits, addr_to_granule(cell));
+	used_bytes += size_classes[class];
+	young_bytes += size_classes[class];
+	allocated_bytes += size_classes[class];
+
+	return cell;
+}
+
+static void *alloc_large(size_t size, bool force)
+{
+	unsigned long count, i;
+	long idx;
+
+	count = DIV_ROUND_UP(size, GC_BLOCK_SIZE);
+
+	if (!may_use_blocks(count, force))
+		return NULL;
+
+	idx = find_free_blocks(count);
+	if (idx < 0)
+		return NULL;
+
+	blocks[idx].kind	= GC_BLOCK_LARGE;
+	blocks[idx].nr_blocks	= count;
+
+	for (i = 1; i < count; i++) {
+		blocks[idx + i].kind	= GC_BLOCK_LARGE_CONT;
+		blocks[idx + i].head	= idx;
+	}
+
+	nr_used_blocks += count;
+	used_bytes += count * GC_BLOCK_SIZE;
+	young_bytes += count * GC_BLOCK_SIZE;
+	allocated_bytes += count * GC_BLOCK_SIZE;
+
+	/* Blocks are cleared when they are freed. */
+	set_bit(alloc_bits, addr_to_granule(block_addr(idx)));
+
+	return block_addr(idx);
+}
+
+/*
+ * Returns a cleared object of @size bytes or NULL if the heap is full.
+ * Unless @force is set, NULL is also returned when the allocation would
+ * exceed the collection threshold or the nursery is full.
+ */
+void *gc_heap_alloc(size_t size, bool force)
+{
+	if (!size)
+		size = 1;
+
+	if (!force && nursery_size && young_bytes >= nursery_size)
+		return NULL;
+
+	if (size <= GC_MAX_SMALL_SIZE)
+		return alloc_small(size, force);
+
+	return alloc_large(size, force);
+}
+
+/*
+ * Returns the start of the allocated object that contains @addr or NULL
+ * if @addr does not point into an allocated object.
+ */
+void *gc_heap_find_object(unsigned long addr)
+{
+	unsigned long idx, size, cell;
+	struct gc_block *block;
+	void *p = (void *) addr;
+	void *start;
+
+	if (p < heap_start || p >= block_addr(nr_blocks))
+		return NULL;
+
+	idx = (p - heap_start) / GC_BLOCK_SIZE;
+	block = &blocks[idx];
+
+	switch (block->kind) {
+	case GC_BLOCK_SMALL:
+		size = size_classes[block->size_class];
+		cell = (p - block_addr(idx)) / size;
+		if (cell >= GC_BLOCK_SIZE / size)
+			return NULL;
+
+		start = block_addr(idx) + cell * size;
+		break;
+	case GC_BLOCK_LARGE_CONT:
+		start = block_addr(block->head);
+		break;
+	case GC_BLOCK_LARGE:
+		start = block_addr(idx);
+		break;
+	default:
+		return NULL;
+	}
+
+	if (!test_bit(alloc_bits, addr_to_granule(start)))
+		return NULL;
+
+	return start;
+}
+
+/*
+ * Returns the number of bytes the heap reserves for @obj which is at
+ * least the requested size.
+ */
+unsigned long gc_heap_object_size(void *obj)
+{
+	unsigned long idx = (obj - heap_start) / GC_BLOCK_SIZE;
+	struct gc_block *block = &blocks[idx];
+
+	if (block->kind == GC_BLOCK_SMALL)
+		return size_classes[block->size_class];
+
+	return block->nr_blocks * GC_BLOCK_SIZE;
+}
+
+/*
+ * Marks @obj and returns true if it was not marked before. The GC
+ * workers mark concurrently so the bit is set atomically and only one
+ * of them wins.
+ */
+bool gc_heap_mark(void *obj)
+{
+	unsigned long granule = addr_to_granule(obj);
+	unsigned long *word = mark_bits + granule / BITS_PER_LONG;
+	unsigned long mask = bit_mask(granule);
+	unsigned long old;
+
+	do {
+		old = *(volatile unsigned long *) word;
+		if (old & mask)
+			return false;
+	} while (cmpxchg_ptr(word, (void *) old, (void *) (old | mask)) != (void *) old);
+
+	return true;
+}
+
+bool gc_heap_is_marked(void *obj)
+{
+	return test_bit(mark_bits, addr_to_granule(obj));
+}
+
+void gc_heap_clear_marks(void)
+{
+	memset(mark_bits, 0, bitmap_size);
+}
+
+void gc_heap_for_each_marked(void (*fn)(void *obj))
+{
+	unsigned long idx, size, i;
+
+	for (idx = 0; idx < nr_blocks; idx++) {
+		struct gc_block *block = &blocks[idx];
+		void *start = block_addr(idx);
+
+		switch (block->kind) {
+		case GC_BLOCK_SMALL:
+			size = size_classes[block->size_class];
+
+			for (i = 0; i < GC_BLOCK_SIZE / size; i++) {
+				void *obj = start + i * size;
+
+				if (gc_heap_is_marked(obj))
+					fn(obj);
+			}
+			break;
+		case GC_BLOCK_LARGE:
+			if (gc_heap_is_marked(start))
+				fn(start);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/*
+ * Calls @fn for every old object that overlaps a dirty card in part
+ * @part of @nr_parts equal parts of the card table. Objects that span
+ * several dirty cards are only visited once per part.
+ */
+void gc_heap_for_each_dirty(void (*fn)(void *obj), unsigned long part, unsigned long nr_parts)
+{
+	unsigned long nr_words = nr_cards / sizeof(unsigned long);
+	unsigned long *words = (unsigned long *) cards;
+	unsigned long card, i, first, last, size, end;
+	void *prev = NULL;
+
+	i	= nr_words * part / nr_parts;
+	end	= nr_words * (part + 1) / nr_parts;
+
+	for (; i < end; i++) {
+		if (!words[i])
+			continue;
+
+		for (card = i * sizeof(unsigned long); card < (i + 1) * sizeof(unsigned long); card++) {
+			unsigned long idx = card / (GC_BLOCK_SIZE / GC_CARD_SIZE);
+			struct gc_block *block = &blocks[idx];
+			void *start = block_addr(idx);
+			void *addr;
+
+			if (cards[card] == GC_CARD_CLEAN)
+				continue;
+
+			addr = heap_start + card * GC_CARD_SIZE;
+
+			switch (block->kind) {
+			case GC_BLOCK_SMALL:
+				size = size_classes[block->size_class];
+
+				first = (addr - start) / size;
+				last = min((addr + GC_CARD_SIZE - 1 - start) / size, GC_BLOCK_SIZE / size - 1);
+				break;
+			case GC_BLOCK_LARGE_CONT:
+				start = block_addr(block->head);
+				/* fall through */
+			case GC_BLOCK_LARGE:
+				size = first = last = 0;
+				break;
+			default:
+				continue;
+			}
+
+			for (; first <= last; first++) {
+				void *obj = start + first * size;
+				unsigned long granule = addr_to_granule(obj);
+
+				if (obj == prev)
+					continue;
+
+				if (!test_bit(alloc_bits, granule) || !test_bit(mark_bits, granule))
+					continue;
+
+				fn(obj);
+				prev = obj;
+			}
+		}
+	}
+}
+
+void gc_heap_clear_cards(void)
+{
+	if (cards)
+		memset(cards, GC_CARD_CLEAN, nr_cards);
+}
+
+/*
+ * A full collection is due when the heap has grown to the threshold. In
+ * the non-generational mode every collection is full.
+ */
+bool gc_heap_needs_full_gc(void)
+{
+	return !nursery_size || nr_used_blocks >= threshold;
+}
+
+/*
+ * Starts a new nursery without a collection. Used when the world can not
+ * be stopped yet during bootstrap.
+ */
+void gc_heap_reset_nursery(void)
+{
+	young_bytes = 0;
+}
+
+static void free_blocks(unsigned long idx, unsigned long count)
+{
+	for (unsigned long i = 0; i < count; i++)
+		blocks[idx + i].kind = GC_BLOCK_FREE;
+
+	nr_used_blocks -= count;
+
+	/* The kernel hands out zeroed pages on the next access. */
+	madvise(block_addr(idx), count * GC_BLOCK_SIZE, MADV_DONTNEED);
+
+	if (idx < next_free_block)
+		next_free_block = idx;
+}
+
+static void sweep_small_block(unsigned long idx)
+{
+	struct gc_block *block = &blocks[idx];
+	unsigned long size, nr_cells, nr_live = 0, i;
+	void *start = block_addr(idx);
+	void *free_list, **tail;
+
+	size = size_classes[block->size_class];
+	nr_cells = GC_BLOCK_SIZE / size;
+
+	free_list = NULL;
+	tail = &free_list;
+
+	for (i = 0; i < nr_cells; i++) {
+		void **cell = start + i * size;
+		unsigned long granule = addr_to_granule(cell);
+
+		if (test_bit(alloc_bits, granule)) {
+			if (test_bit(mark_bits, granule)) {
+				nr_live++;
+				continue;
+			}
+
+			clear_bit(alloc_bits, granule);
+		}
+
+		*tail = cell;
+		tail = (void **) cell;
+	}
+
+	if (!nr_live) {
+		free_blocks(idx, 1);
+		return;
+	}
+
+	used_bytes += nr_live * size;
+
+	*tail = free_lists[block->size_class];
+	free_lists[block->size_class] = free_list;
+}
+
+/*
+ * Frees all allocated objects that are not marked. After a @full
+ * collection the threshold for the next one is set relative to the
+ * amount of live data. The mark bits are left alone, see
+ * gc_heap_clear_marks().
+ */
+void gc_heap_sweep(bool full)
+{
+	unsigned long idx;
+
+	memset(free_lists, 0, sizeof(free_lists));
+	used_bytes = 0;
+
+	for (idx = 0; idx < nr_blocks; idx++) {
+		struct gc_block *block = &blocks[idx];
+		unsigned long granule;
+
+		switch (block->kind) {
+		case GC_BLOCK_SMALL:
+			sweep_small_block(idx);
+			break;
+		case GC_BLOCK_LARGE:
+			granule = addr_to_granule(block_addr(idx));
+
+			if (test_bit(mark_bits, granule)) {
+				used_bytes += block->nr_blocks * GC_BLOCK_SIZE;
+				break;
+			}
+
+			clear_bit(alloc_bits, granule);
+			free_blocks(idx, block->nr_blocks);
+			break;
+		default:
+			break;
+		}
+	}
+
+	young_bytes = 0;
+
+	if (!full)
+		return;
+
+	threshold = max(initial_threshold, 2 * nr_used_blocks);
+	threshold = min(threshold, nr_blocks);
+}
+
+unsigned long gc_heap_used(void)
+{
+	return used_bytes;
+}
+
+unsigned long gc_heap_committed(void)
+{
+	return nr_used_blocks * GC_BLOCK_SIZE;
+}
+
+unsigned long gc_heap_allocated(void)
+{
+	return allocated_bytes;
+}
+
+unsigned long gc_heap_size(void)
+{
+	return nr_blocks * GC_BLOCK_SIZE;
+}
@@ -0,0 +1,172 @@
+/*
+ * Machine-readable log of garbage collections
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "vm/gc-log.h"
+
+#include "vm/class.h"
+#include "vm/die.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/*
+ * Every collection is written as one JSON object on a line of its own:
+ *
+ *   {"gc":3,"type":"young","start_us":120533,"pause_us":2210,
+ *    "safepoint_us":85,"allocated":1048576,"used_before":5242880,
+ *    "used_after":1310720,"committed":2097152,"max":134217728,
+ *    "classes":[{"class":"[C","objects":2018,"bytes":98304},...]}
+ *
+ * The class histogram covers the live objects after marking. It is
+ * collected while the world is stopped so its table is allocated up
+ * front and classes that don't fit are not counted.
+ */
+
+#define GC_LOG_HISTOGRAM_SIZE	4096
+
+const char			*gc_log_file;
+FILE				*gc_log;
+
+static struct gc_class_stats	*histogram;
+static struct timespec		vm_start;
+
+int gc_log_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &vm_start);
+
+	if (!gc_log_file)
+		return 0;
+
+	histogram = calloc(GC_LOG_HISTOGRAM_SIZE, sizeof(*histogram));
+	if (!histogram)
+		return -ENOMEM;
+
+	gc_log = fopen(gc_log_file, "w");
+	if (!gc_log)
+		return -errno;
+
+	return 0;
+}
+
+unsigned long gc_log_uptime_us(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - vm_start.tv_sec) * 1000000 + (now.tv_nsec - vm_start.tv_nsec) / 1000;
+}
+
+/*
+ * Called for every live object while the world is stopped.
+ */
+void gc_log_count_object(struct vm_class *vmc, unsigned long size)
+{
+	unsigned long hash = ((unsigned long) vmc >> 4) % GC_LOG_HISTOGRAM_SIZE;
+
+	for (unsigned int i = 0; i < GC_LOG_HISTOGRAM_SIZE; i++) {
+		struct gc_class_stats *stats = &histogram[(hash + i) % GC_LOG_HISTOGRAM_SIZE];
+
+		if (!stats->vmc)
+			stats->vmc = vmc;
+
+		if (stats->vmc != vmc)
+			continue;
+
+		stats->nr_objects++;
+		stats->nr_bytes += size;
+		return;
+	}
+}
+
+/*
+ * Moves the classes with the most live bytes to @event and clears the
+ * histogram for the next collection.
+ */
+void gc_log_top_classes(struct gc_event *event)
+{
+	event->nr_classes = 0;
+
+	for (unsigned int i = 0; i < GC_LOG_HISTOGRAM_SIZE; i++) {
+		struct gc_class_stats *stats = &histogram[i];
+		unsigned int pos;
+
+		if (!stats->vmc)
+			continue;
+
+		pos = event->nr_classes;
+		while (pos > 0 && event->classes[pos - 1].nr_bytes < stats->nr_bytes) {
+			if (pos < GC_LOG_NR_TOP_CLASSES)
+				event->classes[pos] = event->classes[pos - 1];
+			pos--;
+		}
+
+		if (pos < GC_LOG_NR_TOP_CLASSES)
+			event->classes[pos] = *stats;
+
+		if (event->nr_classes < GC_LOG_NR_TOP_CLASSES)
+			event->nr_classes++;
+
+		memset(stats, 0, sizeof(*stats));
+	}
+}
+
+static void gc_log_string(const char *s)
+{
+	fputc('"', gc_log);
+
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fputc('\\', gc_log);
+
+		fputc(*s, gc_log);
+	}
+
+	fputc('"', gc_log);
+}
+
+void gc_log_event(struct gc_event *event)
+{
+	fprintf(gc_log, "{\"gc\":%lu,\"type\":\"%s\",\"start_us\":%lu,\"pause_us\":%lu,"
+		"\"safepoint_us\":%lu,\"allocated\":%lu,\"used_before\":%lu,"
+		"\"used_after\":%lu,\"committed\":%lu,\"max\":%lu,\"classes\":[",
+		event->id, event->full ? "full" : "young", event->start_us,
+		event->pause_us, event->safepoint_us, event->allocated,
+		event->used_before, event->used_after, event->committed, event->max);
+
+	for (unsigned int i = 0; i < event->nr_classes; i++) {
+		struct gc_class_stats *stats = &event->classes[i];
+
+		fprintf(gc_log, "%s{\"class\":", i ? "," : "");
+		gc_log_string(stats->vmc->name);
+		fprintf(gc_log, ",\"objects\":%lu,\"bytes\":%lu}", stats->nr_objects, stats->nr_bytes);
+	}
+
+	fprintf(gc_log, "]}\n");
+	fflush(gc_log);
+}
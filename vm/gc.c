@@ -31,16 +31,24 @@
  */
 
 #include "arch/registers.h"
+#include "arch/atomic.h"
 #include "arch/memory.h"
 
 #include "sys/signal.h"
 
 #include "jit/compilation-unit.h"
 #include "jit/cu-mapping.h"
+#include "jit/compiler.h"
+#include "jit/exception.h"
+#include "jit/gc-map.h"
+#include "jit/text.h"
 
 #include "lib/guard-page.h"
+#include "lib/bitset.h"
 #include "lib/string.h"
 
+#include "vm/gc-heap.h"
+#include "vm/gc-log.h"
 #include "vm/stdlib.h"
 #include "vm/thread.h"
 #include "vm/method.h"
@@ -49,11 +57,44 @@
 #include "vm/die.h"
 #include "vm/gc.h"
 
+#include <sys/mman.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * The collector is a non-moving mark and sweep collector. Java objects
+ * live in the heap of vm/gc-heap.c. The roots are found precisely where
+ * the VM knows the types:
+ *
+ *   - JIT frames that are stopped at a safepoint poll or at a call are
+ *     described by the GC maps of their compilation unit, see
+ *     include/jit/gc-map.h.
+ *
+ *   - Static fields are allocated with vm_alloc_static_values() and only
+ *     their reference fields are scanned.
+ *
+ *   - JNI global references and other VM references are strong
+ *     vm_references which live in vm_alloc() memory.
+ *
+ * Everything else is scanned conservatively: native and interpreter
+ * frames, JIT frames without a GC map such as stubs, the vm_alloc()
+ * regions and the data and bss sections. Conservative roots only keep
+ * objects alive, they never cause an object to be freed because every
+ * word is resolved to an allocated object by the heap first.
+ *
+ * Marking runs on the GC thread and a pool of GC worker threads. The
+ * roots are split into tasks, one per thread stack plus a few for the
+ * other root sets, which the workers claim one at a time. Every worker
+ * has its own mark stack and workers that run out of work steal from
+ * the others.
+ */
 
 void *gc_safepoint_page;
 
@@ -67,129 +108,930 @@ pthread_spinlock_t gc_spinlock;
 static int nr_in_safepoint;
 static int nr_threads;
 
+/*
+ * Set while the GC stops the world. Suspend signals that arrive when it
+ * is not set are left overs from re-sent signals and are ignored.
+ */
+static volatile sig_atomic_t gc_stopping;
+
+/* The threads don't block the suspend signals before this is set. */
+static bool gc_signals_ready;
+
 static pthread_t gc_thread_id;
 
-unsigned long max_heap_size	= 128 * 1024 * 1024;	/* 128 MB */
+/*
+ * Protects the heap, the vm_alloc() regions and the finalizers. The GC
+ * thread holds it while the world is stopped so no stopped thread can be
+ * in the middle of an allocation.
+ */
+static pthread_mutex_t	gc_heap_mutex		= PTHREAD_MUTEX_INITIALIZER;
+
+unsigned long max_heap_size	= 128 * 1024 * 1024;	/* 128 MB */
+
+bool				newgc_enabled;
+bool				gc_generational;
+unsigned long			gc_nursery_size;
+bool				verbose_gc;
+int				dont_gc;
+
+/* protected by gc_heap_mutex */
+static unsigned long		gc_nr_collections;
+static unsigned long		gc_total_pause_us;
+static unsigned long		gc_peak_used;
+static unsigned long		gc_used_after;
+static unsigned long		gc_committed_after;
+static unsigned long		gc_last_allocated;
+
+struct gc_operations		gc_ops;
+
+/* How long to wait for threads before they are signalled again. */
+#define GC_SUSPEND_TIMEOUT_NS	(10 * 1000 * 1000)
+
+#define GC_MARK_STACK_SIZE	(64 * 1024)
+
+#define GC_MAX_WORKERS		64
+
+/* Maximum number of mark stack entries taken by one steal. */
+#define GC_STEAL_BATCH		64
+
+/* Number of root tasks the dirty cards are split into. */
+#define GC_NR_CARD_TASKS	64
+
+/* Lower bound of the default nursery size which is 1/32 of the heap. */
+#define GC_MIN_NURSERY_SIZE	(1024 * 1024UL)
+
+/*
+ * The entries in [bottom, top) of the mark stack are pending. The owner
+ * pushes and pops at the top, thieves take the oldest entries from the
+ * bottom because those tend to have the most work behind them.
+ */
+struct gc_worker {
+	unsigned int		id;
+	pthread_t		thread;
+	pthread_spinlock_t	lock;
+	void			**stack;
+	unsigned long		bottom;
+	unsigned long		top;
+};
+
+static struct gc_worker		gc_workers[GC_MAX_WORKERS];
+static unsigned int		gc_nr_workers;
+static __thread struct gc_worker *gc_self;
+static bool			mark_stack_overflow;
+
+unsigned int			opt_nr_gc_threads;
+
+/*
+ * A mark phase is started by bumping the generation. The workers that
+ * run out of work count themselves as idle and the phase is over when
+ * all of them are.
+ */
+static pthread_mutex_t		gc_work_mutex		= PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t		gc_work_cond		= PTHREAD_COND_INITIALIZER;
+static pthread_cond_t		gc_work_done_cond	= PTHREAD_COND_INITIALIZER;
+static unsigned long		gc_work_generation;
+static unsigned int		gc_nr_busy_workers;
+
+static bool			gc_phase_roots;
+static bool			gc_phase_full;
+static atomic_t			gc_next_root_task;
+static atomic_t			gc_nr_idle_workers;
+
+/*
+ * Every vm_alloc() region starts with this header. The regions are kept
+ * on a list so that the GC can scan them.
+ */
+struct vm_alloc_region {
+	struct list_head	node;
+
+	/* The class whose static values are in the region or NULL. */
+	struct vm_class		*statics_class;
+
+	/* Set for the execution environment of a stopped thread. */
+	bool			exec_env;
+
+	size_t			size;
+} __attribute__((aligned(16)));
+
+static struct list_head vm_alloc_regions = LIST_HEAD_INIT(vm_alloc_regions);
+
+struct gc_finalizer {
+	struct vm_object	*object;
+	finalizer_fn		finalizer;
+	struct gc_finalizer	*next;
+};
+
+#define GC_FINALIZER_HASH_SIZE	1024
+
+/* Objects with a finalizer that are still reachable */
+static struct gc_finalizer	*finalizers[GC_FINALIZER_HASH_SIZE];
+
+/*
+ * Objects that were found unreachable and whose finalizers have not run
+ * yet. They are roots until then.
+ */
+static struct gc_finalizer	*pending_finalizers;
+
+static __thread bool		running_finalizers;
+
+extern char __data_start[], _end[];
+
+static void gc_heap_lock(void)
+{
+	if (pthread_mutex_lock(&gc_heap_mutex) != 0)
+		die("pthread_mutex_lock");
+}
+
+static void gc_heap_unlock(void)
+{
+	if (pthread_mutex_unlock(&gc_heap_mutex) != 0)
+		die("pthread_mutex_unlock");
+}
+
+static void hide_safepoint_guard_page(void)
+{
+	hide_guard_page(gc_safepoint_page);
+}
+
+static void unhide_safepoint_guard_page(void)
+{
+	unhide_guard_page(gc_safepoint_page);
+}
+
+static void suspend_self(void)
+{
+	sigset_t mask;
+	int sig;
+
+	if (sigemptyset(&mask) != 0)
+		die("sigemptyset");
+
+	if (sigaddset(&mask, SIGUSR2) != 0)
+		die("sigaddset");
+
+	if (sigwait(&mask, &sig) != 0)
+		die("sigwait");
+
+	if (sig != SIGUSR2)
+		die("wrong signal");
+}
+
+/*
+ * Like suspend_self() but gives up after GC_SUSPEND_TIMEOUT_NS. Returns
+ * true if the thread was woken up.
+ */
+static bool suspend_self_timeout(void)
+{
+	struct timespec timeout = {
+		.tv_sec		= 0,
+		.tv_nsec	= GC_SUSPEND_TIMEOUT_NS,
+	};
+	sigset_t mask;
+
+	if (sigemptyset(&mask) != 0)
+		die("sigemptyset");
+
+	if (sigaddset(&mask, SIGUSR2) != 0)
+		die("sigaddset");
+
+	return sigtimedwait(&mask, NULL, &timeout) == SIGUSR2;
+}
+
+static void suspend_thread(pthread_t thread_id)
+{
+	if (pthread_kill(thread_id, SIGUSR1) != 0)
+		die("pthread_kill");
+}
+
+static void resume_thread(pthread_t thread_id)
+{
+	if (pthread_kill(thread_id, SIGUSR2) != 0)
+		die("pthread_kill");
+}
+
+static int get_nr_in_safepoint(void)
+{
+	int ret;
+
+	if (pthread_spin_lock(&gc_spinlock) != 0)
+		die("pthread_spin_lock");
+
+	ret = nr_in_safepoint;
+
+	if (pthread_spin_unlock(&gc_spinlock) != 0)
+		die("pthread_spin_unlock");
+
+	return ret;
+}
+
+static bool do_exit_safepoint(void)
+{
+	bool ret = false;
+
+	assert(vm_get_exec_env()->in_safepoint);
+
+	vm_get_exec_env()->in_safepoint = false;
+
+	if (pthread_spin_lock(&gc_spinlock) != 0)
+		die("pthread_spin_lock");
+
+	assert(nr_in_safepoint > 0);
+
+	if (--nr_in_safepoint == 0)
+		ret = true;
+
+	if (pthread_spin_unlock(&gc_spinlock) != 0)
+		die("pthread_spin_unlock");
+
+	return ret;
+}
+
+static void exit_safepoint(void)
+{
+	if (do_exit_safepoint())
+		resume_thread(gc_thread_id);
+}
+
+static void enter_safepoint(void)
+{
+	assert(!vm_get_exec_env()->in_safepoint);
+
+	vm_get_exec_env()->in_safepoint = true;
+
+	if (pthread_spin_lock(&gc_spinlock) != 0)
+		die("pthread_spin_lock");
+
+	assert(nr_in_safepoint < nr_threads);
+
+	if (++nr_in_safepoint == nr_threads)
+		resume_thread(gc_thread_id);
+
+	if (pthread_spin_unlock(&gc_spinlock) != 0)
+		die("pthread_spin_unlock");
+}
+
+/*
+ * Returns true if @ee might be executing code in the given range or
+ * has a frame of it on the stack. The stack of a stopped thread is
+ * scanned conservatively from the frame of its safepoint handler so that
+ * the interrupted instruction pointer saved by the kernel is included.
+ */
+static bool thread_uses_code(struct vm_exec_env *ee, void *start, size_t size)
+{
+	unsigned long *p;
+
+	if (!ee->stack_end || !ee->safepoint_sp)
+		return false;
+
+	for (p = ee->safepoint_sp; (void *) p < ee->stack_end; p++) {
+		void *addr = (void *) *p;
+
+		if (addr >= start && addr <= start + size)
+			return true;
+	}
+
+	return false;
+}
+
+static bool code_in_use(void *start, size_t size)
+{
+	struct vm_exec_env *ee;
+
+	vm_exec_env_for_each(ee) {
+		if (thread_uses_code(ee, start, size))
+			return true;
+	}
+
+	return false;
+}
+
+static struct vm_alloc_region *vm_alloc_region_of(void *p)
+{
+	return (struct vm_alloc_region *) p - 1;
+}
+
+static void *vm_alloc_region_data(struct vm_alloc_region *region)
+{
+	return region + 1;
+}
+
+/*
+ * Marking
+ */
+
+static void gc_worker_lock(struct gc_worker *worker)
+{
+	if (pthread_spin_lock(&worker->lock) != 0)
+		die("pthread_spin_lock");
+}
+
+static void gc_worker_unlock(struct gc_worker *worker)
+{
+	if (pthread_spin_unlock(&worker->lock) != 0)
+		die("pthread_spin_unlock");
+}
+
+/*
+ * Marked objects that don't fit on the mark stack are traced again from
+ * the heap, see gc_mark().
+ */
+static void gc_push(void *obj)
+{
+	struct gc_worker *self = gc_self;
+
+	gc_worker_lock(self);
+
+	if (self->top == GC_MARK_STACK_SIZE && self->bottom > 0) {
+		memmove(self->stack, self->stack + self->bottom,
+			(self->top - self->bottom) * sizeof(void *));
+		self->top -= self->bottom;
+		self->bottom = 0;
+	}
+
+	if (self->top < GC_MARK_STACK_SIZE)
+		self->stack[self->top++] = obj;
+	else
+		mark_stack_overflow = true;
+
+	gc_worker_unlock(self);
+}
+
+static void *gc_pop(void)
+{
+	struct gc_worker *self = gc_self;
+	void *obj = NULL;
+
+	gc_worker_lock(self);
+
+	if (self->top > self->bottom)
+		obj = self->stack[--self->top];
+
+	if (self->top == self->bottom)
+		self->top = self->bottom = 0;
+
+	gc_worker_unlock(self);
+
+	return obj;
+}
+
+static bool gc_worker_has_work(struct gc_worker *worker)
+{
+	return worker->top != worker->bottom;
+}
+
+/*
+ * Moves up to half of the pending entries of another worker to our own
+ * mark stack.
+ */
+static bool gc_steal(void)
+{
+	struct gc_worker *self = gc_self;
+	void *batch[GC_STEAL_BATCH];
+	unsigned long count = 0;
+
+	for (unsigned int i = 1; i < gc_nr_workers && !count; i++) {
+		struct gc_worker *victim = &gc_workers[(self->id + i) % gc_nr_workers];
+
+		if (!gc_worker_has_work(victim))
+			continue;
+
+		gc_worker_lock(victim);
+
+		count = (victim->top - victim->bottom + 1) / 2;
+		count = min(count, (unsigned long) GC_STEAL_BATCH);
+
+		memcpy(batch, victim->stack + victim->bottom, count * sizeof(void *));
+		victim->bottom += count;
+
+		if (victim->top == victim->bottom)
+			victim->top = victim->bottom = 0;
+
+		gc_worker_unlock(victim);
+	}
+
+	for (unsigned long i = 0; i < count; i++)
+		gc_push(batch[i]);
+
+	return count > 0;
+}
+
+static void gc_mark_word(unsigned long value)
+{
+	void *obj;
+
+	obj = gc_heap_find_object(value);
+	if (!obj || !gc_heap_mark(obj))
+		return;
+
+	gc_push(obj);
+}
+
+static void gc_mark_range(void *start, void *end)
+{
+	unsigned long *p;
+
+	p = (unsigned long *) ALIGN((unsigned long) start, sizeof(unsigned long));
+
+	for (; (void *) (p + 1) <= end; p++)
+		gc_mark_word(*p);
+}
+
+static void gc_mark_words(unsigned long *start, unsigned long count)
+{
+	for (unsigned long i = 0; i < count; i++)
+		gc_mark_word(start[i]);
+}
+
+static void gc_trace_object(void *p)
+{
+	struct vm_object *obj = p;
+	struct vm_class *vmc;
+
+	/* The class is set after allocation. */
+	vmc = obj->class;
+	if (!vmc)
+		return;
+
+	if (vm_class_is_array_class(vmc)) {
+		if (vm_class_is_primitive_class(vmc->array_element_class))
+			return;
+
+		gc_mark_words(vm_array_elems(obj), vm_array_length(obj));
+		return;
+	}
+
+	for (; vmc; vmc = vmc->super) {
+		uint8_t *fields = vm_object_fields(obj);
+
+		gc_mark_words((void *) fields + vmc->ref_fields_offset, vmc->nr_ref_fields);
+	}
+}
+
+static void gc_drain_mark_stack(void)
+{
+	void *obj;
+
+	while ((obj = gc_pop()) != NULL)
+		gc_trace_object(obj);
+}
+
+static void gc_retrace_object(void *obj)
+{
+	gc_trace_object(obj);
+	gc_drain_mark_stack();
+}
+
+/*
+ * Root set
+ */
+
+static void gc_mark_vm_alloc_regions(void)
+{
+	struct vm_alloc_region *region;
+
+	list_for_each_entry(region, &vm_alloc_regions, node) {
+		void *start = vm_alloc_region_data(region);
+		struct vm_class *vmc = region->statics_class;
+
+		if (vmc) {
+			gc_mark_words(start + vmc->static_ref_fields_offset, vmc->nr_static_ref_fields);
+			continue;
+		}
+
+		if (region->exec_env) {
+			struct vm_exec_env *ee = start;
+
+			/* The registers of stopped threads are scanned with their stack. */
+			gc_mark_range(start, &ee->thread_register_state);
+			gc_mark_range(&ee->thread_register_state + 1, start + region->size);
+			continue;
+		}
+
+		gc_mark_range(start, start + region->size);
+	}
+}
+
+static void gc_mark_finalizers(struct gc_finalizer *list)
+{
+	for (; list != NULL; list = list->next)
+		gc_mark_word((unsigned long) list->object);
+}
+
+static struct gc_map *
+gc_frame_map(unsigned long pc, bool is_call, struct compilation_unit **cu_p)
+{
+	struct compilation_unit *cu;
+	unsigned long start;
+
+	cu = jit_lookup_cu(pc);
+	if (!cu || !cu->nr_gc_maps)
+		return NULL;
+
+	start = (unsigned long) cu_native_ptr(cu);
+	if (pc < start || pc > start + cu_native_size(cu))
+		return NULL;
+
+	*cu_p = cu;
+
+	return gc_map_lookup(cu, pc - start, is_call);
+}
+
+/*
+ * The callee saved registers that the prolog of @cu saved. They belong to
+ * the caller of @frame.
+ */
+static void gc_mark_callee_save_area(struct compilation_unit *cu, void *frame)
+{
+	if (!cu)
+		return;
+
+	for (unsigned int reg = 0; reg < NR_GP_REGISTERS; reg++) {
+		unsigned long *slot;
+
+		slot = jit_frame_callee_save_slot(cu, frame, reg);
+		if (slot)
+			gc_mark_word(*slot);
+	}
+}
+
+/*
+ * Marks the references of a JIT frame that has a GC map. Registers of a
+ * frame that is stopped at a call were saved by the callee if it is a
+ * JIT frame, too. Otherwise they are in the conservatively scanned part
+ * of the stack.
+ */
+static void gc_mark_jit_frame(struct compilation_unit *cu, void *frame,
+			      struct gc_map *map, struct register_state *regs,
+			      struct compilation_unit *inner_cu, void *inner_frame)
+{
+	unsigned long *slot;
+
+	for (unsigned long i = 0; i < cu->nr_gc_slots; i++)
+		gc_mark_word(*(unsigned long *) (frame + cu->gc_slots[i]));
+
+	slot = jit_frame_this_slot(cu, frame);
+	if (slot)
+		gc_mark_word(*slot);
+
+	for (unsigned int reg = 0; reg < NR_GP_REGISTERS; reg++) {
+		if (!test_bit(map->register_map, reg) &&
+		    !test_bit(map->conservative_register_map, reg))
+			continue;
+
+		if (!map->is_call) {
+			gc_mark_word(register_state_get(regs, reg));
+			continue;
+		}
+
+		if (!inner_cu)
+			continue;
+
+		slot = jit_frame_callee_save_slot(inner_cu, inner_frame, reg);
+		if (slot)
+			gc_mark_word(*slot);
+	}
+}
+
+/*
+ * Walks the frame pointer chain of a stopped thread. JIT frames with a
+ * GC map are marked precisely and everything in between is scanned
+ * conservatively. The chain is only followed while it looks sane so a
+ * native function that uses the frame pointer register for something
+ * else just makes the rest of the stack conservative.
+ */
+static void gc_mark_thread(struct vm_exec_env *ee)
+{
+	struct register_state *regs = &ee->thread_register_state;
+	struct compilation_unit *cu, *inner_cu = NULL;
+	void *frame, *inner_frame = NULL;
+	unsigned long *cursor, pc;
+	bool is_call = false;
+
+	if (ee->stopped_in_native) {
+		/* The handler frame includes the interrupted registers. */
+		cursor = ee->safepoint_sp;
+	} else {
+		cursor = (unsigned long *) regs->sp;
+	}
+
+	frame = (void *) regs->bp;
+	pc = regs->ip;
+
+	if (!ee->stopped_in_native && !gc_frame_map(pc, false, &cu))
+		gc_mark_range(regs, regs + 1);
+
+	while ((unsigned long) frame % sizeof(unsigned long) == 0 &&
+	       frame >= (void *) cursor && frame + 2 * sizeof(unsigned long) <= ee->stack_end) {
+		unsigned long *fp = frame;
+		struct gc_map *map;
+		void *bottom = NULL;
+
+		map = gc_frame_map(pc, is_call, &cu);
+		if (map) {
+			bottom = jit_frame_bottom(cu, frame);
+			if (bottom < (void *) cursor)
+				map = NULL;
+		}
+
+		if (map) {
+			gc_mark_range(cursor, bottom);
+			gc_mark_jit_frame(cu, frame, map, regs, inner_cu, inner_frame);
+
+			cursor = fp + 2;
+			inner_cu = cu;
+			inner_frame = frame;
+		} else {
+			gc_mark_callee_save_area(inner_cu, inner_frame);
+			inner_cu = NULL;
+		}
+
+		if ((void *) fp[0] <= frame)
+			break;
+
+		frame = (void *) fp[0];
+		pc = fp[1];
+		is_call = true;
+	}
+
+	gc_mark_callee_save_area(inner_cu, inner_frame);
+	gc_mark_range(cursor, ee->stack_end);
+}
+
+static void gc_prepare_roots(void)
+{
+	struct vm_exec_env *ee;
+
+	vm_exec_env_for_each(ee)
+		vm_alloc_region_of(ee)->exec_env = true;
+}
+
+static struct vm_exec_env *gc_nth_exec_env(unsigned int n)
+{
+	struct vm_exec_env *ee;
+
+	vm_exec_env_for_each(ee) {
+		if (n-- == 0)
+			return ee;
+	}
+
+	return NULL;
+}
+
+static int gc_claim_root_task(void)
+{
+	int task;
+
+	do {
+		task = atomic_read(&gc_next_root_task);
+	} while (atomic_cmpxchg(&gc_next_root_task, task, task + 1) != task);
+
+	return task;
+}
+
+/*
+ * The root tasks are the thread stacks followed by the vm_alloc()
+ * regions, the data sections and, in a young collection, the dirty
+ * cards. Returns false when there are no tasks left.
+ */
+static bool gc_mark_root_task(unsigned int task)
+{
+	if (task < (unsigned int) nr_threads) {
+		struct vm_exec_env *ee = gc_nth_exec_env(task);
+
+		if (ee)
+			gc_mark_thread(ee);
+
+		return true;
+	}
+
+	task -= nr_threads;
+
+	switch (task) {
+	case 0:
+		gc_mark_vm_alloc_regions();
+		return true;
+	case 1:
+		gc_mark_range(__data_start, _end);
+		gc_mark_finalizers(pending_finalizers);
+		return true;
+	}
+
+	task -= 2;
+
+	if (task >= GC_NR_CARD_TASKS)
+		return false;
+
+	if (!gc_phase_full)
+		gc_heap_for_each_dirty(gc_trace_object, task, GC_NR_CARD_TASKS);
+
+	return true;
+}
+
+/*
+ * Marks until there is no work left for any worker.
+ */
+static void gc_worker_mark(void)
+{
+	if (gc_phase_roots) {
+		while (gc_mark_root_task(gc_claim_root_task()))
+			gc_drain_mark_stack();
+	}
+
+	for (;;) {
+		gc_drain_mark_stack();
+
+		if (gc_steal())
+			continue;
+
+		atomic_inc(&gc_nr_idle_workers);
+
+		for (;;) {
+			bool has_work = false;
+
+			if (atomic_read(&gc_nr_idle_workers) == (int) gc_nr_workers)
+				return;
+
+			for (unsigned int i = 0; i < gc_nr_workers; i++)
+				has_work |= gc_worker_has_work(&gc_workers[i]);
+
+			if (has_work)
+				break;
+
+			sched_yield();
+		}
+
+		atomic_dec(&gc_nr_idle_workers);
+	}
+}
+
+static void *gc_worker_thread(void *arg)
+{
+	unsigned long generation = 0;
+	sigset_t sigset;
+
+	/* The workers are not VM threads and are never signalled. */
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_BLOCK, &sigset, NULL);
 
-bool				newgc_enabled;
-bool				verbose_gc;
-int				dont_gc;
+	gc_self = arg;
 
-struct gc_operations		gc_ops;
+	thread_init_cu_mapping();
 
-static void hide_safepoint_guard_page(void)
-{
-	hide_guard_page(gc_safepoint_page);
-}
+	for (;;) {
+		if (pthread_mutex_lock(&gc_work_mutex) != 0)
+			die("pthread_mutex_lock");
 
-static void unhide_safepoint_guard_page(void)
-{
-	unhide_guard_page(gc_safepoint_page);
-}
+		while (gc_work_generation == generation) {
+			if (pthread_cond_wait(&gc_work_cond, &gc_work_mutex) != 0)
+				die("pthread_cond_wait");
+		}
 
-static void suspend_self(void)
-{
-	sigset_t mask;
-	int sig;
+		generation = gc_work_generation;
 
-	if (sigemptyset(&mask) != 0)
-		die("sigemptyset");
+		if (pthread_mutex_unlock(&gc_work_mutex) != 0)
+			die("pthread_mutex_unlock");
 
-	if (sigaddset(&mask, SIGUSR2) != 0)
-		die("sigaddset");
+		gc_worker_mark();
 
-	if (sigwait(&mask, &sig) != 0)
-		die("sigwait");
+		if (pthread_mutex_lock(&gc_work_mutex) != 0)
+			die("pthread_mutex_lock");
 
-	if (sig != SIGUSR2)
-		die("wrong signal");
-}
+		if (--gc_nr_busy_workers == 0)
+			pthread_cond_signal(&gc_work_done_cond);
 
-static void suspend_thread(pthread_t thread_id)
-{
-	if (pthread_kill(thread_id, SIGUSR1) != 0)
-		die("pthread_kill");
-}
+		if (pthread_mutex_unlock(&gc_work_mutex) != 0)
+			die("pthread_mutex_unlock");
+	}
 
-static void resume_thread(pthread_t thread_id)
-{
-	if (pthread_kill(thread_id, SIGUSR2) != 0)
-		die("pthread_kill");
+	return NULL;
 }
 
-static bool do_exit_safepoint(void)
+/*
+ * Runs a mark phase on all workers. The GC thread takes part as the
+ * first worker.
+ */
+static void gc_run_workers(bool roots)
 {
-	bool ret = false;
+	gc_phase_roots = roots;
+	atomic_set(&gc_next_root_task, 0);
+	atomic_set(&gc_nr_idle_workers, 0);
 
-	assert(vm_get_exec_env()->in_safepoint);
+	if (pthread_mutex_lock(&gc_work_mutex) != 0)
+		die("pthread_mutex_lock");
 
-	vm_get_exec_env()->in_safepoint = false;
+	gc_nr_busy_workers = gc_nr_workers - 1;
+	gc_work_generation++;
+	pthread_cond_broadcast(&gc_work_cond);
 
-	if (pthread_spin_lock(&gc_spinlock) != 0)
-		die("pthread_spin_lock");
+	if (pthread_mutex_unlock(&gc_work_mutex) != 0)
+		die("pthread_mutex_unlock");
 
-	assert(nr_in_safepoint > 0);
+	gc_worker_mark();
 
-	if (--nr_in_safepoint == 0)
-		ret = true;
+	if (pthread_mutex_lock(&gc_work_mutex) != 0)
+		die("pthread_mutex_lock");
 
-	if (pthread_spin_unlock(&gc_spinlock) != 0)
-		die("pthread_spin_unlock");
+	while (gc_nr_busy_workers) {
+		if (pthread_cond_wait(&gc_work_done_cond, &gc_work_mutex) != 0)
+			die("pthread_cond_wait");
+	}
 
-	return ret;
+	if (pthread_mutex_unlock(&gc_work_mutex) != 0)
+		die("pthread_mutex_unlock");
 }
 
-static void exit_safepoint(void)
+/*
+ * Traces everything that is reachable from the roots if @roots is set
+ * and from the objects on the mark stacks. When a mark stack overflows
+ * the children of some marked objects have not been traced so all
+ * marked objects are traced again.
+ */
+static void gc_mark(bool roots)
 {
-	if (do_exit_safepoint())
-		resume_thread(gc_thread_id);
+	gc_run_workers(roots);
+
+	while (mark_stack_overflow) {
+		mark_stack_overflow = false;
+		gc_heap_for_each_marked(gc_retrace_object);
+	}
 }
 
-static void enter_safepoint(void)
+/*
+ * Moves the finalizers of unreachable objects to the pending list. The
+ * objects and everything they reference must survive until the
+ * finalizers have run.
+ */
+static void gc_queue_finalizers(void)
 {
-	assert(!vm_get_exec_env()->in_safepoint);
+	for (unsigned int i = 0; i < GC_FINALIZER_HASH_SIZE; i++) {
+		struct gc_finalizer **p = &finalizers[i];
 
-	vm_get_exec_env()->in_safepoint = true;
-
-	if (pthread_spin_lock(&gc_spinlock) != 0)
-		die("pthread_spin_lock");
+		while (*p) {
+			struct gc_finalizer *this = *p;
 
-	assert(nr_in_safepoint < nr_threads);
+			if (gc_heap_is_marked(this->object)) {
+				p = &this->next;
+				continue;
+			}
 
-	if (++nr_in_safepoint == nr_threads)
-		resume_thread(gc_thread_id);
+			*p = this->next;
+			this->next = pending_finalizers;
+			pending_finalizers = this;
 
-	if (pthread_spin_unlock(&gc_spinlock) != 0)
-		die("pthread_spin_unlock");
+			gc_mark_word((unsigned long) this->object);
+		}
+	}
 }
 
-static void do_gc_reclaim(void)
+static void gc_count_live_object(void *p)
 {
-	if (verbose_gc)
-		fprintf(stderr, "[GC]\n");
+	struct vm_object *obj = p;
 
-	/* TODO: Do main GC work here. */
+	if (obj->class)
+		gc_log_count_object(obj->class, gc_heap_object_size(p));
 }
 
-static void gc_scan_rootset(struct register_state *regs)
+/*
+ * Old objects stay marked during a young collection so the marking stops
+ * at them. References from old to young objects are found through the
+ * dirty cards. There are no young objects left after any collection so
+ * all cards are clean again.
+ */
+static bool do_gc_reclaim(void)
 {
-	struct compilation_unit *cu;
+	bool full = gc_heap_needs_full_gc();
 
-	cu = jit_lookup_cu(regs->ip);
-	if (!cu) {
-		warn("safepoint at unknown IP %" PRIx64, regs->ip);
-		return;
-	}
+	if (full)
+		gc_heap_clear_marks();
 
-	if (verbose_gc)
-		fprintf(stderr, "[GC at %s.%s]\n", cu->method->class->name, cu->method->name);
+	gc_phase_full = full;
 
-	/* TODO: get live references from this thread. */
+	gc_prepare_roots();
+	gc_mark(true);
+
+	gc_queue_finalizers();
+	gc_mark(false);
+
+	if (gc_log_enabled())
+		gc_heap_for_each_marked(gc_count_live_object);
+
+	jit_text_collect(code_in_use);
+
+	gc_heap_sweep(full);
+	gc_heap_clear_cards();
+
+	return full;
 }
 
 void gc_safepoint(struct register_state *regs)
 {
-	gc_scan_rootset(regs);
+	struct vm_exec_env *ee = vm_get_exec_env();
+
+	if (regs != &ee->thread_register_state)
+		ee->thread_register_state = *regs;
+
+	ee->stopped_in_native = false;
+	ee->safepoint_sp = __builtin_frame_address(0);
 
 	enter_safepoint();
 
@@ -200,29 +1042,30 @@ void gc_safepoint(struct register_state *regs)
 
 void suspend_handler(int sig, siginfo_t *si, void *ctx)
 {
-	struct vm_thread *self = vm_thread_self();
+	struct vm_exec_env *ee = vm_get_exec_env();
+	ucontext_t *uc = ctx;
+
+	if (!ee || !gc_stopping || ee->in_safepoint)
+		return;
 
-	if (signal_from_native(ctx)) {
-		struct register_state thread_register_state;
-		ucontext_t *uc = ctx;
+	/*
+	 * JIT code runs on until it reaches a safepoint poll which traps
+	 * because the safepoint guard page is hidden. If it calls native
+	 * code first the thread is signalled again.
+	 */
+	if (!signal_from_native(ctx))
+		return;
 
-		/*
-		 * Fresh threads might return NULL from vm_thread_self().
-		 */
-		if (self)
-			vm_thread_set_state(self, VM_THREAD_STATE_CONSISTENT);
+	save_signal_registers(&ee->thread_register_state, &uc->uc_mcontext);
 
-		save_signal_registers(&thread_register_state, &uc->uc_mcontext);
-		gc_safepoint(&thread_register_state);
-	} else {
-		vm_thread_set_state(self, VM_THREAD_STATE_CONSISTENT);
+	ee->stopped_in_native = true;
+	ee->safepoint_sp = __builtin_frame_address(0);
 
-		enter_safepoint();
+	enter_safepoint();
 
-		suspend_self();
+	suspend_self();
 
-		do_exit_safepoint();	/* don't wake up GC */
-	}
+	exit_safepoint();
 }
 
 void wakeup_handler(int sig, siginfo_t *si, void *ctx)
@@ -231,110 +1074,136 @@ void wakeup_handler(int sig, siginfo_t *si, void *ctx)
 
 static void gc_resume_rest(void)
 {
-	struct vm_thread *thread;
-
-	if (pthread_spin_lock(&gc_spinlock) != 0)
-		die("pthread_spin_lock");
+	struct vm_exec_env *ee;
 
-	assert(nr_in_safepoint == nr_threads);
+	assert(get_nr_in_safepoint() == nr_threads);
 
-	if (pthread_spin_unlock(&gc_spinlock) != 0)
-		die("pthread_spin_unlock");
+	gc_stopping = false;
 
-	vm_thread_for_each(thread) {
-		assert(thread->posix_id != pthread_self());
+	vm_exec_env_for_each(ee) {
+		assert(ee->posix_id != pthread_self());
 
-		resume_thread(thread->posix_id);
+		resume_thread(ee->posix_id);
 	}
 
 	/* Wait for all threads to leave a safepoint. */
-	suspend_self();
-
-	if (pthread_spin_lock(&gc_spinlock) != 0)
-		die("pthread_spin_lock");
-
-	assert(nr_in_safepoint == 0);
-
-	if (pthread_spin_unlock(&gc_spinlock) != 0)
-		die("pthread_spin_unlock");
+	while (get_nr_in_safepoint() != 0)
+		suspend_self_timeout();
 }
 
 static void gc_suspend_rest(void)
 {
-	unsigned long nr_restarted = 0;
-	struct vm_thread *thread;
-
-	if (pthread_spin_lock(&gc_spinlock) != 0)
-		die("pthread_spin_lock");
+	struct vm_exec_env *ee;
 
-	assert(nr_in_safepoint == 0);
+	assert(get_nr_in_safepoint() == 0);
 	assert(nr_threads > 0);
 
-	if (pthread_spin_unlock(&gc_spinlock) != 0)
-		die("pthread_spin_unlock");
+	/*
+	 * Threads in JIT code stop at their next safepoint poll through
+	 * guard page polling. Threads in native code are stopped by the
+	 * signal.
+	 */
+	gc_stopping = true;
 
-	vm_thread_for_each(thread) {
-		assert(thread->posix_id != pthread_self());
+	hide_safepoint_guard_page();
 
-		suspend_thread(thread->posix_id);
-	}
+	vm_exec_env_for_each(ee) {
+		assert(ee->posix_id != pthread_self());
 
-	/* Wait for all threads to enter a safepoint.  */
-	suspend_self();
+		suspend_thread(ee->posix_id);
+	}
 
 	/*
-	 * Restart inconsistent threads and let them run until they enter a
-	 * safepoint through guard page polling.
+	 * Wait for all threads to enter a safepoint. A thread that was
+	 * signalled in JIT code and then entered native code without
+	 * passing a poll needs another signal.
 	 */
-	hide_safepoint_guard_page();
-
-	vm_thread_for_each(thread) {
-		assert(thread->posix_id != pthread_self());
+	while (get_nr_in_safepoint() != nr_threads) {
+		if (suspend_self_timeout())
+			continue;
 
-		if (vm_thread_get_state(thread) == VM_THREAD_STATE_INCONSISTENT) {
-			resume_thread(thread->posix_id);
-			nr_restarted++;
+		vm_exec_env_for_each(ee) {
+			if (!ee->in_safepoint)
+				suspend_thread(ee->posix_id);
 		}
 	}
 
-	/* Wait for restarted threads to enter a safepoint.  */
-	if (nr_restarted)
-		suspend_self();
-
-	if (pthread_spin_lock(&gc_spinlock) != 0)
-		die("pthread_spin_lock");
+	unhide_safepoint_guard_page();
+}
 
-	assert(nr_in_safepoint == nr_threads);
+static unsigned long elapsed_us(struct timespec *start)
+{
+	struct timespec now;
 
-	if (pthread_spin_unlock(&gc_spinlock) != 0)
-		die("pthread_spin_unlock");
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	unhide_safepoint_guard_page();
+	return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
 }
 
 static void do_gc(void)
 {
+	unsigned long used_before = 0, used_after = 0, heap_size = 0, us;
+	struct timespec start, stop_start;
+	struct gc_event event;
+	bool collected = false;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
 	vm_lock_thread_count();
 
+	gc_heap_lock();
+
 	if (pthread_spin_lock(&gc_spinlock) != 0)
 		die("pthread_spin_lock");
 
-	nr_threads = vm_nr_threads();
+	nr_threads = vm_nr_exec_envs();
+
+	if (pthread_spin_unlock(&gc_spinlock) != 0)
+		die("pthread_spin_unlock");
 
 	/* Don't deadlock during early boostrap. */
-	if (nr_threads == 0) {
-		if (pthread_spin_unlock(&gc_spinlock) != 0)
-			die("pthread_spin_unlock");
+	if (nr_threads == 0 || !gc_signals_ready) {
+		gc_heap_reset_nursery();
 		goto out;
 	}
 
-	if (pthread_spin_unlock(&gc_spinlock) != 0)
-		die("pthread_spin_unlock");
+	used_before = gc_heap_used();
+
+	event.start_us = gc_log_uptime_us();
+	clock_gettime(CLOCK_MONOTONIC, &stop_start);
 
 	gc_suspend_rest();
-	do_gc_reclaim();
+	event.safepoint_us = elapsed_us(&stop_start);
+
+	event.full = do_gc_reclaim();
 	gc_resume_rest();
+	event.pause_us = elapsed_us(&stop_start);
+
+	used_after = gc_heap_used();
+	heap_size = gc_heap_committed();
+	collected = true;
+
+	event.id		= ++gc_nr_collections;
+	event.allocated		= gc_heap_allocated() - gc_last_allocated;
+	event.used_before	= used_before;
+	event.used_after	= used_after;
+	event.committed		= heap_size;
+	event.max		= gc_heap_size();
+
+	gc_last_allocated	= gc_heap_allocated();
+	gc_total_pause_us	+= event.pause_us;
+	gc_peak_used		= max(gc_peak_used, used_before);
+	gc_used_after		= used_after;
+	gc_committed_after	= heap_size;
+
+	if (gc_log_enabled())
+		gc_log_top_classes(&event);
 out:
+	gc_heap_unlock();
+
+	if (collected)
+		jit_text_sweep();
+
 	if (pthread_spin_lock(&gc_spinlock) != 0)
 		die("pthread_spin_lock");
 
@@ -353,6 +1222,37 @@ out:
 
 	if (pthread_mutex_unlock(&gc_reclaim_mutex) != 0)
 		die("pthread_mutex_unlock");
+
+	/* No printing while the world is stopped, a thread might hold the stdio lock. */
+	if (!collected)
+		return;
+
+	if (gc_log_enabled())
+		gc_log_event(&event);
+
+	if (verbose_gc) {
+		us = elapsed_us(&start);
+
+		fprintf(stderr, "[%s %luK->%luK(%luK), %lu.%03lu ms]\n",
+			gc_generational && event.full ? "Full GC" : "GC",
+			used_before / 1024, used_after / 1024, heap_size / 1024,
+			us / 1000, us % 1000);
+	}
+}
+
+static bool gc_requested(void)
+{
+	bool ret;
+
+	if (pthread_mutex_lock(&gc_reclaim_mutex) != 0)
+		die("pthread_mutex_lock");
+
+	ret = gc_reclaim_in_progress;
+
+	if (pthread_mutex_unlock(&gc_reclaim_mutex) != 0)
+		die("pthread_mutex_unlock");
+
+	return ret;
 }
 
 static void *gc_thread(void *arg)
@@ -360,6 +1260,8 @@ static void *gc_thread(void *arg)
 	struct sigaction sa;
 	sigset_t sigset;
 
+	thread_init_cu_mapping();
+
 	sigemptyset(&sa.sa_mask);
 	sa.sa_flags	= SA_RESTART | SA_SIGINFO;
 
@@ -377,9 +1279,14 @@ static void *gc_thread(void *arg)
 
 	pthread_sigmask(SIG_BLOCK, &sigset, NULL);
 
+	gc_self = &gc_workers[0];
+
 	for (;;) {
 		suspend_self();
-		do_gc();
+
+		/* Ignore wake-ups from threads that left a safepoint late. */
+		if (gc_requested())
+			do_gc();
 	}
 	return NULL;
 }
@@ -415,23 +1322,101 @@ wait_for_reclaim:
 		die("pthread_mutex_unlock");
 }
 
+/*
+ * Runs the finalizers of objects that were found unreachable. This is
+ * done by the allocating threads because finalizers may take locks and
+ * call into Java.
+ */
+static void gc_run_finalizers(void)
+{
+	struct gc_finalizer *list;
+
+	if (!pending_finalizers || running_finalizers)
+		return;
+
+	if (!vm_get_exec_env() || exception_occurred())
+		return;
+
+	gc_heap_lock();
+
+	list = pending_finalizers;
+	pending_finalizers = NULL;
+
+	gc_heap_unlock();
+
+	running_finalizers = true;
+
+	while (list) {
+		struct gc_finalizer *this = list;
+
+		list = this->next;
+
+		this->finalizer(this->object);
+		free(this);
+	}
+
+	running_finalizers = false;
+}
+
 static void *do_gc_alloc(size_t size)
 {
 	void *p;
 
-	gc_start();
+	gc_heap_lock();
+	p = gc_heap_alloc(size, dont_gc);
+	gc_heap_unlock();
+
+	if (!p) {
+		gc_start();
 
-	p	= malloc(size);
+		gc_heap_lock();
+		p = gc_heap_alloc(size, true);
+		gc_heap_unlock();
+	}
 
-	if (p)
-		memset(p, 0, size);
+	gc_run_finalizers();
 
 	return p;
 }
 
+static void *vm_alloc_region(size_t size, struct vm_class *statics_class)
+{
+	struct vm_alloc_region *region;
+
+	region = malloc(sizeof(*region) + size);
+	if (!region)
+		return NULL;
+
+	region->statics_class	= statics_class;
+	region->exec_env	= false;
+	region->size		= size;
+
+	gc_heap_lock();
+	list_add(&region->node, &vm_alloc_regions);
+	gc_heap_unlock();
+
+	return vm_alloc_region_data(region);
+}
+
 static void *do_vm_alloc(size_t size)
 {
-	return malloc(size);
+	return vm_alloc_region(size, NULL);
+}
+
+static void *do_vm_alloc_static_values(struct vm_class *vmc, size_t size)
+{
+	void *p;
+
+	p = vm_alloc_region(size, NULL);
+	if (!p)
+		return NULL;
+
+	memset(p, 0, size);
+
+	/* The static values are all null until the class is linked. */
+	vm_alloc_region_of(p)->statics_class = vmc;
+
+	return p;
 }
 
 void *vm_zalloc(size_t size)
@@ -449,12 +1434,56 @@ void *vm_zalloc(size_t size)
 
 static void do_vm_free(void *p)
 {
-	free(p);
+	struct vm_alloc_region *region;
+
+	if (!p)
+		return;
+
+	region = vm_alloc_region_of(p);
+
+	gc_heap_lock();
+	list_del(&region->node);
+	gc_heap_unlock();
+
+	free(region);
+}
+
+static unsigned long finalizer_hash(struct vm_object *object)
+{
+	return ((unsigned long) object / GC_GRANULE_SIZE) % GC_FINALIZER_HASH_SIZE;
 }
 
 static int do_gc_register_finalizer(struct vm_object *object, finalizer_fn finalizer)
 {
-	return 0;
+	struct gc_finalizer **bucket, *this;
+	int err = 0;
+
+	bucket = &finalizers[finalizer_hash(object)];
+
+	gc_heap_lock();
+
+	for (this = *bucket; this != NULL; this = this->next) {
+		if (this->object == object) {
+			this->finalizer = finalizer;
+			goto out_unlock;
+		}
+	}
+
+	this = malloc(sizeof *this);
+	if (!this) {
+		err = -ENOMEM;
+		goto out_unlock;
+	}
+
+	this->object	= object;
+	this->finalizer	= finalizer;
+	this->next	= *bucket;
+	*bucket		= this;
+
+out_unlock:
+	gc_heap_unlock();
+
+	return err;
 }
 
 static void do_gc_setup_signals(void)
@@ -481,6 +1510,38 @@ static void do_gc_setup_signals(void)
 		die("sigaddset");
 
 	pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+	gc_signals_ready = true;
+}
+
+static void do_gc_get_stats(struct gc_stats *stats)
+{
+	struct gc_finalizer *this;
+
+	gc_heap_lock();
+
+	stats->name			= gc_generational ? "Generational" : "MarkSweep";
+	stats->nr_collections		= gc_nr_collections;
+	stats->total_pause_us		= gc_total_pause_us;
+	stats->used			= gc_heap_used();
+	stats->committed		= gc_heap_committed();
+	stats->max			= gc_heap_size();
+	stats->peak_used		= max(gc_peak_used, stats->used);
+	stats->used_after_gc		= gc_used_after;
+	stats->committed_after_gc	= gc_committed_after;
+	stats->nr_pending_finalizers	= 0;
+
+	for (this = pending_finalizers; this != NULL; this = this->next)
+		stats->nr_pending_finalizers++;
+
+	gc_heap_unlock();
+}
+
+static void do_gc_reset_peak(void)
+{
+	gc_heap_lock();
+	gc_peak_used = gc_heap_used();
+	gc_heap_unlock();
 }
 
 static void gc_setup(void)
@@ -490,10 +1551,50 @@ static void gc_setup(void)
 		.gc_alloc_noscan	= do_gc_alloc,
 		.vm_alloc		= do_vm_alloc,
 		.vm_free		= do_vm_free,
+		.vm_alloc_static_values	= do_vm_alloc_static_values,
 		.gc_register_finalizer	= do_gc_register_finalizer,
 		.gc_setup_signals	= do_gc_setup_signals,
+		.gc_get_stats		= do_gc_get_stats,
+		.gc_reset_peak		= do_gc_reset_peak,
 	};
 
+	if (gc_heap_init(max_heap_size))
+		die("Couldn't reserve %lu bytes for the heap", max_heap_size);
+
+	if (gc_generational) {
+		if (!gc_nursery_size)
+			gc_nursery_size = max(max_heap_size / 32, GC_MIN_NURSERY_SIZE);
+
+		if (gc_heap_init_cards(gc_nursery_size))
+			die("Couldn't allocate GC card table");
+	}
+
+	gc_nr_workers = opt_nr_gc_threads;
+	if (!gc_nr_workers)
+		gc_nr_workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+	gc_nr_workers = min(max(gc_nr_workers, 1U), (unsigned int) GC_MAX_WORKERS);
+
+	for (unsigned int i = 0; i < gc_nr_workers; i++) {
+		struct gc_worker *worker = &gc_workers[i];
+
+		worker->id = i;
+
+		worker->stack = mmap(NULL, GC_MARK_STACK_SIZE * sizeof(void *), PROT_READ | PROT_WRITE,
+				     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (worker->stack == MAP_FAILED)
+			die("Couldn't allocate GC mark stack");
+
+		if (pthread_spin_init(&worker->lock, PTHREAD_PROCESS_PRIVATE) != 0)
+			die("pthread_spin_init");
+	}
+
+	/* The GC thread itself is the first worker. */
+	for (unsigned int i = 1; i < gc_nr_workers; i++) {
+		if (pthread_create(&gc_workers[i].thread, NULL, &gc_worker_thread, &gc_workers[i]))
+			die("Couldn't create GC worker thread");
+	}
+
 	if (pthread_spin_init(&gc_spinlock, PTHREAD_PROCESS_SHARED) != 0)
 		die("pthread_spin_init");
 
@@ -507,6 +1608,9 @@ void gc_init(void)
 	if (!gc_safepoint_page)
 		die("Couldn't allocate GC safepoint guard page");
 
+	if (gc_log_init())
+		die("Couldn't open GC log file '%s'", gc_log_file);
+
 	if (newgc_enabled)
 		gc_setup();
 	else
@@ -24,244 +24,1606 @@
  * Please refer to the file LICENSE for details.
  */
 
+
 #include "vm/interp.h"
 
 #include "cafebabe/code_attribute.h"
+#include "cafebabe/constant_pool.h"
+
+#include "jit/emulate.h"
+#include "jit/exception.h"
+
+#include "vm/bytecode.h"
+#include "vm/call.h"
+#include "vm/class.h"
+#include "vm/errors.h"
+#include "vm/field.h"
+#include "vm/limits.h"
 #include "vm/method.h"
+#include "vm/monitor.h"
+#include "vm/object.h"
+#include "vm/opcodes.h"
+#include "vm/preload.h"
+#include "vm/stack-trace.h"
+#include "vm/types.h"
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 #include <stdio.h>
+#include <math.h>
+
+bool opt_interp_only;
+bool opt_tiered_compilation;
+unsigned long opt_compile_threshold = 1000;
+
+/*
+ * Local variables and operand stack entries are machine words. Longs and
+ * doubles occupy two slots like in the class file. On 32-bit machines the
+ * value is split across both slots and on 64-bit machines it is kept in
+ * the first one. This is the same layout that vm_call_method_a() uses for
+ * arguments so they are passed to and from the interpreter as is.
+ */
+static inline jint slot_get_int(unsigned long *slot)
+{
+	return (jint) *slot;
+}
+
+static inline void slot_set_int(unsigned long *slot, jint value)
+{
+	*slot = (long) value;
+}
+
+static inline jlong slot_get_long(unsigned long *slot)
+{
+	jlong value;
+
+	memcpy(&value, slot, sizeof(value));
+	return value;
+}
+
+static inline void slot_set_long(unsigned long *slot, jlong value)
+{
+	memcpy(slot, &value, sizeof(value));
+}
+
+static inline jfloat slot_get_float(unsigned long *slot)
+{
+	jfloat value;
+
+	memcpy(&value, slot, sizeof(value));
+	return value;
+}
+
+static inline void slot_set_float(unsigned long *slot, jfloat value)
+{
+	*slot = 0;
+	memcpy(slot, &value, sizeof(value));
+}
+
+static inline jdouble slot_get_double(unsigned long *slot)
+{
+	jdouble value;
+
+	memcpy(&value, slot, sizeof(value));
+	return value;
+}
+
+static inline void slot_set_double(unsigned long *slot, jdouble value)
+{
+	memcpy(slot, &value, sizeof(value));
+}
+
+static inline struct vm_object *slot_get_ref(unsigned long *slot)
+{
+	return (struct vm_object *) *slot;
+}
+
+static inline void slot_set_ref(unsigned long *slot, struct vm_object *value)
+{
+	*slot = (unsigned long) value;
+}
+
+#define POP_INT()	slot_get_int(--sp)
+#define POP_FLOAT()	slot_get_float(--sp)
+#define POP_REF()	slot_get_ref(--sp)
+#define POP_LONG()	(sp -= 2, slot_get_long(sp))
+#define POP_DOUBLE()	(sp -= 2, slot_get_double(sp))
+
+#define PUSH_INT(v)	slot_set_int(sp++, (v))
+#define PUSH_FLOAT(v)	slot_set_float(sp++, (v))
+#define PUSH_REF(v)	slot_set_ref(sp++, (v))
+#define PUSH_LONG(v)	do { slot_set_long(sp, (v)); sp += 2; } while (0)
+#define PUSH_DOUBLE(v)	do { slot_set_double(sp, (v)); sp += 2; } while (0)
+
+static unsigned long *push_value(unsigned long *sp, enum vm_type type, void *p)
+{
+	switch (type) {
+	case J_BOOLEAN:
+		slot_set_int(sp, *(jboolean *) p);
+		return sp + 1;
+	case J_BYTE:
+		slot_set_int(sp, *(jbyte *) p);
+		return sp + 1;
+	case J_CHAR:
+		slot_set_int(sp, *(jchar *) p);
+		return sp + 1;
+	case J_SHORT:
+		slot_set_int(sp, *(jshort *) p);
+		return sp + 1;
+	case J_INT:
+		slot_set_int(sp, *(jint *) p);
+		return sp + 1;
+	case J_FLOAT:
+		slot_set_float(sp, *(jfloat *) p);
+		return sp + 1;
+	case J_REFERENCE:
+		slot_set_ref(sp, *(struct vm_object **) p);
+		return sp + 1;
+	case J_LONG:
+		slot_set_long(sp, *(jlong *) p);
+		return sp + 2;
+	case J_DOUBLE:
+		slot_set_double(sp, *(jdouble *) p);
+		return sp + 2;
+	default:
+		assert(!"invalid field type");
+	}
+
+	return sp;
+}
+
+/*
+ * Values smaller than machine word are stored as whole words like the
+ * field setters in vm/object.h do. See the comment there for details.
+ */
+static unsigned long *pop_value(unsigned long *sp, enum vm_type type, void *p)
+{
+	switch (type) {
+	case J_BOOLEAN:
+		*(unsigned long *) p = (jboolean) slot_get_int(--sp);
+		break;
+	case J_BYTE:
+		*(long *) p = (jbyte) slot_get_int(--sp);
+		break;
+	case J_CHAR:
+		*(unsigned long *) p = (jchar) slot_get_int(--sp);
+		break;
+	case J_SHORT:
+		*(long *) p = (jshort) slot_get_int(--sp);
+		break;
+	case J_INT:
+		*(jint *) p = slot_get_int(--sp);
+		break;
+	case J_FLOAT:
+		*(jfloat *) p = slot_get_float(--sp);
+		break;
+	case J_REFERENCE:
+		*(struct vm_object **) p = slot_get_ref(--sp);
+		break;
+	case J_LONG:
+		sp -= 2;
+		*(jlong *) p = slot_get_long(sp);
+		break;
+	case J_DOUBLE:
+		sp -= 2;
+		*(jdouble *) p = slot_get_double(sp);
+		break;
+	default:
+		assert(!"invalid field type");
+	}
+
+	return sp;
+}
+
+static unsigned long *push_result(unsigned long *sp, enum vm_type type, union jvalue *result)
+{
+	switch (type) {
+	case J_VOID:
+		break;
+	case J_BOOLEAN:
+		PUSH_INT(result->z);
+		break;
+	case J_BYTE:
+		PUSH_INT(result->b);
+		break;
+	case J_CHAR:
+		PUSH_INT(result->c);
+		break;
+	case J_SHORT:
+		PUSH_INT(result->s);
+		break;
+	case J_INT:
+		PUSH_INT(result->i);
+		break;
+	case J_FLOAT:
+		PUSH_FLOAT(result->f);
+		break;
+	case J_REFERENCE:
+		PUSH_REF(result->l);
+		break;
+	case J_LONG:
+		PUSH_LONG(result->j);
+		break;
+	case J_DOUBLE:
+		PUSH_DOUBLE(result->d);
+		break;
+	default:
+		assert(!"invalid return type");
+	}
+
+	return sp;
+}
+
+static void set_int_result(struct vm_method *method, union jvalue *result, jint value)
+{
+	switch (method->return_type.vm_type) {
+	case J_BOOLEAN:
+		result->i = (jboolean) value;
+		break;
+	case J_BYTE:
+		result->i = (jbyte) value;
+		break;
+	case J_CHAR:
+		result->i = (jchar) value;
+		break;
+	case J_SHORT:
+		result->i = (jshort) value;
+		break;
+	default:
+		result->i = value;
+		break;
+	}
+}
+
+static void *signal_no_class_def_found(void)
+{
+	if (!exception_occurred())
+		signal_new_exception(vm_java_lang_NoClassDefFoundError, NULL);
+
+	return NULL;
+}
+
+static struct vm_class *resolve_class(struct vm_class *vmc, uint16_t idx)
+{
+	struct vm_class *class;
+
+	class = vm_class_resolve_class(vmc, idx);
+	if (!class)
+		return signal_no_class_def_found();
+
+	return class;
+}
+
+static struct vm_field *resolve_field(struct vm_class *vmc, uint16_t idx, bool is_static)
+{
+	struct vm_field *vmf;
+
+	vmf = vm_class_resolve_field_recursive(vmc, idx);
+	if (!vmf) {
+		if (!exception_occurred())
+			signal_new_exception(vm_java_lang_NoSuchFieldError, NULL);
+
+		return NULL;
+	}
+
+	if (is_static && vm_class_ensure_init(vmf->class))
+		return NULL;
 
-enum interp_status {
-	INTERP_CONTINUE,
-	INTERP_RETURN,
-};
+	return vmf;
+}
 
-static enum interp_status interp(uint8_t opc)
+static struct vm_method *resolve_method(struct vm_class *vmc, unsigned char opc, uint16_t idx)
 {
+	struct vm_method *vmm;
+
 	switch (opc) {
-	case OPC_NOP:
-		 break;
-	case OPC_ACONST_NULL:	assert(!"OPC_ACONST_NULL"); break;
-	case OPC_ICONST_M1:	assert(!"OPC_ICONST_M1"); break;
-	case OPC_ICONST_0:	assert(!"OPC_ICONST_0"); break;
-	case OPC_ICONST_1:	assert(!"OPC_ICONST_1"); break;
-	case OPC_ICONST_2:	assert(!"OPC_ICONST_2"); break;
-	case OPC_ICONST_3:	assert(!"OPC_ICONST_3"); break;
-	case OPC_ICONST_4:	assert(!"OPC_ICONST_4"); break;
-	case OPC_ICONST_5:	assert(!"OPC_ICONST_5"); break;
-	case OPC_LCONST_0:	assert(!"OPC_LCONST_0"); break;
-	case OPC_LCONST_1:	assert(!"OPC_LCONST_1"); break;
-	case OPC_FCONST_0:	assert(!"OPC_FCONST_0"); break;
-	case OPC_FCONST_1:	assert(!"OPC_FCONST_1"); break;
-	case OPC_FCONST_2:	assert(!"OPC_FCONST_2"); break;
-	case OPC_DCONST_0:	assert(!"OPC_DCONST_0"); break;
-	case OPC_DCONST_1:	assert(!"OPC_DCONST_1"); break;
-	case OPC_BIPUSH:	assert(!"OPC_BIPUSH"); break;
-	case OPC_SIPUSH:	assert(!"OPC_SIPUSH"); break;
-	case OPC_LDC:	assert(!"OPC_LDC"); break;
-	case OPC_LDC_W:	assert(!"OPC_LDC_W"); break;
-	case OPC_LDC2_W:	assert(!"OPC_LDC2_W"); break;
-	case OPC_ILOAD:	assert(!"OPC_ILOAD"); break;
-	case OPC_LLOAD:	assert(!"OPC_LLOAD"); break;
-	case OPC_FLOAD:	assert(!"OPC_FLOAD"); break;
-	case OPC_DLOAD:	assert(!"OPC_DLOAD"); break;
-	case OPC_ALOAD:	assert(!"OPC_ALOAD"); break;
-	case OPC_ILOAD_0:	assert(!"OPC_ILOAD_0"); break;
-	case OPC_ILOAD_1:	assert(!"OPC_ILOAD_1"); break;
-	case OPC_ILOAD_2:	assert(!"OPC_ILOAD_2"); break;
-	case OPC_ILOAD_3:	assert(!"OPC_ILOAD_3"); break;
-	case OPC_LLOAD_0:	assert(!"OPC_LLOAD_0"); break;
-	case OPC_LLOAD_1:	assert(!"OPC_LLOAD_1"); break;
-	case OPC_LLOAD_2:	assert(!"OPC_LLOAD_2"); break;
-	case OPC_LLOAD_3:	assert(!"OPC_LLOAD_3"); break;
-	case OPC_FLOAD_0:	assert(!"OPC_FLOAD_0"); break;
-	case OPC_FLOAD_1:	assert(!"OPC_FLOAD_1"); break;
-	case OPC_FLOAD_2:	assert(!"OPC_FLOAD_2"); break;
-	case OPC_FLOAD_3:	assert(!"OPC_FLOAD_3"); break;
-	case OPC_DLOAD_0:	assert(!"OPC_DLOAD_0"); break;
-	case OPC_DLOAD_1:	assert(!"OPC_DLOAD_1"); break;
-	case OPC_DLOAD_2:	assert(!"OPC_DLOAD_2"); break;
-	case OPC_DLOAD_3:	assert(!"OPC_DLOAD_3"); break;
-	case OPC_ALOAD_0:	assert(!"OPC_ALOAD_0"); break;
-	case OPC_ALOAD_1:	assert(!"OPC_ALOAD_1"); break;
-	case OPC_ALOAD_2:	assert(!"OPC_ALOAD_2"); break;
-	case OPC_ALOAD_3:	assert(!"OPC_ALOAD_3"); break;
-	case OPC_IALOAD:	assert(!"OPC_IALOAD"); break;
-	case OPC_LALOAD:	assert(!"OPC_LALOAD"); break;
-	case OPC_FALOAD:	assert(!"OPC_FALOAD"); break;
-	case OPC_DALOAD:	assert(!"OPC_DALOAD"); break;
-	case OPC_AALOAD:	assert(!"OPC_AALOAD"); break;
-	case OPC_BALOAD:	assert(!"OPC_BALOAD"); break;
-	case OPC_CALOAD:	assert(!"OPC_CALOAD"); break;
-	case OPC_SALOAD:	assert(!"OPC_SALOAD"); break;
-	case OPC_ISTORE:	assert(!"OPC_ISTORE"); break;
-	case OPC_LSTORE:	assert(!"OPC_LSTORE"); break;
-	case OPC_FSTORE:	assert(!"OPC_FSTORE"); break;
-	case OPC_DSTORE:	assert(!"OPC_DSTORE"); break;
-	case OPC_ASTORE:	assert(!"OPC_ASTORE"); break;
-	case OPC_ISTORE_0:	assert(!"OPC_ISTORE_0"); break;
-	case OPC_ISTORE_1:	assert(!"OPC_ISTORE_1"); break;
-	case OPC_ISTORE_2:	assert(!"OPC_ISTORE_2"); break;
-	case OPC_ISTORE_3:	assert(!"OPC_ISTORE_3"); break;
-	case OPC_LSTORE_0:	assert(!"OPC_LSTORE_0"); break;
-	case OPC_LSTORE_1:	assert(!"OPC_LSTORE_1"); break;
-	case OPC_LSTORE_2:	assert(!"OPC_LSTORE_2"); break;
-	case OPC_LSTORE_3:	assert(!"OPC_LSTORE_3"); break;
-	case OPC_FSTORE_0:	assert(!"OPC_FSTORE_0"); break;
-	case OPC_FSTORE_1:	assert(!"OPC_FSTORE_1"); break;
-	case OPC_FSTORE_2:	assert(!"OPC_FSTORE_2"); break;
-	case OPC_FSTORE_3:	assert(!"OPC_FSTORE_3"); break;
-	case OPC_DSTORE_0:	assert(!"OPC_DSTORE_0"); break;
-	case OPC_DSTORE_1:	assert(!"OPC_DSTORE_1"); break;
-	case OPC_DSTORE_2:	assert(!"OPC_DSTORE_2"); break;
-	case OPC_DSTORE_3:	assert(!"OPC_DSTORE_3"); break;
-	case OPC_ASTORE_0:	assert(!"OPC_ASTORE_0"); break;
-	case OPC_ASTORE_1:	assert(!"OPC_ASTORE_1"); break;
-	case OPC_ASTORE_2:	assert(!"OPC_ASTORE_2"); break;
-	case OPC_ASTORE_3:	assert(!"OPC_ASTORE_3"); break;
-	case OPC_IASTORE:	assert(!"OPC_IASTORE"); break;
-	case OPC_LASTORE:	assert(!"OPC_LASTORE"); break;
-	case OPC_FASTORE:	assert(!"OPC_FASTORE"); break;
-	case OPC_DASTORE:	assert(!"OPC_DASTORE"); break;
-	case OPC_AASTORE:	assert(!"OPC_AASTORE"); break;
-	case OPC_BASTORE:	assert(!"OPC_BASTORE"); break;
-	case OPC_CASTORE:	assert(!"OPC_CASTORE"); break;
-	case OPC_SASTORE:	assert(!"OPC_SASTORE"); break;
-	case OPC_POP:	assert(!"OPC_POP"); break;
-	case OPC_POP2:	assert(!"OPC_POP2"); break;
-	case OPC_DUP:	assert(!"OPC_DUP"); break;
-	case OPC_DUP_X1:	assert(!"OPC_DUP_X1"); break;
-	case OPC_DUP_X2:	assert(!"OPC_DUP_X2"); break;
-	case OPC_DUP2:	assert(!"OPC_DUP2"); break;
-	case OPC_DUP2_X1:	assert(!"OPC_DUP2_X1"); break;
-	case OPC_DUP2_X2:	assert(!"OPC_DUP2_X2"); break;
-	case OPC_SWAP:	assert(!"OPC_SWAP"); break;
-	case OPC_IADD:	assert(!"OPC_IADD"); break;
-	case OPC_LADD:	assert(!"OPC_LADD"); break;
-	case OPC_FADD:	assert(!"OPC_FADD"); break;
-	case OPC_DADD:	assert(!"OPC_DADD"); break;
-	case OPC_ISUB:	assert(!"OPC_ISUB"); break;
-	case OPC_LSUB:	assert(!"OPC_LSUB"); break;
-	case OPC_FSUB:	assert(!"OPC_FSUB"); break;
-	case OPC_DSUB:	assert(!"OPC_DSUB"); break;
-	case OPC_IMUL:	assert(!"OPC_IMUL"); break;
-	case OPC_LMUL:	assert(!"OPC_LMUL"); break;
-	case OPC_FMUL:	assert(!"OPC_FMUL"); break;
-	case OPC_DMUL:	assert(!"OPC_DMUL"); break;
-	case OPC_IDIV:	assert(!"OPC_IDIV"); break;
-	case OPC_LDIV:	assert(!"OPC_LDIV"); break;
-	case OPC_FDIV:	assert(!"OPC_FDIV"); break;
-	case OPC_DDIV:	assert(!"OPC_DDIV"); break;
-	case OPC_IREM:	assert(!"OPC_IREM"); break;
-	case OPC_LREM:	assert(!"OPC_LREM"); break;
-	case OPC_FREM:	assert(!"OPC_FREM"); break;
-	case OPC_DREM:	assert(!"OPC_DREM"); break;
-	case OPC_INEG:	assert(!"OPC_INEG"); break;
-	case OPC_LNEG:	assert(!"OPC_LNEG"); break;
-	case OPC_FNEG:	assert(!"OPC_FNEG"); break;
-	case OPC_DNEG:	assert(!"OPC_DNEG"); break;
-	case OPC_ISHL:	assert(!"OPC_ISHL"); break;
-	case OPC_LSHL:	assert(!"OPC_LSHL"); break;
-	case OPC_ISHR:	assert(!"OPC_ISHR"); break;
-	case OPC_LSHR:	assert(!"OPC_LSHR"); break;
-	case OPC_IUSHR:	assert(!"OPC_IUSHR"); break;
-	case OPC_LUSHR:	assert(!"OPC_LUSHR"); break;
-	case OPC_IAND:	assert(!"OPC_IAND"); break;
-	case OPC_LAND:	assert(!"OPC_LAND"); break;
-	case OPC_IOR:	assert(!"OPC_IOR"); break;
-	case OPC_LOR:	assert(!"OPC_LOR"); break;
-	case OPC_IXOR:	assert(!"OPC_IXOR"); break;
-	case OPC_LXOR:	assert(!"OPC_LXOR"); break;
-	case OPC_IINC:	assert(!"OPC_IINC"); break;
-	case OPC_I2L:	assert(!"OPC_I2L"); break;
-	case OPC_I2F:	assert(!"OPC_I2F"); break;
-	case OPC_I2D:	assert(!"OPC_I2D"); break;
-	case OPC_L2I:	assert(!"OPC_L2I"); break;
-	case OPC_L2F:	assert(!"OPC_L2F"); break;
-	case OPC_L2D:	assert(!"OPC_L2D"); break;
-	case OPC_F2I:	assert(!"OPC_F2I"); break;
-	case OPC_F2L:	assert(!"OPC_F2L"); break;
-	case OPC_F2D:	assert(!"OPC_F2D"); break;
-	case OPC_D2I:	assert(!"OPC_D2I"); break;
-	case OPC_D2L:	assert(!"OPC_D2L"); break;
-	case OPC_D2F:	assert(!"OPC_D2F"); break;
-	case OPC_I2B:	assert(!"OPC_I2B"); break;
-	case OPC_I2C:	assert(!"OPC_I2C"); break;
-	case OPC_I2S:	assert(!"OPC_I2S"); break;
-	case OPC_LCMP:	assert(!"OPC_LCMP"); break;
-	case OPC_FCMPL:	assert(!"OPC_FCMPL"); break;
-	case OPC_FCMPG:	assert(!"OPC_FCMPG"); break;
-	case OPC_DCMPL:	assert(!"OPC_DCMPL"); break;
-	case OPC_DCMPG:	assert(!"OPC_DCMPG"); break;
-	case OPC_IFEQ:	assert(!"OPC_IFEQ"); break;
-	case OPC_IFNE:	assert(!"OPC_IFNE"); break;
-	case OPC_IFLT:	assert(!"OPC_IFLT"); break;
-	case OPC_IFGE:	assert(!"OPC_IFGE"); break;
-	case OPC_IFGT:	assert(!"OPC_IFGT"); break;
-	case OPC_IFLE:	assert(!"OPC_IFLE"); break;
-	case OPC_IF_ICMPEQ:	assert(!"OPC_IF_ICMPEQ"); break;
-	case OPC_IF_ICMPNE:	assert(!"OPC_IF_ICMPNE"); break;
-	case OPC_IF_ICMPLT:	assert(!"OPC_IF_ICMPLT"); break;
-	case OPC_IF_ICMPGE:	assert(!"OPC_IF_ICMPGE"); break;
-	case OPC_IF_ICMPGT:	assert(!"OPC_IF_ICMPGT"); break;
-	case OPC_IF_ICMPLE:	assert(!"OPC_IF_ICMPLE"); break;
-	case OPC_IF_ACMPEQ:	assert(!"OPC_IF_ACMPEQ"); break;
-	case OPC_IF_ACMPNE:	assert(!"OPC_IF_ACMPNE"); break;
-	case OPC_GOTO:	assert(!"OPC_GOTO"); break;
-	case OPC_JSR:	assert(!"OPC_JSR"); break;
-	case OPC_RET:	assert(!"OPC_RET"); break;
-	case OPC_TABLESWITCH:	assert(!"OPC_TABLESWITCH"); break;
-	case OPC_LOOKUPSWITCH:	assert(!"OPC_LOOKUPSWITCH"); break;
-	case OPC_IRETURN:	assert(!"OPC_IRETURN"); break;
-	case OPC_LRETURN:	assert(!"OPC_LRETURN"); break;
-	case OPC_FRETURN:	assert(!"OPC_FRETURN"); break;
-	case OPC_DRETURN:	assert(!"OPC_DRETURN"); break;
-	case OPC_ARETURN:	assert(!"OPC_ARETURN"); break;
-	case OPC_RETURN:
-		return INTERP_RETURN;
-	case OPC_GETSTATIC:	assert(!"OPC_GETSTATIC"); break;
-	case OPC_PUTSTATIC:	assert(!"OPC_PUTSTATIC"); break;
-	case OPC_GETFIELD:	assert(!"OPC_GETFIELD"); break;
-	case OPC_PUTFIELD:	assert(!"OPC_PUTFIELD"); break;
-	case OPC_INVOKEVIRTUAL:	assert(!"OPC_INVOKEVIRTUAL"); break;
-	case OPC_INVOKESPECIAL:	assert(!"OPC_INVOKESPECIAL"); break;
-	case OPC_INVOKESTATIC:	assert(!"OPC_INVOKESTATIC"); break;
-	case OPC_INVOKEINTERFACE:	assert(!"OPC_INVOKEINTERFACE"); break;
-	case OPC_NEW:	assert(!"OPC_NEW"); break;
-	case OPC_NEWARRAY:	assert(!"OPC_NEWARRAY"); break;
-	case OPC_ANEWARRAY:	assert(!"OPC_ANEWARRAY"); break;
-	case OPC_ARRAYLENGTH:	assert(!"OPC_ARRAYLENGTH"); break;
-	case OPC_ATHROW:	assert(!"OPC_ATHROW"); break;
-	case OPC_CHECKCAST:	assert(!"OPC_CHECKCAST"); break;
-	case OPC_INSTANCEOF:	assert(!"OPC_INSTANCEOF"); break;
-	case OPC_MONITORENTER:	assert(!"OPC_MONITORENTER"); break;
-	case OPC_MONITOREXIT:	assert(!"OPC_MONITOREXIT"); break;
-	case OPC_WIDE:	assert(!"OPC_WIDE"); break;
-	case OPC_MULTIANEWARRAY:	assert(!"OPC_MULTIANEWARRAY"); break;
-	case OPC_IFNULL:	assert(!"OPC_IFNULL"); break;
-	case OPC_IFNONNULL:	assert(!"OPC_IFNONNULL"); break;
-	case OPC_GOTO_W:	assert(!"OPC_GOTO_W"); break;
-	case OPC_JSR_W:	assert(!"OPC_JSR_W"); break;
-	case OPC_BREAKPOINT:	assert(!"OPC_BREAKPOINT"); break;
+	case OPC_INVOKEINTERFACE:
+		vmm = vm_class_resolve_interface_method_recursive(vmc, idx);
+		break;
+	case OPC_INVOKEVIRTUAL:
+		vmm = vm_class_resolve_method_recursive(vmc, idx, 0);
+		break;
 	default:
-		assert(!"unknown bytecode");
+		vmm = vm_class_resolve_method_recursive(vmc, idx, CAFEBABE_CLASS_ACC_STATIC);
+		break;
 	}
 
-	return INTERP_CONTINUE;
+	if (!vmm && !exception_occurred())
+		signal_new_exception(vm_java_lang_NoSuchMethodError, NULL);
+
+	return vmm;
 }
 
-void vm_interp_method_v(struct vm_method *method, va_list args, union jvalue *result)
+static unsigned long *ldc(struct vm_class *vmc, uint16_t idx, unsigned long *sp)
+{
+	const struct cafebabe_constant_info_utf8 *utf8;
+	struct cafebabe_constant_pool *cp;
+	struct vm_object *string;
+	struct vm_class *class;
+
+	cp = &vmc->class->constant_pool[idx];
+
+	switch (cp->tag) {
+	case CAFEBABE_CONSTANT_TAG_INTEGER:
+		PUSH_INT(cafebabe_constant_pool_get_integer(cp));
+		break;
+	case CAFEBABE_CONSTANT_TAG_FLOAT:
+		PUSH_FLOAT(cafebabe_constant_pool_get_float(cp));
+		break;
+	case CAFEBABE_CONSTANT_TAG_LONG:
+		PUSH_LONG(cafebabe_constant_pool_get_long(cp));
+		break;
+	case CAFEBABE_CONSTANT_TAG_DOUBLE:
+		PUSH_DOUBLE(cafebabe_constant_pool_get_double(cp));
+		break;
+	case CAFEBABE_CONSTANT_TAG_STRING:
+		if (cafebabe_class_constant_get_utf8(vmc->class, cp->string.string_index, &utf8)) {
+			signal_new_exception(vm_java_lang_InternalError, "unable to lookup class constant");
+			return NULL;
+		}
+
+		string = vm_object_alloc_string_from_utf8(utf8->bytes, utf8->length);
+		if (!string)
+			return NULL;
+
+		PUSH_REF(string);
+		break;
+	case CAFEBABE_CONSTANT_TAG_CLASS:
+		class = resolve_class(vmc, idx);
+		if (!class)
+			return NULL;
+
+		if (vm_class_ensure_object(class))
+			return NULL;
+
+		PUSH_REF(class->object);
+		break;
+	default:
+		signal_new_exception(vm_java_lang_InternalError, "unknown constant tag: %d", cp->tag);
+		return NULL;
+	}
+
+	return sp;
+}
+
+static int check_array_access(struct vm_object *array, jint index)
+{
+	if (!array) {
+		throw_npe();
+		return -1;
+	}
+
+	vm_object_check_array(array, index);
+	if (exception_occurred())
+		return -1;
+
+	return 0;
+}
+
+static struct vm_object *
+alloc_multi_array(struct vm_class *vmc, int nr_dimensions, jint *counts)
+{
+	struct vm_class *elem_class;
+	struct vm_object *array;
+
+	if (vm_class_ensure_init(vmc))
+		return NULL;
+
+	elem_class = vm_class_get_array_element_class(vmc);
+
+	if (vm_class_is_primitive_class(elem_class)) {
+		enum vm_type type = vm_class_get_storage_vmtype(elem_class);
+
+		array = vm_object_alloc_array_raw(vmc, vmtype_get_size(type), counts[0]);
+	} else
+		array = vm_object_alloc_array(vmc, counts[0]);
+
+	if (!array || nr_dimensions == 1)
+		return array;
+
+	for (jint i = 0; i < counts[0]; i++) {
+		struct vm_object *elem;
+
+		elem = alloc_multi_array(elem_class, nr_dimensions - 1, counts + 1);
+		if (!elem)
+			return NULL;
+
+		array_set_field_object(array, i, elem);
+	}
+
+	return array;
+}
+
+static jint idiv(jint value1, jint value2)
+{
+	if (value1 == J_INT_MIN && value2 == -1)
+		return J_INT_MIN;
+
+	return value1 / value2;
+}
+
+static jint irem(jint value1, jint value2)
+{
+	if (value2 == -1)
+		return 0;
+
+	return value1 % value2;
+}
+
+static jlong ldiv_(jlong value1, jlong value2)
+{
+	if (value1 == J_LONG_MIN && value2 == -1)
+		return J_LONG_MIN;
+
+	return value1 / value2;
+}
+
+static jlong lrem(jlong value1, jlong value2)
+{
+	if (value2 == -1)
+		return 0;
+
+	return value1 % value2;
+}
+
+static bool int_branch_taken(unsigned char opc, jint value1, jint value2)
+{
+	switch (opc) {
+	case OPC_IFEQ:
+	case OPC_IF_ICMPEQ:
+		return value1 == value2;
+	case OPC_IFNE:
+	case OPC_IF_ICMPNE:
+		return value1 != value2;
+	case OPC_IFLT:
+	case OPC_IF_ICMPLT:
+		return value1 < value2;
+	case OPC_IFGE:
+	case OPC_IF_ICMPGE:
+		return value1 >= value2;
+	case OPC_IFGT:
+	case OPC_IF_ICMPGT:
+		return value1 > value2;
+	case OPC_IFLE:
+	case OPC_IF_ICMPLE:
+		return value1 <= value2;
+	}
+
+	assert(!"not an int branch");
+	return false;
+}
+
+/*
+ * Returns the bytecode offset of the handler in @method that catches
+ * exception of class @exception_class thrown at @pc or -1 if the
+ * exception propagates to the caller.
+ */
+static long find_handler(struct vm_method *method, struct vm_class *exception_class,
+			 unsigned long pc)
+{
+	struct cafebabe_code_attribute *code_attribute = &method->code_attribute;
+
+	for (unsigned int i = 0; i < code_attribute->exception_table_length; i++) {
+		struct cafebabe_code_attribute_exception *eh;
+		struct vm_class *catch_class;
+
+		eh = &code_attribute->exception_table[i];
+		if (!exception_covers(eh, pc))
+			continue;
+
+		/* This matches to everything. */
+		if (eh->catch_type == 0)
+			return eh->handler_pc;
+
+		catch_class = vm_class_resolve_class(method->class, eh->catch_type);
+		if (catch_class && vm_class_is_assignable_from(catch_class, exception_class))
+			return eh->handler_pc;
+	}
+
+	return -1;
+}
+
+static void invoke(struct vm_method *vmm, unsigned long *args, union jvalue *result)
+{
+	if (vm_method_is_missing(vmm)) {
+		signal_new_exception(vm_java_lang_NoSuchMethodError, "%s.%s%s",
+				     vmm->class->name, vmm->name, vmm->type);
+		return;
+	}
+
+	if (vm_class_is_interface(vmm->class)) {
+		signal_new_exception(vm_java_lang_NoSuchMethodError, "%s.%s%s",
+				     slot_get_ref(args)->class->name, vmm->name, vmm->type);
+		return;
+	}
+
+	vm_call_method_a(vmm, args, result);
+}
+
+static void interp(struct interp_frame *frame, unsigned long *locals,
+		   unsigned long *stack, union jvalue *result)
+{
+	struct vm_method *method = frame->method;
+	const unsigned char *code = method->code_attribute.code;
+	struct vm_class *vmc = method->class;
+	unsigned long *sp = stack;
+	unsigned long next_pc;
+	unsigned long pc = 0;
+
+	for (;;) {
+		unsigned char opc = code[pc];
+
+		/* Make the instruction visible to the stack walker. */
+		frame->pc = pc;
+
+		next_pc = pc + bc_insn_size(code, pc);
+
+		switch (opc) {
+		case OPC_NOP:
+			break;
+		case OPC_ACONST_NULL:
+			PUSH_REF(NULL);
+			break;
+		case OPC_ICONST_M1:
+		case OPC_ICONST_0:
+		case OPC_ICONST_1:
+		case OPC_ICONST_2:
+		case OPC_ICONST_3:
+		case OPC_ICONST_4:
+		case OPC_ICONST_5:
+			PUSH_INT(opc - OPC_ICONST_0);
+			break;
+		case OPC_LCONST_0:
+		case OPC_LCONST_1:
+			PUSH_LONG(opc - OPC_LCONST_0);
+			break;
+		case OPC_FCONST_0:
+		case OPC_FCONST_1:
+		case OPC_FCONST_2:
+			PUSH_FLOAT(opc - OPC_FCONST_0);
+			break;
+		case OPC_DCONST_0:
+		case OPC_DCONST_1:
+			PUSH_DOUBLE(opc - OPC_DCONST_0);
+			break;
+		case OPC_BIPUSH:
+			PUSH_INT((int8_t) code[pc + 1]);
+			break;
+		case OPC_SIPUSH:
+			PUSH_INT(read_s16(&code[pc + 1]));
+			break;
+		case OPC_LDC:
+			sp = ldc(vmc, code[pc + 1], sp);
+			if (!sp)
+				goto exception;
+			break;
+		case OPC_LDC_W:
+		case OPC_LDC2_W:
+			sp = ldc(vmc, read_u16(&code[pc + 1]), sp);
+			if (!sp)
+				goto exception;
+			break;
+		case OPC_ILOAD:
+		case OPC_FLOAD:
+		case OPC_ALOAD:
+			*sp++ = locals[code[pc + 1]];
+			break;
+		case OPC_LLOAD:
+		case OPC_DLOAD:
+			sp[0] = locals[code[pc + 1]];
+			sp[1] = locals[code[pc + 1] + 1];
+			sp += 2;
+			break;
+		case OPC_ILOAD_0:
+		case OPC_ILOAD_1:
+		case OPC_ILOAD_2:
+		case OPC_ILOAD_3:
+		case OPC_FLOAD_0:
+		case OPC_FLOAD_1:
+		case OPC_FLOAD_2:
+		case OPC_FLOAD_3:
+		case OPC_ALOAD_0:
+		case OPC_ALOAD_1:
+		case OPC_ALOAD_2:
+		case OPC_ALOAD_3:
+			*sp++ = locals[(opc - OPC_ILOAD_0) & 3];
+			break;
+		case OPC_LLOAD_0:
+		case OPC_LLOAD_1:
+		case OPC_LLOAD_2:
+		case OPC_LLOAD_3:
+		case OPC_DLOAD_0:
+		case OPC_DLOAD_1:
+		case OPC_DLOAD_2:
+		case OPC_DLOAD_3: {
+			unsigned int idx = (opc - OPC_ILOAD_0) & 3;
+
+			sp[0] = locals[idx];
+			sp[1] = locals[idx + 1];
+			sp += 2;
+			break;
+		}
+		case OPC_IALOAD: {
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			PUSH_INT(array_get_field_int(array, index));
+			break;
+		}
+		case OPC_LALOAD: {
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			PUSH_LONG(array_get_field_long(array, index));
+			break;
+		}
+		case OPC_FALOAD: {
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			PUSH_FLOAT(array_get_field_float(array, index));
+			break;
+		}
+		case OPC_DALOAD: {
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			PUSH_DOUBLE(array_get_field_double(array, index));
+			break;
+		}
+		case OPC_AALOAD: {
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			PUSH_REF(array_get_field_object(array, index));
+			break;
+		}
+		case OPC_BALOAD: {
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			PUSH_INT(array_get_field_byte(array, index));
+			break;
+		}
+		case OPC_CALOAD: {
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			PUSH_INT(array_get_field_char(array, index));
+			break;
+		}
+		case OPC_SALOAD: {
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			PUSH_INT(array_get_field_short(array, index));
+			break;
+		}
+		case OPC_ISTORE:
+		case OPC_FSTORE:
+		case OPC_ASTORE:
+			locals[code[pc + 1]] = *--sp;
+			break;
+		case OPC_LSTORE:
+		case OPC_DSTORE:
+			sp -= 2;
+			locals[code[pc + 1]] = sp[0];
+			locals[code[pc + 1] + 1] = sp[1];
+			break;
+		case OPC_ISTORE_0:
+		case OPC_ISTORE_1:
+		case OPC_ISTORE_2:
+		case OPC_ISTORE_3:
+		case OPC_FSTORE_0:
+		case OPC_FSTORE_1:
+		case OPC_FSTORE_2:
+		case OPC_FSTORE_3:
+		case OPC_ASTORE_0:
+		case OPC_ASTORE_1:
+		case OPC_ASTORE_2:
+		case OPC_ASTORE_3:
+			locals[(opc - OPC_ISTORE_0) & 3] = *--sp;
+			break;
+		case OPC_LSTORE_0:
+		case OPC_LSTORE_1:
+		case OPC_LSTORE_2:
+		case OPC_LSTORE_3:
+		case OPC_DSTORE_0:
+		case OPC_DSTORE_1:
+		case OPC_DSTORE_2:
+		case OPC_DSTORE_3: {
+			unsigned int idx = (opc - OPC_ISTORE_0) & 3;
+
+			sp -= 2;
+			locals[idx] = sp[0];
+			locals[idx + 1] = sp[1];
+			break;
+		}
+		case OPC_IASTORE: {
+			jint value = POP_INT();
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			array_set_field_int(array, index, value);
+			break;
+		}
+		case OPC_LASTORE: {
+			jlong value = POP_LONG();
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			array_set_field_long(array, index, value);
+			break;
+		}
+		case OPC_FASTORE: {
+			jfloat value = POP_FLOAT();
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			array_set_field_float(array, index, value);
+			break;
+		}
+		case OPC_DASTORE: {
+			jdouble value = POP_DOUBLE();
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			array_set_field_double(array, index, value);
+			break;
+		}
+		case OPC_AASTORE: {
+			struct vm_object *value = POP_REF();
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			array_store_check(array, value);
+			if (exception_occurred())
+				goto exception;
+
+			array_set_field_object(array, index, value);
+			break;
+		}
+		case OPC_BASTORE: {
+			jint value = POP_INT();
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			array_set_field_byte(array, index, value);
+			break;
+		}
+		case OPC_CASTORE: {
+			jint value = POP_INT();
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			array_set_field_char(array, index, value);
+			break;
+		}
+		case OPC_SASTORE: {
+			jint value = POP_INT();
+			jint index = POP_INT();
+			struct vm_object *array = POP_REF();
+
+			if (check_array_access(array, index))
+				goto exception;
+
+			array_set_field_short(array, index, value);
+			break;
+		}
+		case OPC_POP:
+			sp--;
+			break;
+		case OPC_POP2:
+			sp -= 2;
+			break;
+		case OPC_DUP:
+			sp[0] = sp[-1];
+			sp++;
+			break;
+		case OPC_DUP_X1: {
+			unsigned long v1 = sp[-1], v2 = sp[-2];
+
+			sp[-2] = v1;
+			sp[-1] = v2;
+			sp[0] = v1;
+			sp++;
+			break;
+		}
+		case OPC_DUP_X2: {
+			unsigned long v1 = sp[-1], v2 = sp[-2], v3 = sp[-3];
+
+			sp[-3] = v1;
+			sp[-2] = v3;
+			sp[-1] = v2;
+			sp[0] = v1;
+			sp++;
+			break;
+		}
+		case OPC_DUP2:
+			sp[0] = sp[-2];
+			sp[1] = sp[-1];
+			sp += 2;
+			break;
+		case OPC_DUP2_X1: {
+			unsigned long v1 = sp[-1], v2 = sp[-2], v3 = sp[-3];
+
+			sp[-3] = v2;
+			sp[-2] = v1;
+			sp[-1] = v3;
+			sp[0] = v2;
+			sp[1] = v1;
+			sp += 2;
+			break;
+		}
+		case OPC_DUP2_X2: {
+			unsigned long v1 = sp[-1], v2 = sp[-2], v3 = sp[-3], v4 = sp[-4];
+
+			sp[-4] = v2;
+			sp[-3] = v1;
+			sp[-2] = v4;
+			sp[-1] = v3;
+			sp[0] = v2;
+			sp[1] = v1;
+			sp += 2;
+			break;
+		}
+		case OPC_SWAP: {
+			unsigned long v1 = sp[-1];
+
+			sp[-1] = sp[-2];
+			sp[-2] = v1;
+			break;
+		}
+		case OPC_IADD:
+		case OPC_ISUB:
+		case OPC_IMUL:
+		case OPC_IAND:
+		case OPC_IOR:
+		case OPC_IXOR:
+		case OPC_ISHL:
+		case OPC_ISHR:
+		case OPC_IUSHR: {
+			uint32_t value2 = POP_INT();
+			uint32_t value1 = POP_INT();
+			uint32_t value;
+
+			switch (opc) {
+			case OPC_IADD:	value = value1 + value2; break;
+			case OPC_ISUB:	value = value1 - value2; break;
+			case OPC_IMUL:	value = value1 * value2; break;
+			case OPC_IAND:	value = value1 & value2; break;
+			case OPC_IOR:	value = value1 | value2; break;
+			case OPC_IXOR:	value = value1 ^ value2; break;
+			case OPC_ISHL:	value = value1 << (value2 & 0x1f); break;
+			case OPC_ISHR:	value = (int32_t) value1 >> (value2 & 0x1f); break;
+			default:	value = value1 >> (value2 & 0x1f); break;
+			}
+
+			PUSH_INT(value);
+			break;
+		}
+		case OPC_LADD:
+		case OPC_LSUB:
+		case OPC_LMUL:
+		case OPC_LAND:
+		case OPC_LOR:
+		case OPC_LXOR: {
+			uint64_t value2 = POP_LONG();
+			uint64_t value1 = POP_LONG();
+			uint64_t value;
+
+			switch (opc) {
+			case OPC_LADD:	value = value1 + value2; break;
+			case OPC_LSUB:	value = value1 - value2; break;
+			case OPC_LMUL:	value = value1 * value2; break;
+			case OPC_LAND:	value = value1 & value2; break;
+			case OPC_LOR:	value = value1 | value2; break;
+			default:	value = value1 ^ value2; break;
+			}
+
+			PUSH_LONG(value);
+			break;
+		}
+		case OPC_LSHL:
+		case OPC_LSHR:
+		case OPC_LUSHR: {
+			jint value2 = POP_INT();
+			uint64_t value1 = POP_LONG();
+			uint64_t value;
+
+			switch (opc) {
+			case OPC_LSHL:	value = value1 << (value2 & 0x3f); break;
+			case OPC_LSHR:	value = (int64_t) value1 >> (value2 & 0x3f); break;
+			default:	value = value1 >> (value2 & 0x3f); break;
+			}
+
+			PUSH_LONG(value);
+			break;
+		}
+		case OPC_IDIV:
+		case OPC_IREM: {
+			jint value2 = POP_INT();
+			jint value1 = POP_INT();
+
+			if (value2 == 0) {
+				signal_new_exception(vm_java_lang_ArithmeticException, "division by zero");
+				goto exception;
+			}
+
+			PUSH_INT(opc == OPC_IDIV ? idiv(value1, value2) : irem(value1, value2));
+			break;
+		}
+		case OPC_LDIV:
+		case OPC_LREM: {
+			jlong value2 = POP_LONG();
+			jlong value1 = POP_LONG();
+
+			if (value2 == 0) {
+				signal_new_exception(vm_java_lang_ArithmeticException, "division by zero");
+				goto exception;
+			}
+
+			PUSH_LONG(opc == OPC_LDIV ? ldiv_(value1, value2) : lrem(value1, value2));
+			break;
+		}
+		case OPC_FADD:
+		case OPC_FSUB:
+		case OPC_FMUL:
+		case OPC_FDIV:
+		case OPC_FREM: {
+			jfloat value2 = POP_FLOAT();
+			jfloat value1 = POP_FLOAT();
+			jfloat value;
+
+			switch (opc) {
+			case OPC_FADD:	value = value1 + value2; break;
+			case OPC_FSUB:	value = value1 - value2; break;
+			case OPC_FMUL:	value = value1 * value2; break;
+			case OPC_FDIV:	value = value1 / value2; break;
+			default:	value = fmodf(value1, value2); break;
+			}
+
+			PUSH_FLOAT(value);
+			break;
+		}
+		case OPC_DADD:
+		case OPC_DSUB:
+		case OPC_DMUL:
+		case OPC_DDIV:
+		case OPC_DREM: {
+			jdouble value2 = POP_DOUBLE();
+			jdouble value1 = POP_DOUBLE();
+			jdouble value;
+
+			switch (opc) {
+			case OPC_DADD:	value = value1 + value2; break;
+			case OPC_DSUB:	value = value1 - value2; break;
+			case OPC_DMUL:	value = value1 * value2; break;
+			case OPC_DDIV:	value = value1 / value2; break;
+			default:	value = fmod(value1, value2); break;
+			}
+
+			PUSH_DOUBLE(value);
+			break;
+		}
+		case OPC_INEG:
+			slot_set_int(sp - 1, -(uint32_t) slot_get_int(sp - 1));
+			break;
+		case OPC_LNEG:
+			slot_set_long(sp - 2, -(uint64_t) slot_get_long(sp - 2));
+			break;
+		case OPC_FNEG:
+			slot_set_float(sp - 1, -slot_get_float(sp - 1));
+			break;
+		case OPC_DNEG:
+			slot_set_double(sp - 2, -slot_get_double(sp - 2));
+			break;
+		case OPC_IINC: {
+			unsigned int idx = code[pc + 1];
+
+			slot_set_int(&locals[idx], (uint32_t) slot_get_int(&locals[idx]) + (int8_t) code[pc + 2]);
+			break;
+		}
+		case OPC_I2L:
+		case OPC_I2F:
+		case OPC_I2D:
+		case OPC_I2B:
+		case OPC_I2C:
+		case OPC_I2S: {
+			jint value = POP_INT();
+
+			switch (opc) {
+			case OPC_I2L:	PUSH_LONG(value); break;
+			case OPC_I2F:	PUSH_FLOAT(value); break;
+			case OPC_I2D:	PUSH_DOUBLE(value); break;
+			case OPC_I2B:	PUSH_INT((jbyte) value); break;
+			case OPC_I2C:	PUSH_INT((jchar) value); break;
+			default:	PUSH_INT((jshort) value); break;
+			}
+			break;
+		}
+		case OPC_L2I:
+		case OPC_L2F:
+		case OPC_L2D: {
+			jlong value = POP_LONG();
+
+			switch (opc) {
+			case OPC_L2I:	PUSH_INT((jint) value); break;
+			case OPC_L2F:	PUSH_FLOAT(value); break;
+			default:	PUSH_DOUBLE(value); break;
+			}
+			break;
+		}
+		case OPC_F2I:
+		case OPC_F2L:
+		case OPC_F2D: {
+			jfloat value = POP_FLOAT();
+
+			switch (opc) {
+			case OPC_F2I:	PUSH_INT(emulate_f2i(value)); break;
+			case OPC_F2L:	PUSH_LONG(emulate_f2l(value)); break;
+			default:	PUSH_DOUBLE(value); break;
+			}
+			break;
+		}
+		case OPC_D2I:
+		case OPC_D2L:
+		case OPC_D2F: {
+			jdouble value = POP_DOUBLE();
+
+			switch (opc) {
+			case OPC_D2I:	PUSH_INT(emulate_d2i(value)); break;
+			case OPC_D2L:	PUSH_LONG(emulate_d2l(value)); break;
+			default:	PUSH_FLOAT(value); break;
+			}
+			break;
+		}
+		case OPC_LCMP: {
+			jlong value2 = POP_LONG();
+			jlong value1 = POP_LONG();
+
+			PUSH_INT(emulate_lcmp(value1, value2));
+			break;
+		}
+		case OPC_FCMPL:
+		case OPC_FCMPG: {
+			jfloat value2 = POP_FLOAT();
+			jfloat value1 = POP_FLOAT();
+
+			if (opc == OPC_FCMPL)
+				PUSH_INT(emulate_fcmpl(value1, value2));
+			else
+				PUSH_INT(emulate_fcmpg(value1, value2));
+			break;
+		}
+		case OPC_DCMPL:
+		case OPC_DCMPG: {
+			jdouble value2 = POP_DOUBLE();
+			jdouble value1 = POP_DOUBLE();
+
+			if (opc == OPC_DCMPL)
+				PUSH_INT(emulate_dcmpl(value1, value2));
+			else
+				PUSH_INT(emulate_dcmpg(value1, value2));
+			break;
+		}
+		case OPC_IFEQ:
+		case OPC_IFNE:
+		case OPC_IFLT:
+		case OPC_IFGE:
+		case OPC_IFGT:
+		case OPC_IFLE: {
+			jint value = POP_INT();
+
+			if (int_branch_taken(opc, value, 0))
+				next_pc = pc + read_s16(&code[pc + 1]);
+			break;
+		}
+		case OPC_IF_ICMPEQ:
+		case OPC_IF_ICMPNE:
+		case OPC_IF_ICMPLT:
+		case OPC_IF_ICMPGE:
+		case OPC_IF_ICMPGT:
+		case OPC_IF_ICMPLE: {
+			jint value2 = POP_INT();
+			jint value1 = POP_INT();
+
+			if (int_branch_taken(opc, value1, value2))
+				next_pc = pc + read_s16(&code[pc + 1]);
+			break;
+		}
+		case OPC_IF_ACMPEQ:
+		case OPC_IF_ACMPNE: {
+			struct vm_object *value2 = POP_REF();
+			struct vm_object *value1 = POP_REF();
+
+			if ((value1 == value2) == (opc == OPC_IF_ACMPEQ))
+				next_pc = pc + read_s16(&code[pc + 1]);
+			break;
+		}
+		case OPC_IFNULL:
+		case OPC_IFNONNULL: {
+			struct vm_object *value = POP_REF();
+
+			if ((value == NULL) == (opc == OPC_IFNULL))
+				next_pc = pc + read_s16(&code[pc + 1]);
+			break;
+		}
+		case OPC_GOTO:
+			next_pc = pc + read_s16(&code[pc + 1]);
+			break;
+		case OPC_GOTO_W:
+			next_pc = pc + read_s32(&code[pc + 1]);
+			break;
+		case OPC_JSR:
+			*sp++ = next_pc;
+			next_pc = pc + read_s16(&code[pc + 1]);
+			break;
+		case OPC_JSR_W:
+			*sp++ = next_pc;
+			next_pc = pc + read_s32(&code[pc + 1]);
+			break;
+		case OPC_RET:
+			next_pc = locals[code[pc + 1]];
+			break;
+		case OPC_TABLESWITCH: {
+			struct tableswitch_info info;
+			jint index = POP_INT();
+
+			get_tableswitch_info(code, pc, &info);
+
+			if (index < (int32_t) info.low || index > (int32_t) info.high)
+				next_pc = pc + info.default_target;
+			else
+				next_pc = pc + read_s32(info.targets + (index - (int32_t) info.low) * 4);
+			break;
+		}
+		case OPC_LOOKUPSWITCH: {
+			struct lookupswitch_info info;
+			jint key = POP_INT();
+
+			get_lookupswitch_info(code, pc, &info);
+
+			next_pc = pc + info.default_target;
+
+			for (unsigned int i = 0; i < info.count; i++) {
+				if (read_lookupswitch_match(&info, i) == key) {
+					next_pc = pc + read_lookupswitch_target(&info, i);
+					break;
+				}
+			}
+			break;
+		}
+		case OPC_IRETURN:
+			set_int_result(method, result, POP_INT());
+			return;
+		case OPC_LRETURN:
+			result->j = POP_LONG();
+			return;
+		case OPC_FRETURN:
+			result->f = POP_FLOAT();
+			return;
+		case OPC_DRETURN:
+			result->d = POP_DOUBLE();
+			return;
+		case OPC_ARETURN:
+			result->l = POP_REF();
+			return;
+		case OPC_RETURN:
+			return;
+		case OPC_GETSTATIC: {
+			struct vm_field *vmf;
+
+			vmf = resolve_field(vmc, read_u16(&code[pc + 1]), true);
+			if (!vmf)
+				goto exception;
+
+			sp = push_value(sp, vm_field_type(vmf), &vmf->class->static_values[vmf->offset]);
+			break;
+		}
+		case OPC_PUTSTATIC: {
+			struct vm_field *vmf;
+
+			vmf = resolve_field(vmc, read_u16(&code[pc + 1]), true);
+			if (!vmf)
+				goto exception;
+
+			sp = pop_value(sp, vm_field_type(vmf), &vmf->class->static_values[vmf->offset]);
+			break;
+		}
+		case OPC_GETFIELD: {
+			struct vm_object *obj;
+			struct vm_field *vmf;
+
+			vmf = resolve_field(vmc, read_u16(&code[pc + 1]), false);
+			if (!vmf)
+				goto exception;
+
+			obj = POP_REF();
+			if (!obj) {
+				throw_npe();
+				goto exception;
+			}
+
+			sp = push_value(sp, vm_field_type(vmf), &vm_object_fields(obj)[vmf->offset]);
+			break;
+		}
+		case OPC_PUTFIELD: {
+			struct vm_object *obj;
+			struct vm_field *vmf;
+			enum vm_type type;
+
+			vmf = resolve_field(vmc, read_u16(&code[pc + 1]), false);
+			if (!vmf)
+				goto exception;
+
+			type = vm_field_type(vmf);
+
+			obj = slot_get_ref(sp - (vm_type_is_pair(type) ? 2 : 1) - 1);
+			if (!obj) {
+				throw_npe();
+				goto exception;
+			}
+
+			sp = pop_value(sp, type, &vm_object_fields(obj)[vmf->offset]);
+			sp--;
+
+			if (type == J_REFERENCE)
+				gc_card_mark(obj);
+			break;
+		}
+		case OPC_INVOKEVIRTUAL:
+		case OPC_INVOKESPECIAL:
+		case OPC_INVOKESTATIC:
+		case OPC_INVOKEINTERFACE: {
+			struct vm_method *target;
+			union jvalue ret;
+			unsigned long *args;
+
+			target = resolve_method(vmc, opc, read_u16(&code[pc + 1]));
+			if (!target)
+				goto exception;
+
+			args = sp - target->args_count;
+
+			if (opc != OPC_INVOKESTATIC) {
+				struct vm_object *this = slot_get_ref(args);
+
+				if (!this) {
+					throw_npe();
+					goto exception;
+				}
+
+				if (opc != OPC_INVOKESPECIAL)
+					target = vm_class_get_virtual_method(this->class, target);
+			}
+
+			sp = args;
+
+			invoke(target, args, &ret);
+			if (exception_occurred())
+				goto exception;
+
+			sp = push_result(sp, target->return_type.vm_type, &ret);
+			break;
+		}
+		case OPC_NEW: {
+			struct vm_object *obj;
+			struct vm_class *class;
+
+			class = resolve_class(vmc, read_u16(&code[pc + 1]));
+			if (!class)
+				goto exception;
+
+			obj = vm_object_alloc(class);
+			if (!obj)
+				goto exception;
+
+			PUSH_REF(obj);
+			break;
+		}
+		case OPC_NEWARRAY: {
+			struct vm_object *array;
+			jint count = POP_INT();
+
+			array_size_check(count);
+			if (exception_occurred())
+				goto exception;
+
+			array = vm_object_alloc_primitive_array(code[pc + 1], count);
+			if (!array)
+				goto exception;
+
+			PUSH_REF(array);
+			break;
+		}
+		case OPC_ANEWARRAY: {
+			struct vm_object *array;
+			struct vm_class *class;
+			jint count = POP_INT();
+
+			class = resolve_class(vmc, read_u16(&code[pc + 1]));
+			if (!class)
+				goto exception;
+
+			array_size_check(count);
+			if (exception_occurred())
+				goto exception;
+
+			array = vm_object_alloc_array_of(class, count);
+			if (!array)
+				goto exception;
+
+			PUSH_REF(array);
+			break;
+		}
+		case OPC_MULTIANEWARRAY: {
+			unsigned int nr_dimensions = code[pc + 3];
+			jint counts[nr_dimensions];
+			struct vm_object *array;
+			struct vm_class *class;
+
+			class = resolve_class(vmc, read_u16(&code[pc + 1]));
+			if (!class)
+				goto exception;
+
+			sp -= nr_dimensions;
+
+			for (unsigned int i = 0; i < nr_dimensions; i++) {
+				counts[i] = slot_get_int(&sp[i]);
+
+				array_size_check(counts[i]);
+				if (exception_occurred())
+					goto exception;
+			}
+
+			array = alloc_multi_array(class, nr_dimensions, counts);
+			if (!array)
+				goto exception;
+
+			PUSH_REF(array);
+			break;
+		}
+		case OPC_ARRAYLENGTH: {
+			struct vm_object *array = POP_REF();
+
+			if (!array) {
+				throw_npe();
+				goto exception;
+			}
+
+			PUSH_INT(vm_array_length(array));
+			break;
+		}
+		case OPC_ATHROW: {
+			struct vm_object *obj = POP_REF();
+
+			if (!obj) {
+				throw_npe();
+				goto exception;
+			}
+
+			signal_exception(obj);
+			goto exception;
+		}
+		case OPC_CHECKCAST: {
+			struct vm_class *class;
+
+			class = resolve_class(vmc, read_u16(&code[pc + 1]));
+			if (!class)
+				goto exception;
+
+			vm_object_check_cast(slot_get_ref(sp - 1), class);
+			if (exception_occurred())
+				goto exception;
+			break;
+		}
+		case OPC_INSTANCEOF: {
+			struct vm_object *obj = POP_REF();
+			struct vm_class *class;
+
+			class = resolve_class(vmc, read_u16(&code[pc + 1]));
+			if (!class)
+				goto exception;
+
+			PUSH_INT(vm_object_is_instance_of(obj, class));
+			break;
+		}
+		case OPC_MONITORENTER:
+		case OPC_MONITOREXIT: {
+			struct vm_object *obj = POP_REF();
+			int err;
+
+			if (!obj) {
+				throw_npe();
+				goto exception;
+			}
+
+			if (opc == OPC_MONITORENTER)
+				err = vm_object_lock(obj);
+			else
+				err = vm_object_unlock(obj);
+
+			if (err)
+				goto exception;
+			break;
+		}
+		case OPC_WIDE: {
+			unsigned int idx = read_u16(&code[pc + 2]);
+
+			switch (code[pc + 1]) {
+			case OPC_ILOAD:
+			case OPC_FLOAD:
+			case OPC_ALOAD:
+				*sp++ = locals[idx];
+				break;
+			case OPC_LLOAD:
+			case OPC_DLOAD:
+				sp[0] = locals[idx];
+				sp[1] = locals[idx + 1];
+				sp += 2;
+				break;
+			case OPC_ISTORE:
+			case OPC_FSTORE:
+			case OPC_ASTORE:
+				locals[idx] = *--sp;
+				break;
+			case OPC_LSTORE:
+			case OPC_DSTORE:
+				sp -= 2;
+				locals[idx] = sp[0];
+				locals[idx + 1] = sp[1];
+				break;
+			case OPC_IINC:
+				slot_set_int(&locals[idx], (uint32_t) slot_get_int(&locals[idx]) + read_s16(&code[pc + 4]));
+				break;
+			case OPC_RET:
+				next_pc = locals[idx];
+				break;
+			default:
+				signal_new_exception(vm_java_lang_VerifyError, "invalid wide opcode");
+				goto exception;
+			}
+			break;
+		}
+		default:
+			signal_new_exception(vm_java_lang_VerifyError, "invalid opcode 0x%x", opc);
+			goto exception;
+		}
+
+		/* Loop back branches make a method hot just like invocations. */
+		if (next_pc <= pc)
+			method->backedge_count++;
+
+		pc = next_pc;
+		continue;
+
+exception: {
+			struct vm_object *exception = exception_occurred();
+			long handler_pc;
+
+			handler_pc = find_handler(method, exception->class, pc);
+			if (handler_pc < 0)
+				return;
+
+			clear_exception();
+
+			sp = stack;
+			PUSH_REF(exception);
+
+			pc = handler_pc;
+		}
+	}
+}
+
+/**
+ * vm_interp_method_a - executes @method in the interpreter
+ *
+ * The @args array contains the arguments in the same layout as for
+ * vm_call_method_a(). If the method throws, the exception is left
+ * pending for the caller.
+ */
+void vm_interp_method_a(struct vm_method *method, unsigned long *args, union jvalue *result)
 {
-	uint32_t pc;
+	struct cafebabe_code_attribute *code_attribute = &method->code_attribute;
+	unsigned long locals[code_attribute->max_locals + 1];
+	unsigned long stack[code_attribute->max_stack + 1];
+	struct vm_object *lock = NULL;
+	struct interp_frame frame;
+
+	method->invocation_count++;
+
+	result->j = 0;
+
+	if (vm_method_is_static(method) && vm_class_ensure_init(method->class))
+		return;
+
+	memcpy(locals, args, sizeof(unsigned long) * method->args_count);
 
-	pc = 0;
-	while (pc < method->code_attribute.code_length) {
-		uint8_t opc = method->code_attribute.code[pc];
+	if (method_is_synchronized(method)) {
+		if (vm_method_is_static(method))
+			lock = method->class->object;
+		else
+			lock = slot_get_ref(&locals[0]);
 
-		if (interp(opc) == INTERP_RETURN)
+		if (vm_object_lock(lock))
 			return;
+	}
+
+	frame.method = method;
+	frame.pc = 0;
+	frame.native_frame = __builtin_frame_address(0);
+	vm_enter_interp(&frame);
+
+	interp(&frame, locals, stack, result);
+
+	vm_leave_interp();
+
+	if (lock) {
+		struct vm_object *exception = exception_occurred();
 
-		pc++;
+		clear_exception();
+
+		if (vm_object_unlock(lock))
+			return;
+
+		if (exception)
+			signal_exception(exception);
 	}
 }
+
+void vm_interp_method_v(struct vm_method *method, va_list args, union jvalue *result)
+{
+	unsigned long args_array[method->args_count];
+
+	for (int i = 0; i < method->args_count; i++)
+		args_array[i] = va_arg(args, unsigned long);
+
+	vm_interp_method_a(method, args_array, result);
+}
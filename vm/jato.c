@@ -53,11 +53,14 @@
 #include "runtime/stack-walker.h"
 #include "runtime/runtime.h"
 
+#include "jit/cha.h"
+#include "jit/compile-queue.h"
 #include "jit/compiler.h"
 #include "jit/cu-mapping.h"
 #include "jit/gdb.h"
 #include "jit/exception.h"
 #include "jit/inline-cache.h"
+#include "jit/inline.h"
 #include "jit/perf-map.h"
 #include "jit/debug.h"
 #include "jit/text.h"
@@ -73,6 +76,7 @@
 #include "vm/reflection.h"
 #include "vm/natives.h"
 #include "vm/preload.h"
+#include "vm/profiler.h"
 #include "vm/version.h"
 #include "vm/interp.h"
 #include "vm/itable.h"
@@ -90,12 +94,14 @@
 #include "vm/jar.h"
 #include "vm/jni.h"
 #include "vm/gc.h"
+#include "vm/gc-log.h"
 #include "vm/vm.h"
 #include "vm/java-version.h"
 
 #include "arch/init.h"
 
 #include "runtime/gnu_java_lang_management_VMThreadMXBeanImpl.h"
+#include "runtime/memory-management.h"
 #include "runtime/java_lang_reflect_VMMethod.h"
 #include "runtime/java_lang_reflect_VMField.h"
 #include "runtime/java_lang_VMClassLoader.h"
@@ -122,15 +128,27 @@ static bool use_system_classloader = true;
  */
 bool opt_ssa_enable;
 
-static bool opt_interp_only;
-
 /*
  * Enable JIT workarounds for valgrind.
  */
 bool running_on_valgrind;
 
+/*
+ * Print JIT code cache statistics at exit.
+ */
+static bool opt_print_code_cache;
+static bool opt_print_string_table_stats;
+
 static void vm_atexit(void)
 {
+	if (opt_print_code_cache)
+		jit_text_print_stats();
+
+	if (opt_print_string_table_stats)
+		vm_string_print_stats();
+
+	profiler_exit();
+
 	classloader_destroy();
 }
 
@@ -428,6 +446,23 @@ static jint native_atomiclong_vm_supports_cs8(void)
 }
 
 static struct vm_native natives[] = {
+	DEFINE_NATIVE("gnu/java/lang/management/VMGarbageCollectorMXBeanImpl", "getCollectionCount", native_vmgarbagecollectormxbeanimpl_get_collection_count),
+	DEFINE_NATIVE("gnu/java/lang/management/VMGarbageCollectorMXBeanImpl", "getCollectionTime", native_vmgarbagecollectormxbeanimpl_get_collection_time),
+	DEFINE_NATIVE("gnu/java/lang/management/VMManagementFactory", "getGarbageCollectorNames", native_vmmanagementfactory_get_garbage_collector_names),
+	DEFINE_NATIVE("gnu/java/lang/management/VMManagementFactory", "getMemoryManagerNames", native_vmmanagementfactory_get_memory_manager_names),
+	DEFINE_NATIVE("gnu/java/lang/management/VMManagementFactory", "getMemoryPoolNames", native_vmmanagementfactory_get_memory_pool_names),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryMXBeanImpl", "getObjectPendingFinalizationCount", native_vmmemorymxbeanimpl_get_object_pending_finalization_count),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryMXBeanImpl", "isVerbose", native_vmmemorymxbeanimpl_is_verbose),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryMXBeanImpl", "setVerbose", native_vmmemorymxbeanimpl_set_verbose),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryManagerMXBeanImpl", "getMemoryPoolNames", native_vmmemorymanagermxbeanimpl_get_memory_pool_names),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryManagerMXBeanImpl", "isValid", native_vmmemorymanagermxbeanimpl_is_valid),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryPoolMXBeanImpl", "getCollectionUsage", native_vmmemorypoolmxbeanimpl_get_collection_usage),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryPoolMXBeanImpl", "getMemoryManagerNames", native_vmmemorypoolmxbeanimpl_get_memory_manager_names),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryPoolMXBeanImpl", "getPeakUsage", native_vmmemorypoolmxbeanimpl_get_peak_usage),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryPoolMXBeanImpl", "getType", native_vmmemorypoolmxbeanimpl_get_type),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryPoolMXBeanImpl", "getUsage", native_vmmemorypoolmxbeanimpl_get_usage),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryPoolMXBeanImpl", "isValid", native_vmmemorypoolmxbeanimpl_is_valid),
+	DEFINE_NATIVE("gnu/java/lang/management/VMMemoryPoolMXBeanImpl", "resetPeakUsage", native_vmmemorypoolmxbeanimpl_reset_peak_usage),
 	DEFINE_NATIVE("gnu/java/lang/management/VMThreadMXBeanImpl", "getThreadInfoForId", gnu_java_lang_management_VMThreadMXBeanImpl_getThreadInfoForId),
 	DEFINE_NATIVE("gnu/classpath/VMStackWalker", "getClassContext", native_vmstackwalker_getclasscontext),
 	DEFINE_NATIVE("gnu/classpath/VMStackWalker", "getClassLoader", java_lang_VMClass_getClassLoader),
@@ -589,6 +624,10 @@ static void jit_init_natives(void)
 	"  -version	   print out version number and copyright information\n"	\
 	"\n"										\
 	"  -Xint           operate in interpreter-only mode\n"				\
+	"  -XX:+TieredCompilation interpret methods until they become hot\n"		\
+	"  -XX:CompileThreshold=<n> invocations before a method is compiled\n"		\
+	"  -XX:CICompilerCount=<n> number of background compiler threads\n"		\
+	"  -Xbatch         compile hot methods in the calling thread\n"		\
 	"  -XX:+PrintCompilation Print a message when a method is compiled\n"
 
 static void usage(FILE *f, int retval)
@@ -703,6 +742,12 @@ static void handle_newgc(void)
 	newgc_enabled	= true;
 }
 
+static void handle_generational_gc(void)
+{
+	newgc_enabled	= true;
+	gc_generational	= true;
+}
+
 static void handle_maps(void)
 {
 	dump_maps = true;
@@ -713,6 +758,16 @@ static void handle_perf(void)
 	perf_enabled = true;
 }
 
+static void handle_profile(void)
+{
+	opt_profile = true;
+}
+
+static void handle_profile_counters(void)
+{
+	opt_profile_counters = true;
+}
+
 static void handle_ssa(void)
 {
 	opt_ssa_enable = true;
@@ -723,11 +778,31 @@ static void handle_no_ic(void)
 	opt_ic_enabled  = false;
 }
 
+static void handle_no_inline(void)
+{
+	opt_inline_enabled = false;
+}
+
+static void handle_no_cha(void)
+{
+	opt_cha = false;
+}
+
 static void handle_int(void)
 {
 	opt_interp_only  = true;
 }
 
+static void handle_tiered_compilation(void)
+{
+	opt_tiered_compilation = true;
+}
+
+static void handle_batch(void)
+{
+	opt_background_compilation = false;
+}
+
 static void regex_compile(regex_t *regex, const char *arg)
 {
 	int err = regcomp(regex, arg, REG_EXTENDED | REG_NOSUB);
@@ -808,6 +883,11 @@ static void handle_trace_itable(void)
 	opt_trace_itable = true;
 }
 
+static void handle_trace_ic(void)
+{
+	opt_trace_ic = true;
+}
+
 static void handle_trace_liveness(void)
 {
 	opt_trace_liveness = true;
@@ -886,16 +966,81 @@ static void handle_max_heap_size(const char *arg)
 	}
 }
 
+static void handle_nursery_size(const char *arg)
+{
+	gc_nursery_size = parse_long(arg);
+
+	if (!gc_nursery_size) {
+		fprintf(stderr, "%s: unparseable nursery size '%s'\n", program_name, arg);
+		usage(stderr, EXIT_FAILURE);
+	}
+}
+
+static void handle_gc_threads(const char *arg)
+{
+	opt_nr_gc_threads = parse_long(arg);
+
+	if (!opt_nr_gc_threads) {
+		fprintf(stderr, "%s: invalid GC thread count '%s'\n", program_name, arg);
+		usage(stderr, EXIT_FAILURE);
+	}
+}
+
+static void handle_gc_log(const char *arg)
+{
+	gc_log_file = arg;
+}
+
 static void handle_thread_stack_size(const char *arg)
 {
 	/* Ignore */
 }
 
+static void handle_compile_threshold(const char *arg)
+{
+	opt_compile_threshold = parse_long(arg);
+
+	if (!opt_compile_threshold) {
+		fprintf(stderr, "%s: invalid compile threshold '%s'\n", program_name, arg);
+		usage(stderr, EXIT_FAILURE);
+	}
+}
+
+static void handle_compiler_count(const char *arg)
+{
+	opt_nr_compiler_threads = parse_long(arg);
+
+	if (!opt_nr_compiler_threads) {
+		fprintf(stderr, "%s: invalid compiler thread count '%s'\n", program_name, arg);
+		usage(stderr, EXIT_FAILURE);
+	}
+}
+
+static void handle_max_inline_size(const char *arg)
+{
+	opt_max_inline_size = parse_long(arg);
+}
+
 static void handle_print_compilation(void)
 {
 	opt_print_compilation = true;
 }
 
+static void handle_print_code_cache(void)
+{
+	opt_print_code_cache = true;
+}
+
+static void handle_print_string_table_stats(void)
+{
+	opt_print_string_table_stats = true;
+}
+
+static void handle_omit_stack_trace_in_fast_throw(void)
+{
+	opt_omit_stack_trace_in_fast_throw = true;
+}
+
 struct option {
 	const char *name;
 
@@ -930,9 +1075,14 @@ const struct option options[] = {
 	DEFINE_OPTION("Xnogc",			handle_nogc),
 	DEFINE_OPTION("Xnosystemclassloader",	handle_no_system_classloader),
 	DEFINE_OPTION("Xperf",			handle_perf),
+	DEFINE_OPTION("Xprof",			handle_profile),
+	DEFINE_OPTION("Xprof:counters",		handle_profile_counters),
 	DEFINE_OPTION("Xssa",			handle_ssa),
 	DEFINE_OPTION("Xnoic",			handle_no_ic),
+	DEFINE_OPTION("Xnoinline",		handle_no_inline),
+	DEFINE_OPTION("Xnocha",			handle_no_cha),
 	DEFINE_OPTION("Xint",			handle_int),
+	DEFINE_OPTION("Xbatch",			handle_batch),
 
 	DEFINE_OPTION("Xdebug:stack",		handle_debug_stack),
 	DEFINE_OPTION("Xtrace:asm",		handle_trace_asm),
@@ -943,6 +1093,7 @@ const struct option options[] = {
 	DEFINE_OPTION("Xtrace:exceptions",	handle_trace_exceptions),
 	DEFINE_OPTION("Xtrace:invoke",		handle_trace_invoke),
 	DEFINE_OPTION("Xtrace:invoke-verbose",	handle_trace_invoke_verbose),
+	DEFINE_OPTION("Xtrace:ic",		handle_trace_ic),
 	DEFINE_OPTION("Xtrace:itable",		handle_trace_itable),
 	DEFINE_OPTION("Xtrace:jit",		handle_trace_jit),
 	DEFINE_OPTION("Xtrace:liveness",	handle_trace_liveness),
@@ -959,10 +1110,21 @@ const struct option options[] = {
 
 	DEFINE_OPTION_ADJACENT_ARG("Xbootclasspath/a:",	handle_bootclasspath_append),
 	DEFINE_OPTION_ADJACENT_ARG("D",		handle_define),
+	DEFINE_OPTION_ADJACENT_ARG("Xloggc:",	handle_gc_log),
+	DEFINE_OPTION_ADJACENT_ARG("Xmn",	handle_nursery_size),
 	DEFINE_OPTION_ADJACENT_ARG("Xmx",	handle_max_heap_size),
 	DEFINE_OPTION_ADJACENT_ARG("Xss",	handle_thread_stack_size),
 
+	DEFINE_OPTION("XX:+OmitStackTraceInFastThrow",	handle_omit_stack_trace_in_fast_throw),
 	DEFINE_OPTION("XX:+PrintCompilation",	handle_print_compilation),
+	DEFINE_OPTION("XX:+PrintCodeCache",	handle_print_code_cache),
+	DEFINE_OPTION("XX:+PrintStringTableStatistics",	handle_print_string_table_stats),
+	DEFINE_OPTION("XX:+TieredCompilation",	handle_tiered_compilation),
+	DEFINE_OPTION("XX:+UseGenerationalGC",	handle_generational_gc),
+	DEFINE_OPTION_ADJACENT_ARG("XX:CompileThreshold=",	handle_compile_threshold),
+	DEFINE_OPTION_ADJACENT_ARG("XX:CICompilerCount=",	handle_compiler_count),
+	DEFINE_OPTION_ADJACENT_ARG("XX:MaxInlineSize=",	handle_max_inline_size),
+	DEFINE_OPTION_ADJACENT_ARG("XX:ParallelGCThreads=",	handle_gc_threads),
 };
 
 static const struct option *get_option(const char *name)
@@ -1084,7 +1246,7 @@ do_main_class(void)
 		array_set_field_object(args, i, arg);
 	}
 
-	if (opt_interp_only) {
+	if (vm_method_should_interpret(vmm)) {
 		vm_interp_method(vmm, args);
 	} else {
 		void (*java_main)(void *);
@@ -1198,7 +1360,6 @@ main(int argc, char *argv[])
 
 	arch_init();
 	init_string_intern();
-	init_literals_hash_map();
 	init_system_properties();
 
 	parse_options(argc, argv);
@@ -1207,6 +1368,7 @@ main(int argc, char *argv[])
 		print_proc_maps();
 
 	gc_init();
+	init_literals_hash_map();
 	init_exec_env();
 	vm_reference_init();
 
@@ -1246,6 +1408,16 @@ main(int argc, char *argv[])
 		goto out_check_exception;
 	}
 
+	if (init_compile_queue()) {
+		fprintf(stderr, "could not start compiler threads\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (profiler_init()) {
+		fprintf(stderr, "could not start profiler\n");
+		exit(EXIT_FAILURE);
+	}
+
 	switch (operation) {
 	case OPERATION_MAIN_CLASS:
 		status = do_main_class();
@@ -24,6 +24,7 @@
  * Please refer to the file LICENSE for details.
  */
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -31,6 +32,7 @@
 #include "jit/exception.h"
 
 #include "lib/guard-page.h"
+#include "lib/hash-map.h"
 
 #include "runtime/java_lang_VMClass.h"
 #include "vm/call.h"
@@ -456,20 +458,95 @@ static jobject JNI_PopLocalFrame(JNIEnv *env, jobject result)
 	return 0;
 }
 
+/*
+ * A global reference keeps its object alive through a strong vm_reference
+ * which the GC treats as a root. Global references are the objects
+ * themselves so they are counted per object.
+ */
+struct jni_global_ref {
+	struct vm_reference	*ref;
+	unsigned long		count;
+};
+
+static pthread_mutex_t jni_global_refs_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Maps an object to its struct jni_global_ref. */
+static struct hash_map *jni_global_refs;
+
 static jobject JNI_NewGlobalRef(JNIEnv *env, jobject obj)
 {
+	struct jni_global_ref *global_ref;
+
 	enter_vm_from_jni();
 
-	/* TODO: fix this when GC is implemented. */
+	if (!obj)
+		return NULL;
+
+	pthread_mutex_lock(&jni_global_refs_mutex);
+
+	if (!jni_global_refs) {
+		jni_global_refs = alloc_hash_map(&pointer_key);
+		if (!jni_global_refs)
+			goto out_oom;
+	}
+
+	if (!hash_map_get(jni_global_refs, obj, (void **) &global_ref)) {
+		global_ref->count++;
+		goto out_unlock;
+	}
 
+	global_ref = malloc(sizeof *global_ref);
+	if (!global_ref)
+		goto out_oom;
+
+	global_ref->ref = vm_reference_alloc_strong(obj);
+	if (!global_ref->ref) {
+		free(global_ref);
+		obj = NULL;
+		goto out_unlock;
+	}
+
+	global_ref->count = 1;
+
+	if (hash_map_put(jni_global_refs, obj, global_ref)) {
+		vm_reference_free(global_ref->ref);
+		free(global_ref);
+		goto out_oom;
+	}
+
+ out_unlock:
+	pthread_mutex_unlock(&jni_global_refs_mutex);
 	return obj;
+
+ out_oom:
+	pthread_mutex_unlock(&jni_global_refs_mutex);
+	return throw_oom_error();
 }
 
 static void JNI_DeleteGlobalRef(JNIEnv *env, jobject globalRef)
 {
+	struct jni_global_ref *global_ref;
+
 	enter_vm_from_jni();
 
-	/* TODO: fix this when GC is implemented. */
+	if (!globalRef)
+		return;
+
+	pthread_mutex_lock(&jni_global_refs_mutex);
+
+	if (!jni_global_refs ||
+	    hash_map_get(jni_global_refs, globalRef, (void **) &global_ref))
+		goto out_unlock;
+
+	if (--global_ref->count)
+		goto out_unlock;
+
+	hash_map_remove(jni_global_refs, globalRef);
+	vm_reference_free(global_ref->ref);
+	free(global_ref);
+
+ out_unlock:
+	pthread_mutex_unlock(&jni_global_refs_mutex);
 }
 
 static void JNI_DeleteLocalRef(JNIEnv *env, jobject localRef)
@@ -1129,7 +1206,7 @@ static jstring JNI_NewStringUTF(JNIEnv *env, const char *bytes)
 {
 	enter_vm_from_jni();
 
-	return vm_object_alloc_string_from_c(bytes);
+	return vm_object_alloc_uninterned_string_from_utf8((const uint8_t *) bytes, strlen(bytes));
 }
 
 static jsize JNI_GetStringUTFLength(JNIEnv *env, jstring string)
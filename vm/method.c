@@ -99,6 +99,9 @@ int vm_method_do_init(struct vm_method *vmm)
 	if (args_map_init(vmm))
 		return -1;
 
+	vmm->invocation_count = 0;
+	vmm->backedge_count = 0;
+
 	return 0;
 }
 
@@ -114,6 +117,7 @@ int vm_method_init(struct vm_method *vmm,
 	vmm->method = method;
 	vmm->flags = 0;
 	vmm->annotation_initialized = false;
+	INIT_LIST_HEAD(&vmm->cha_site_list);
 
 	const struct cafebabe_constant_info_utf8 *name;
 	if (cafebabe_class_constant_get_utf8(class, method->name_index, &name))
@@ -246,6 +250,7 @@ int vm_method_init_from_interface(struct vm_method *vmm, struct vm_class *vmc,
 	vmm->type = interface_method->type;
 
 	vmm->flags = 0;
+	INIT_LIST_HEAD(&vmm->cha_site_list);
 
 	if (parse_method_type(vmm)) {
 		warn("method type parsing failed for: %s", vmm->type);
@@ -26,6 +26,8 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include "arch/memory.h"
 #include "arch/atomic.h"
@@ -113,10 +115,26 @@ static inline void wait(struct vm_monitor_record *record)
 	vm_thread_set_state(self, VM_THREAD_STATE_RUNNABLE);
 }
 
+static inline bool thin_lock_owned_by(void *lock_word, struct vm_exec_env *ee)
+{
+	return ((unsigned long) lock_word & ~THIN_LOCK_COUNT_MASK) == ee->thin_lock_word;
+}
+
+static inline int thin_lock_count(void *lock_word)
+{
+	return (((unsigned long) lock_word & THIN_LOCK_COUNT_MASK) >> THIN_LOCK_COUNT_SHIFT) + 1;
+}
+
+/*
+ * Checks whether current thread owns the monitor. *record_p is set to
+ * NULL when the monitor is thin locked.
+ */
 static inline
 int owner_check(struct vm_object *object, struct vm_monitor_record **record_p)
 {
 	struct vm_monitor_record *record;
+	struct vm_exec_env *ee;
+	void *lock_word;
 
 	/*
 	 * Both atomic_read() calls do not need a memory barrier.
@@ -125,16 +143,73 @@ int owner_check(struct vm_object *object, struct vm_monitor_record **record_p)
 	 * those values were set by this thread.
 	 */
 
-	record	= object->monitor_record;
-	if (record && record->owner == vm_get_exec_env()) {
-		*record_p = record;
-		return 0;
+	ee		= vm_get_exec_env();
+	lock_word	= object->monitor_record;
+
+	if (is_thin_lock(lock_word)) {
+		if (thin_lock_owned_by(lock_word, ee)) {
+			*record_p = NULL;
+			return 0;
+		}
+	} else {
+		record = lock_word;
+		if (record && record->owner == ee) {
+			*record_p = record;
+			return 0;
+		}
 	}
 
 	signal_new_exception(vm_java_lang_IllegalMonitorStateException, NULL);
 	return -1;
 }
 
+/*
+ * Replaces the thin lock held by current thread with a monitor record
+ * carrying the same lock count. No atomic operation is needed because
+ * other threads never modify a thin lock word.
+ */
+static struct vm_monitor_record *inflate_thin_lock(struct vm_object *self)
+{
+	struct vm_monitor_record *record;
+
+	record = get_monitor_record();
+	if (!record)
+		return NULL;
+
+	record->owner		= vm_get_exec_env();
+	record->lock_count	= thin_lock_count(self->monitor_record);
+
+	/* Publish initialized record */
+	smp_wmb();
+
+	self->monitor_record = record;
+	return record;
+}
+
+/*
+ * Waits until the owner of a thin lock releases or inflates it. Threads
+ * only get here on contention, which is assumed to be short, so we spin
+ * before falling back to sleeping.
+ */
+static void wait_for_thin_lock(struct vm_object *self, void *lock_word)
+{
+	struct vm_thread *thread = vm_thread_self();
+	unsigned int nr_spins = 0;
+
+	if (thread)
+		vm_thread_set_state(thread, VM_THREAD_STATE_BLOCKED);
+
+	while (self->monitor_record == lock_word) {
+		if (nr_spins++ < 100)
+			sched_yield();
+		else
+			usleep(100);
+	}
+
+	if (thread)
+		vm_thread_set_state(thread, VM_THREAD_STATE_RUNNABLE);
+}
+
 /*
  * Acquire the lock on object's monitor. This implementation uses
  * relaxed-locking protocol based on David Dice's work: "Implementing
@@ -146,19 +221,36 @@ int vm_object_lock(struct vm_object *self)
 {
 	struct vm_monitor_record *old_record;
 	struct vm_exec_env *ee;
+	bool contended = false;
+	void *lock_word;
 
 	ee = vm_get_exec_env();
 
 	while (true) {
-		old_record	= self->monitor_record;
+		lock_word	= self->monitor_record;
 
-		if (!old_record) {
+		if (!lock_word && !contended) {
+			if (!cmpxchg_ptr(&self->monitor_record, NULL, (void *) ee->thin_lock_word))
+				return 0;
+
+			continue;
+		}
+
+		/*
+		 * Monitors which have seen contention are inflated right
+		 * away so that other contending threads can block on the
+		 * record instead of spinning.
+		 */
+		if (!lock_word) {
 			struct vm_monitor_record *record = get_monitor_record();
 			if (!record) {
 				throw_oom_error();
 				return -1;
 			}
 
+			record->owner		= ee;
+			record->lock_count	= 1;
+
 			if (!cmpxchg_ptr(&self->monitor_record, NULL, record)) {
 				return 0;
 			}
@@ -167,6 +259,31 @@ int vm_object_lock(struct vm_object *self)
 			continue;
 		}
 
+		if (is_thin_lock(lock_word)) {
+			if (!thin_lock_owned_by(lock_word, ee)) {
+				contended = true;
+				wait_for_thin_lock(self, lock_word);
+				continue;
+			}
+
+			if (((unsigned long) lock_word & THIN_LOCK_COUNT_MASK) != THIN_LOCK_COUNT_MASK) {
+				self->monitor_record = lock_word + THIN_LOCK_COUNT_ONE;
+				return 0;
+			}
+
+			/* Recursion count overflow */
+			old_record = inflate_thin_lock(self);
+			if (!old_record) {
+				throw_oom_error();
+				return -1;
+			}
+
+			old_record->lock_count++;
+			return 0;
+		}
+
+		old_record	= lock_word;
+
 		/* Check if recursive lock. No need for memory barrier
 		 * here because if current thread unlocked the monitor
 		 * and is no longer its owner then atomic_read() will
@@ -232,6 +349,19 @@ int vm_object_unlock(struct vm_object *self)
 	if (owner_check(self, &record))
 		return -1;
 
+	if (!record) {
+		void *lock_word = self->monitor_record;
+
+		if ((unsigned long) lock_word & THIN_LOCK_COUNT_MASK) {
+			self->monitor_record = lock_word - THIN_LOCK_COUNT_ONE;
+			return 0;
+		}
+
+		smp_mb(); /* Required by java memory model */
+		self->monitor_record = NULL;
+		return 0;
+	}
+
 	if (record->lock_count > 1) {
 		record->lock_count--;
 		smp_mb(); /* Required by java memory model */
@@ -311,6 +441,15 @@ static int vm_object_do_wait(struct vm_object *self, struct timespec *timespec)
 	if (owner_check(self, &record))
 		return -1;
 
+	/* Waiting threads need a monitor record to be notified through */
+	if (!record) {
+		record = inflate_thin_lock(self);
+		if (!record) {
+			throw_oom_error();
+			return -1;
+		}
+	}
+
 	thread_self = vm_thread_self();
 
 	pthread_mutex_lock(&record->notify_mutex);
@@ -402,6 +541,10 @@ int vm_object_notify(struct vm_object *self)
 	if (owner_check(self, &record))
 		return -1;
 
+	/* Nobody can be waiting on a thin locked monitor */
+	if (!record)
+		return 0;
+
 	pthread_mutex_lock(&record->notify_mutex);
 	pthread_cond_signal(&record->notify_cond);
 	pthread_mutex_unlock(&record->notify_mutex);
@@ -418,6 +561,9 @@ int vm_object_notify_all(struct vm_object *self)
 		return -1;
 	}
 
+	if (!record)
+		return 0;
+
 	pthread_mutex_lock(&record->notify_mutex);
 	pthread_cond_broadcast(&record->notify_cond);
 	pthread_mutex_unlock(&record->notify_mutex);
@@ -7,6 +7,7 @@
 #include "vm/errors.h"
 #include "vm/stdlib.h"
 #include "vm/string.h"
+#include "vm/tlab.h"
 #include "vm/class.h"
 #include "vm/types.h"
 #include "vm/call.h"
@@ -58,6 +59,17 @@ static void vm_object_init_common(struct vm_object *object)
 	object->monitor_record = NULL;
 }
 
+static void *alloc_object(size_t size)
+{
+	void *res;
+
+	res = tlab_alloc(size);
+	if (res)
+		return res;
+
+	return gc_alloc(size);
+}
+
 struct vm_object *vm_object_alloc(struct vm_class *class)
 {
 	struct vm_object *res;
@@ -65,7 +77,7 @@ struct vm_object *vm_object_alloc(struct vm_class *class)
 	if (vm_class_ensure_init(class))
 		return rethrow_exception();
 
-	res = gc_alloc(sizeof(*res) + class->object_size);
+	res = alloc_object(sizeof(*res) + class->object_size);
 	if (!res)
 		return throw_oom_error();
 
@@ -91,55 +103,59 @@ struct vm_object *vm_object_alloc_array_raw(struct vm_class *class, size_t elem_
 	return &ret->object;
 }
 
-struct vm_object *vm_object_alloc_primitive_array(int type, int count)
+struct vm_class *vm_primitive_array_class(int type)
 {
-	struct vm_array *res;
-	int vm_type;
-
-	vm_type = bytecode_type_to_vmtype(type);
-	assert(vm_type != J_VOID);
-
-	res = gc_alloc_noscan(sizeof(*res) + vmtype_get_size(vm_type) * count);
-	if (!res)
-		return throw_oom_error();
-
-	vm_object_init_common(&res->object);
-
 	switch (type) {
 	case T_BOOLEAN:
-		res->object.class = classloader_load(NULL, "[Z");
-		break;
+		return classloader_load(NULL, "[Z");
 	case T_CHAR:
-		res->object.class = classloader_load(NULL, "[C");
-		break;
+		return classloader_load(NULL, "[C");
 	case T_FLOAT:
-		res->object.class = classloader_load(NULL, "[F");
-		break;
+		return classloader_load(NULL, "[F");
 	case T_DOUBLE:
-		res->object.class = classloader_load(NULL, "[D");
-		break;
+		return classloader_load(NULL, "[D");
 	case T_BYTE:
-		res->object.class = classloader_load(NULL, "[B");
-		break;
+		return classloader_load(NULL, "[B");
 	case T_SHORT:
-		res->object.class = classloader_load(NULL, "[S");
-		break;
+		return classloader_load(NULL, "[S");
 	case T_INT:
-		res->object.class = classloader_load(NULL, "[I");
-		break;
+		return classloader_load(NULL, "[I");
 	case T_LONG:
-		res->object.class = classloader_load(NULL, "[J");
-		break;
-	default:
-		return throw_internal_error();
+		return classloader_load(NULL, "[J");
 	}
 
-	if (!res->object.class)
+	return NULL;
+}
+
+struct vm_object *vm_object_alloc_primitive_array(int type, int count)
+{
+	struct vm_class *class;
+	struct vm_array *res;
+	size_t size;
+	int vm_type;
+
+	vm_type = bytecode_type_to_vmtype(type);
+	assert(vm_type != J_VOID);
+
+	class = vm_primitive_array_class(type);
+	if (!class)
 		return throw_internal_error();
 
-	if (vm_class_ensure_init(res->object.class))
+	if (vm_class_ensure_init(class))
 		return throw_internal_error();
 
+	size = sizeof(*res) + vmtype_get_size(vm_type) * count;
+
+	/* Small arrays come from the pointer-free thread-local buffer. */
+	res = tlab_alloc_noscan(size);
+	if (!res)
+		res = gc_alloc_noscan(size);
+	if (!res)
+		return throw_oom_error();
+
+	vm_object_init_common(&res->object);
+
+	res->object.class = class;
 	res->array_length = count;
 
 	return &res->object;
@@ -213,7 +229,7 @@ struct vm_object *vm_object_alloc_array(struct vm_class *class, int count)
 	if (vm_class_ensure_init(class))
 		return rethrow_exception();
 
-	res = gc_alloc(sizeof(*res) + sizeof(struct vm_object *) * count);
+	res = alloc_object(sizeof(*res) + sizeof(struct vm_object *) * count);
 	if (!res)
 		return throw_oom_error();
 
@@ -317,19 +333,50 @@ struct vm_object *vm_object_clone(struct vm_object *obj)
 struct vm_object *
 vm_object_alloc_string_from_utf8(const uint8_t bytes[], unsigned int length)
 {
-	struct vm_object *array = utf8_to_char_array(bytes, length);
+	return vm_string_intern_utf8(bytes, length);
+}
+
+/*
+ * Returns a new string for the modified UTF-8 @bytes. Unlike
+ * vm_object_alloc_string_from_utf8() the string is not interned.
+ */
+struct vm_object *
+vm_object_alloc_uninterned_string_from_utf8(const uint8_t bytes[], unsigned int length)
+{
+	unsigned int count;
+
+	if (utf8_char_count(bytes, length, &count))
+		return rethrow_exception();
+
+	return vm_object_alloc_string_from_utf8_count(bytes, length, count);
+}
+
+/*
+ * Returns a new uninterned string for the modified UTF-8 @bytes which
+ * have already been checked by utf8_char_count() to hold @count
+ * characters.
+ */
+struct vm_object *
+vm_object_alloc_string_from_utf8_count(const uint8_t bytes[], unsigned int length,
+				       unsigned int count)
+{
+	struct vm_object *array, *string;
+
+	array = vm_object_alloc_primitive_array(T_CHAR, count);
 	if (!array)
 		return rethrow_exception();
 
-	struct vm_object *string = vm_object_alloc(vm_java_lang_String);
+	utf8_decode_chars(vm_array_elems(array), bytes, length);
+
+	string = vm_object_alloc(vm_java_lang_String);
 	if (!string)
 		return rethrow_exception();
 
 	field_set_int(string, vm_java_lang_String_offset, 0);
-	field_set_int(string, vm_java_lang_String_count, vm_array_length(array));
+	field_set_int(string, vm_java_lang_String_count, count);
 	field_set_object(string, vm_java_lang_String_value, array);
 
-	return vm_string_intern(string);
+	return string;
 }
 
 struct vm_object *
@@ -349,8 +396,7 @@ vm_object_alloc_string_from_c(const char *bytes)
 	NOT_IMPLEMENTED;
 #endif
 
-	for (unsigned int i = 0; i < n; ++i)
-		array_set_field_char(array, i, bytes[i]);
+	bytes_to_chars(vm_array_elems(array), (const uint8_t *) bytes, n);
 
 	field_set_int(string, vm_java_lang_String_offset, 0);
 	field_set_int(string, vm_java_lang_String_count, vm_array_length(array));
@@ -0,0 +1,538 @@
+/*
+ * Sampling profiler and profile counters of compiled code
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "vm/profiler.h"
+
+#include "arch/atomic.h"
+#include "arch/cmpxchg.h"
+
+#include "jit/compilation-unit.h"
+#include "jit/compiler.h"
+#include "jit/cu-mapping.h"
+
+#include "lib/array.h"
+
+#include "vm/stack-trace.h"
+#include "vm/method.h"
+#include "vm/thread.h"
+#include "vm/class.h"
+#include "vm/die.h"
+
+#include "sys/signal.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <time.h>
+
+/*
+ * The profiler thread sends SIGPROF to every thread at a fixed interval.
+ * The signal handler walks the Java frames of the interrupted thread
+ * with stack_trace_elem_next_java() and counts the method on top of the
+ * stack (self), every method on the stack (total) and every caller and
+ * callee pair. The handler runs concurrently on many threads so the
+ * tables are allocated up front and updated with atomic operations.
+ *
+ * A thread that is interrupted in native code is only attributed to
+ * Java methods if it entered native code through a VM native or a JNI
+ * method. Interpreted methods have no frames that can be walked.
+ */
+
+#define PROFILER_INTERVAL_NS		(10 * 1000 * 1000)
+
+#define PROFILER_NR_METHODS		8192
+#define PROFILER_NR_EDGES		32768
+#define PROFILER_MAX_PROBES		64
+#define PROFILER_MAX_DEPTH		128
+
+/* Number of methods whose callers and callees are printed. */
+#define PROFILER_CALL_GRAPH_SIZE	20
+
+bool opt_profile;
+bool opt_profile_counters;
+
+struct profile_method {
+	struct compilation_unit	*cu;
+	atomic_t		self;
+	atomic_t		total;
+};
+
+/*
+ * The key of an edge packs the indices of the caller and the callee in
+ * the method table, see edge_key().
+ */
+struct profile_edge {
+	void			*key;
+	atomic_t		count;
+};
+
+static struct profile_method	*methods;
+static struct profile_edge	*edges;
+
+static atomic_t			nr_samples;
+static atomic_t			nr_java_samples;
+static atomic_t			nr_lost_samples;
+
+static volatile sig_atomic_t	dump_requested;
+static volatile sig_atomic_t	profiler_stopped;
+
+/* Compilation units with counters. Protected by profiler_mutex. */
+static pthread_mutex_t		profiler_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct array		profiled_cus;
+
+static int lookup_method(struct compilation_unit *cu)
+{
+	unsigned long hash = ((unsigned long) cu >> 4) % PROFILER_NR_METHODS;
+
+	for (unsigned int i = 0; i < PROFILER_MAX_PROBES; i++) {
+		unsigned long idx = (hash + i) % PROFILER_NR_METHODS;
+		struct compilation_unit *prev;
+
+		prev = methods[idx].cu;
+		if (!prev)
+			prev = cmpxchg_ptr(&methods[idx].cu, NULL, cu);
+
+		if (!prev || prev == cu)
+			return idx;
+	}
+
+	return -1;
+}
+
+static void *edge_key(int caller, int callee)
+{
+	return (void *) (((unsigned long) caller + 1) << 16 | (callee + 1));
+}
+
+static struct profile_edge *lookup_edge(int caller, int callee)
+{
+	void *key = edge_key(caller, callee);
+	unsigned long hash;
+
+	hash = ((unsigned long) caller * 31 + callee) % PROFILER_NR_EDGES;
+
+	for (unsigned int i = 0; i < PROFILER_MAX_PROBES; i++) {
+		struct profile_edge *edge = &edges[(hash + i) % PROFILER_NR_EDGES];
+		void *prev;
+
+		prev = edge->key;
+		if (!prev)
+			prev = cmpxchg_ptr(&edge->key, NULL, key);
+
+		if (!prev || prev == key)
+			return edge;
+	}
+
+	return NULL;
+}
+
+static bool on_stack_below(int *stack, unsigned int depth, int idx)
+{
+	for (unsigned int i = 0; i < depth; i++) {
+		if (stack[i] == idx)
+			return true;
+	}
+
+	return false;
+}
+
+static void profiler_record(struct stack_trace_elem *elem)
+{
+	int stack[PROFILER_MAX_DEPTH];
+	unsigned int depth = 0;
+
+	do {
+		struct compilation_unit *cu;
+		int idx;
+
+		cu = stack_trace_elem_get_cu(elem);
+		if (!cu)
+			continue;
+
+		idx = lookup_method(cu);
+		if (idx < 0) {
+			atomic_inc(&nr_lost_samples);
+			return;
+		}
+
+		stack[depth++] = idx;
+	} while (depth < PROFILER_MAX_DEPTH && stack_trace_elem_next_java(elem) == 0);
+
+	if (!depth)
+		return;
+
+	atomic_inc(&nr_java_samples);
+	atomic_inc(&methods[stack[0]].self);
+
+	for (unsigned int i = 0; i < depth; i++) {
+		struct profile_edge *edge;
+
+		/* Recursive methods are counted once per sample. */
+		if (!on_stack_below(stack, i, stack[i]))
+			atomic_inc(&methods[stack[i]].total);
+
+		if (!i)
+			continue;
+
+		edge = lookup_edge(stack[i], stack[i - 1]);
+		if (edge)
+			atomic_inc(&edge->count);
+	}
+}
+
+static void profiler_signal_handler(int sig, siginfo_t *si, void *ctx)
+{
+	struct stack_trace_elem elem;
+	struct register_state regs;
+	int saved_errno = errno;
+	ucontext_t *uc = ctx;
+
+	save_signal_registers(&regs, &uc->uc_mcontext);
+
+	atomic_inc(&nr_samples);
+
+	/*
+	 * Compiled code always has a frame pointer. Native code may not
+	 * so it is skipped up to the method that called into it.
+	 */
+	if (!is_native(regs.ip)) {
+		init_stack_trace_elem(&elem, regs.ip, (void *) regs.bp);
+		profiler_record(&elem);
+	} else if (!init_stack_trace_elem_native_caller(&elem)) {
+		profiler_record(&elem);
+	}
+
+	errno = saved_errno;
+}
+
+static void profiler_sample_threads(void)
+{
+	struct vm_exec_env *ee;
+
+	/*
+	 * Threads are removed from the list under threads_mutex before they
+	 * exit so every thread on the list can be signalled.
+	 */
+	pthread_mutex_lock(&threads_mutex);
+
+	vm_exec_env_for_each(ee)
+		pthread_kill(ee->posix_id, SIGPROF);
+
+	pthread_mutex_unlock(&threads_mutex);
+}
+
+static void *profiler_thread(void *arg)
+{
+	struct timespec interval = {
+		.tv_sec		= 0,
+		.tv_nsec	= PROFILER_INTERVAL_NS,
+	};
+
+	thread_init_cu_mapping();
+
+	while (!profiler_stopped) {
+		nanosleep(&interval, NULL);
+
+		if (dump_requested) {
+			dump_requested = 0;
+			profiler_dump();
+		}
+
+		if (opt_profile && !profiler_stopped)
+			profiler_sample_threads();
+	}
+
+	return NULL;
+}
+
+int profiler_init(void)
+{
+	pthread_t thread;
+
+	if (!opt_profile && !opt_profile_counters)
+		return 0;
+
+	if (opt_profile) {
+		struct sigaction sa;
+
+		methods = calloc(PROFILER_NR_METHODS, sizeof(*methods));
+		if (!methods)
+			return -ENOMEM;
+
+		edges = calloc(PROFILER_NR_EDGES, sizeof(*edges));
+		if (!edges)
+			return -ENOMEM;
+
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags	= SA_RESTART | SA_SIGINFO;
+
+		/* Don't let the GC stop a thread in the middle of a sample. */
+		sigaddset(&sa.sa_mask, SIGUSR1);
+
+		sa.sa_sigaction	= profiler_signal_handler;
+		if (sigaction(SIGPROF, &sa, NULL))
+			return -errno;
+	}
+
+	if (pthread_create(&thread, NULL, profiler_thread, NULL))
+		return -EAGAIN;
+
+	pthread_detach(thread);
+
+	return 0;
+}
+
+void profiler_exit(void)
+{
+	if (!opt_profile && !opt_profile_counters)
+		return;
+
+	profiler_stopped = 1;
+
+	profiler_dump();
+}
+
+void profiler_add_cu(struct compilation_unit *cu)
+{
+	pthread_mutex_lock(&profiler_mutex);
+
+	if (array_append(&profiled_cus, cu))
+		warn("out of memory");
+
+	pthread_mutex_unlock(&profiler_mutex);
+}
+
+/*
+ * Called from the SIGQUIT handler. The profile is printed by the
+ * profiler thread because printing is not async-signal-safe.
+ */
+void profiler_request_dump(void)
+{
+	dump_requested = 1;
+}
+
+static double percent(unsigned long count, unsigned long total)
+{
+	if (!total)
+		return 0.0;
+
+	return 100.0 * count / total;
+}
+
+static const char *profile_method_name(int idx, char *symbol, size_t len)
+{
+	return cu_symbol(methods[idx].cu, symbol, len);
+}
+
+static int self_cmp(const void *p1, const void *p2)
+{
+	const struct profile_method *m1 = &methods[*(const int *) p1];
+	const struct profile_method *m2 = &methods[*(const int *) p2];
+
+	return atomic_read(&m2->self) - atomic_read(&m1->self);
+}
+
+static int total_cmp(const void *p1, const void *p2)
+{
+	const struct profile_method *m1 = &methods[*(const int *) p1];
+	const struct profile_method *m2 = &methods[*(const int *) p2];
+
+	return atomic_read(&m2->total) - atomic_read(&m1->total);
+}
+
+static void print_edges(int idx, bool callers, unsigned long nr_java)
+{
+	char symbol[256];
+
+	for (unsigned int i = 0; i < PROFILER_NR_EDGES; i++) {
+		struct profile_edge *edge = &edges[i];
+		unsigned long key = (unsigned long) edge->key;
+		int caller, callee;
+
+		if (!key)
+			continue;
+
+		caller = (key >> 16) - 1;
+		callee = (key & 0xffff) - 1;
+
+		if ((callers ? callee : caller) != idx)
+			continue;
+
+		fprintf(stderr, "    %s %6.2f%%  %s\n", callers ? "<-" : "->",
+			percent(atomic_read(&edge->count), nr_java),
+			profile_method_name(callers ? caller : callee, symbol, sizeof(symbol)));
+	}
+}
+
+static void profiler_dump_samples(void)
+{
+	unsigned long nr_java, nr_methods = 0;
+	char symbol[256];
+	int *sorted;
+
+	sorted = malloc(PROFILER_NR_METHODS * sizeof(*sorted));
+	if (!sorted) {
+		warn("out of memory");
+		return;
+	}
+
+	for (unsigned int i = 0; i < PROFILER_NR_METHODS; i++) {
+		if (methods[i].cu)
+			sorted[nr_methods++] = i;
+	}
+
+	nr_java = atomic_read(&nr_java_samples);
+
+	fprintf(stderr, "Flat profile of %d samples, %lu in Java methods, %d lost:\n\n",
+		atomic_read(&nr_samples), nr_java, atomic_read(&nr_lost_samples));
+
+	fprintf(stderr, "   self   total  method\n");
+
+	qsort(sorted, nr_methods, sizeof(*sorted), self_cmp);
+
+	for (unsigned long i = 0; i < nr_methods; i++) {
+		struct profile_method *m = &methods[sorted[i]];
+
+		if (!atomic_read(&m->self))
+			break;
+
+		fprintf(stderr, "%6.2f%% %6.2f%%  %s\n",
+			percent(atomic_read(&m->self), nr_java),
+			percent(atomic_read(&m->total), nr_java),
+			profile_method_name(sorted[i], symbol, sizeof(symbol)));
+	}
+
+	fprintf(stderr, "\nCall graph:\n\n");
+
+	qsort(sorted, nr_methods, sizeof(*sorted), total_cmp);
+
+	for (unsigned long i = 0; i < nr_methods && i < PROFILER_CALL_GRAPH_SIZE; i++) {
+		struct profile_method *m = &methods[sorted[i]];
+
+		print_edges(sorted[i], true, nr_java);
+
+		fprintf(stderr, "%6.2f%% %6.2f%%  %s\n",
+			percent(atomic_read(&m->self), nr_java),
+			percent(atomic_read(&m->total), nr_java),
+			profile_method_name(sorted[i], symbol, sizeof(symbol)));
+
+		print_edges(sorted[i], false, nr_java);
+
+		fprintf(stderr, "\n");
+	}
+
+	free(sorted);
+}
+
+static unsigned long nr_backedges_taken(struct compilation_unit *cu)
+{
+	unsigned long count = 0;
+
+	for (unsigned long i = 0; i < cu->nr_backedge_counters; i++)
+		count += cu->backedge_counters[i].count;
+
+	return count;
+}
+
+static int counters_cmp(const void *p1, const void *p2)
+{
+	struct compilation_unit *cu1 = *(struct compilation_unit **) p1;
+	struct compilation_unit *cu2 = *(struct compilation_unit **) p2;
+	unsigned long count1, count2;
+
+	count1 = cu1->nr_entries + nr_backedges_taken(cu1);
+	count2 = cu2->nr_entries + nr_backedges_taken(cu2);
+
+	if (count1 == count2)
+		return 0;
+
+	return count1 < count2 ? 1 : -1;
+}
+
+static void profiler_dump_counters(void)
+{
+	struct compilation_unit **cus;
+	unsigned int nr_cus;
+	char symbol[256];
+
+	pthread_mutex_lock(&profiler_mutex);
+
+	nr_cus = profiled_cus.size;
+
+	cus = malloc(nr_cus * sizeof(*cus));
+	if (nr_cus && !cus) {
+		pthread_mutex_unlock(&profiler_mutex);
+		warn("out of memory");
+		return;
+	}
+
+	memcpy(cus, profiled_cus.ptr, nr_cus * sizeof(*cus));
+
+	pthread_mutex_unlock(&profiler_mutex);
+
+	qsort(cus, nr_cus, sizeof(*cus), counters_cmp);
+
+	fprintf(stderr, "Counters of %u compiled methods:\n\n", nr_cus);
+	fprintf(stderr, "     entries    backedges  method\n");
+
+	for (unsigned int i = 0; i < nr_cus; i++) {
+		struct compilation_unit *cu = cus[i];
+		unsigned long backedges;
+
+		backedges = nr_backedges_taken(cu);
+		if (!cu->nr_entries && !backedges)
+			break;
+
+		fprintf(stderr, "%12lu %12lu  %s\n", cu->nr_entries, backedges,
+			cu_symbol(cu, symbol, sizeof(symbol)));
+
+		for (unsigned long j = 0; j < cu->nr_backedge_counters; j++) {
+			struct backedge_counter *counter = &cu->backedge_counters[j];
+
+			if (!counter->count)
+				continue;
+
+			fprintf(stderr, "             %12lu    bc %lu -> %lu\n",
+				counter->count, counter->bc_offset,
+				counter->target_bc_offset);
+		}
+	}
+
+	free(cus);
+}
+
+void profiler_dump(void)
+{
+	/* The tables are missing if the VM exits before it is started. */
+	if (opt_profile && methods)
+		profiler_dump_samples();
+
+	if (opt_profile_counters)
+		profiler_dump_counters();
+}
@@ -33,6 +33,7 @@
 #include "vm/jni.h"
 #include "vm/object.h"
 #include "vm/preload.h"
+#include "vm/profiler.h"
 #include "vm/signal.h"
 #include "vm/stack-trace.h"
 #include "vm/thread.h"
@@ -167,6 +168,8 @@ static void sigquit_handler(int sig, siginfo_t *si, void *ctx)
 {
 	struct vm_thread *this;
 
+	profiler_request_dump();
+
 	print_trace();
 
 	if (main_called)
@@ -189,6 +192,12 @@ void setup_signal_handlers(void)
 	sigemptyset(&sa.sa_mask);
 	sa.sa_flags	= SA_RESTART | SA_SIGINFO;
 
+	/*
+	 * A thread that stops at a safepoint poll must not be stopped
+	 * again by the GC from within the SIGSEGV handler.
+	 */
+	sigaddset(&sa.sa_mask, SIGUSR1);
+
 	sa.sa_sigaction	= sigsegv_handler;
 	sigaction(SIGSEGV, &sa, NULL);
 
@@ -47,6 +47,8 @@
 #include "jit/exception.h"
 #include "jit/compiler.h"
 
+#include "arch/memory.h"
+
 #include "lib/symbol.h"
 
 #include <stdlib.h>
@@ -61,6 +63,7 @@ __thread struct jni_stack_entry jni_stack[JNI_STACK_SIZE];
 __thread unsigned long jni_stack_offset;
 __thread struct vm_native_stack_entry vm_native_stack[VM_NATIVE_STACK_SIZE];
 __thread unsigned long vm_native_stack_offset;
+__thread struct interp_frame *interp_frame_top;
 
 void init_stack_trace_printing(void)
 {
@@ -91,21 +94,31 @@ static bool vm_native_stack_is_full(void)
 	return vm_native_stack_index() == VM_NATIVE_STACK_SIZE;
 }
 
+/*
+ * The stacks can be walked by a signal handler that interrupts the
+ * owning thread, see vm/profiler.c. New entries are filled in before
+ * they are pushed so that the handler never sees a partial entry.
+ */
 static inline struct jni_stack_entry *new_jni_stack_entry(void)
 {
-	struct jni_stack_entry *tr = (void*)jni_stack + jni_stack_offset;
+	return (void*)jni_stack + jni_stack_offset;
+}
 
+static inline void push_jni_stack_entry(void)
+{
+	barrier();
 	jni_stack_offset += sizeof(struct jni_stack_entry);
-	return tr;
 }
 
 static inline struct vm_native_stack_entry *new_vm_native_stack_entry(void)
 {
-	struct vm_native_stack_entry *tr = (void*)vm_native_stack +
-		vm_native_stack_offset;
+	return (void*)vm_native_stack + vm_native_stack_offset;
+}
 
+static inline void push_vm_native_stack_entry(void)
+{
+	barrier();
 	vm_native_stack_offset += sizeof(struct vm_native_stack_entry);
-	return tr;
 }
 
 int vm_enter_jni(void *caller_frame, struct vm_method *method,
@@ -125,6 +138,7 @@ int vm_enter_jni(void *caller_frame, struct vm_method *method,
 	tr->caller_frame = caller_frame;
 	tr->return_address = return_address;
 	tr->method = method;
+	push_jni_stack_entry();
 	return 0;
 }
 
@@ -143,6 +157,7 @@ int vm_enter_vm_native(void *target, void *stack_ptr)
 
 	tr->stack_ptr = stack_ptr;
 	tr->target = target;
+	push_vm_native_stack_entry();
 	return 0;
 }
 
@@ -157,6 +172,29 @@ void vm_leave_vm_native(void)
 	vm_native_stack_offset -= sizeof(struct vm_native_stack_entry);
 }
 
+void vm_enter_interp(struct interp_frame *frame)
+{
+	frame->prev = interp_frame_top;
+	barrier();
+	interp_frame_top = frame;
+}
+
+void vm_leave_interp(void)
+{
+	interp_frame_top = interp_frame_top->prev;
+}
+
+static void init_stack_trace_elem_interp(struct stack_trace_elem *elem,
+					 struct interp_frame *frame)
+{
+	elem->type = STACK_TRACE_ELEM_TYPE_INTERP;
+	elem->is_native = true;
+	elem->cu = frame->method->compilation_unit;
+	elem->addr = frame->pc;
+	elem->frame = frame->native_frame;
+	elem->interp_frame = frame->prev;
+}
+
 /**
  * stack_trace_elem_next - sets @elem to the next call stack element.
  *
@@ -254,6 +292,19 @@ int stack_trace_elem_next(struct stack_trace_elem *elem)
 		}
 	}
 
+	/*
+	 * Check if we hit the frame of an interpreted method. JNI calls
+	 * are skipped as a whole so drop interpreter frames that lie
+	 * below @new_frame first.
+	 */
+	while (elem->interp_frame && elem->interp_frame->native_frame < new_frame)
+		elem->interp_frame = elem->interp_frame->prev;
+
+	if (elem->interp_frame && elem->interp_frame->native_frame == new_frame) {
+		init_stack_trace_elem_interp(elem, elem->interp_frame);
+		return 0;
+	}
+
 	/* Check if previous elemement was called from JIT trampoline. */
 	if (elem->is_native && called_from_jit_trampoline(elem->frame)) {
 		elem->type = STACK_TRACE_ELEM_TYPE_TRAMPOLINE;
@@ -306,6 +357,7 @@ void init_stack_trace_elem(struct stack_trace_elem *elem, unsigned long addr,
 
 	elem->vm_native_stack_index = vm_native_stack_index() - 1;
 	elem->jni_stack_index = jni_stack_index() - 1;
+	elem->interp_frame = interp_frame_top;
 
 	if (vm_native_stack_get_frame() == frame) {
 		elem->type = STACK_TRACE_ELEM_TYPE_VM_NATIVE;
@@ -313,12 +365,67 @@ void init_stack_trace_elem(struct stack_trace_elem *elem, unsigned long addr,
 	}
 }
 
+/**
+ * init_stack_trace_elem_native_caller - sets @elem to the innermost VM
+ *     native, JNI or interpreted method that the current thread runs.
+ *     This is used to walk the stack from native code whose frame
+ *     pointers can not be trusted.
+ *
+ * Returns 0 on success and -1 when no such method is on the stack.
+ */
+int init_stack_trace_elem_native_caller(struct stack_trace_elem *elem)
+{
+	struct interp_frame *interp = interp_frame_top;
+	struct jni_stack_entry *jni = NULL;
+	void *vm_native_frame;
+
+	vm_native_frame = vm_native_stack_get_frame();
+
+	if (jni_stack_index() > 0)
+		jni = &jni_stack[jni_stack_index() - 1];
+
+	if (interp && (!vm_native_frame || interp->native_frame < vm_native_frame) &&
+	    (!jni || interp->native_frame < jni->caller_frame)) {
+		init_stack_trace_elem_interp(elem, interp);
+
+		elem->vm_native_stack_index = vm_native_stack_index() - 1;
+		elem->jni_stack_index = jni_stack_index() - 1;
+		return 0;
+	}
+
+	/* The stack grows down so the innermost call has the lowest frame. */
+	if (jni && (!vm_native_frame || jni->caller_frame < vm_native_frame)) {
+		/* JNI_OnLoad invocations have no method */
+		if (!jni->method)
+			return -1;
+
+		elem->type = STACK_TRACE_ELEM_TYPE_JNI;
+		elem->is_native = false;
+		elem->cu = jni->method->compilation_unit;
+		elem->addr = jni->return_address;
+		elem->frame = NULL;
+
+		elem->vm_native_stack_index = vm_native_stack_index() - 1;
+		elem->jni_stack_index = jni_stack_index() - 1;
+		elem->interp_frame = interp;
+		return 0;
+	}
+
+	if (!vm_native_frame)
+		return -1;
+
+	init_stack_trace_elem(elem, (unsigned long) vm_native_stack[vm_native_stack_index() - 1].target,
+			      vm_native_frame);
+	return 0;
+}
+
 struct compilation_unit *stack_trace_elem_get_cu(struct stack_trace_elem *elem)
 {
 	if (elem->type == STACK_TRACE_ELEM_TYPE_OTHER)
 		return NULL;
 
-	if (elem->type == STACK_TRACE_ELEM_TYPE_JNI)
+	if (elem->type == STACK_TRACE_ELEM_TYPE_JNI ||
+	    elem->type == STACK_TRACE_ELEM_TYPE_INTERP)
 		return elem->cu;
 
 	return jit_lookup_cu(elem->addr);
@@ -374,9 +481,11 @@ int get_java_stack_trace_depth(struct stack_trace_elem *elem)
 
 /**
  * get_intermediate_stack_trace - returns an array with intermediate
- *   java stack trace. Each stack trace element is described by two
- *   consequtive elements: a pointer to struct vm_method and bytecode
- *   offset.
+ *   java stack trace. Each stack trace element is described by three
+ *   consequtive elements: the element type, a pointer to struct
+ *   compilation_unit for JNI and interpreted methods or the
+ *   instruction address otherwise, and the bytecode offset of
+ *   interpreted methods.
  */
 static struct vm_object *get_intermediate_stack_trace(void)
 {
@@ -400,18 +509,27 @@ static struct vm_object *get_intermediate_stack_trace(void)
 	if (depth == 0)
 		return NULL;
 
-	array = vm_object_alloc_primitive_array(J_NATIVE_PTR, depth * 2);
+	array = vm_object_alloc_primitive_array(J_NATIVE_PTR, depth * 3);
 	if (!array)
 		return NULL;
 
 	i = 0;
 	do {
-		if (st_elem.type == STACK_TRACE_ELEM_TYPE_JNI) {
-			array_set_field_ptr(array, i++, (void*) st_elem.type);
+		array_set_field_ptr(array, i++, (void*) st_elem.type);
+
+		switch (st_elem.type) {
+		case STACK_TRACE_ELEM_TYPE_JNI:
 			array_set_field_ptr(array, i++, st_elem.cu);
-		} else {
-			array_set_field_ptr(array, i++, (void*) st_elem.type);
+			array_set_field_ptr(array, i++, (void*) BC_OFFSET_UNKNOWN);
+			break;
+		case STACK_TRACE_ELEM_TYPE_INTERP:
+			array_set_field_ptr(array, i++, st_elem.cu);
+			array_set_field_ptr(array, i++, (void*) st_elem.addr);
+			break;
+		default:
 			array_set_field_ptr(array, i++, (void*) st_elem.addr);
+			array_set_field_ptr(array, i++, NULL);
+			break;
 		}
 	} while (stack_trace_elem_next_java(&st_elem) == 0);
 
@@ -442,6 +560,8 @@ void print_java_stack_trace_elem(struct stack_trace_elem *elem)
 
 	if (elem->type == STACK_TRACE_ELEM_TYPE_TRAMPOLINE)
 		bc_offset = 0;
+	else if (elem->type == STACK_TRACE_ELEM_TYPE_INTERP)
+		bc_offset = elem->addr;
 	else {
 		bc_offset = jit_lookup_bc_offset(cu,
 						(unsigned char *) elem->addr);
@@ -520,7 +640,7 @@ convert_intermediate_stack_trace(struct vm_object *array)
 	depth = vm_array_length(array);
 
 	ste_array = vm_object_alloc_array(
-		vm_array_of_java_lang_StackTraceElement, depth / 2);
+		vm_array_of_java_lang_StackTraceElement, depth / 3);
 	if (!ste_array)
 		return NULL;
 
@@ -530,9 +650,10 @@ convert_intermediate_stack_trace(struct vm_object *array)
 		unsigned long bc_offset;
 
 		type = (enum stack_trace_elem_type) array_get_field_ptr(array, i++);
-		if (type == STACK_TRACE_ELEM_TYPE_JNI) {
+		if (type == STACK_TRACE_ELEM_TYPE_JNI ||
+		    type == STACK_TRACE_ELEM_TYPE_INTERP) {
 			cu = array_get_field_ptr(array, i++);
-			bc_offset = BC_OFFSET_UNKNOWN;
+			bc_offset = (unsigned long) array_get_field_ptr(array, i++);
 		} else {
 			void *addr = array_get_field_ptr(array, i++);
 			cu = jit_lookup_cu((unsigned long) addr);
@@ -540,6 +661,7 @@ convert_intermediate_stack_trace(struct vm_object *array)
 				error("no compilation_unit mapping for %p", addr);
 
 			bc_offset = jit_lookup_bc_offset(cu, addr);
+			i++;
 		}
 
 		struct vm_object *ste
@@ -572,9 +694,15 @@ struct vm_object *get_java_stack_trace(void)
 struct vm_object *
 native_vmthrowable_fill_in_stack_trace(struct vm_object *throwable)
 {
+	struct vm_exec_env *ee = vm_get_exec_env();
 	struct vm_object *vmstate;
 	struct vm_object *array;
 
+	if (ee->omit_stack_trace) {
+		ee->omit_stack_trace = false;
+		return NULL;
+	}
+
 	vmstate = vm_object_alloc(vm_java_lang_VMThrowable);
 	if (!vmstate)
 		return NULL;
@@ -714,6 +842,7 @@ static const char *stack_trace_elem_type_names[] = {
 	[STACK_TRACE_ELEM_TYPE_JIT] = "jit",
 	[STACK_TRACE_ELEM_TYPE_VM_NATIVE] = "vm native",
 	[STACK_TRACE_ELEM_TYPE_JNI] = "jni",
+	[STACK_TRACE_ELEM_TYPE_INTERP] = "interp",
 	[STACK_TRACE_ELEM_TYPE_OTHER] = "native",
 	[STACK_TRACE_ELEM_TYPE_TRAMPOLINE] = "trampoline",
 };
@@ -31,100 +31,305 @@
 #include "vm/preload.h"
 #include "vm/errors.h"
 #include "vm/object.h"
+#include "vm/utf8.h"
 #include "vm/die.h"
-#include "vm/reference.h"
-
-#include "lib/hash-map.h"
+#include "vm/gc.h"
 
 #include <pthread.h>
 #include <memory.h>
-
-static struct hash_map *literals;
-static pthread_mutex_t literals_mutex = PTHREAD_MUTEX_INITIALIZER;
+#include <stdio.h>
 
 /*
- * Compare key1 string and key2 weak reference to string.
+ * Interned strings are kept in a hash table that is split into shards
+ * by the high bits of the string hash. Every shard has its own lock and
+ * an open-addressed table of strings together with their hash codes, so
+ * threads that intern different strings rarely touch the same lock and
+ * probing compares the cached hash codes before the characters.
+ *
+ * The tables are allocated with vm_alloc() which makes every interned
+ * string a GC root. Interned strings are never removed.
  */
-static bool string_obj_equals(const void *key1, const void *key2)
-{
-	struct vm_object *array1, *array2;
-	jint offset1, offset2;
-	jint count1, count2;
 
-	count1 = field_get_int(key1, vm_java_lang_String_count);
-	count2 = field_get_int(key2, vm_java_lang_String_count);
+#define NR_LITERAL_SHARDS		64
+#define LITERAL_SHARD_BITS		6
+#define LITERAL_SHARD_INITIAL_SIZE	256
 
-	if (count1 != count2)
-		return false;
+struct literal_entry {
+	uint32_t		hash;
+	struct vm_object	*string;
+};
+
+struct literal_shard {
+	pthread_mutex_t		mutex;
+	struct literal_entry	*entries;
+	unsigned long		size;
+	unsigned long		nr_entries;
+
+	unsigned long		nr_lookups;
+	unsigned long		nr_contended;
+} __attribute__((aligned(64)));
 
-	offset1 = field_get_int(key1, vm_java_lang_String_offset);
-	offset2 = field_get_int(key2, vm_java_lang_String_offset);
+static struct literal_shard literals[NR_LITERAL_SHARDS];
 
-	array1 = field_get_object(key1, vm_java_lang_String_value);
-	array2 = field_get_object(key2, vm_java_lang_String_value);
+typedef bool (*literal_match_fn)(struct vm_object *, const void *, unsigned int);
 
-	int fsize = vmtype_get_size(J_CHAR);
+static inline uint32_t string_hash_step(uint32_t hash, uint16_t ch)
+{
+	return 31 * hash + ch;
+}
 
-	return memcmp(vm_array_elems(array1) + offset1 * fsize,
-		      vm_array_elems(array2) + offset2 * fsize,
-		      count1 * fsize) == 0;
+/* Spreads the bits of the string hash over the shard and slot indexes. */
+static inline uint32_t literal_hash_mix(uint32_t hash)
+{
+	return hash * 0x9e3779b1U;
 }
 
-static unsigned long string_obj_hash(const void *key)
+static uint16_t *string_chars(struct vm_object *string, jint *count)
 {
 	struct vm_object *array;
-	unsigned long hash;
 	jint offset;
+
+	offset = field_get_int(string, vm_java_lang_String_offset);
+	*count = field_get_int(string, vm_java_lang_String_count);
+	array = field_get_object(string, vm_java_lang_String_value);
+
+	return (uint16_t *) vm_array_elems(array) + offset;
+}
+
+static uint32_t string_obj_hash(struct vm_object *string)
+{
+	uint16_t *chars;
+	uint32_t hash;
 	jint count;
 
-	offset = field_get_int(key, vm_java_lang_String_offset);
-	count = field_get_int(key, vm_java_lang_String_count);
-	array = field_get_object(key, vm_java_lang_String_value);
+	chars = string_chars(string, &count);
 
 	hash = 0;
 
 	for (jint i = 0; i < count; i++)
-		hash = 31 * hash + array_get_field_char(array, i + offset);
+		hash = string_hash_step(hash, chars[i]);
 
 	return hash;
 }
 
-static struct key_operations string_obj_key_ops = {
-	.hash	= string_obj_hash,
-	.equals	= string_obj_equals
-};
+static bool string_obj_equals(struct vm_object *string, const void *key, unsigned int unused)
+{
+	uint16_t *chars1, *chars2;
+	jint count1, count2;
+
+	chars1 = string_chars(string, &count1);
+	chars2 = string_chars((struct vm_object *) key, &count2);
+
+	if (count1 != count2)
+		return false;
+
+	return memcmp(chars1, chars2, count1 * sizeof(uint16_t)) == 0;
+}
+
+static bool string_utf8_equals(struct vm_object *string, const void *key, unsigned int length)
+{
+	const uint8_t *bytes = key;
+	unsigned int pos = 0;
+	uint16_t *chars;
+	jint count;
+
+	chars = string_chars(string, &count);
+
+	for (jint i = 0; i < count; i++) {
+		if (pos >= length)
+			return false;
+
+		if (utf8_next_char(bytes, &pos) != chars[i])
+			return false;
+	}
+
+	return pos == length;
+}
+
+static struct literal_shard *literal_shard_lock(uint32_t hash)
+{
+	struct literal_shard *shard;
+
+	shard = &literals[literal_hash_mix(hash) >> (32 - LITERAL_SHARD_BITS)];
+
+	if (pthread_mutex_trylock(&shard->mutex)) {
+		pthread_mutex_lock(&shard->mutex);
+		shard->nr_contended++;
+	}
+
+	shard->nr_lookups++;
+
+	return shard;
+}
+
+static void literal_shard_unlock(struct literal_shard *shard)
+{
+	pthread_mutex_unlock(&shard->mutex);
+}
+
+/*
+ * Returns the slot of the string that matches @key or the empty slot
+ * where it should be inserted.
+ */
+static struct literal_entry *
+literal_shard_find(struct literal_shard *shard, uint32_t hash,
+		   literal_match_fn match, const void *key, unsigned int length)
+{
+	unsigned long mask = shard->size - 1;
+	unsigned long i;
+
+	for (i = literal_hash_mix(hash) & mask; ; i = (i + 1) & mask) {
+		struct literal_entry *entry = &shard->entries[i];
+
+		if (!entry->string)
+			return entry;
+
+		if (entry->hash == hash && match(entry->string, key, length))
+			return entry;
+	}
+}
+
+static int literal_shard_grow(struct literal_shard *shard)
+{
+	struct literal_entry *old_entries;
+	unsigned long old_size;
+
+	old_entries = shard->entries;
+	old_size = shard->size;
+
+	shard->size = old_size * 2;
+	shard->entries = vm_zalloc(sizeof(struct literal_entry) * shard->size);
+	if (!shard->entries) {
+		shard->entries = old_entries;
+		shard->size = old_size;
+		return -1;
+	}
+
+	for (unsigned long i = 0; i < old_size; i++) {
+		struct literal_entry *entry = &old_entries[i];
+
+		if (!entry->string)
+			continue;
+
+		*literal_shard_find(shard, entry->hash, string_obj_equals, entry->string, 0) = *entry;
+	}
+
+	vm_free(old_entries);
+
+	return 0;
+}
 
 void init_literals_hash_map(void)
 {
-	literals = alloc_hash_map(&string_obj_key_ops);
-	if (!literals)
-		error("failed to initialize literals hash map");
+	for (unsigned int i = 0; i < NR_LITERAL_SHARDS; i++) {
+		struct literal_shard *shard = &literals[i];
+
+		pthread_mutex_init(&shard->mutex, NULL);
+
+		shard->size = LITERAL_SHARD_INITIAL_SIZE;
+		shard->entries = vm_zalloc(sizeof(struct literal_entry) * shard->size);
+		if (!shard->entries)
+			error("failed to initialize literals hash map");
+	}
 }
 
 struct vm_object *vm_string_intern(struct vm_object *string)
 {
-	struct vm_reference *intern;
+	struct literal_shard *shard;
+	struct literal_entry *entry;
 	struct vm_object *result;
+	uint32_t hash;
 
-	pthread_mutex_lock(&literals_mutex);
+	hash = string_obj_hash(string);
 
-	if (hash_map_get(literals, string, (void **) &intern) == 0) {
-		pthread_mutex_unlock(&literals_mutex);
-		result = vm_reference_get(intern);
-		return result;
-	}
+	shard = literal_shard_lock(hash);
 
-	result = string;
-	intern = vm_reference_alloc(result, VM_REFERENCE_STRONG);
-	if (!intern) {
-		result = throw_oom_error();
+	entry = literal_shard_find(shard, hash, string_obj_equals, string, 0);
+	if (entry->string) {
+		result = entry->string;
 		goto out;
 	}
 
-	if (hash_map_put(literals, string, intern))
-		result = throw_oom_error();
+	/* Keep the table at most three quarters full. */
+	if (4 * (shard->nr_entries + 1) > 3 * shard->size) {
+		if (literal_shard_grow(shard)) {
+			result = throw_oom_error();
+			goto out;
+		}
+
+		entry = literal_shard_find(shard, hash, string_obj_equals, string, 0);
+	}
+
+	entry->hash = hash;
+	entry->string = string;
+	shard->nr_entries++;
 
+	result = string;
  out:
-	pthread_mutex_unlock(&literals_mutex);
+	literal_shard_unlock(shard);
 	return result;
 }
+
+/*
+ * Returns the interned string for the modified UTF-8 @bytes. The string
+ * is only allocated if it has not been interned yet.
+ */
+struct vm_object *vm_string_intern_utf8(const uint8_t *bytes, unsigned int length)
+{
+	struct literal_shard *shard;
+	struct literal_entry *entry;
+	struct vm_object *result;
+	unsigned int count;
+	unsigned int pos;
+	uint32_t hash;
+
+	if (utf8_char_count(bytes, length, &count))
+		return rethrow_exception();
+
+	hash = 0;
+
+	for (pos = 0; pos < length; )
+		hash = string_hash_step(hash, utf8_next_char(bytes, &pos));
+
+	shard = literal_shard_lock(hash);
+	entry = literal_shard_find(shard, hash, string_utf8_equals, bytes, length);
+	result = entry->string;
+	literal_shard_unlock(shard);
+
+	if (result)
+		return result;
+
+	result = vm_object_alloc_string_from_utf8_count(bytes, length, count);
+	if (!result)
+		return NULL;
+
+	/* Another thread may have interned the same string meanwhile. */
+	return vm_string_intern(result);
+}
+
+void vm_string_print_stats(void)
+{
+	unsigned long nr_entries = 0, nr_lookups = 0, nr_contended = 0;
+	unsigned long max_entries = 0;
+
+	for (unsigned int i = 0; i < NR_LITERAL_SHARDS; i++) {
+		struct literal_shard *shard = &literals[i];
+
+		pthread_mutex_lock(&shard->mutex);
+
+		nr_entries += shard->nr_entries;
+		nr_lookups += shard->nr_lookups;
+		nr_contended += shard->nr_contended;
+
+		if (shard->nr_entries > max_entries)
+			max_entries = shard->nr_entries;
+
+		pthread_mutex_unlock(&shard->mutex);
+	}
+
+	fprintf(stderr, "String table: %lu strings in %d shards, largest shard %lu strings\n",
+		nr_entries, NR_LITERAL_SHARDS, max_entries);
+	fprintf(stderr, "String table: %lu lookups, %lu contended (%.2f%%)\n",
+		nr_lookups, nr_contended,
+		nr_lookups ? 100.0 * nr_contended / nr_lookups : 0.0);
+}
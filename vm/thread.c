@@ -31,6 +31,7 @@
 #include "vm/die.h"
 #include "vm/errors.h"
 #include "vm/gc.h"
+#include "vm/monitor.h"
 #include "vm/object.h"
 #include "vm/preload.h"
 #include "vm/reference.h"
@@ -44,6 +45,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 
 pthread_key_t current_exec_env_key;
 
@@ -62,6 +64,14 @@ static int nr_non_daemons;
 
 struct list_head thread_list;
 
+/*
+ * Execution environments of all threads that run VM code, including the
+ * threads that are not Java threads. These are the threads that the GC
+ * stops. Protected by threads_mutex.
+ */
+struct list_head exec_env_list = LIST_HEAD_INIT(exec_env_list);
+static unsigned int nr_exec_envs;
+
 static bool thread_count_locked;
 static pthread_cond_t thread_count_lock_cond = PTHREAD_COND_INITIALIZER;
 
@@ -144,6 +154,12 @@ unsigned int vm_nr_threads(void)
 	return nr_threads;
 }
 
+/* Must hold threads_mutex */
+unsigned int vm_nr_exec_envs(void)
+{
+	return nr_exec_envs;
+}
+
 void vm_thread_set_state(struct vm_thread *thread, enum vm_thread_state state)
 {
 	atomic_set(&thread->state, state);
@@ -244,6 +260,19 @@ int init_threading(void)
 	return 0;
 }
 
+static atomic_t next_thread_id = { 1 };
+
+static unsigned long alloc_thread_id(void)
+{
+	int id;
+
+	do {
+		id = atomic_read(&next_thread_id);
+	} while (atomic_cmpxchg(&next_thread_id, id, id + 1) != id);
+
+	return id;
+}
+
 static struct vm_exec_env *alloc_exec_env(void)
 {
 	struct vm_exec_env *ee;
@@ -254,14 +283,60 @@ static struct vm_exec_env *alloc_exec_env(void)
 
 	ee->thread			= NULL;
 	ee->exception			= NULL;
+	ee->omit_stack_trace		= false;
+	ee->stack_trace_pending		= NULL;
 	ee->trace_classloader_level	= 0;
 	INIT_LIST_HEAD(&ee->free_monitor_recs);
 	ee->in_safepoint	= false;
+	ee->stopped_in_native	= false;
+	INIT_LIST_HEAD(&ee->list_node);
 	ee->trace_buffer = NULL;
+	ee->stack_end = NULL;
+	ee->safepoint_sp = NULL;
+	memset(&ee->tlab, 0, sizeof(ee->tlab));
+	ee->thin_lock_word = (alloc_thread_id() << THIN_LOCK_ID_SHIFT) | THIN_LOCK_TAG;
 
 	return ee;
 }
 
+/*
+ * Records the stack bounds of the current thread and makes it visible to
+ * the GC. Must be called by the thread that @ee belongs to.
+ */
+static void exec_env_init_stack(struct vm_exec_env *ee)
+{
+	pthread_attr_t attr;
+	size_t stack_size;
+	void *stack_addr;
+
+	if (pthread_getattr_np(pthread_self(), &attr) != 0)
+		die("pthread_getattr_np");
+
+	if (pthread_attr_getstack(&attr, &stack_addr, &stack_size) != 0)
+		die("pthread_attr_getstack");
+
+	pthread_attr_destroy(&attr);
+
+	ee->stack_end = stack_addr + stack_size;
+	ee->posix_id = pthread_self();
+
+	pthread_mutex_lock(&threads_mutex);
+	while (thread_count_locked)
+		pthread_cond_wait(&thread_count_lock_cond, &threads_mutex);
+
+	list_add(&ee->list_node, &exec_env_list);
+	nr_exec_envs++;
+
+	pthread_mutex_unlock(&threads_mutex);
+}
+
+/* The caller must hold threads_mutex */
+static void exec_env_detach(struct vm_exec_env *ee)
+{
+	list_del(&ee->list_node);
+	nr_exec_envs--;
+}
+
 static void free_exec_env(struct vm_exec_env *env)
 {
 	struct vm_monitor_record *this, *next;
@@ -284,6 +359,32 @@ void init_exec_env(void)
 		error("out of memory");
 
 	pthread_setspecific(current_exec_env_key, vm_exec_env);
+	current_exec_env = vm_exec_env;
+
+	exec_env_init_stack(vm_exec_env);
+}
+
+/**
+ * Sets up execution environment for a VM internal thread, such as a JIT
+ * compiler thread, that is not associated with a java.lang.Thread.
+ */
+int init_internal_exec_env(void)
+{
+	struct vm_exec_env *ee;
+
+	ee = alloc_exec_env();
+	if (!ee)
+		return -ENOMEM;
+
+	pthread_setspecific(current_exec_env_key, ee);
+	current_exec_env = ee;
+
+	exec_env_init_stack(ee);
+
+	thread_init_cu_mapping();
+	thread_init_exceptions();
+
+	return 0;
 }
 
 /**
@@ -295,8 +396,12 @@ static void *vm_thread_entry(void *arg)
 	struct vm_thread *thread = ee->thread;
 
 	pthread_setspecific(current_exec_env_key, ee);
+	current_exec_env = ee;
+
+	exec_env_init_stack(ee);
 
 	setup_signal_handlers();
+	thread_init_cu_mapping();
 	thread_init_exceptions();
 
 	/* XXX: Prevent collection of associated VMThread until
@@ -317,6 +422,7 @@ static void *vm_thread_entry(void *arg)
 		pthread_cond_wait(&thread_count_lock_cond, &threads_mutex);
 
 	vm_thread_detach_thread(vm_thread_self());
+	exec_env_detach(ee);
 	pthread_mutex_unlock(&threads_mutex);
 
 	thread->ee = NULL;
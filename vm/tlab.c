@@ -0,0 +1,85 @@
+/*
+ * Thread-local allocation buffers
+ *
+ * This file is released under the GPL version 2 with the following
+ * clarification and special exception:
+ *
+ *     Linking this library statically or dynamically with other modules is
+ *     making a combined work based on this library. Thus, the terms and
+ *     conditions of the GNU General Public License cover the whole
+ *     combination.
+ *
+ *     As a special exception, the copyright holders of this library give you
+ *     permission to link this library with independent modules to produce an
+ *     executable, regardless of the license terms of these independent
+ *     modules, and to copy and distribute the resulting executable under terms
+ *     of your choice, provided that you also meet, for each linked independent
+ *     module, the terms and conditions of the license of that module. An
+ *     independent module is a module which is not derived from or based on
+ *     this library. If you modify this library, you may extend this exception
+ *     to your version of the library, but you are not obligated to do so. If
+ *     you do not wish to do so, delete this exception statement from your
+ *     version.
+ *
+ * Please refer to the file LICENSE for details.
+ */
+
+#include "vm/tlab.h"
+#include "vm/thread.h"
+#include "vm/gc.h"
+
+bool tlab_enabled(void)
+{
+	return gc_ops.gc_alloc_many != NULL;
+}
+
+static void *__tlab_alloc(void **free_lists, size_t size, void *(*refill)(size_t))
+{
+	unsigned long index;
+	void **obj;
+
+	index = tlab_index(size);
+	if (index >= TLAB_NR_FREE_LISTS)
+		return NULL;
+
+	obj = free_lists[index];
+	if (!obj) {
+		obj = refill(index * TLAB_GRANULE);
+		if (!obj)
+			return NULL;
+	}
+
+	free_lists[index] = *obj;
+	*obj = NULL;
+
+	return obj;
+}
+
+/*
+ * Returns a cleared object of at least @size bytes from the free lists of
+ * the current thread or NULL if the object can not be allocated from a
+ * TLAB. Callers are expected to fall back to gc_alloc() in that case.
+ */
+void *tlab_alloc(size_t size)
+{
+	struct vm_exec_env *ee = current_exec_env;
+
+	if (!ee || !tlab_enabled())
+		return NULL;
+
+	return __tlab_alloc(ee->tlab.free_lists, size, gc_alloc_many);
+}
+
+/*
+ * Same as tlab_alloc() for objects whose content is not scanned by the GC.
+ * Callers fall back to gc_alloc_noscan().
+ */
+void *tlab_alloc_noscan(size_t size)
+{
+	struct vm_exec_env *ee = current_exec_env;
+
+	if (!ee || !tlab_enabled())
+		return NULL;
+
+	return __tlab_alloc(ee->tlab.noscan_free_lists, size, gc_alloc_many_noscan);
+}
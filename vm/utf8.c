@@ -8,18 +8,77 @@
 #include <string.h>
 #include <stdio.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Most strings in class files are plain ASCII. The ASCII runs are
+ * scanned and widened 16 bytes at a time with SSE2 and the scalar
+ * decoder only handles the multi-byte characters.
+ */
+
+/*
+ * Returns the number of ASCII bytes at the start of @bytes.
+ */
+unsigned int utf8_ascii_prefix(const uint8_t *bytes, unsigned int n)
+{
+	unsigned int i = 0;
+
+#ifdef __SSE2__
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) &bytes[i]);
+		int mask = _mm_movemask_epi8(v);
+
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+
+	while (i < n && !(bytes[i] & 0x80))
+		i++;
+
+	return i;
+}
+
+/*
+ * Zero-extends @n bytes to UTF-16 characters.
+ */
+void bytes_to_chars(uint16_t *chars, const uint8_t *bytes, unsigned int n)
+{
+	unsigned int i = 0;
+
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) &bytes[i]);
+
+		_mm_storeu_si128((__m128i *) &chars[i], _mm_unpacklo_epi8(v, zero));
+		_mm_storeu_si128((__m128i *) &chars[i + 8], _mm_unpackhi_epi8(v, zero));
+	}
+#endif
+
+	for (; i < n; i++)
+		chars[i] = bytes[i];
+}
+
 int utf8_char_count(const uint8_t *bytes, unsigned int n, unsigned int *res)
 {
 	unsigned int result = 0;
 
 	for (unsigned int i = 0; i < n; ++i) {
-		++result;
-
 		/* 0xxxxxxx: 1 byte */
 		if (!(bytes[i] & 0x80)) {
+			unsigned int len = utf8_ascii_prefix(&bytes[i], n - i);
+
+			result += len;
+			i += len - 1;
 			continue;
 		}
 
+		++result;
+
 		/* 110xxxxx: 2 bytes */
 		if ((bytes[i] & 0xe0) == 0xc0) {
 			if (i + 1 >= n)
@@ -59,29 +118,27 @@ struct vm_object *utf8_to_char_array(const uint8_t *bytes, unsigned int n)
 	if (!array)
 		return rethrow_exception();
 
-	for (unsigned int i = 0, j = 0; i < n; ++i) {
-		if (!(bytes[i] & 0x80)) {
-			array_set_field_char(array, j++, bytes[i]);
-			continue;
-		}
+	utf8_decode_chars(vm_array_elems(array), bytes, n);
 
-		if ((bytes[i] & 0xe0) == 0xc0) {
-			uint16_t ch = (uint16_t) (bytes[i] & 0x1f) << 6;
-			ch += bytes[++i] & 0x3f;
-			array_set_field_char(array, j++, ch);
-			continue;
-		}
+	return array;
+}
 
-		if ((bytes[i] & 0xf0) == 0xe0) {
-			uint16_t ch = (uint16_t) (bytes[i] & 0xf) << 12;
-			ch += (uint16_t) (bytes[++i] & 0x3f) << 6;
-			ch += bytes[++i] & 0x3f;
-			array_set_field_char(array, j++, ch);
-			continue;
-		}
-	}
+/*
+ * Decodes @n bytes of modified UTF-8 into @chars which must have room
+ * for the count returned by utf8_char_count().
+ */
+void utf8_decode_chars(uint16_t *chars, const uint8_t *bytes, unsigned int n)
+{
+	for (unsigned int i = 0, j = 0; i < n; ) {
+		unsigned int len = utf8_ascii_prefix(&bytes[i], n - i);
 
-	return array;
+		bytes_to_chars(&chars[j], &bytes[i], len);
+		i += len;
+		j += len;
+
+		if (i < n)
+			chars[j++] = utf8_next_char(bytes, &i);
+	}
 }
 
 char *dots_to_slash(const char *utf)